@@ -135,15 +135,18 @@ function GenerateMacOSXSettings(settings, conf, arch)
 	-- Build server launcher before adding game stuff
 	local serverlaunch = Link(settings, "serverlaunch", Compile(settings, "src/osxlaunch/server.m"))
 
-	-- Master server, version server and tools
+	-- Master server and version server
 	BuildEngineCommon(settings)
 	BuildMasterserver(settings)
 	BuildVersionserver(settings)
-	BuildTools(settings)
 
 	-- Add requirements for Server & Client
 	BuildGameCommon(settings)
 
+	-- Tools and benchmarks need the game's network objects
+	BuildTools(settings)
+	BuildBenchmarks(settings)
+
 	-- Server
 	settings.link.frameworks:Add("Cocoa")
 	local server_exe = BuildServer(settings)
@@ -176,15 +179,18 @@ function GenerateLinuxSettings(settings, conf, arch)
 
 	GenerateCommonSettings(settings, conf, arch)
 
-	-- Master server, version server and tools
+	-- Master server and version server
 	BuildEngineCommon(settings)
-	BuildTools(settings)
 	BuildMasterserver(settings)
 	BuildVersionserver(settings)
 
 	-- Add requirements for Server & Client
 	BuildGameCommon(settings)
 
+	-- Tools and benchmarks need the game's network objects
+	BuildTools(settings)
+	BuildBenchmarks(settings)
+
 	-- Server
 	BuildServer(settings)
 
@@ -235,15 +241,18 @@ function GenerateWindowsSettings(settings, conf, target_arch, compiler)
 
 	GenerateCommonSettings(settings, conf, target_arch)
 
-	-- Master server, version server and tools
+	-- Master server and version server
 	BuildEngineCommon(settings)
 	BuildMasterserver(settings)
 	BuildVersionserver(settings)
-	BuildTools(settings)
 
 	-- Add requirements for Server & Client
 	BuildGameCommon(settings)
 
+	-- Tools and benchmarks need the game's network objects
+	BuildTools(settings)
+	BuildBenchmarks(settings)
+
 	-- Server
 	local server_settings = settings:Copy()
 	server_settings.link.extrafiles:Add(icons.server)
@@ -320,13 +329,39 @@ function BuildGameCommon(settings)
 end
 
 
+-- client files that need no device, the benchmarks link them too
+headless_client_src = {"src/engine/client/sound_kernels.cpp", "src/engine/client/soundmixer.cpp", "src/game/client/prediction.cpp", "src/game/client/particle_group.cpp"}
+
+headless_client_files = {}
+function HeadlessClientFiles(settings)
+	-- compile only once per configuration
+
+	if not headless_client_files[settings] then
+		headless_client_files[settings] = Compile(settings, headless_client_src)
+	end
+
+	return headless_client_files[settings]
+end
+
 function BuildClient(settings, family, platform)
 	config.sdl:Apply(settings)
 	config.freetype:Apply(settings)
 	
-	local client = Compile(settings, Collect("src/engine/client/*.cpp"))
+	local client_src = {}
+	for i,v in ipairs(Collect("src/engine/client/*.cpp")) do
+		if not TableContains(headless_client_src, v) then
+			table.insert(client_src, v)
+		end
+	end
+	local client = Compile(settings, client_src, HeadlessClientFiles(settings))
 	
-	local game_client = Compile(settings, CollectRecursive("src/game/client/*.cpp"), SharedClientFiles())
+	local game_client_src = {}
+	for i,v in ipairs(CollectRecursive("src/game/client/*.cpp")) do
+		if not TableContains(headless_client_src, v) then
+			table.insert(game_client_src, v)
+		end
+	end
+	local game_client = Compile(settings, game_client_src, SharedClientFiles())
 	local game_editor = Compile(settings, Collect("src/game/editor/*.cpp"))
 	
 	Link(settings, "teeworlds", libs["zlib"], libs["md5"], libs["wavpack"], libs["png"], libs["json"], client, game_client, game_editor)
@@ -349,6 +384,15 @@ function BuildTools(settings)
 	PseudoTarget(settings.link.Output(settings, "pseudo_tools") .. settings.link.extension, tools)
 end
 
+function BuildBenchmarks(settings)
+	local benchmarks = {}
+	for i,v in ipairs(Collect("src/benchmarks/*.cpp")) do
+		local benchmarkname = PathFilename(PathBase(v))
+		benchmarks[i] = Link(settings, benchmarkname, Compile(settings, v), HeadlessClientFiles(settings), libs["zlib"], libs["md5"])
+	end
+	PseudoTarget(settings.link.Output(settings, "pseudo_benchmarks") .. settings.link.extension, benchmarks)
+end
+
 function BuildMasterserver(settings)
 	return Link(settings, "mastersrv", Compile(settings, Collect("src/mastersrv/*.cpp")), libs["zlib"], libs["md5"])
 end
@@ -435,6 +479,15 @@ function CopyToDir(dst, ...)
 	return output
 end
 
+function TableContains(tab, value)
+	for i,v in ipairs(tab) do
+		if v == value then
+			return true
+		end
+	end
+	return false
+end
+
 function split(str, sep)
 	local vals = {}
 	str:gsub("([^,]+)", function(val) table.insert(vals, val) end)
@@ -472,7 +525,7 @@ end
 
 targets = {client="teeworlds", server="teeworlds_srv",
            versionserver="versionsrv", masterserver="mastersrv",
-           tools="pseudo_tools", content="content"}
+           tools="pseudo_tools", benchmarks="pseudo_benchmarks", content="content"}
 
 subtargets = {}
 for t, cur_target in pairs(targets) do
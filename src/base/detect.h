@@ -140,6 +140,16 @@
 	#endif
 #endif
 
+#if defined(__arm__) || defined(_M_ARM)
+	#define CONF_ARCH_ARM 1
+	#define CONF_ARCH_STRING "arm"
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+	#define CONF_ARCH_ARM64 1
+	#define CONF_ARCH_STRING "arm64"
+#endif
+
 
 #ifndef CONF_FAMILY_STRING
 #define CONF_FAMILY_STRING "unknown"
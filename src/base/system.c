@@ -1,5 +1,9 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE /* recvmmsg and sendmmsg */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -11,6 +15,7 @@
 
 #if defined(CONF_FAMILY_UNIX)
 	#include <sys/time.h>
+	#include <sys/mman.h>
 	#include <unistd.h>
 
 	/* unix net includes */
@@ -27,6 +32,10 @@
 
 	#include <dirent.h>
 
+	#if defined(CONF_PLATFORM_LINUX)
+		#define NET_UDP_MMSG 1
+	#endif
+
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
 	#endif
@@ -38,6 +47,7 @@
 	#include <ws2tcpip.h>
 	#include <fcntl.h>
 	#include <direct.h>
+	#include <io.h>
 	#include <errno.h>
 #else
 	#error NOT IMPLEMENTED
@@ -47,6 +57,14 @@
 	#include <sys/filio.h>
 #endif
 
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -158,6 +176,33 @@ typedef struct MEMTAIL
 static struct MEMHEADER *first = 0;
 static const int MEM_GUARD_VAL = 0xbaadc0de;
 
+/* the list of blocks and the stats are shared by all threads */
+static volatile long mem_lock_flag = 0;
+
+static void mem_lock()
+{
+#if defined(__GNUC__)
+	while(__sync_lock_test_and_set(&mem_lock_flag, 1))
+		;
+#elif defined(CONF_FAMILY_WINDOWS)
+	while(InterlockedExchange(&mem_lock_flag, 1))
+		;
+#else
+	#error not implemented on this platform
+#endif
+}
+
+static void mem_unlock()
+{
+#if defined(__GNUC__)
+	__sync_lock_release(&mem_lock_flag);
+#elif defined(CONF_FAMILY_WINDOWS)
+	InterlockedExchange(&mem_lock_flag, 0);
+#else
+	#error not implemented on this platform
+#endif
+}
+
 void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned alignment)
 {
 	/* TODO: fix alignment */
@@ -171,18 +216,19 @@ void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned al
 	header->size = size;
 	header->filename = filename;
 	header->line = line;
+	tail->guard = MEM_GUARD_VAL;
 
+	mem_lock();
 	memory_stats.allocated += header->size;
 	memory_stats.total_allocations++;
 	memory_stats.active_allocations++;
 
-	tail->guard = MEM_GUARD_VAL;
-
 	header->prev = (MEMHEADER *)0;
 	header->next = first;
 	if(first)
 		first->prev = header;
 	first = header;
+	mem_unlock();
 
 	/*dbg_msg("mem", "++ %p", header+1); */
 	return header+1;
@@ -198,6 +244,7 @@ void mem_free(void *p)
 		if(tail->guard != MEM_GUARD_VAL)
 			dbg_msg("mem", "!! %p", p);
 		/* dbg_msg("mem", "-- %p", p); */
+		mem_lock();
 		memory_stats.allocated -= header->size;
 		memory_stats.active_allocations--;
 
@@ -207,6 +254,7 @@ void mem_free(void *p)
 			first = header->next;
 		if(header->next)
 			header->next->prev = header->prev;
+		mem_unlock();
 
 		free(header);
 	}
@@ -369,6 +417,40 @@ int io_flush(IOHANDLE io)
 	return 0;
 }
 
+void *io_map(IOHANDLE io, unsigned size)
+{
+	if(!size)
+		return 0;
+#if defined(CONF_FAMILY_UNIX)
+	void *data = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno((FILE*)io), 0);
+	if(data == MAP_FAILED)
+		return 0;
+	return data;
+#elif defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping;
+	void *data;
+	mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno((FILE*)io)), NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(!mapping)
+		return 0;
+	data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+	CloseHandle(mapping); /* the view keeps the mapping alive */
+	return data;
+#else
+	return 0;
+#endif
+}
+
+void io_unmap(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_UNIX)
+	munmap(data, size);
+#elif defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#endif
+}
+
 void *thread_init(void (*threadfunc)(void *), void *u)
 {
 #if defined(CONF_FAMILY_UNIX)
@@ -522,6 +604,32 @@ void lock_unlock(LOCK lock)
 	#endif
 #endif
 
+/* -----  atomics ----- */
+int atomic_load_acquire(const volatile int *value)
+{
+#if defined(__GNUC__)
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#elif defined(CONF_FAMILY_WINDOWS)
+	int result = *value;
+	MemoryBarrier();
+	return result;
+#else
+	#error not implemented on this platform
+#endif
+}
+
+void atomic_store_release(volatile int *value, int new_value)
+{
+#if defined(__GNUC__)
+	__atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#elif defined(CONF_FAMILY_WINDOWS)
+	MemoryBarrier();
+	*value = new_value;
+#else
+	#error not implemented on this platform
+#endif
+}
+
 
 /* -----  time ----- */
 int64 time_get()
@@ -1078,6 +1186,158 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize)
 	return -1; /* error */
 }
 
+#if defined(NET_UDP_MMSG)
+enum
+{
+	NET_UDP_MMSG_MAX = 64
+};
+
+static int priv_net_udp_recv_mmsg(int socket, NETDATAGRAM *datagrams, int num)
+{
+	struct mmsghdr msgs[NET_UDP_MMSG_MAX];
+	struct iovec iovecs[NET_UDP_MMSG_MAX];
+	struct sockaddr_storage addrs[NET_UDP_MMSG_MAX];
+	int i, received;
+
+	if(num > NET_UDP_MMSG_MAX)
+		num = NET_UDP_MMSG_MAX;
+
+	mem_zero(msgs, sizeof(struct mmsghdr)*num);
+	for(i = 0; i < num; i++)
+	{
+		iovecs[i].iov_base = datagrams[i].data;
+		iovecs[i].iov_len = datagrams[i].size;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	received = recvmmsg(socket, msgs, num, MSG_DONTWAIT, 0);
+	if(received <= 0)
+		return 0;
+
+	for(i = 0; i < received; i++)
+	{
+		sockaddr_to_netaddr((struct sockaddr *)&addrs[i], &datagrams[i].addr);
+		datagrams[i].size = msgs[i].msg_len;
+		network_stats.recv_bytes += msgs[i].msg_len;
+		network_stats.recv_packets++;
+	}
+	return received;
+}
+
+/* sends a run of packets that all go to unicast addresses of the socket's type */
+static int priv_net_udp_send_mmsg(int socket, int type, const NETDATAGRAM *datagrams, int num)
+{
+	struct mmsghdr msgs[NET_UDP_MMSG_MAX];
+	struct iovec iovecs[NET_UDP_MMSG_MAX];
+	union
+	{
+		struct sockaddr_in in;
+		struct sockaddr_in6 in6;
+	} addrs[NET_UDP_MMSG_MAX];
+	int i, first, sent = 0;
+
+	if(num > NET_UDP_MMSG_MAX)
+		num = NET_UDP_MMSG_MAX;
+
+	mem_zero(msgs, sizeof(struct mmsghdr)*num);
+	for(i = 0; i < num; i++)
+	{
+		if(type == NETTYPE_IPV4)
+		{
+			netaddr_to_sockaddr_in(&datagrams[i].addr, &addrs[i].in);
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i].in);
+		}
+		else
+		{
+			netaddr_to_sockaddr_in6(&datagrams[i].addr, &addrs[i].in6);
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i].in6);
+		}
+		iovecs[i].iov_base = datagrams[i].data;
+		iovecs[i].iov_len = datagrams[i].size;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+
+		network_stats.sent_bytes += datagrams[i].size;
+		network_stats.sent_packets++;
+	}
+
+	/* sendmmsg stops at the first packet that fails, skip it like sendto would */
+	first = 0;
+	while(first < num)
+	{
+		int result = sendmmsg(socket, msgs+first, num-first, 0);
+		if(result <= 0)
+		{
+			first++;
+			continue;
+		}
+		first += result;
+		sent += result;
+	}
+	return sent;
+}
+#endif
+
+int net_udp_send_batch(NETSOCKET sock, const NETDATAGRAM *datagrams, int num)
+{
+	int sent = 0;
+#if defined(NET_UDP_MMSG)
+	int i = 0;
+	while(i < num)
+	{
+		int type = datagrams[i].addr.type;
+		int socket = type == NETTYPE_IPV4 ? sock.ipv4sock : type == NETTYPE_IPV6 ? sock.ipv6sock : -1;
+		int count = 1;
+
+		/* broadcasts and missing sockets are left to net_udp_send */
+		if(socket < 0)
+		{
+			if(net_udp_send(sock, &datagrams[i].addr, datagrams[i].data, datagrams[i].size) >= 0)
+				sent++;
+			i++;
+			continue;
+		}
+
+		while(i+count < num && count < NET_UDP_MMSG_MAX && datagrams[i+count].addr.type == (unsigned)type)
+			count++;
+		sent += priv_net_udp_send_mmsg(socket, type, datagrams+i, count);
+		i += count;
+	}
+#else
+	int i;
+	for(i = 0; i < num; i++)
+	{
+		if(net_udp_send(sock, &datagrams[i].addr, datagrams[i].data, datagrams[i].size) >= 0)
+			sent++;
+	}
+#endif
+	return sent;
+}
+
+int net_udp_recv_batch(NETSOCKET sock, NETDATAGRAM *datagrams, int num)
+{
+	int received = 0;
+#if defined(NET_UDP_MMSG)
+	if(sock.ipv4sock >= 0)
+		received = priv_net_udp_recv_mmsg(sock.ipv4sock, datagrams, num);
+	if(received < num && sock.ipv6sock >= 0)
+		received += priv_net_udp_recv_mmsg(sock.ipv6sock, datagrams+received, num-received);
+#else
+	while(received < num)
+	{
+		int bytes = net_udp_recv(sock, &datagrams[received].addr, datagrams[received].data, datagrams[received].size);
+		if(bytes <= 0)
+			break;
+		datagrams[received++].size = bytes;
+	}
+#endif
+	return received;
+}
+
 int net_udp_close(NETSOCKET sock)
 {
 	return priv_net_close_all_sockets(sock);
@@ -1568,6 +1828,72 @@ int time_houroftheday()
 	return time_info->tm_hour;
 }
 
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+static void cpu_cpuid(unsigned leaf, unsigned *regs)
+{
+#if defined(_MSC_VER)
+	__cpuidex((int *)regs, leaf, 0);
+#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	if(leaf <= __get_cpuid_max(leaf&0x80000000, 0))
+		__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned cpu_xgetbv()
+{
+#if defined(_MSC_VER)
+	return (unsigned)_xgetbv(0);
+#else
+	unsigned eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return eax;
+#endif
+}
+#endif
+
+/* -1 until detected, threads that detect at the same time store the same flags */
+static volatile int cpu_feature_flags = -1;
+
+int cpu_features()
+{
+	int flags = atomic_load_acquire(&cpu_feature_flags);
+	if(flags != -1)
+		return flags;
+
+	flags = 0;
+
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	{
+		unsigned regs[4];
+		cpu_cpuid(0, regs);
+		if(regs[0] >= 1)
+		{
+			cpu_cpuid(1, regs);
+			if(regs[3]&(1<<26))
+				flags |= CPU_FEATURE_SSE2;
+
+			/* avx2 also needs the os to save the ymm registers */
+			if((regs[2]&(1<<27)) && (regs[2]&(1<<28)) && (cpu_xgetbv()&6) == 6)
+			{
+				cpu_cpuid(0, regs);
+				if(regs[0] >= 7)
+				{
+					cpu_cpuid(7, regs);
+					if(regs[1]&(1<<5))
+						flags |= CPU_FEATURE_AVX2;
+				}
+			}
+		}
+	}
+#elif defined(CONF_ARCH_ARM64) || defined(__ARM_NEON)
+	flags |= CPU_FEATURE_NEON;
+#endif
+
+	atomic_store_release(&cpu_feature_flags, flags);
+	return flags;
+}
+
 void str_append(char *dst, const char *src, int dst_size)
 {
 	int s = strlen(dst);
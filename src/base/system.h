@@ -87,6 +87,7 @@ void dbg_msg(const char *sys, const char *fmt, ...);
 	Remarks:
 		- Passing 0 to size will allocated the smallest amount possible
 		and return a unique pointer.
+		- Can be called from any thread.
 
 	See Also:
 		<mem_free>
@@ -102,6 +103,7 @@ void *mem_alloc_debug(const char *filename, int line, unsigned size, unsigned al
 		- In the debug version of the library the function will assert if
 		a non-valid block is passed, like a null pointer or a block that
 		isn't allocated.
+		- Can be called from any thread.
 
 	See Also:
 		<mem_alloc>
@@ -321,6 +323,35 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps a whole file into memory. The mapping is private, writing
+		to it changes the copy in memory only and never the file. It
+		stays valid after the file has been closed, but the file must
+		not be shortened while it is mapped.
+
+	Parameters:
+		io - Handle to the file.
+		size - Size of the file.
+
+	Returns:
+		Returns the start of the mapping, 0 if the file couldn't be mapped.
+
+	See Also:
+		<io_unmap>
+*/
+void *io_map(IOHANDLE io, unsigned size);
+
+/*
+	Function: io_unmap
+		Removes a mapping created by <io_map>.
+
+	Parameters:
+		data - Start of the mapping.
+		size - Size that was passed to <io_map>.
+*/
+void io_unmap(void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -427,14 +458,33 @@ void lock_unlock(LOCK lock);
 	void semaphore_destroy(SEMAPHORE *sem);
 #endif
 
+/* Group: Atomics */
+
+/*
+	Function: atomic_load_acquire
+		Reads an int that another thread writes with
+		<atomic_store_release>. Everything that thread wrote before
+		the store is visible after the load.
+*/
+int atomic_load_acquire(const volatile int *value);
+
+/*
+	Function: atomic_store_release
+		Writes an int so that everything written before is visible
+		to the thread that reads it with <atomic_load_acquire>.
+*/
+void atomic_store_release(volatile int *value, int new_value);
+
 /* Group: Timer */
 #ifdef __GNUC__
 /* if compiled with -pedantic-errors it will complain about long
 	not being a C90 thing.
 */
 __extension__ typedef long long int64;
+__extension__ typedef unsigned long long uint64;
 #else
 typedef long long int64;
+typedef unsigned long long uint64;
 #endif
 /*
 	Function: time_get
@@ -475,6 +525,27 @@ int time_timestamp();
 */
 int time_houroftheday();
 
+/* Group: CPU */
+enum
+{
+	CPU_FEATURE_SSE2=1,
+	CPU_FEATURE_AVX2=2,
+	CPU_FEATURE_NEON=4
+};
+
+/*
+	Function: cpu_features
+		Detects the vector instruction sets the processor and
+		operating system support.
+
+	Returns:
+		A combination of the CPU_FEATURE_* flags.
+
+	Remarks:
+		The detection only runs on the first call.
+*/
+int cpu_features();
+
 /* Group: Network General */
 typedef struct
 {
@@ -616,6 +687,57 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize);
 
+/*
+	Structure: NETDATAGRAM
+		One packet for <net_udp_send_batch> and <net_udp_recv_batch>.
+*/
+typedef struct
+{
+	NETADDR addr;
+	void *data;
+	int size;
+} NETDATAGRAM;
+
+/*
+	Function: net_udp_send_batch
+		Sends several packets over an UDP socket with as few system
+		calls as possible.
+
+	Parameters:
+		sock - Socket to use.
+		datagrams - Packets to send, each with its own address.
+		num - Number of packets.
+
+	Returns:
+		The number of packets that were sent without error.
+
+	Remarks:
+		- Uses sendmmsg where available and <net_udp_send> for
+		  every packet otherwise.
+*/
+int net_udp_send_batch(NETSOCKET sock, const NETDATAGRAM *datagrams, int num);
+
+/*
+	Function: net_udp_recv_batch
+		Recives all waiting packets over an UDP socket, up to the
+		given number, with as few system calls as possible.
+
+	Parameters:
+		sock - Socket to use.
+		datagrams - Packets to fill. data and size have to describe
+			the buffers, size and addr get set to what was recived.
+		num - Number of packets.
+
+	Returns:
+		The number of packets recived, 0 if none were waiting.
+
+	Remarks:
+		- Uses recvmmsg where available and <net_udp_recv> for
+		  every packet otherwise.
+		- A recived packet can have a size of 0.
+*/
+int net_udp_recv_batch(NETSOCKET sock, NETDATAGRAM *datagrams, int num);
+
 /*
 	Function: net_udp_close
 		Closes an UDP socket.
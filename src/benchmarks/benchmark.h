@@ -0,0 +1,25 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef BENCHMARKS_BENCHMARK_H
+#define BENCHMARKS_BENCHMARK_H
+
+// helpers shared by the benchmarks, each of them is a single file program
+
+// xorshift, so every platform generates the same input and runs can be compared
+static unsigned s_Seed = 1;
+
+inline unsigned Random()
+{
+	s_Seed ^= s_Seed<<13;
+	s_Seed ^= s_Seed>>17;
+	s_Seed ^= s_Seed<<5;
+	return s_Seed;
+}
+
+// restarts the sequence, 0 would only ever generate 0 so it becomes 1
+inline void SeedRandom(int Seed)
+{
+	s_Seed = Seed > 0 ? Seed : 1;
+}
+
+#endif
@@ -0,0 +1,275 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+
+#include "benchmark.h"
+
+// fuzzes CCollision::IntersectLine and MoveBox against the per pixel versions
+// they replaced and measures both on the same inputs
+
+enum
+{
+	NUM_LINES=200000,
+	NUM_BODIES=256,
+	BODY_TICKS=1000,
+};
+
+static float RandomFloat(float Min, float Max)
+{
+	return Min+(Random()%100000)*(Max-Min)/100000.0f;
+}
+
+static CCollision s_Collision;
+
+static int RefIntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance+1);
+	vec2 Last = Pos0;
+
+	for(int i = 0; i < End; i++)
+	{
+		float a = i/float(End);
+		vec2 Pos = mix(Pos0, Pos1, a);
+		if(s_Collision.CheckPoint(Pos.x, Pos.y))
+		{
+			if(pOutCollision)
+				*pOutCollision = Pos;
+			if(pOutBeforeCollision)
+				*pOutBeforeCollision = Last;
+			return s_Collision.GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static void RefMoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
+{
+	vec2 Pos = *pInoutPos;
+	vec2 Vel = *pInoutVel;
+
+	float Distance = length(Vel);
+	int Max = (int)Distance;
+
+	if(Distance > 0.00001f)
+	{
+		float Fraction = 1.0f/(float)(Max+1);
+		for(int i = 0; i <= Max; i++)
+		{
+			vec2 NewPos = Pos + Vel*Fraction;
+
+			if(s_Collision.TestBox(vec2(NewPos.x, NewPos.y), Size))
+			{
+				int Hits = 0;
+
+				if(s_Collision.TestBox(vec2(Pos.x, NewPos.y), Size))
+				{
+					NewPos.y = Pos.y;
+					Vel.y *= -Elasticity;
+					Hits++;
+				}
+
+				if(s_Collision.TestBox(vec2(NewPos.x, Pos.y), Size))
+				{
+					NewPos.x = Pos.x;
+					Vel.x *= -Elasticity;
+					Hits++;
+				}
+
+				if(Hits == 0)
+				{
+					NewPos.y = Pos.y;
+					Vel.y *= -Elasticity;
+					NewPos.x = Pos.x;
+					Vel.x *= -Elasticity;
+				}
+			}
+
+			Pos = NewPos;
+		}
+	}
+
+	*pInoutPos = Pos;
+	*pInoutVel = Vel;
+}
+
+static bool Same(vec2 a, vec2 b)
+{
+	return mem_comp(&a, &b, sizeof(vec2)) == 0;
+}
+
+static vec2 RandomPos()
+{
+	// a bit outside of the map as well
+	return vec2(RandomFloat(-64.0f, s_Collision.GetWidth()*32.0f+64.0f), RandomFloat(-64.0f, s_Collision.GetHeight()*32.0f+64.0f));
+}
+
+struct CLine
+{
+	vec2 m_From;
+	vec2 m_To;
+};
+
+static CLine s_aLines[NUM_LINES];
+
+static bool RunLines()
+{
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		// hook and projectile sized lines mostly, laser sized ones and axis aligned ones too
+		s_aLines[i].m_From = RandomPos();
+		float Length = (i%4) == 0 ? RandomFloat(0.0f, 800.0f) : RandomFloat(0.0f, 80.0f);
+		float Angle = RandomFloat(0.0f, 2*pi);
+		if(i%8 == 1)
+			Angle = (Random()%4)*pi/2;
+		s_aLines[i].m_To = s_aLines[i].m_From+vec2(cosf(Angle), sinf(Angle))*Length;
+		if(i%16 == 2)
+			s_aLines[i].m_To = s_aLines[i].m_From;
+	}
+
+	int Hits = 0;
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		vec2 RefCol, RefBefore, Col, Before;
+		int RefRes = RefIntersectLine(s_aLines[i].m_From, s_aLines[i].m_To, &RefCol, &RefBefore);
+		int Res = s_Collision.IntersectLine(s_aLines[i].m_From, s_aLines[i].m_To, &Col, &Before);
+		if(Res != RefRes || !Same(Col, RefCol) || !Same(Before, RefBefore))
+		{
+			dbg_msg("collision", "IntersectLine differs for %f %f -> %f %f: %d (%f %f, %f %f), was %d (%f %f, %f %f)",
+				s_aLines[i].m_From.x, s_aLines[i].m_From.y, s_aLines[i].m_To.x, s_aLines[i].m_To.y,
+				Res, Col.x, Col.y, Before.x, Before.y, RefRes, RefCol.x, RefCol.y, RefBefore.x, RefBefore.y);
+			return false;
+		}
+		if(Res)
+			Hits++;
+	}
+
+	int64 Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		RefIntersectLine(s_aLines[i].m_From, s_aLines[i].m_To, 0, 0);
+	int64 RefTime = time_get()-Start;
+	Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		s_Collision.IntersectLine(s_aLines[i].m_From, s_aLines[i].m_To, 0, 0);
+	int64 Time = time_get()-Start;
+
+	dbg_msg("collision", "IntersectLine: %d lines, %d hits, per pixel %6.3f us/line, tiles %6.3f us/line, %.2fx", (int)NUM_LINES, Hits,
+		RefTime*1000000.0/time_freq()/NUM_LINES, Time*1000000.0/time_freq()/NUM_LINES, RefTime/(double)Time);
+	return true;
+}
+
+struct CBody
+{
+	vec2 m_Pos;
+	vec2 m_Vel;
+	vec2 m_Size;
+	float m_Elasticity;
+};
+
+static CBody s_aRefBodies[NUM_BODIES];
+static CBody s_aBodies[NUM_BODIES];
+
+// bodies fall, run and get thrown around like characters and flags do
+static void TickBodies(CBody *pBodies, int Tick, bool Reference)
+{
+	for(int i = 0; i < NUM_BODIES; i++)
+	{
+		CBody *pBody = &pBodies[i];
+		pBody->m_Vel.y += 0.5f;
+		if((Tick+i)%50 == 0)
+			pBody->m_Vel += vec2(((Tick*7+i)%41-20)*1.0f, ((Tick*3+i)%31-25)*1.0f);
+		else
+			pBody->m_Vel.x = pBody->m_Vel.x*0.95f + (((Tick/60+i)%3)-1)*0.5f;
+		if(Reference)
+			RefMoveBox(&pBody->m_Pos, &pBody->m_Vel, pBody->m_Size, pBody->m_Elasticity);
+		else
+			s_Collision.MoveBox(&pBody->m_Pos, &pBody->m_Vel, pBody->m_Size, pBody->m_Elasticity);
+	}
+}
+
+static bool RunBodies()
+{
+	for(int i = 0; i < NUM_BODIES; i++)
+	{
+		vec2 Pos;
+		do
+			Pos = RandomPos();
+		while(s_Collision.CheckPoint(Pos));
+		s_aRefBodies[i].m_Pos = Pos;
+		s_aRefBodies[i].m_Vel = vec2(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+		s_aRefBodies[i].m_Size = i%2 ? vec2(28.0f, 28.0f) : vec2(14.0f, 14.0f);
+		s_aRefBodies[i].m_Elasticity = i%2 ? 0.0f : 0.5f;
+	}
+	mem_copy(s_aBodies, s_aRefBodies, sizeof(s_aBodies));
+
+	int64 RefTime = 0;
+	int64 Time = 0;
+	for(int t = 0; t < BODY_TICKS; t++)
+	{
+		int64 Start = time_get();
+		TickBodies(s_aRefBodies, t, true);
+		RefTime += time_get()-Start;
+		Start = time_get();
+		TickBodies(s_aBodies, t, false);
+		Time += time_get()-Start;
+
+		for(int i = 0; i < NUM_BODIES; i++)
+			if(!Same(s_aBodies[i].m_Pos, s_aRefBodies[i].m_Pos) || !Same(s_aBodies[i].m_Vel, s_aRefBodies[i].m_Vel))
+			{
+				dbg_msg("collision", "MoveBox differs for body %d in tick %d: %f %f (%f %f), was %f %f (%f %f)", i, t,
+					s_aBodies[i].m_Pos.x, s_aBodies[i].m_Pos.y, s_aBodies[i].m_Vel.x, s_aBodies[i].m_Vel.y,
+					s_aRefBodies[i].m_Pos.x, s_aRefBodies[i].m_Pos.y, s_aRefBodies[i].m_Vel.x, s_aRefBodies[i].m_Vel.y);
+				return false;
+			}
+	}
+
+	int Moves = NUM_BODIES*BODY_TICKS;
+	dbg_msg("collision", "MoveBox: %d moves, per pixel %6.3f us/move, tiles %6.3f us/move, %.2fx", Moves,
+		RefTime*1000000.0/time_freq()/Moves, Time*1000000.0/time_freq()/Moves, RefTime/(double)Time);
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("collision", "usage: %s <map> [seed]", argv[0]); // ignore_convention
+		return -1;
+	}
+	if(argc > 2) // ignore_convention
+		SeedRandom(str_toint(argv[2])); // ignore_convention
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IEngineMap *pMap = CreateEngineMap();
+	char aMapFile[512];
+	str_format(aMapFile, sizeof(aMapFile), "maps/%s.map", argv[1]); // ignore_convention
+	if(!pStorage || !pMap->Load(aMapFile, pStorage))
+	{
+		dbg_msg("collision", "couldn't load %s", aMapFile);
+		return -1;
+	}
+
+	CLayers Layers;
+	Layers.Init(0, pMap);
+	s_Collision.Init(&Layers);
+
+	bool Result = RunLines() && RunBodies();
+
+	pMap->Unload();
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,168 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+#include "benchmark.h"
+
+// executes a 10k line config on the console, once with distinct lines and
+// once with lines that repeat like binds and votes do, and checks that the
+// command lookup and the parsed lines agree with what the list gives
+
+enum
+{
+	NUM_COMMANDS=400, // about what a server with game and tune commands has
+	NUM_LINES=10000,
+	NUM_REPEATED_LINES=64,
+	NUM_PASSES=20,
+};
+
+static char s_aaCommandNames[NUM_COMMANDS][32];
+static char s_aaLines[NUM_LINES][128];
+static unsigned s_aLineChecksums[NUM_LINES];
+static unsigned s_Checksum = 0;
+
+static void ConBench(IConsole::IResult *pResult, void *pUserData)
+{
+	s_Checksum = s_Checksum*31 + (unsigned)(long)pUserData;
+	for(int i = 0; i < pResult->NumArguments(); i++)
+	{
+		s_Checksum = s_Checksum*31 + pResult->GetInteger(i);
+		for(const char *p = pResult->GetString(i); *p; p++)
+			s_Checksum = s_Checksum*31 + *p;
+	}
+}
+
+static const char *RandomCommand()
+{
+	// mixed case, the lookup doesn't care
+	static char s_aName[32];
+	str_copy(s_aName, s_aaCommandNames[Random()%NUM_COMMANDS], sizeof(s_aName));
+	if(Random()%8 == 0)
+		s_aName[0] += 'A'-'a';
+	return s_aName;
+}
+
+static void MakeLine(char *pLine, int Size)
+{
+	switch(Random()%4)
+	{
+	case 0: str_format(pLine, Size, "%s %d %d", RandomCommand(), Random()%1000, Random()%100); break;
+	case 1: str_format(pLine, Size, "%s \"some \\\"quoted\\\" text %d\" %d", RandomCommand(), Random()%1000, Random()%10); break;
+	case 2: str_format(pLine, Size, "%s %d; %s %d # comment", RandomCommand(), Random()%1000, RandomCommand(), Random()%10); break;
+	default: str_format(pLine, Size, "sv_max_clients %d", 1 + Random()%16);
+	}
+}
+
+static const IConsole::CCommandInfo *FindInList(IConsole *pConsole, const char *pName)
+{
+	for(const IConsole::CCommandInfo *pInfo = pConsole->FirstCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER); pInfo; pInfo = pInfo->NextCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER))
+	{
+		if(str_comp_nocase(pInfo->m_pName, pName) == 0)
+			return pInfo;
+	}
+	return 0;
+}
+
+static bool CheckLookup(IConsole *pConsole)
+{
+	for(int i = 0; i < NUM_COMMANDS*4; i++)
+	{
+		const char *pName = i < NUM_COMMANDS ? s_aaCommandNames[i] : RandomCommand();
+		if(pConsole->GetCommandInfo(pName, CFGFLAG_SERVER, false) != FindInList(pConsole, pName))
+		{
+			dbg_msg("console", "lookup of '%s' differs from the command list", pName);
+			return false;
+		}
+	}
+
+	// temporary commands come and go
+	pConsole->RegisterTemp("bench_temp", "", CFGFLAG_SERVER, "");
+	bool Found = pConsole->GetCommandInfo("BENCH_TEMP", CFGFLAG_SERVER, true) != 0;
+	pConsole->DeregisterTemp("bench_temp");
+	if(!Found || pConsole->GetCommandInfo("bench_temp", CFGFLAG_SERVER, true))
+	{
+		dbg_msg("console", "temporary command lookup failed");
+		return false;
+	}
+	pConsole->RegisterTemp("bench_temp", "", CFGFLAG_SERVER, "");
+	pConsole->DeregisterTempAll();
+	if(pConsole->GetCommandInfo("bench_temp", CFGFLAG_SERVER, true))
+	{
+		dbg_msg("console", "temporary command survived DeregisterTempAll");
+		return false;
+	}
+	return true;
+}
+
+static bool Run(IConsole *pConsole, int NumDistinct, const char *pName)
+{
+	// the first run of each distinct line gives its checksum
+	for(int i = 0; i < NumDistinct; i++)
+	{
+		s_Checksum = 0;
+		pConsole->ExecuteLine(s_aaLines[i]);
+		s_aLineChecksums[i] = s_Checksum;
+	}
+
+	int64 Time = 0;
+	int64 ListTime = 0;
+	for(int p = 0; p < NUM_PASSES; p++)
+	{
+		int64 Start = time_get();
+		for(int i = 0; i < NUM_LINES; i++)
+			pConsole->ExecuteLine(s_aaLines[i%NumDistinct]);
+		Time += time_get()-Start;
+
+		for(int i = 0; i < NUM_LINES; i++)
+		{
+			s_Checksum = 0;
+			pConsole->ExecuteLine(s_aaLines[i%NumDistinct]);
+			if(s_Checksum != s_aLineChecksums[i%NumDistinct])
+			{
+				dbg_msg("console", "'%s' executed differently the %d. time", s_aaLines[i%NumDistinct], p+2);
+				return false;
+			}
+		}
+
+		// what walking the command list costs for the first command of each line
+		Start = time_get();
+		for(int i = 0; i < NUM_LINES; i++)
+		{
+			char aName[32];
+			str_copy(aName, s_aaLines[i%NumDistinct], sizeof(aName));
+			for(int c = 0; aName[c]; c++)
+				if(aName[c] == ' ')
+					aName[c] = 0;
+			FindInList(pConsole, aName);
+		}
+		ListTime += time_get()-Start;
+	}
+
+	int Lines = NUM_LINES*NUM_PASSES;
+	dbg_msg("console", "%s: %6.3f us/line, walking the command list alone %6.3f us/line", pName,
+		Time*1000000.0/time_freq()/Lines, ListTime*1000000.0/time_freq()/Lines);
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	for(int i = 0; i < NUM_COMMANDS; i++)
+	{
+		str_format(s_aaCommandNames[i], sizeof(s_aaCommandNames[i]), "bench_%c%c_command_%d", 'a'+Random()%26, 'a'+Random()%26, i);
+		pConsole->Register(s_aaCommandNames[i], i%2 ? "s?i" : "?ir", CFGFLAG_SERVER, ConBench, (void *)(long)i, "");
+	}
+	for(int i = 0; i < NUM_LINES; i++)
+		MakeLine(s_aaLines[i], sizeof(s_aaLines[i]));
+
+	bool Result = CheckLookup(pConsole) && Run(pConsole, NUM_LINES, "10k distinct lines") && Run(pConsole, NUM_REPEATED_LINES, "10k repeated lines");
+
+	delete pConsole;
+	return Result ? 0 : -1;
+}
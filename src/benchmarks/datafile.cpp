@@ -0,0 +1,180 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/storage.h>
+#include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
+
+#include "benchmark.h"
+
+// writes a datafile with map sized data blocks, reads it through the file
+// and through the mapping and checks that items and data are the same,
+// then measures loading all data blocks each way
+
+enum
+{
+	NUM_BLOCKS=24,
+	BLOCK_INTS=512*512,
+	NUM_ITEMS=64,
+	ITEM_INTS=8,
+	NUM_ROUNDS=5,
+	NUM_THREADS=3,
+};
+
+static const char *s_pFilename = "benchmark_datafile.map";
+
+static bool WriteFile(IStorage *pStorage)
+{
+	CDataFileWriter Writer;
+	if(!Writer.Open(pStorage, s_pFilename))
+		return false;
+
+	int aItem[ITEM_INTS];
+	for(int i = 0; i < NUM_ITEMS; i++)
+	{
+		for(int k = 0; k < ITEM_INTS; k++)
+			aItem[k] = Random();
+		Writer.AddItem(i%4, i, sizeof(aItem), aItem);
+	}
+
+	// runs of equal tiles, like tile layers have
+	int *pData = (int *)mem_alloc(BLOCK_INTS*sizeof(int), 1);
+	for(int b = 0; b < NUM_BLOCKS; b++)
+	{
+		for(int i = 0; i < BLOCK_INTS;)
+		{
+			int Value = Random()%4 ? 0 : Random()&0xff;
+			for(int Run = 1+Random()%64; Run && i < BLOCK_INTS; Run--)
+				pData[i++] = Value;
+		}
+		Writer.AddData(BLOCK_INTS*sizeof(int), pData);
+	}
+	mem_free(pData);
+
+	Writer.Finish();
+	return true;
+}
+
+static bool Compare(CDataFileReader *pRead, CDataFileReader *pMapped)
+{
+	if(pRead->NumItems() != pMapped->NumItems() || pRead->NumData() != pMapped->NumData() || pRead->Crc() != pMapped->Crc())
+	{
+		dbg_msg("datafile", "header differs");
+		return false;
+	}
+
+	for(int i = 0; i < pRead->NumItems(); i++)
+	{
+		int Type, ID, MappedType, MappedID;
+		void *pItem = pRead->GetItem(i, &Type, &ID);
+		void *pMappedItem = pMapped->GetItem(i, &MappedType, &MappedID);
+		if(Type != MappedType || ID != MappedID || pRead->GetItemSize(i) != pMapped->GetItemSize(i) ||
+			mem_comp(pItem, pMappedItem, ITEM_INTS*sizeof(int)) != 0)
+		{
+			dbg_msg("datafile", "item %d differs", i);
+			return false;
+		}
+	}
+
+	for(int i = 0; i < pRead->NumData(); i++)
+	{
+		void *pData = pRead->GetData(i);
+		void *pMappedData = pMapped->GetData(i);
+		if(!pData || !pMappedData || mem_comp(pData, pMappedData, BLOCK_INTS*sizeof(int)) != 0)
+		{
+			dbg_msg("datafile", "data %d differs", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Check(IStorage *pStorage, CJobPool *pPool)
+{
+	CDataFileReader Read, Mapped, Parallel;
+	if(!Read.Open(pStorage, s_pFilename, IStorage::TYPE_SAVE, false) ||
+		!Mapped.Open(pStorage, s_pFilename, IStorage::TYPE_SAVE) ||
+		!Parallel.Open(pStorage, s_pFilename, IStorage::TYPE_SAVE))
+	{
+		dbg_msg("datafile", "couldn't open %s", s_pFilename);
+		return false;
+	}
+	if(!Mapped.IsMapped())
+		dbg_msg("datafile", "the file couldn't be mapped, comparing the read path with itself");
+
+	int aIndices[NUM_BLOCKS];
+	for(int i = 0; i < NUM_BLOCKS; i++)
+		aIndices[i] = i;
+	Parallel.LoadData(aIndices, NUM_BLOCKS, pPool);
+
+	if(!Compare(&Read, &Mapped) || !Compare(&Read, &Parallel))
+		return false;
+
+	// unloaded blocks come back from the cache, or get decompressed again without it
+	for(int CacheSize = BLOCK_INTS*sizeof(int)*4; CacheSize >= 0; CacheSize -= BLOCK_INTS*sizeof(int)*2)
+	{
+		Mapped.SetCacheSize(CacheSize);
+		for(int i = 0; i < NUM_BLOCKS; i++)
+			Mapped.UnloadData(Random()%NUM_BLOCKS);
+		if(!Compare(&Read, &Mapped))
+			return false;
+	}
+	return true;
+}
+
+static int64 Load(IStorage *pStorage, bool Map, CJobPool *pPool)
+{
+	int64 Start = time_get();
+	CDataFileReader Reader;
+	Reader.Open(pStorage, s_pFilename, IStorage::TYPE_SAVE, Map);
+	if(pPool)
+	{
+		int aIndices[NUM_BLOCKS];
+		for(int i = 0; i < NUM_BLOCKS; i++)
+			aIndices[i] = i;
+		Reader.LoadData(aIndices, NUM_BLOCKS, pPool);
+	}
+	else
+	{
+		for(int i = 0; i < Reader.NumData(); i++)
+			Reader.GetData(i);
+	}
+	Reader.Close();
+	return time_get()-Start;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	if(!pStorage || !WriteFile(pStorage))
+	{
+		dbg_msg("datafile", "couldn't write %s", s_pFilename);
+		return -1;
+	}
+
+	CJobPool Pool;
+	Pool.Init(NUM_THREADS);
+
+	bool Result = Check(pStorage, &Pool);
+	if(Result)
+	{
+		int64 aTimes[3] = {0, 0, 0};
+		for(int r = 0; r < NUM_ROUNDS; r++)
+		{
+			aTimes[0] += Load(pStorage, false, 0);
+			aTimes[1] += Load(pStorage, true, 0);
+			aTimes[2] += Load(pStorage, true, &Pool);
+		}
+
+		dbg_msg("datafile", "%d blocks of %d kb, read %7.2f ms, mapped %7.2f ms, mapped on %d threads %7.2f ms",
+			NUM_BLOCKS, (int)(BLOCK_INTS*sizeof(int)/1024), aTimes[0]*1000.0/time_freq()/NUM_ROUNDS,
+			aTimes[1]*1000.0/time_freq()/NUM_ROUNDS, NUM_THREADS+1, aTimes[2]*1000.0/time_freq()/NUM_ROUNDS);
+	}
+
+	pStorage->RemoveFile(s_pFilename, IStorage::TYPE_SAVE);
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,245 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/version.h>
+
+#include "benchmark.h"
+
+// records an hour long demo, opens it through the seek index and through
+// the scan older demos take, checks that both end up at the same snapshots
+// when seeking and measures opening and seeking
+
+enum
+{
+	NUM_TICKS=SERVER_TICK_SPEED*60*60,
+	NUM_PLAYERS=16,
+	ITEM_TYPE=32, // not a game type, the size goes with the delta
+	ITEM_INTS=12,
+	NUM_ROUNDS=5,
+	NUM_SEEKS=200,
+};
+
+static const char *s_pMapName = "benchmark_demo_seek";
+static const char *s_pMapFilename = "maps/benchmark_demo_seek.map";
+static const char *s_pFilename = "demos/benchmark_demo_seek.demo";
+static const char *s_pLegacyFilename = "demos/benchmark_demo_seek_legacy.demo";
+
+class CLastSnapshot : public CDemoPlayer::IListner
+{
+public:
+	int m_Crc;
+	int m_Size;
+
+	CLastSnapshot() : m_Crc(0), m_Size(-1) {}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		m_Crc = ((CSnapshot *)pData)->Crc();
+		m_Size = Size;
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+static bool WriteMap(IStorage *pStorage)
+{
+	// the recorder only copies the map into the demo
+	CDataFileWriter Writer;
+	if(!Writer.Open(pStorage, s_pMapFilename))
+		return false;
+	int Version = 1;
+	Writer.AddItem(0, 0, sizeof(Version), &Version);
+	Writer.Finish();
+	return true;
+}
+
+static bool Record(IStorage *pStorage, IConsole *pConsole, CSnapshotDelta *pDelta)
+{
+	CDemoRecorder Recorder(pDelta);
+	if(Recorder.Start(pStorage, pConsole, s_pFilename, GAME_NETVERSION, s_pMapName, 0, "server"))
+		return false;
+
+	static int s_aaPlayers[NUM_PLAYERS][ITEM_INTS];
+	for(int p = 0; p < NUM_PLAYERS; p++)
+		for(int i = 0; i < ITEM_INTS; i++)
+			s_aaPlayers[p][i] = Random()%1024;
+
+	static char s_aSnapshot[CSnapshot::MAX_SIZE];
+	CSnapshotBuilder Builder;
+	for(int Tick = 1; Tick <= NUM_TICKS; Tick++)
+	{
+		// players move around, now and then someone leaves for a while
+		Builder.Init();
+		for(int p = 0; p < NUM_PLAYERS; p++)
+		{
+			if((Tick/SERVER_TICK_SPEED+p*37)%300 < 20)
+				continue;
+			for(int i = 0; i < ITEM_INTS; i++)
+				if(i < 4 || Random()%8 == 0)
+					s_aaPlayers[p][i] += (int)(Random()%7)-3;
+			int *pItem = (int *)Builder.NewItem(ITEM_TYPE, p, sizeof(s_aaPlayers[p]));
+			if(pItem)
+				mem_copy(pItem, s_aaPlayers[p], sizeof(s_aaPlayers[p]));
+		}
+		Recorder.RecordSnapshot(Tick, s_aSnapshot, Builder.Finish(s_aSnapshot));
+
+		if(Tick%SERVER_TICK_SPEED == 0)
+		{
+			int aMessage[4] = {Tick, (int)Random(), (int)Random(), (int)Random()};
+			Recorder.RecordMessage(aMessage, sizeof(aMessage));
+		}
+	}
+	return Recorder.Stop() == 0;
+}
+
+static bool CopyLegacy(IStorage *pStorage)
+{
+	// a trailing empty chunk hides the seek index like demos from before it
+	IOHANDLE From = pStorage->OpenFile(s_pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	IOHANDLE To = pStorage->OpenFile(s_pLegacyFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!From || !To)
+	{
+		if(From)
+			io_close(From);
+		if(To)
+			io_close(To);
+		return false;
+	}
+
+	static unsigned char s_aBuffer[64*1024];
+	unsigned Bytes;
+	while((Bytes = io_read(From, s_aBuffer, sizeof(s_aBuffer))) > 0)
+		io_write(To, s_aBuffer, Bytes);
+	unsigned char EmptyChunk = 0;
+	io_write(To, &EmptyChunk, 1);
+	io_close(From);
+	io_close(To);
+	return true;
+}
+
+static int64 Load(CDemoPlayer *pPlayer, IStorage *pStorage, IConsole *pConsole, const char *pFilename)
+{
+	int64 Start = time_get();
+	if(pPlayer->Load(pStorage, pConsole, pFilename, IStorage::TYPE_SAVE, GAME_NETVERSION))
+		return -1;
+	return time_get()-Start;
+}
+
+static bool Check(IStorage *pStorage, IConsole *pConsole, CSnapshotDelta *pDelta, int64 *pSeekTime)
+{
+	CLastSnapshot IndexSnapshot, LegacySnapshot;
+	CDemoPlayer Index(pDelta), Legacy(pDelta);
+	Index.SetListner(&IndexSnapshot);
+	Legacy.SetListner(&LegacySnapshot);
+	if(Load(&Index, pStorage, pConsole, s_pFilename) < 0 || Load(&Legacy, pStorage, pConsole, s_pLegacyFilename) < 0)
+	{
+		dbg_msg("demo_seek", "couldn't load the demos");
+		return false;
+	}
+
+	const CDemoPlayer::CPlaybackInfo *pIndexInfo = Index.Info();
+	const CDemoPlayer::CPlaybackInfo *pLegacyInfo = Legacy.Info();
+	if(pIndexInfo->m_SeekablePoints != pLegacyInfo->m_SeekablePoints || pIndexInfo->m_Info.m_FirstTick != pLegacyInfo->m_Info.m_FirstTick ||
+		pIndexInfo->m_Info.m_LastTick != pLegacyInfo->m_Info.m_LastTick || pIndexInfo->m_Info.m_LastTick != NUM_TICKS)
+	{
+		dbg_msg("demo_seek", "index: %d keyframes, ticks %d-%d, scan: %d keyframes, ticks %d-%d",
+			pIndexInfo->m_SeekablePoints, pIndexInfo->m_Info.m_FirstTick, pIndexInfo->m_Info.m_LastTick,
+			pLegacyInfo->m_SeekablePoints, pLegacyInfo->m_Info.m_FirstTick, pLegacyInfo->m_Info.m_LastTick);
+		return false;
+	}
+
+	Index.Play();
+	Legacy.Play();
+	*pSeekTime = 0;
+	for(int s = 0; s < NUM_SEEKS; s++)
+	{
+		float Percent = (Random()%1000)/1000.0f;
+		int64 Start = time_get();
+		int Result = Index.SetPos(Percent);
+		*pSeekTime += time_get()-Start;
+		if(Result != Legacy.SetPos(Percent) || pIndexInfo->m_Info.m_CurrentTick != pLegacyInfo->m_Info.m_CurrentTick ||
+			pIndexInfo->m_PreviousTick != pLegacyInfo->m_PreviousTick || IndexSnapshot.m_Size != LegacySnapshot.m_Size ||
+			IndexSnapshot.m_Crc != LegacySnapshot.m_Crc)
+		{
+			dbg_msg("demo_seek", "seeking to %.3f differs", Percent);
+			return false;
+		}
+	}
+
+	Index.Stop();
+	Legacy.Stop();
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	if(!pStorage || !pConsole)
+		return -1;
+
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+
+	// the demo player saves the map of the demo
+	pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+	pStorage->CreateFolder("demos", IStorage::TYPE_SAVE);
+	pStorage->CreateFolder("downloadedmaps", IStorage::TYPE_SAVE);
+
+	CSnapshotDelta SnapshotDelta;
+	int64 RecordTime = time_get();
+	bool Result = WriteMap(pStorage) && Record(pStorage, pConsole, &SnapshotDelta) && CopyLegacy(pStorage);
+	RecordTime = time_get()-RecordTime;
+	if(!Result)
+		dbg_msg("demo_seek", "couldn't record %s", s_pFilename);
+
+	int64 SeekTime = 0;
+	if(Result)
+		Result = Check(pStorage, pConsole, &SnapshotDelta, &SeekTime);
+
+	if(Result)
+	{
+		int64 aTimes[2] = {0, 0};
+		for(int r = 0; r < NUM_ROUNDS; r++)
+		{
+			CDemoPlayer Index(&SnapshotDelta), Legacy(&SnapshotDelta);
+			aTimes[0] += Load(&Index, pStorage, pConsole, s_pFilename);
+			aTimes[1] += Load(&Legacy, pStorage, pConsole, s_pLegacyFilename);
+			Index.Stop();
+			Legacy.Stop();
+		}
+
+		unsigned Size = 0;
+		IOHANDLE File = pStorage->OpenFile(s_pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+		if(File)
+		{
+			Size = io_length(File);
+			io_close(File);
+		}
+
+		dbg_msg("demo_seek", "%d minutes, %d kb, recorded in %.2f ms", NUM_TICKS/SERVER_TICK_SPEED/60, Size/1024, RecordTime*1000.0/time_freq());
+		dbg_msg("demo_seek", "open with index %7.2f ms, open with scan %7.2f ms, seek %7.3f ms",
+			aTimes[0]*1000.0/time_freq()/NUM_ROUNDS, aTimes[1]*1000.0/time_freq()/NUM_ROUNDS, SeekTime*1000.0/time_freq()/NUM_SEEKS);
+	}
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "downloadedmaps/%s_%08x.map", s_pMapName, 0);
+	pStorage->RemoveFile(aBuf, IStorage::TYPE_SAVE);
+	pStorage->RemoveFile(s_pMapFilename, IStorage::TYPE_SAVE);
+	pStorage->RemoveFile(s_pFilename, IStorage::TYPE_SAVE);
+	pStorage->RemoveFile(s_pLegacyFilename, IStorage::TYPE_SAVE);
+	return Result ? 0 : -1;
+}
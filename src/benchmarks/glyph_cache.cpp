@@ -0,0 +1,171 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/client/glyphcache.h>
+
+#include "benchmark.h"
+
+// looks up the characters of a few hundred frames of text like the text
+// renderer does, once through the glyph cache and once through the linear
+// searches it replaced, and checks that both put every character into the
+// same slot
+
+enum
+{
+	NUM_FRAMES=500,
+	LINES_PER_FRAME=40, // scoreboard, chat and hud
+	LINE_LENGTH=32,
+	NUM_WIDE_CHARACTERS=8000,
+};
+
+// the old slot handling, with a counter instead of time_get so no two touches are equal
+class CLinearGlyphs
+{
+	int m_aChr[CGlyphCache::MAX_SLOTS];
+	int64 m_aTouchTime[CGlyphCache::MAX_SLOTS];
+	int m_NumSlots;
+	int m_NumUsed;
+
+public:
+	void Reset(int NumSlots) { m_NumSlots = NumSlots; m_NumUsed = 0; }
+
+	int Find(int Chr, int64 Now)
+	{
+		for(int i = 0; i < m_NumUsed; i++)
+		{
+			if(m_aChr[i] == Chr)
+			{
+				m_aTouchTime[i] = Now;
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int Add(int Chr, int64 Now)
+	{
+		int Slot = 0;
+		if(m_NumUsed < m_NumSlots)
+			Slot = m_NumUsed++;
+		else
+		{
+			for(int i = 1; i < m_NumSlots; i++)
+			{
+				if(m_aTouchTime[i] < m_aTouchTime[Slot])
+					Slot = i;
+			}
+		}
+		m_aChr[Slot] = Chr;
+		m_aTouchTime[Slot] = Now;
+		return Slot;
+	}
+};
+
+static CGlyphCache s_Cache;
+static CLinearGlyphs s_Linear;
+static int s_aaaFrames[NUM_FRAMES][LINES_PER_FRAME][LINE_LENGTH];
+
+static int RandomCharacter(int WidePercent)
+{
+	if((int)(Random()%100) >= WidePercent)
+		return 32 + Random()%95;
+	// a few wide characters are common, most are rare
+	int Range = NUM_WIDE_CHARACTERS;
+	while(Range > 64 && Random()%2)
+		Range /= 2;
+	return 0x4E00 + Random()%Range;
+}
+
+static void MakeFrames(int WidePercent)
+{
+	// most lines stay the same from frame to frame, a chat line comes in now and then
+	for(int l = 0; l < LINES_PER_FRAME; l++)
+		for(int c = 0; c < LINE_LENGTH; c++)
+			s_aaaFrames[0][l][c] = RandomCharacter(WidePercent);
+	for(int f = 1; f < NUM_FRAMES; f++)
+	{
+		mem_copy(s_aaaFrames[f], s_aaaFrames[f-1], sizeof(s_aaaFrames[f]));
+		if(Random()%4 == 0)
+		{
+			int Line = Random()%LINES_PER_FRAME;
+			for(int c = 0; c < LINE_LENGTH; c++)
+				s_aaaFrames[f][Line][c] = RandomCharacter(WidePercent);
+		}
+	}
+}
+
+static bool Run(const char *pName, int NumSlots, int WidePercent)
+{
+	MakeFrames(WidePercent);
+
+	// first check that the slots agree
+	s_Cache.Reset(NumSlots);
+	s_Linear.Reset(NumSlots);
+	int64 Now = 0;
+	int Misses = 0;
+	for(int f = 0; f < NUM_FRAMES; f++)
+		for(int l = 0; l < LINES_PER_FRAME; l++)
+			for(int c = 0; c < LINE_LENGTH; c++)
+			{
+				int Chr = s_aaaFrames[f][l][c];
+				Now++;
+				int Slot = s_Cache.Find(Chr);
+				int LinearSlot = s_Linear.Find(Chr, Now);
+				if((Slot < 0) != (LinearSlot < 0))
+				{
+					dbg_msg("glyph_cache", "%s: character %d %s, the linear search says otherwise", pName, Chr, Slot < 0 ? "missing" : "found");
+					return false;
+				}
+				if(Slot < 0)
+				{
+					Misses++;
+					Slot = s_Cache.Add(Chr);
+					LinearSlot = s_Linear.Add(Chr, Now);
+				}
+				if(Slot != LinearSlot)
+				{
+					dbg_msg("glyph_cache", "%s: character %d went into slot %d, the linear search put it into %d", pName, Chr, Slot, LinearSlot);
+					return false;
+				}
+			}
+
+	// then time them separately
+	s_Linear.Reset(NumSlots);
+	int64 Start = time_get();
+	for(int f = 0; f < NUM_FRAMES; f++)
+		for(int l = 0; l < LINES_PER_FRAME; l++)
+			for(int c = 0; c < LINE_LENGTH; c++)
+				if(s_Linear.Find(s_aaaFrames[f][l][c], ++Now) < 0)
+					s_Linear.Add(s_aaaFrames[f][l][c], Now);
+	int64 LinearTime = time_get()-Start;
+
+	s_Cache.Reset(NumSlots);
+	Start = time_get();
+	for(int f = 0; f < NUM_FRAMES; f++)
+		for(int l = 0; l < LINES_PER_FRAME; l++)
+			for(int c = 0; c < LINE_LENGTH; c++)
+				if(s_Cache.Find(s_aaaFrames[f][l][c]) < 0)
+					s_Cache.Add(s_aaaFrames[f][l][c]);
+	int64 Time = time_get()-Start;
+
+	int Lookups = NUM_FRAMES*LINES_PER_FRAME*LINE_LENGTH;
+	dbg_msg("glyph_cache", "%s: %d slots, %d lookups/frame, %.1f misses/frame, linear %7.2f us/frame, hashed %7.2f us/frame, %.1fx",
+		pName, NumSlots, Lookups/NUM_FRAMES, Misses/(float)NUM_FRAMES, LinearTime*1000000.0/time_freq()/NUM_FRAMES,
+		Time*1000000.0/time_freq()/NUM_FRAMES, LinearTime/(double)max(Time, (int64)1));
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc > 1) // ignore_convention
+		SeedRandom(str_toint(argv[1])); // ignore_convention
+
+	// the texture starts with 8x8 slots and grows up to 64x64
+	bool Result = Run("ascii", 64, 0) && Run("ascii", 256, 0) &&
+		Run("mixed", 1024, 20) && Run("wide", CGlyphCache::MAX_SLOTS, 60) && Run("wide", 512, 60);
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,112 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/shared/huffman.h>
+#include <engine/shared/network.h>
+
+#include "benchmark.h"
+
+// measures the network huffman coding on packets drawn from the frequency table it is built from
+
+enum
+{
+	NUM_PACKETS=4096,
+	PACKET_SIZE=NET_MAX_PAYLOAD,
+	MAX_COMPRESSED_SIZE=PACKET_SIZE*4,
+};
+
+static unsigned char s_aaPackets[NUM_PACKETS][PACKET_SIZE];
+static unsigned char s_aaCompressed[NUM_PACKETS][MAX_COMPRESSED_SIZE];
+static int s_aCompressedSize[NUM_PACKETS];
+static unsigned char s_aDecompressed[PACKET_SIZE];
+
+// the table gives the 0 byte an artificial weight to get it the shortest code,
+// packets are sampled with it as frequent as all other bytes together
+static void GeneratePackets(bool Uniform)
+{
+	const unsigned *pFrequencies = CNetBase::HuffmanFrequencies();
+	unsigned aWeights[256];
+	unsigned Total = 0;
+	for(int i = 1; i < 256; i++)
+	{
+		aWeights[i] = pFrequencies[i];
+		Total += aWeights[i];
+	}
+	aWeights[0] = Total;
+	Total *= 2;
+
+	for(int p = 0; p < NUM_PACKETS; p++)
+	{
+		for(int i = 0; i < PACKET_SIZE; i++)
+		{
+			if(Uniform)
+			{
+				s_aaPackets[p][i] = Random()&0xff;
+				continue;
+			}
+
+			unsigned Value = Random()%Total;
+			int Symbol = 0;
+			while(Value >= aWeights[Symbol])
+				Value -= aWeights[Symbol++];
+			s_aaPackets[p][i] = Symbol;
+		}
+	}
+}
+
+static bool Run(CHuffman *pHuffman, const char *pName, int Iterations)
+{
+	int64 CompressTime = 0;
+	int64 DecompressTime = 0;
+	int64 CompressedBytes = 0;
+
+	for(int n = 0; n < Iterations; n++)
+	{
+		int64 Start = time_get();
+		for(int p = 0; p < NUM_PACKETS; p++)
+			s_aCompressedSize[p] = pHuffman->Compress(s_aaPackets[p], PACKET_SIZE, s_aaCompressed[p], MAX_COMPRESSED_SIZE);
+		CompressTime += time_get()-Start;
+
+		Start = time_get();
+		for(int p = 0; p < NUM_PACKETS; p++)
+		{
+			int Size = pHuffman->Decompress(s_aaCompressed[p], s_aCompressedSize[p], s_aDecompressed, PACKET_SIZE);
+			if(Size != PACKET_SIZE || mem_comp(s_aDecompressed, s_aaPackets[p], PACKET_SIZE) != 0)
+			{
+				dbg_msg("huffman", "%s: packet %d did not survive the round trip", pName, p);
+				return false;
+			}
+		}
+		DecompressTime += time_get()-Start;
+
+		for(int p = 0; p < NUM_PACKETS; p++)
+			CompressedBytes += s_aCompressedSize[p];
+	}
+
+	double Bytes = (double)PACKET_SIZE*NUM_PACKETS*Iterations;
+	dbg_msg("huffman", "%-8s ratio %.3f, compress %7.1f MB/s, decompress %7.1f MB/s", pName, CompressedBytes/Bytes,
+		Bytes/(1024*1024)/(CompressTime/(double)time_freq()), Bytes/(1024*1024)/(DecompressTime/(double)time_freq()));
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	int Iterations = argc > 1 ? max(str_toint(argv[1]), 1) : 20; // ignore_convention
+
+	static CHuffman s_Huffman;
+	s_Huffman.Init(CNetBase::HuffmanFrequencies());
+
+	GeneratePackets(false);
+	if(!Run(&s_Huffman, "table", Iterations))
+		return -1;
+
+	GeneratePackets(true);
+	if(!Run(&s_Huffman, "uniform", Iterations))
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include <engine/shared/jobs.h>
+
+// measures the overhead of the job pool: adding and waiting for single
+// jobs, many small jobs at once, parallel for and chains of jobs that
+// depend on each other, and checks that every job ran once and in order
+
+enum
+{
+	NUM_THREADS=3,
+	NUM_SINGLE=20000,
+	NUM_FANOUT=4096,
+	NUM_ROUNDS=20,
+	NUM_PARALLEL=1<<20,
+	NUM_CHAIN=1024,
+};
+
+static volatile unsigned s_Counter;
+
+static int EmptyJob(void *pData)
+{
+	return 1;
+}
+
+static int CountJob(void *pData)
+{
+	atomic_inc(&s_Counter);
+	return 0;
+}
+
+static int64 SingleJobs(CJobPool *pPool, bool *pResult)
+{
+	CJob Job;
+	int64 Start = time_get();
+	for(int i = 0; i < NUM_SINGLE; i++)
+	{
+		pPool->Add(&Job, EmptyJob, 0);
+		pPool->Wait(&Job);
+		if(Job.Result() != 1)
+			*pResult = false;
+	}
+	return time_get()-Start;
+}
+
+static int64 FanOut(CJobPool *pPool, bool *pResult)
+{
+	CJob *pJobs = new CJob[NUM_FANOUT];
+	int64 Time = 0;
+	for(int r = 0; r < NUM_ROUNDS; r++)
+	{
+		s_Counter = 0;
+		int64 Start = time_get();
+		for(int i = 0; i < NUM_FANOUT; i++)
+			pPool->Add(&pJobs[i], CountJob, 0, i%CJobPool::NUM_PRIORITIES);
+		for(int i = 0; i < NUM_FANOUT; i++)
+			pPool->Wait(&pJobs[i]);
+		Time += time_get()-Start;
+		if(s_Counter != NUM_FANOUT)
+		{
+			dbg_msg("jobs", "fan out ran %d of %d jobs", s_Counter, NUM_FANOUT);
+			*pResult = false;
+		}
+	}
+	delete [] pJobs;
+	return Time;
+}
+
+static void SquareRange(int Start, int End, void *pData)
+{
+	int *pValues = (int *)pData;
+	for(int i = Start; i < End; i++)
+		pValues[i] = (i&0xfff)*(i&0xfff);
+}
+
+static int64 ParallelFor(CJobPool *pPool, bool *pResult)
+{
+	int *pValues = (int *)mem_alloc(NUM_PARALLEL*sizeof(int), 1);
+	int64 Time = 0;
+	for(int r = 0; r < NUM_ROUNDS; r++)
+	{
+		mem_zero(pValues, NUM_PARALLEL*sizeof(int));
+		int64 Start = time_get();
+		pPool->ParallelFor(NUM_PARALLEL, 1024, SquareRange, pValues);
+		Time += time_get()-Start;
+		for(int i = 0; i < NUM_PARALLEL; i++)
+			if(pValues[i] != (i&0xfff)*(i&0xfff))
+			{
+				dbg_msg("jobs", "parallel for missed %d", i);
+				*pResult = false;
+				break;
+			}
+	}
+	mem_free(pValues);
+	return Time;
+}
+
+// every link checks that the one before it is done and counts up
+struct CLink
+{
+	CJob m_Job;
+	CLink *m_pPrev;
+	int m_Order;
+};
+
+static volatile unsigned s_Order;
+
+static int LinkJob(void *pData)
+{
+	CLink *pLink = (CLink *)pData;
+	if(pLink->m_pPrev && pLink->m_pPrev->m_Job.Status() != CJob::STATE_DONE)
+		return -1;
+	pLink->m_Order = atomic_inc(&s_Order);
+	return 0;
+}
+
+static int64 Chain(CJobPool *pPool, bool *pResult)
+{
+	CLink *pLinks = new CLink[NUM_CHAIN];
+	int64 Time = 0;
+	for(int r = 0; r < NUM_ROUNDS; r++)
+	{
+		s_Order = 0;
+		int64 Start = time_get();
+		for(int i = 0; i < NUM_CHAIN; i++)
+		{
+			CJob *pDependency = i ? &pLinks[i-1].m_Job : 0;
+			pLinks[i].m_pPrev = i ? &pLinks[i-1] : 0;
+			pPool->Add(&pLinks[i].m_Job, LinkJob, &pLinks[i], CJobPool::PRIORITY_NORMAL, &pDependency, i ? 1 : 0);
+		}
+		pPool->Wait(&pLinks[NUM_CHAIN-1].m_Job);
+		Time += time_get()-Start;
+		for(int i = 0; i < NUM_CHAIN; i++)
+		{
+			if(pLinks[i].m_Job.Status() != CJob::STATE_DONE || pLinks[i].m_Job.Result() != 0 || pLinks[i].m_Order != i+1)
+			{
+				dbg_msg("jobs", "chain link %d ran out of order", i);
+				*pResult = false;
+				break;
+			}
+		}
+	}
+	delete [] pLinks;
+	return Time;
+}
+
+// a job that waits for two others that wait for the same one
+static bool Diamond(CJobPool *pPool)
+{
+	CLink aLinks[4];
+	for(int r = 0; r < NUM_ROUNDS*10; r++)
+	{
+		s_Order = 0;
+		aLinks[0].m_pPrev = 0;
+		pPool->Add(&aLinks[0].m_Job, LinkJob, &aLinks[0]);
+		CJob *pTop = &aLinks[0].m_Job;
+		for(int i = 1; i < 3; i++)
+		{
+			aLinks[i].m_pPrev = &aLinks[0];
+			pPool->Add(&aLinks[i].m_Job, LinkJob, &aLinks[i], CJobPool::PRIORITY_HIGH, &pTop, 1);
+		}
+		CJob *apMiddle[2] = {&aLinks[1].m_Job, &aLinks[2].m_Job};
+		aLinks[3].m_pPrev = &aLinks[1];
+		pPool->Add(&aLinks[3].m_Job, LinkJob, &aLinks[3], CJobPool::PRIORITY_BACKGROUND, apMiddle, 2);
+		pPool->Wait(&aLinks[3].m_Job);
+
+		if(aLinks[0].m_Order != 1 || aLinks[3].m_Order != 4 || aLinks[1].m_Job.Status() != CJob::STATE_DONE ||
+			aLinks[2].m_Job.Status() != CJob::STATE_DONE || aLinks[3].m_Job.Result() != 0)
+		{
+			dbg_msg("jobs", "diamond ran out of order");
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Run(CJobPool *pPool)
+{
+	bool Result = true;
+	int64 Single = SingleJobs(pPool, &Result);
+	int64 Fan = FanOut(pPool, &Result);
+	int64 Parallel = ParallelFor(pPool, &Result);
+	int64 Chained = Chain(pPool, &Result);
+	Result = Diamond(pPool) && Result;
+
+	dbg_msg("jobs", "%d threads: add+wait %6.2f us/job, fan out %6.2f us/job, parallel for %7.2f ms, chain %6.2f us/link",
+		pPool->NumThreads(), Single*1000000.0/time_freq()/NUM_SINGLE, Fan*1000000.0/time_freq()/NUM_ROUNDS/NUM_FANOUT,
+		Parallel*1000.0/time_freq()/NUM_ROUNDS, Chained*1000000.0/time_freq()/NUM_ROUNDS/NUM_CHAIN);
+	return Result;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	// without threads the jobs run right when they are added
+	CJobPool Inline;
+	Inline.Init(0);
+	bool Result = Run(&Inline);
+
+	CJobPool Pool;
+	Pool.Init(NUM_THREADS);
+	Result = Run(&Pool) && Result;
+
+	if(!Result)
+		dbg_msg("jobs", "failed");
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,169 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/storage.h>
+#include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
+
+// resaves every map of a directory like map_resave does, once compressing
+// on the calling thread and once on a job pool, checks that the resaved
+// maps read back the same and measures both
+
+enum
+{
+	MAX_MAPS=256,
+	NUM_THREADS=3,
+};
+
+struct CMapList
+{
+	char m_aaNames[MAX_MAPS][128];
+	int m_Num;
+};
+
+static const char *s_pResaveFilename = "benchmark_resave.map";
+
+static int ListMapsCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CMapList *pList = (CMapList *)pUser;
+	int Length = str_length(pName);
+	if(IsDir || Length < 4 || str_comp(pName+Length-4, ".map") != 0 || pList->m_Num == MAX_MAPS)
+		return 0;
+	str_copy(pList->m_aaNames[pList->m_Num++], pName, sizeof(pList->m_aaNames[0]));
+	return 0;
+}
+
+static bool Resave(IStorage *pStorage, const char *pFilename, CJobPool *pPool, int CompressionLevel)
+{
+	CDataFileReader Reader;
+	CDataFileWriter Writer;
+	if(!Reader.Open(pStorage, pFilename, IStorage::TYPE_ALL) || !Writer.Open(pStorage, s_pResaveFilename, pPool, CompressionLevel))
+		return false;
+
+	for(int i = 0; i < Reader.NumItems(); i++)
+	{
+		int Type, ID;
+		void *pItem = Reader.GetItem(i, &Type, &ID);
+		Writer.AddItem(Type, ID, Reader.GetItemSize(i), pItem);
+	}
+
+	Reader.SetCacheSize(0);
+	for(int i = 0; i < Reader.NumData(); i++)
+	{
+		Writer.AddData(Reader.GetUncompressedDataSize(i), Reader.GetData(i));
+		Reader.UnloadData(i);
+	}
+
+	Writer.Finish();
+	return true;
+}
+
+static bool Compare(IStorage *pStorage, const char *pFilename, int *pResavedSize)
+{
+	CDataFileReader Source, Resaved;
+	if(!Source.Open(pStorage, pFilename, IStorage::TYPE_ALL) || !Resaved.Open(pStorage, s_pResaveFilename, IStorage::TYPE_SAVE))
+		return false;
+
+	IOHANDLE File = pStorage->OpenFile(s_pResaveFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	*pResavedSize = File ? (int)io_length(File) : 0;
+	if(File)
+		io_close(File);
+
+	if(Source.NumItems() != Resaved.NumItems() || Source.NumData() != Resaved.NumData())
+	{
+		dbg_msg("map_resave", "%s: number of items or data differs", pFilename);
+		return false;
+	}
+
+	for(int i = 0; i < Source.NumItems(); i++)
+	{
+		int Type, ID, ResavedType, ResavedID;
+		void *pItem = Source.GetItem(i, &Type, &ID);
+		void *pResavedItem = Resaved.GetItem(i, &ResavedType, &ResavedID);
+		if(Type != ResavedType || ID != ResavedID || Source.GetItemSize(i) != Resaved.GetItemSize(i) ||
+			mem_comp(pItem, pResavedItem, Source.GetItemSize(i)) != 0)
+		{
+			dbg_msg("map_resave", "%s: item %d differs", pFilename, i);
+			return false;
+		}
+	}
+
+	for(int i = 0; i < Source.NumData(); i++)
+	{
+		int Size = Source.GetUncompressedDataSize(i);
+		void *pData = Source.GetData(i);
+		void *pResavedData = Resaved.GetData(i);
+		if(Size != Resaved.GetUncompressedDataSize(i) || !pData || !pResavedData || mem_comp(pData, pResavedData, Size) != 0)
+		{
+			dbg_msg("map_resave", "%s: data %d differs", pFilename, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	if(!pStorage)
+		return -1;
+
+	const char *pDirectory = argc > 1 ? argv[1] : "maps"; // ignore_convention
+	static CMapList s_Maps;
+	s_Maps.m_Num = 0;
+	pStorage->ListDirectory(IStorage::TYPE_ALL, pDirectory, ListMapsCallback, &s_Maps);
+	if(!s_Maps.m_Num)
+	{
+		dbg_msg("map_resave", "no maps in '%s'", pDirectory);
+		return -1;
+	}
+
+	CJobPool Pool;
+	Pool.Init(NUM_THREADS);
+
+	struct
+	{
+		const char *m_pName;
+		CJobPool *m_pPool;
+		int m_CompressionLevel;
+		int64 m_Time;
+		int64 m_Size;
+	} aRuns[] = {
+		{"main thread", 0, CDataFileWriter::COMPRESSION_DEFAULT, 0, 0},
+		{"pool", &Pool, CDataFileWriter::COMPRESSION_DEFAULT, 0, 0},
+		{"pool, fast", &Pool, CDataFileWriter::COMPRESSION_FAST, 0, 0},
+		{"pool, best", &Pool, CDataFileWriter::COMPRESSION_BEST, 0, 0},
+	};
+
+	bool Result = true;
+	for(int m = 0; m < s_Maps.m_Num && Result; m++)
+	{
+		char aFilename[512];
+		str_format(aFilename, sizeof(aFilename), "%s/%s", pDirectory, s_Maps.m_aaNames[m]);
+		for(unsigned r = 0; r < sizeof(aRuns)/sizeof(aRuns[0]) && Result; r++)
+		{
+			int64 Start = time_get();
+			int ResavedSize = 0;
+			Result = Resave(pStorage, aFilename, aRuns[r].m_pPool, aRuns[r].m_CompressionLevel);
+			aRuns[r].m_Time += time_get()-Start;
+			if(!Result)
+				dbg_msg("map_resave", "couldn't resave %s", aFilename);
+			else
+				Result = Compare(pStorage, aFilename, &ResavedSize);
+			aRuns[r].m_Size += ResavedSize;
+		}
+	}
+	pStorage->RemoveFile(s_pResaveFilename, IStorage::TYPE_SAVE);
+
+	if(Result)
+	{
+		for(unsigned r = 0; r < sizeof(aRuns)/sizeof(aRuns[0]); r++)
+			dbg_msg("map_resave", "%d maps, %-12s %8.2f ms, %8d kb", s_Maps.m_Num, aRuns[r].m_pName,
+				aRuns[r].m_Time*1000.0/time_freq(), (int)(aRuns[r].m_Size/1024));
+	}
+	return Result ? 0 : -1;
+}
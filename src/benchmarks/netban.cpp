@@ -0,0 +1,314 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+
+#include "benchmark.h"
+
+// fills the ban list with 100k address and range bans, checks CNetBan::IsBanned
+// against a scan over all bans and measures what the check costs per packet
+
+enum
+{
+	NUM_ADDR_BANS_V4=60000,
+	NUM_ADDR_BANS_V6=20000,
+	NUM_RANGE_BANS_V4=15000,
+	NUM_RANGE_BANS_V6=5000,
+	NUM_BANS=NUM_ADDR_BANS_V4+NUM_ADDR_BANS_V6+NUM_RANGE_BANS_V4+NUM_RANGE_BANS_V6,
+
+	NUM_CHECKED_PACKETS=2000,
+	NUM_TIMED_PACKETS=1000000,
+	MAX_LINES=16,
+};
+
+// the ban list prints every change to the console, so the results are
+// only logged once the ban list is done
+static char s_aaLines[MAX_LINES][256];
+static int s_NumLines = 0;
+
+static void Report(const char *pLine)
+{
+	if(s_NumLines < MAX_LINES)
+		str_copy(s_aaLines[s_NumLines++], pLine, sizeof(s_aaLines[0]));
+}
+
+struct CRefBan
+{
+	CNetRange m_Range; // single addresses have equal bounds
+	bool m_Active;
+};
+
+static CRefBan s_aRefBans[NUM_BANS];
+static int s_NumRefBans = 0;
+static NETADDR s_aPackets[NUM_TIMED_PACKETS];
+
+static int IpSize(const NETADDR *pAddr)
+{
+	return pAddr->type==NETTYPE_IPV4 ? 4 : 16;
+}
+
+static NETADDR RandomAddr(int Type)
+{
+	NETADDR Addr;
+	mem_zero(&Addr, sizeof(Addr));
+	Addr.type = Type;
+	// keep the addresses in a few blocks so that ranges and addresses overlap
+	Addr.ip[0] = 1 + Random()%8;
+	for(int i = 1; i < IpSize(&Addr); i++)
+		Addr.ip[i] = Random();
+	Addr.port = 8303;
+	return Addr;
+}
+
+static NETADDR RandomAddrIn(const CNetRange *pRange)
+{
+	// pick bytes between the bounds from the front
+	NETADDR Addr = pRange->m_LB;
+	bool Lower = true, Upper = true;
+	for(int i = 0; i < IpSize(&Addr); i++)
+	{
+		int Min = Lower ? pRange->m_LB.ip[i] : 0;
+		int Max = Upper ? pRange->m_UB.ip[i] : 255;
+		Addr.ip[i] = Min + Random()%(Max-Min+1);
+		Lower = Lower && Addr.ip[i] == Min;
+		Upper = Upper && Addr.ip[i] == Max;
+	}
+	return Addr;
+}
+
+static CNetRange RandomRange(int Type)
+{
+	CNetRange Range;
+	Range.m_LB = RandomAddr(Type);
+	Range.m_UB = Range.m_LB;
+	int Size = IpSize(&Range.m_LB);
+	if(Random()%2)
+	{
+		// subnet like
+		int Bytes = 1 + Random()%(Type==NETTYPE_IPV4 ? 2 : 8);
+		for(int i = Size-Bytes; i < Size; i++)
+		{
+			Range.m_LB.ip[i] = 0;
+			Range.m_UB.ip[i] = 255;
+		}
+	}
+	else
+	{
+		// arbitrary bounds over the last bytes
+		int Span = 1 + Random()%0x7ffff;
+		for(int i = Size-1; i >= 0 && Span; i--)
+		{
+			int Sum = Range.m_UB.ip[i] + (Span&0xff);
+			Range.m_UB.ip[i] = Sum&0xff;
+			Span = (Span>>8) + (Sum>>8);
+		}
+		if(mem_comp(Range.m_LB.ip, Range.m_UB.ip, Size) >= 0)
+			Range.m_UB.ip[0] = 0xff;
+	}
+	return Range;
+}
+
+static bool RefIsBanned(const NETADDR *pAddr)
+{
+	for(int i = 0; i < s_NumRefBans; i++)
+	{
+		const CNetRange *pRange = &s_aRefBans[i].m_Range;
+		if(s_aRefBans[i].m_Active && pRange->m_LB.type == pAddr->type &&
+			mem_comp(pRange->m_LB.ip, pAddr->ip, IpSize(pAddr)) <= 0 && mem_comp(pRange->m_UB.ip, pAddr->ip, IpSize(pAddr)) >= 0)
+			return true;
+	}
+	return false;
+}
+
+static NETADDR RandomPacket()
+{
+	// a quarter comes from banned addresses, a quarter from banned ranges
+	const CRefBan *pBan = &s_aRefBans[Random()%s_NumRefBans];
+	switch(Random()%4)
+	{
+	case 0: return pBan->m_Range.m_LB;
+	case 1: return RandomAddrIn(&pBan->m_Range);
+	case 2: return RandomAddr(Random()%4 ? NETTYPE_IPV4 : NETTYPE_IPV6);
+	}
+
+	// anywhere
+	NETADDR Addr = RandomAddr(Random()%4 ? NETTYPE_IPV4 : NETTYPE_IPV6);
+	Addr.ip[0] = Random();
+	return Addr;
+}
+
+static bool Check(CNetBan *pNetBan, const char *pWhen)
+{
+	char aBuf[256];
+	int Banned = 0;
+	for(int i = 0; i < NUM_CHECKED_PACKETS; i++)
+	{
+		NETADDR Addr = RandomPacket();
+		bool Result = pNetBan->IsBanned(&Addr, aBuf, sizeof(aBuf));
+		if(Result != RefIsBanned(&Addr))
+		{
+			char aAddrStr[NETADDR_MAXSTRSIZE], aLine[256];
+			net_addr_str(&Addr, aAddrStr, sizeof(aAddrStr), false);
+			str_format(aLine, sizeof(aLine), "%s: %s is %s, but shouldn't be", pWhen, aAddrStr, Result ? "banned" : "not banned");
+			Report(aLine);
+			return false;
+		}
+		if(Result)
+			Banned++;
+	}
+
+	str_format(aBuf, sizeof(aBuf), "%s: %d of %d packets agree with the scan, %d banned", pWhen, (int)NUM_CHECKED_PACKETS, (int)NUM_CHECKED_PACKETS, Banned);
+	Report(aBuf);
+	return true;
+}
+
+static double TimePackets(CNetBan *pNetBan, int Num)
+{
+	// without a buffer for the ban message, like the master server does it
+	int64 Start = time_get();
+	for(int i = 0; i < Num; i++)
+		pNetBan->IsBanned(&s_aPackets[i], 0, 0);
+	return Num ? (time_get()-Start)*1000000000.0/time_freq()/Num : 0.0;
+}
+
+static void Measure(CNetBan *pNetBan, const char *pWhen, bool Scan)
+{
+	// banned packets first, then the others
+	int NumBanned = 0;
+	for(int i = 0; i < NUM_TIMED_PACKETS; i++)
+	{
+		s_aPackets[i] = RandomPacket();
+		if(pNetBan->IsBanned(&s_aPackets[i], 0, 0))
+		{
+			NETADDR Addr = s_aPackets[NumBanned];
+			s_aPackets[NumBanned++] = s_aPackets[i];
+			s_aPackets[i] = Addr;
+		}
+	}
+
+	int64 Start = time_get();
+	TimePackets(pNetBan, NUM_TIMED_PACKETS);
+	double Ns = (time_get()-Start)*1000000000.0/time_freq()/NUM_TIMED_PACKETS;
+	double BannedNs = TimePackets(pNetBan, NumBanned);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%s: IsBanned %6.1f ns/packet, %6.1f ns/banned packet (%d%%)", pWhen, Ns, BannedNs, NumBanned*100/NUM_TIMED_PACKETS);
+	Report(aBuf);
+
+	// the scan is far too slow for all packets
+	if(Scan)
+	{
+		int NumScanned = NUM_TIMED_PACKETS/1000;
+		Start = time_get();
+		for(int i = 0; i < NumScanned; i++)
+			RefIsBanned(&s_aPackets[i*1000]);
+		str_format(aBuf, sizeof(aBuf), "%s: scan over all bans %9.1f ns/packet", pWhen, (time_get()-Start)*1000000000.0/time_freq()/NumScanned);
+		Report(aBuf);
+	}
+}
+
+static bool Run(CNetBan *pNetBan)
+{
+	char aBuf[256];
+
+	// fill the ban list
+	int64 Start = time_get();
+	for(int i = 0; i < NUM_BANS; i++)
+	{
+		CRefBan *pRef = &s_aRefBans[s_NumRefBans];
+		int Result;
+		if(i < NUM_ADDR_BANS_V4+NUM_ADDR_BANS_V6)
+		{
+			pRef->m_Range.m_LB = RandomAddr(i < NUM_ADDR_BANS_V4 ? NETTYPE_IPV4 : NETTYPE_IPV6);
+			pRef->m_Range.m_UB = pRef->m_Range.m_LB;
+			Result = pNetBan->BanAddr(&pRef->m_Range.m_LB, 3600, "benchmark");
+		}
+		else
+		{
+			pRef->m_Range = RandomRange(i < NUM_ADDR_BANS_V4+NUM_ADDR_BANS_V6+NUM_RANGE_BANS_V4 ? NETTYPE_IPV4 : NETTYPE_IPV6);
+			Result = pNetBan->BanRange(&pRef->m_Range, 3600, "benchmark");
+		}
+		if(Result == 0)
+		{
+			pRef->m_Active = true;
+			s_NumRefBans++;
+		}
+	}
+	int64 Time = time_get()-Start;
+	str_format(aBuf, sizeof(aBuf), "added %d bans in %.1f ms", s_NumRefBans, Time*1000.0/time_freq());
+	Report(aBuf);
+
+	if(!Check(pNetBan, "all bans"))
+		return false;
+	Measure(pNetBan, "all bans", true);
+
+	// take every second ban off again
+	Start = time_get();
+	for(int i = 0; i < s_NumRefBans; i += 2)
+	{
+		CRefBan *pRef = &s_aRefBans[i];
+		if(NetComp(&pRef->m_Range.m_LB, &pRef->m_Range.m_UB) == 0)
+			pNetBan->UnbanByAddr(&pRef->m_Range.m_LB);
+		else
+			pNetBan->UnbanByRange(&pRef->m_Range);
+		pRef->m_Active = false;
+	}
+	Time = time_get()-Start;
+	str_format(aBuf, sizeof(aBuf), "removed %d bans in %.1f ms", (s_NumRefBans+1)/2, Time*1000.0/time_freq());
+	Report(aBuf);
+
+	if(!Check(pNetBan, "half of the bans"))
+		return false;
+
+	// bans that run out leave the list on the next update after that second
+	pNetBan->UnbanAll();
+	for(int i = 0; i < s_NumRefBans; i++)
+	{
+		s_aRefBans[i].m_Active = false;
+		if(NetComp(&s_aRefBans[i].m_Range.m_LB, &s_aRefBans[i].m_Range.m_UB) == 0)
+			pNetBan->BanAddr(&s_aRefBans[i].m_Range.m_LB, 1, "benchmark");
+		else
+			pNetBan->BanRange(&s_aRefBans[i].m_Range, 1, "benchmark");
+	}
+	int64 UpdateTime = 0;
+	int Updates = 0;
+	int64 End = time_get()+3*time_freq();
+	while(time_get() < End)
+	{
+		Start = time_get();
+		pNetBan->Update();
+		UpdateTime += time_get()-Start;
+		Updates++;
+		thread_sleep(10);
+	}
+	str_format(aBuf, sizeof(aBuf), "expired %d bans in %d updates, %.1f ms in total", s_NumRefBans, Updates, UpdateTime*1000.0/time_freq());
+	Report(aBuf);
+
+	if(!Check(pNetBan, "expired bans"))
+		return false;
+	Measure(pNetBan, "no bans", false);
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	if(argc > 1) // ignore_convention
+		SeedRandom(str_toint(argv[1])); // ignore_convention
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan NetBan;
+	NetBan.Init(pConsole, 0);
+
+	bool Result = Run(&NetBan);
+
+	dbg_logger_stdout();
+	for(int i = 0; i < s_NumLines; i++)
+		dbg_msg("netban", "%s", s_aaLines[i]);
+
+	delete pConsole;
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,317 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h> // srand
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/client/particle_group.h>
+
+// spawns the particles of smoke trails and bursts of explosions like the
+// effects do and updates them at 100 fps, once with the linked list of
+// particles CParticles had before and once with the particle groups.
+// the list updates the way CParticles::Update did and gets timed like that.
+// the check runs both with the same elasticity, the random bounces draw
+// different random numbers, and compares the particles after every update
+
+enum
+{
+	NUM_GROUPS=3, // trails, explosions and general like CParticles
+	MAX_PARTICLES=CParticleGroups::MAX_PARTICLES,
+	FRAMES_PER_SECOND=100,
+	NUM_FRAMES=FRAMES_PER_SECOND*30,
+};
+
+static CCollision s_Collision;
+
+static vec2 RandomDir() { return normalize(vec2(frandom()-0.5f, frandom()-0.5f)); }
+
+static vec2 RandomPos()
+{
+	vec2 Pos;
+	do
+		Pos = vec2(32.0f+frandom()*max(s_Collision.GetWidth()*32-64, 1), 32.0f+frandom()*max(s_Collision.GetHeight()*32-64, 1));
+	while(s_Collision.CheckPoint(Pos));
+	return Pos;
+}
+
+// the old particle system, the lists start with the newest particle
+class CLinkedParticles
+{
+	struct CEntry
+	{
+		CParticle m_Part;
+		float m_Life;
+		int m_PrevPart;
+		int m_NextPart;
+	};
+
+	CEntry m_aParticles[MAX_PARTICLES];
+	int m_FirstFree;
+	int m_aFirstPart[NUM_GROUPS];
+
+public:
+	void Reset()
+	{
+		for(int i = 0; i < MAX_PARTICLES; i++)
+		{
+			m_aParticles[i].m_PrevPart = i-1;
+			m_aParticles[i].m_NextPart = i+1;
+		}
+		m_aParticles[0].m_PrevPart = 0;
+		m_aParticles[MAX_PARTICLES-1].m_NextPart = -1;
+		m_FirstFree = 0;
+		for(int i = 0; i < NUM_GROUPS; i++)
+			m_aFirstPart[i] = -1;
+	}
+
+	void Add(int Group, const CParticle *pPart)
+	{
+		if(m_FirstFree == -1)
+			return;
+
+		int Id = m_FirstFree;
+		m_FirstFree = m_aParticles[Id].m_NextPart;
+		if(m_FirstFree != -1)
+			m_aParticles[m_FirstFree].m_PrevPart = -1;
+
+		m_aParticles[Id].m_Part = *pPart;
+		m_aParticles[Id].m_Life = 0;
+		m_aParticles[Id].m_PrevPart = -1;
+		m_aParticles[Id].m_NextPart = m_aFirstPart[Group];
+		if(m_aFirstPart[Group] != -1)
+			m_aParticles[m_aFirstPart[Group]].m_PrevPart = Id;
+		m_aFirstPart[Group] = Id;
+	}
+
+	// CParticles::Update before the groups, the elasticity can be fixed for the check
+	void Update(float TimePassed, int FrictionCount, float Elasticity)
+	{
+		for(int g = 0; g < NUM_GROUPS; g++)
+		{
+			int i = m_aFirstPart[g];
+			while(i != -1)
+			{
+				CEntry *pEntry = &m_aParticles[i];
+				int Next = pEntry->m_NextPart;
+				pEntry->m_Part.m_Vel.y += pEntry->m_Part.m_Gravity*TimePassed;
+
+				for(int f = 0; f < FrictionCount; f++)
+					pEntry->m_Part.m_Vel *= pEntry->m_Part.m_Friction;
+
+				vec2 Vel = pEntry->m_Part.m_Vel*TimePassed;
+				s_Collision.MovePoint(&pEntry->m_Part.m_Pos, &Vel, Elasticity < 0.0f ? 0.1f+0.9f*frandom() : Elasticity, NULL);
+				pEntry->m_Part.m_Vel = Vel*(1.0f/TimePassed);
+
+				pEntry->m_Life += TimePassed;
+				pEntry->m_Part.m_Rot += TimePassed*pEntry->m_Part.m_Rotspeed;
+
+				if(pEntry->m_Life > pEntry->m_Part.m_LifeSpan)
+				{
+					if(pEntry->m_PrevPart != -1)
+						m_aParticles[pEntry->m_PrevPart].m_NextPart = pEntry->m_NextPart;
+					else
+						m_aFirstPart[g] = pEntry->m_NextPart;
+					if(pEntry->m_NextPart != -1)
+						m_aParticles[pEntry->m_NextPart].m_PrevPart = pEntry->m_PrevPart;
+
+					if(m_FirstFree != -1)
+						m_aParticles[m_FirstFree].m_PrevPart = i;
+					pEntry->m_PrevPart = -1;
+					pEntry->m_NextPart = m_FirstFree;
+					m_FirstFree = i;
+				}
+
+				i = Next;
+			}
+		}
+	}
+
+	// the groups keep the oldest particle first, the lists the newest
+	bool Matches(const CParticleGroups *pGroups) const
+	{
+		for(int g = 0; g < NUM_GROUPS; g++)
+		{
+			int n = pGroups->Num()-1;
+			for(int i = m_aFirstPart[g]; i != -1; i = m_aParticles[i].m_NextPart, n--)
+			{
+				while(n >= 0 && pGroups->Group(n) != g)
+					n--;
+				const CEntry *pEntry = &m_aParticles[i];
+				if(n < 0 || pGroups->Pos(n) != pEntry->m_Part.m_Pos || pGroups->Vel(n) != pEntry->m_Part.m_Vel ||
+					pGroups->Life(n) != pEntry->m_Life || pGroups->Rot(n) != pEntry->m_Part.m_Rot)
+					return false;
+			}
+			while(n >= 0 && pGroups->Group(n) != g)
+				n--;
+			if(n != -1)
+				return false;
+		}
+		return true;
+	}
+};
+
+static CLinkedParticles s_Linked;
+static CParticleGroups s_Groups;
+
+static void Add(int Mode, int Group, const CParticle *pPart)
+{
+	if(Mode != 2)
+		s_Linked.Add(Group, pPart);
+	if(Mode != 1)
+		s_Groups.Add(Group, pPart);
+}
+
+static void SmokeTrail(int Mode, vec2 Pos, vec2 Vel)
+{
+	CParticle p;
+	p.SetDefault();
+	p.m_Pos = Pos;
+	p.m_Vel = Vel + RandomDir()*50.0f;
+	p.m_LifeSpan = 0.5f + frandom()*0.5f;
+	p.m_StartSize = 12.0f + frandom()*8;
+	p.m_EndSize = 0;
+	p.m_Friction = 0.7f;
+	p.m_Gravity = frandom()*-500.0f;
+	Add(Mode, 0, &p);
+}
+
+static void Explosion(int Mode, vec2 Pos)
+{
+	CParticle p;
+	p.SetDefault();
+	p.m_Pos = Pos;
+	p.m_LifeSpan = 0.4f;
+	p.m_StartSize = 150.0f;
+	p.m_EndSize = 0;
+	p.m_Rot = frandom()*pi*2;
+	Add(Mode, 1, &p);
+
+	for(int i = 0; i < 24; i++)
+	{
+		CParticle p;
+		p.SetDefault();
+		p.m_Pos = Pos;
+		p.m_Vel = RandomDir() * ((1.0f + frandom()*0.2f) * 1000.0f);
+		p.m_LifeSpan = 0.5f + frandom()*0.4f;
+		p.m_StartSize = 32.0f + frandom()*8;
+		p.m_EndSize = 0;
+		p.m_Gravity = frandom()*-800.0f;
+		p.m_Friction = 0.4f;
+		Add(Mode, 2, &p);
+	}
+}
+
+// Mode 0 checks the groups against the list, 1 times the list and 2 the groups
+static bool Run(int Mode, int Trails, int BurstInterval, int BurstSize, int64 *pTime, int64 *pMaxTime, int64 *pNumParticles)
+{
+	s_Linked.Reset();
+	s_Groups.Reset();
+	*pTime = 0;
+	*pMaxTime = 0;
+	*pNumParticles = 0;
+
+	// the same particles and bounces every run
+	srand(1);
+	vec2 aTrails[64];
+	for(int t = 0; t < Trails; t++)
+		aTrails[t] = RandomPos();
+
+	float TimePassed = 1.0f/FRAMES_PER_SECOND;
+	float FrictionFraction = 0;
+	for(int Frame = 0; Frame < NUM_FRAMES; Frame++)
+	{
+		// trails at 50 hz, bursts of explosions now and then
+		if(Frame%2 == 0)
+			for(int t = 0; t < Trails; t++)
+				SmokeTrail(Mode, aTrails[t], RandomDir()*1000.0f);
+		if(Frame%BurstInterval == 0)
+			for(int e = 0; e < BurstSize; e++)
+				Explosion(Mode, RandomPos());
+
+		FrictionFraction += TimePassed;
+		int FrictionCount = 0;
+		while(FrictionFraction > 0.05f)
+		{
+			FrictionCount++;
+			FrictionFraction -= 0.05f;
+		}
+
+		if(Mode == 0)
+		{
+			s_Linked.Update(TimePassed, FrictionCount, 0.5f);
+			s_Groups.Update(TimePassed, FrictionCount, &s_Collision, 0.5f);
+			if(!s_Linked.Matches(&s_Groups))
+			{
+				dbg_msg("particles", "particles differ at frame %d", Frame);
+				return false;
+			}
+			continue;
+		}
+
+		int64 Start = time_get();
+		if(Mode == 1)
+			s_Linked.Update(TimePassed, FrictionCount, -1.0f);
+		else
+			s_Groups.Update(TimePassed, FrictionCount, &s_Collision);
+		int64 Time = time_get()-Start;
+		*pTime += Time;
+		*pMaxTime = max(*pMaxTime, Time);
+		*pNumParticles += s_Groups.Num();
+	}
+	return true;
+}
+
+static bool Bench(const char *pName, int Trails, int BurstInterval, int BurstSize)
+{
+	int64 aTimes[3], aMaxTimes[3], aParticles[3];
+	if(!Run(0, Trails, BurstInterval, BurstSize, &aTimes[0], &aMaxTimes[0], &aParticles[0]))
+		return false;
+	Run(1, Trails, BurstInterval, BurstSize, &aTimes[1], &aMaxTimes[1], &aParticles[1]);
+	Run(2, Trails, BurstInterval, BurstSize, &aTimes[2], &aMaxTimes[2], &aParticles[2]);
+
+	double Us = 1000000.0/time_freq();
+	dbg_msg("particles", "%-10s %5d particles: list %7.2f us/frame (max %7.2f), groups %7.2f us/frame (max %7.2f)",
+		pName, (int)(aParticles[2]/NUM_FRAMES), aTimes[1]*Us/NUM_FRAMES, aMaxTimes[1]*Us, aTimes[2]*Us/NUM_FRAMES, aMaxTimes[2]*Us);
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("particles", "usage: %s <map>", argv[0]); // ignore_convention
+		return -1;
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IEngineMap *pMap = CreateEngineMap();
+	char aMapFile[512];
+	str_format(aMapFile, sizeof(aMapFile), "maps/%s.map", argv[1]); // ignore_convention
+	if(!pStorage || !pMap->Load(aMapFile, pStorage))
+	{
+		dbg_msg("particles", "couldn't load %s", aMapFile);
+		return -1;
+	}
+
+	CLayers Layers;
+	Layers.Init(0, pMap);
+	s_Collision.Init(&Layers);
+
+	// a few grenades in the air, a fight and everyone spamming grenades
+	bool Result = Bench("trails", 8, FRAMES_PER_SECOND, 1) && Bench("fight", 16, FRAMES_PER_SECOND/5, 4) &&
+		Bench("explosions", 32, FRAMES_PER_SECOND/2, 40);
+	if(!Result)
+		dbg_msg("particles", "failed");
+
+	pMap->Unload();
+	return Result ? 0 : -1;
+}
@@ -0,0 +1,197 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+
+#include <generated/protocol.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+
+#include "benchmark.h"
+
+// reports how the time of a server tick grows with the player count. the
+// character physics and the per client snapshots are what scales with it
+
+enum
+{
+	SNAP_RANGE_X=1000,
+	SNAP_RANGE_Y=800,
+};
+
+static CCollision s_Collision;
+static CWorldCore s_World;
+static CCharacterCore s_aCores[MAX_CLIENTS];
+
+// one of these per snapping client, what the server keeps to delta against
+static char s_aaLastSnap[MAX_CLIENTS][CSnapshot::MAX_SIZE];
+static char s_aSnap[CSnapshot::MAX_SIZE];
+static char s_aDelta[CSnapshot::MAX_SIZE];
+static char s_aCompressed[CSnapshot::MAX_SIZE];
+
+static vec2 FreePosition()
+{
+	while(1)
+	{
+		vec2 Pos((Random()%s_Collision.GetWidth())*32.0f+16.0f, (Random()%s_Collision.GetHeight())*32.0f+16.0f);
+		if(!s_Collision.CheckPoint(Pos))
+			return Pos;
+	}
+}
+
+static void Spawn(int NumPlayers)
+{
+	mem_zero(s_World.m_apCharacters, sizeof(s_World.m_apCharacters));
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		s_aCores[i].Init(&s_World, &s_Collision);
+		s_aCores[i].Reset();
+		s_aCores[i].m_Pos = FreePosition();
+		s_World.m_apCharacters[i] = &s_aCores[i];
+		((CSnapshot *)s_aaLastSnap[i])->Clear();
+	}
+}
+
+// players run around, jump and hook at random
+static void SetInputs(int NumPlayers, int Tick)
+{
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		CNetObj_PlayerInput *pInput = &s_aCores[i].m_Input;
+		if(Tick%25 == i%25)
+		{
+			pInput->m_Direction = (int)(Random()%3)-1;
+			pInput->m_TargetX = (int)(Random()%512)-256;
+			pInput->m_TargetY = (int)(Random()%512)-256;
+			pInput->m_Hook = Random()%2;
+		}
+		pInput->m_Jump = (Tick+i)%40 < 2;
+	}
+}
+
+static void TickCores(int NumPlayers)
+{
+	for(int i = 0; i < NumPlayers; i++)
+		s_aCores[i].Tick(true);
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		s_aCores[i].Move();
+		s_aCores[i].Quantize();
+
+		// players that fall out of the map respawn
+		if(s_Collision.GetCollisionAt(s_aCores[i].m_Pos.x, s_aCores[i].m_Pos.y)&CCollision::COLFLAG_DEATH ||
+			s_aCores[i].m_Pos.x < 0 || s_aCores[i].m_Pos.y < 0 ||
+			s_aCores[i].m_Pos.x > s_Collision.GetWidth()*32.0f || s_aCores[i].m_Pos.y > s_Collision.GetHeight()*32.0f)
+		{
+			s_aCores[i].Reset();
+			s_aCores[i].m_Pos = FreePosition();
+		}
+	}
+}
+
+// returns the compressed bytes of all snapshots
+static int SnapAll(CSnapshotBuilder *pBuilder, CSnapshotDelta *pDelta, int NumPlayers, int Tick)
+{
+	int Bytes = 0;
+	for(int c = 0; c < NumPlayers; c++)
+	{
+		pBuilder->Init();
+		for(int i = 0; i < NumPlayers; i++)
+		{
+			CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)pBuilder->NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+			pInfo->m_PlayerFlags = 0;
+			pInfo->m_Score = i;
+			pInfo->m_Latency = 50;
+
+			vec2 Diff = s_aCores[i].m_Pos-s_aCores[c].m_Pos;
+			if(absolute(Diff.x) > SNAP_RANGE_X || absolute(Diff.y) > SNAP_RANGE_Y)
+				continue;
+
+			CNetObj_Character *pCharacter = (CNetObj_Character *)pBuilder->NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+			mem_zero(pCharacter, sizeof(CNetObj_Character));
+			s_aCores[i].Write(pCharacter);
+			pCharacter->m_Tick = Tick;
+			pCharacter->m_Health = 10;
+		}
+		int Size = pBuilder->Finish(s_aSnap);
+
+		int DeltaSize = pDelta->CreateDelta((CSnapshot *)s_aaLastSnap[c], (CSnapshot *)s_aSnap, s_aDelta);
+		if(DeltaSize)
+			Bytes += CVariableInt::Compress(s_aDelta, DeltaSize, s_aCompressed);
+		mem_copy(s_aaLastSnap[c], s_aSnap, Size);
+	}
+	return Bytes;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("player_count", "usage: %s <map> [ticks]", argv[0]); // ignore_convention
+		return -1;
+	}
+	int Ticks = argc > 2 ? max(str_toint(argv[2]), 1) : 500; // ignore_convention
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IEngineMap *pMap = CreateEngineMap();
+	char aMapFile[512];
+	str_format(aMapFile, sizeof(aMapFile), "maps/%s.map", argv[1]); // ignore_convention
+	if(!pStorage || !pMap->Load(aMapFile, pStorage))
+	{
+		dbg_msg("player_count", "couldn't load %s", aMapFile);
+		return -1;
+	}
+
+	CLayers Layers;
+	Layers.Init(0, pMap);
+	s_Collision.Init(&Layers);
+
+	CNetObjHandler NetObjHandler;
+	static CSnapshotBuilder s_Builder;
+	static CSnapshotDelta s_Delta;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		s_Delta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+
+	static const int s_aPlayerCounts[] = {1, 4, 8, 12, MAX_CLIENTS};
+	for(unsigned p = 0; p < sizeof(s_aPlayerCounts)/sizeof(s_aPlayerCounts[0]); p++)
+	{
+		int NumPlayers = s_aPlayerCounts[p];
+
+		SeedRandom(1);
+		Spawn(NumPlayers);
+
+		int64 CoreTime = 0;
+		int64 SnapTime = 0;
+		int64 Bytes = 0;
+		for(int t = 0; t < Ticks; t++)
+		{
+			SetInputs(NumPlayers, t);
+			int64 Start = time_get();
+			TickCores(NumPlayers);
+			CoreTime += time_get()-Start;
+
+			// the server snaps every second tick
+			if(t%2 == 0)
+			{
+				Start = time_get();
+				Bytes += SnapAll(&s_Builder, &s_Delta, NumPlayers, t);
+				SnapTime += time_get()-Start;
+			}
+		}
+
+		double TickUs = CoreTime*1000000.0/time_freq()/Ticks;
+		double SnapUs = SnapTime*1000000.0/time_freq()/Ticks;
+		dbg_msg("player_count", "%2d players: core %7.2f us/tick, snap %8.2f us/tick, total %8.2f us/tick, %6.1f snapshot bytes/tick",
+			NumPlayers, TickUs, SnapUs, TickUs+SnapUs, Bytes/(double)Ticks);
+	}
+
+	pMap->Unload();
+	return 0;
+}
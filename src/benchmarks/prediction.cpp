@@ -0,0 +1,287 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/client/prediction.h>
+
+#include "benchmark.h"
+
+// plays a match on the server side, then predicts it the way the client
+// does at 200 ms ping: snapshots every second tick that arrive 100 ms
+// late and a predicted tick 100 ms ahead. checks that the incremental
+// prediction ends up where predicting everything from the snapshot does
+// and compares the ticks both simulate per frame
+
+enum
+{
+	NUM_PLAYERS=8,
+	NUM_TICKS=50*60,
+	FRAMES_PER_SECOND=100,
+	LATENCY_TICKS=5, // one way, 100 ms
+	SNAP_INTERVAL=2,
+	LOCAL_ID=0,
+};
+
+static CCollision s_Collision;
+static CTuningParams s_Tuning;
+
+// inputs of every player for every tick and the world the server sends for every tick
+static CNetObj_PlayerInput s_aaInputs[NUM_TICKS+LATENCY_TICKS*2+2][NUM_PLAYERS];
+static CNetObj_CharacterCore s_aaSnapCores[NUM_TICKS+1][NUM_PLAYERS];
+
+// players keep their input for a while, like people do
+static void GenerateInputs(int NumPlayers, bool Moving)
+{
+	mem_zero(s_aaInputs, sizeof(s_aaInputs));
+	for(int p = 0; p < NumPlayers; p++)
+	{
+		CNetObj_PlayerInput Input = {0};
+		Input.m_TargetX = 100;
+		int Hold = 0;
+		for(int t = 0; t < NUM_TICKS+LATENCY_TICKS*2+2; t++)
+		{
+			if(Moving || p == LOCAL_ID)
+			{
+				if(--Hold <= 0)
+				{
+					Hold = 1+Random()%25;
+					Input.m_Direction = (int)(Random()%3)-1;
+					Input.m_Jump = Random()%4 == 0;
+					Input.m_Hook = Random()%3 == 0;
+					Input.m_TargetX = (int)(Random()%400)-200;
+					Input.m_TargetY = (int)(Random()%400)-200;
+				}
+				else
+					Input.m_Jump = 0;
+			}
+			s_aaInputs[t][p] = Input;
+		}
+	}
+}
+
+static void RunServer(int NumPlayers)
+{
+	CWorldCore World;
+	World.m_Tuning = s_Tuning;
+	static CCharacterCore s_aCharacters[NUM_PLAYERS];
+	for(int p = 0; p < NumPlayers; p++)
+	{
+		vec2 Pos;
+		do
+			Pos = vec2(32.0f+Random()%max(s_Collision.GetWidth()*32-64, 1), 32.0f+Random()%max(s_Collision.GetHeight()*32-64, 1));
+		while(s_Collision.TestBox(Pos, vec2(28.0f, 28.0f)));
+
+		s_aCharacters[p].Init(&World, &s_Collision);
+		s_aCharacters[p].Reset();
+		s_aCharacters[p].m_Pos = Pos;
+		s_aCharacters[p].Quantize();
+		World.m_apCharacters[p] = &s_aCharacters[p];
+	}
+
+	for(int t = 0; t <= NUM_TICKS; t++)
+	{
+		if(t > 0)
+		{
+			for(int p = 0; p < NumPlayers; p++)
+			{
+				s_aCharacters[p].m_Input = s_aaInputs[t][p];
+				s_aCharacters[p].Tick(true);
+			}
+			for(int p = 0; p < NumPlayers; p++)
+			{
+				s_aCharacters[p].Move();
+				s_aCharacters[p].Quantize();
+			}
+		}
+
+		for(int p = 0; p < NumPlayers; p++)
+		{
+			mem_zero(&s_aaSnapCores[t][p], sizeof(s_aaSnapCores[t][p]));
+			s_aCharacters[p].Write(&s_aaSnapCores[t][p]);
+			s_aaSnapCores[t][p].m_Tick = t;
+		}
+	}
+}
+
+// what CGameClient::OnPredict did before, all ticks from the snapshot
+static void PredictAll(int NumPlayers, int SnapTick, int PredTick, CNetObj_CharacterCore *pOut)
+{
+	CWorldCore World;
+	World.m_Tuning = s_Tuning;
+	CCharacterCore aCharacters[NUM_PLAYERS];
+	for(int p = 0; p < NumPlayers; p++)
+	{
+		aCharacters[p].Init(&World, &s_Collision);
+		aCharacters[p].Read(&s_aaSnapCores[SnapTick][p]);
+		World.m_apCharacters[p] = &aCharacters[p];
+	}
+
+	for(int Tick = SnapTick+1; Tick <= PredTick; Tick++)
+	{
+		for(int p = 0; p < NumPlayers; p++)
+		{
+			mem_zero(&aCharacters[p].m_Input, sizeof(aCharacters[p].m_Input));
+			if(p == LOCAL_ID)
+			{
+				aCharacters[p].m_Input = s_aaInputs[Tick][p];
+				aCharacters[p].Tick(true);
+			}
+			else
+				aCharacters[p].Tick(false);
+		}
+		for(int p = 0; p < NumPlayers; p++)
+		{
+			aCharacters[p].Move();
+			aCharacters[p].Quantize();
+		}
+	}
+
+	if(pOut)
+		for(int p = 0; p < NumPlayers; p++)
+		{
+			mem_zero(&pOut[p], sizeof(pOut[p]));
+			aCharacters[p].Write(&pOut[p]);
+		}
+}
+
+static CPrediction s_Prediction;
+
+static void PredictIncremental(int NumPlayers, int SnapTick, int PredTick)
+{
+	const CNetObj_CharacterCore *apSnapCores[MAX_CLIENTS] = {0};
+	for(int p = 0; p < NumPlayers; p++)
+		apSnapCores[p] = &s_aaSnapCores[SnapTick][p];
+	CNetObj_PlayerInput aInputs[CPrediction::HISTORY_SIZE];
+	for(int Tick = SnapTick+1; Tick <= PredTick; Tick++)
+		aInputs[Tick-SnapTick-1] = s_aaInputs[Tick][LOCAL_ID];
+	s_Prediction.Predict(&s_Tuning, apSnapCores, SnapTick, PredTick, LOCAL_ID, aInputs);
+}
+
+// Mode 0 checks the incremental prediction against the full one, 1 times the full one and 2 the incremental one
+static bool RunClient(int NumPlayers, int Mode, int64 *pTime, int *pNumFrames, int64 *pNumTicks)
+{
+	s_Prediction.Init(&s_Collision);
+	*pTime = 0;
+	*pNumFrames = 0;
+	*pNumTicks = 0;
+	int64 StartTicks = s_Prediction.Stats()->m_NumTicks;
+
+	int LastSnapTick = -1, LastPredTick = -1;
+	for(int Frame = 0;; Frame++)
+	{
+		int ServerTick = Frame*50/FRAMES_PER_SECOND;
+		int SnapTick = (ServerTick-LATENCY_TICKS)/SNAP_INTERVAL*SNAP_INTERVAL;
+		int PredTick = ServerTick+LATENCY_TICKS+1;
+		if(ServerTick > NUM_TICKS)
+			break;
+		if(SnapTick < 0)
+			continue;
+		(*pNumFrames)++;
+
+		// the client only predicts when there's a new snapshot or predicted tick
+		if(SnapTick == LastSnapTick && PredTick == LastPredTick)
+			continue;
+		LastSnapTick = SnapTick;
+		LastPredTick = PredTick;
+
+		if(Mode == 0)
+		{
+			CNetObj_CharacterCore aExpected[NUM_PLAYERS];
+			PredictAll(NumPlayers, SnapTick, PredTick, aExpected);
+			PredictIncremental(NumPlayers, SnapTick, PredTick);
+			for(int p = 0; p < NumPlayers; p++)
+			{
+				CCharacterCore Character;
+				CNetObj_CharacterCore Core = {0};
+				if(s_Prediction.GetCharacter(PredTick, p, &Character))
+					Character.Write(&Core);
+				if(mem_comp(&Core, &aExpected[p], sizeof(Core)) != 0)
+				{
+					dbg_msg("prediction", "player %d differs at tick %d predicted from %d: %d %d, expected %d %d", p, PredTick, SnapTick,
+						Core.m_X, Core.m_Y, aExpected[p].m_X, aExpected[p].m_Y);
+					return false;
+				}
+			}
+		}
+		else if(Mode == 1)
+		{
+			int64 Start = time_get();
+			PredictAll(NumPlayers, SnapTick, PredTick, 0);
+			*pTime += time_get()-Start;
+			*pNumTicks += PredTick-SnapTick;
+		}
+		else
+		{
+			int64 Start = time_get();
+			PredictIncremental(NumPlayers, SnapTick, PredTick);
+			*pTime += time_get()-Start;
+		}
+	}
+
+	if(Mode == 2)
+		*pNumTicks = s_Prediction.Stats()->m_NumTicks-StartTicks;
+	return true;
+}
+
+static bool Run(const char *pName, int NumPlayers, bool Moving)
+{
+	GenerateInputs(NumPlayers, Moving);
+	RunServer(NumPlayers);
+
+	int64 aTimes[3], aTicks[3];
+	int NumFrames;
+	int64 Predictions = s_Prediction.Stats()->m_NumPredictions;
+	int64 Replays = s_Prediction.Stats()->m_NumReplays;
+	if(!RunClient(NumPlayers, 0, &aTimes[0], &NumFrames, &aTicks[0]))
+		return false;
+	Predictions = s_Prediction.Stats()->m_NumPredictions-Predictions;
+	Replays = s_Prediction.Stats()->m_NumReplays-Replays;
+	RunClient(NumPlayers, 1, &aTimes[1], &NumFrames, &aTicks[1]);
+	RunClient(NumPlayers, 2, &aTimes[2], &NumFrames, &aTicks[2]);
+
+	dbg_msg("prediction", "%-7s %d players, %d frames: all %5.2f ticks/frame %6.2f us/frame, incremental %5.2f ticks/frame %6.2f us/frame, %d%% replays",
+		pName, NumPlayers, NumFrames, aTicks[1]/(double)NumFrames, aTimes[1]*1000000.0/time_freq()/NumFrames,
+		aTicks[2]/(double)NumFrames, aTimes[2]*1000000.0/time_freq()/NumFrames, (int)(Replays*100/max(Predictions, (int64)1)));
+	return true;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("prediction", "usage: %s <map>", argv[0]); // ignore_convention
+		return -1;
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IEngineMap *pMap = CreateEngineMap();
+	char aMapFile[512];
+	str_format(aMapFile, sizeof(aMapFile), "maps/%s.map", argv[1]); // ignore_convention
+	if(!pStorage || !pMap->Load(aMapFile, pStorage))
+	{
+		dbg_msg("prediction", "couldn't load %s", aMapFile);
+		return -1;
+	}
+
+	CLayers Layers;
+	Layers.Init(0, pMap);
+	s_Collision.Init(&Layers);
+
+	// the others idle predict like they play, moving ones make snapshots differ
+	bool Result = Run("alone", 1, false) && Run("idle", NUM_PLAYERS, false) && Run("moving", NUM_PLAYERS, true);
+	if(!Result)
+		dbg_msg("prediction", "failed");
+
+	pMap->Unload();
+	return Result ? 0 : -1;
+}
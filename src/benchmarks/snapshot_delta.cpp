@@ -0,0 +1,360 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/network.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+#include <engine/shared/snapshot_kernels.h>
+
+#include <generated/protocol.h>
+#include <game/version.h>
+
+// compares the snapshot delta kernels against the scalar ones on the snapshots of a recorded demo,
+// and checks that deltas created on threads are the same bytes as the ones created one after another
+
+class CSnapshotCollector : public CDemoPlayer::IListner
+{
+public:
+	enum
+	{
+		MAX_SNAPSHOTS=4096,
+	};
+
+	CSnapshot *m_apSnapshots[MAX_SNAPSHOTS];
+	int m_NumSnapshots;
+
+	CSnapshotCollector() : m_NumSnapshots(0) {}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		if(m_NumSnapshots == MAX_SNAPSHOTS)
+			return;
+		CSnapshot *pSnap = (CSnapshot *)mem_alloc(Size, 1);
+		mem_copy(pSnap, pData, Size);
+		m_apSnapshots[m_NumSnapshots++] = pSnap;
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+// an item that exists in two following snapshots, what the delta coding works on
+struct CItemPair
+{
+	const int *m_pPast;
+	const int *m_pCurrent;
+	const int *m_pDiff;
+	int m_Size;
+};
+
+static CItemPair *s_pPairs = 0;
+static int s_NumPairs = 0;
+static int s_NumInts = 0;
+static int s_aOut[CSnapshot::MAX_SIZE/4];
+static int s_aExpected[CSnapshot::MAX_SIZE/4];
+static volatile int s_Sink = 0;
+
+enum
+{
+	KERNEL_DIFF=0,
+	KERNEL_UNDIFF,
+	KERNEL_SUM,
+	NUM_KERNELS
+};
+
+static void CollectPairs(CSnapshotCollector *pCollector)
+{
+	int MaxPairs = 0;
+	int MaxInts = 0;
+	for(int s = 1; s < pCollector->m_NumSnapshots; s++)
+	{
+		CSnapshot *pTo = pCollector->m_apSnapshots[s];
+		MaxPairs += pTo->NumItems();
+		for(int i = 0; i < pTo->NumItems(); i++)
+			MaxInts += pTo->GetItemSize(i)/4;
+	}
+
+	s_pPairs = (CItemPair *)mem_alloc(max(MaxPairs, 1)*sizeof(CItemPair), 1);
+	int *pDiffData = (int *)mem_alloc(max(MaxInts, 1)*sizeof(int), 1);
+	const CSnapshotKernels *pScalar = CSnapshotKernels::Get(0);
+
+	for(int s = 1; s < pCollector->m_NumSnapshots; s++)
+	{
+		CSnapshot *pFrom = pCollector->m_apSnapshots[s-1];
+		CSnapshot *pTo = pCollector->m_apSnapshots[s];
+
+		int aSlots[CSnapshotKeyIndex::MAX_SLOTS*2];
+		CSnapshotKeyIndex FromIndex;
+		FromIndex.Init(pFrom, aSlots);
+
+		for(int i = 0; i < pTo->NumItems(); i++)
+		{
+			int PastIndex = FromIndex.GetItemIndex(pTo->GetItem(i)->Key());
+			int Size = pTo->GetItemSize(i)/4;
+			if(PastIndex == -1 || pFrom->GetItemSize(PastIndex)/4 != Size)
+				continue;
+
+			CItemPair *pPair = &s_pPairs[s_NumPairs++];
+			pPair->m_pPast = pFrom->GetItem(PastIndex)->Data();
+			pPair->m_pCurrent = pTo->GetItem(i)->Data();
+			pPair->m_pDiff = pDiffData+s_NumInts;
+			pPair->m_Size = Size;
+			pScalar->m_pfnDiff(pPair->m_pPast, pPair->m_pCurrent, pDiffData+s_NumInts, Size);
+			s_NumInts += Size;
+		}
+	}
+}
+
+static bool Verify(const CSnapshotKernels *pKernels)
+{
+	const CSnapshotKernels *pScalar = CSnapshotKernels::Get(0);
+
+	// the packed size boundaries rarely show up in a demo
+	static const int s_aEdges[] = {0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8192, -8193, 0xfffff, 0x100000, -0x100000, -0x100001,
+		0x7ffffff, 0x8000000, -0x8000000, -0x8000001, 0x7fffffff, (int)0x80000000};
+	const int NumEdges = sizeof(s_aEdges)/sizeof(s_aEdges[0]);
+	int aPast[NumEdges];
+	for(int i = 0; i < NumEdges; i++)
+		aPast[i] = i*0x01010101;
+	for(int Size = 0; Size <= NumEdges; Size++)
+	{
+		int Expected = pScalar->m_pfnUndiff(aPast, s_aEdges+NumEdges-Size, s_aExpected, Size);
+		int Result = pKernels->m_pfnUndiff(aPast, s_aEdges+NumEdges-Size, s_aOut, Size);
+		if(Result != Expected || mem_comp(s_aOut, s_aExpected, Size*sizeof(int)) != 0)
+		{
+			dbg_msg("snapshot_delta", "%s: undiff mismatch for %d edge values", pKernels->m_pName, Size);
+			return false;
+		}
+	}
+
+	for(int p = 0; p < s_NumPairs; p++)
+	{
+		const CItemPair *pPair = &s_pPairs[p];
+		int Size = pPair->m_Size;
+
+		int Expected = pScalar->m_pfnDiff(pPair->m_pPast, pPair->m_pCurrent, s_aExpected, Size);
+		int Result = pKernels->m_pfnDiff(pPair->m_pPast, pPair->m_pCurrent, s_aOut, Size);
+		if(Result != Expected || mem_comp(s_aOut, s_aExpected, Size*sizeof(int)) != 0)
+		{
+			dbg_msg("snapshot_delta", "%s: diff mismatch at item pair %d", pKernels->m_pName, p);
+			return false;
+		}
+
+		Expected = pScalar->m_pfnUndiff(pPair->m_pPast, pPair->m_pDiff, s_aExpected, Size);
+		Result = pKernels->m_pfnUndiff(pPair->m_pPast, pPair->m_pDiff, s_aOut, Size);
+		if(Result != Expected || mem_comp(s_aOut, s_aExpected, Size*sizeof(int)) != 0)
+		{
+			dbg_msg("snapshot_delta", "%s: undiff mismatch at item pair %d", pKernels->m_pName, p);
+			return false;
+		}
+
+		if(pScalar->m_pfnSum(pPair->m_pCurrent, Size) != pKernels->m_pfnSum(pPair->m_pCurrent, Size))
+		{
+			dbg_msg("snapshot_delta", "%s: sum mismatch at item pair %d", pKernels->m_pName, p);
+			return false;
+		}
+	}
+	return true;
+}
+
+// what the server does for a client after snapping it: a delta against the
+// snapshot the client acked last, compressed with CVariableInt
+struct CDeltaJob
+{
+	CSnapshot *m_pFrom;
+	CSnapshot *m_pTo;
+	int m_CompSize;
+	char m_aCompData[CSnapshot::MAX_SIZE];
+};
+
+struct CDeltaJobs
+{
+	CSnapshotDelta *m_pDelta;
+	CDeltaJob *m_pJobs;
+};
+
+static void CreateDeltas(int Start, int End, void *pUser)
+{
+	CDeltaJobs *pJobs = (CDeltaJobs *)pUser;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	for(int j = Start; j < End; j++)
+	{
+		CDeltaJob *pJob = &pJobs->m_pJobs[j];
+		int DeltaSize = pJobs->m_pDelta->CreateDelta(pJob->m_pFrom, pJob->m_pTo, aDeltaData);
+		pJob->m_CompSize = DeltaSize ? CVariableInt::Compress(aDeltaData, DeltaSize, pJob->m_aCompData) : 0;
+	}
+}
+
+// creates the deltas of all snapshots in batches of one per client, like the server
+// does every tick, once on this thread and once spread over the pool. returns false
+// if the two differ in a single byte
+static bool MeasureThreadedDeltas(CSnapshotCollector *pCollector, CSnapshotDelta *pDelta, CJobPool *pPool, int Iterations)
+{
+	enum
+	{
+		ACK_DISTANCE=5, // snapshots the acked one is behind, 100ms at 50 snapshots per second
+	};
+
+	static CDeltaJob s_aSerialJobs[MAX_CLIENTS];
+	static CDeltaJob s_aThreadedJobs[MAX_CLIENTS];
+	static CSnapshot s_EmptySnap;
+	s_EmptySnap.Clear();
+
+	CDeltaJobs Serial = {pDelta, s_aSerialJobs};
+	CDeltaJobs Threaded = {pDelta, s_aThreadedJobs};
+	int64 SerialTime = 0;
+	int64 ThreadedTime = 0;
+	int NumBatches = 0;
+	for(int n = 0; n < Iterations; n++)
+	{
+		for(int First = 0; First < pCollector->m_NumSnapshots; First += MAX_CLIENTS)
+		{
+			int NumJobs = min((int)MAX_CLIENTS, pCollector->m_NumSnapshots-First);
+			for(int j = 0; j < NumJobs; j++)
+			{
+				int To = First+j;
+				s_aSerialJobs[j].m_pFrom = s_aThreadedJobs[j].m_pFrom = To >= ACK_DISTANCE ? pCollector->m_apSnapshots[To-ACK_DISTANCE] : &s_EmptySnap;
+				s_aSerialJobs[j].m_pTo = s_aThreadedJobs[j].m_pTo = pCollector->m_apSnapshots[To];
+			}
+
+			int64 Start = time_get();
+			CreateDeltas(0, NumJobs, &Serial);
+			SerialTime += time_get()-Start;
+
+			Start = time_get();
+			pPool->ParallelFor(NumJobs, 1, CreateDeltas, &Threaded, CJobPool::PRIORITY_HIGH);
+			ThreadedTime += time_get()-Start;
+			NumBatches++;
+
+			for(int j = 0; j < NumJobs; j++)
+			{
+				if(s_aThreadedJobs[j].m_CompSize != s_aSerialJobs[j].m_CompSize ||
+					mem_comp(s_aThreadedJobs[j].m_aCompData, s_aSerialJobs[j].m_aCompData, s_aSerialJobs[j].m_CompSize) != 0)
+				{
+					dbg_msg("snapshot_delta", "threaded delta of snapshot %d differs from the serial one", First+j);
+					return false;
+				}
+			}
+		}
+	}
+
+	double SerialUs = SerialTime*1000000.0/time_freq()/NumBatches;
+	double ThreadedUs = ThreadedTime*1000000.0/time_freq()/NumBatches;
+	dbg_msg("snapshot_delta", "%d deltas per tick: serial %8.2f us/tick, %d threads %8.2f us/tick, %5.2fx, all bytes equal",
+		MAX_CLIENTS, SerialUs, pPool->NumThreads()+1, ThreadedUs, SerialUs/ThreadedUs);
+	return true;
+}
+
+// returns the time of one pass over all item pairs in nanoseconds
+static double Measure(const CSnapshotKernels *pKernels, int Kernel, int Iterations)
+{
+	int Sink = 0;
+	int64 Start = time_get();
+	for(int n = 0; n < Iterations; n++)
+	{
+		for(int p = 0; p < s_NumPairs; p++)
+		{
+			const CItemPair *pPair = &s_pPairs[p];
+			if(Kernel == KERNEL_DIFF)
+				Sink |= pKernels->m_pfnDiff(pPair->m_pPast, pPair->m_pCurrent, s_aOut, pPair->m_Size);
+			else if(Kernel == KERNEL_UNDIFF)
+				Sink += pKernels->m_pfnUndiff(pPair->m_pPast, pPair->m_pDiff, s_aOut, pPair->m_Size);
+			else
+				Sink += pKernels->m_pfnSum(pPair->m_pCurrent, pPair->m_Size);
+		}
+	}
+	int64 Elapsed = time_get()-Start;
+	s_Sink += Sink;
+	return Elapsed*1000000000.0/time_freq()/Iterations;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc < 2) // ignore_convention
+	{
+		dbg_msg("snapshot_delta", "usage: %s <demo> [iterations] [threads]", argv[0]); // ignore_convention
+		return -1;
+	}
+	int Iterations = argc > 2 ? max(str_toint(argv[2]), 1) : 100; // ignore_convention
+	int NumThreads = argc > 3 ? max(str_toint(argv[3]), 1) : 4; // ignore_convention
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	if(!pStorage || !pConsole)
+		return -1;
+
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+
+	// the demo player saves the map of the demo
+	pStorage->CreateFolder("downloadedmaps", IStorage::TYPE_SAVE);
+
+	// the demo deltas leave out the size of the items the game knows
+	CNetObjHandler NetObjHandler;
+	CSnapshotDelta SnapshotDelta;
+	for(int i = 0; i < NUM_NETOBJTYPES; i++)
+		SnapshotDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+
+	CSnapshotCollector Collector;
+	CDemoPlayer DemoPlayer(&SnapshotDelta);
+	DemoPlayer.SetListner(&Collector);
+	if(DemoPlayer.Load(pStorage, pConsole, argv[1], IStorage::TYPE_ALL, GAME_NETVERSION)) // ignore_convention
+		return -1;
+
+	// play the demo as fast as possible, it pauses at the end
+	DemoPlayer.Play();
+	DemoPlayer.SetSpeed(1000000.0f);
+	while(DemoPlayer.IsPlaying() && !DemoPlayer.BaseInfo()->m_Paused)
+		DemoPlayer.Update();
+	DemoPlayer.Stop();
+
+	CollectPairs(&Collector);
+	dbg_msg("snapshot_delta", "%d snapshots, %d item pairs, %d ints, %d iterations, cpu features 0x%x",
+		Collector.m_NumSnapshots, s_NumPairs, s_NumInts, Iterations, cpu_features());
+	if(!s_NumPairs)
+		return -1;
+
+	static const char *s_apKernelNames[NUM_KERNELS] = {"diff", "undiff", "sum"};
+	double aScalarTime[NUM_KERNELS] = {0};
+	bool Failed = false;
+	for(int k = 0; k < CSnapshotKernels::Num(); k++)
+	{
+		const CSnapshotKernels *pKernels = CSnapshotKernels::Get(k);
+		if(!pKernels->Supported())
+		{
+			dbg_msg("snapshot_delta", "%s: not supported by this cpu", pKernels->m_pName);
+			continue;
+		}
+		if(!Verify(pKernels))
+		{
+			Failed = true;
+			continue;
+		}
+
+		for(int Kernel = 0; Kernel < NUM_KERNELS; Kernel++)
+		{
+			double Time = Measure(pKernels, Kernel, Iterations);
+			if(k == 0)
+				aScalarTime[Kernel] = Time;
+			dbg_msg("snapshot_delta", "%-6s %-6s %8.2f ns/item %6.2f ints/ns %5.2fx%s", pKernels->m_pName, s_apKernelNames[Kernel],
+				Time/s_NumPairs, s_NumInts/Time, aScalarTime[Kernel]/Time, pKernels == CSnapshotKernels::Best() ? " (used)" : "");
+		}
+	}
+
+	// the calling thread takes a share too
+	CJobPool Pool;
+	Pool.Init(NumThreads-1);
+	if(!MeasureThreadedDeltas(&Collector, &SnapshotDelta, &Pool, max(Iterations/10, 1)))
+		Failed = true;
+
+	return Failed ? -1 : 0;
+}
@@ -0,0 +1,406 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/sound.h>
+#include <engine/client/sound_kernels.h>
+#include <engine/client/soundmixer.h>
+
+#include <math.h>
+
+#include "benchmark.h"
+
+// mixes a few minutes of up to 64 voices that get started and stopped at
+// random without an audio device, through every kernel set and through
+// the mixer as it was before the command queue, and checks that all of
+// them give the same output
+
+enum
+{
+	NUM_TEST_SAMPLES=32,
+	MAX_FRAMES=1024, // snd_buffer_size*2
+	NUM_BUFFERS=6000,
+	MIXING_RATE=48000,
+};
+
+static CSample s_aSamples[NUM_TEST_SAMPLES];
+static CSample s_aReferenceSamples[NUM_TEST_SAMPLES]; // the reference keeps its own paused positions
+
+// the mixer as it was, minus the lock
+class CReferenceMixer
+{
+	struct CVoice
+	{
+		CSample *m_pSample;
+		int m_Channel;
+		int m_Tick;
+		int m_Flags;
+		int m_X, m_Y;
+	};
+
+	CVoice m_aVoices[CSoundMixer::NUM_VOICES];
+	int m_NextVoice;
+	int m_aMixBuffer[MAX_FRAMES*2];
+
+public:
+	int m_aChannelVolumes[CSoundMixer::NUM_CHANNELS];
+	int m_CenterX;
+	int m_CenterY;
+	float m_MaxDistance;
+	int m_Volume;
+	int m_NumOverflows;
+
+	CReferenceMixer()
+	{
+		mem_zero(m_aVoices, sizeof(m_aVoices));
+		m_NextVoice = 0;
+		for(int i = 0; i < CSoundMixer::NUM_CHANNELS; i++)
+			m_aChannelVolumes[i] = i == 0 ? 255 : 0;
+		m_CenterX = 0;
+		m_CenterY = 0;
+		m_MaxDistance = 1500.0f;
+		m_Volume = 100;
+		m_NumOverflows = 0;
+	}
+
+	int NumPlaying() const
+	{
+		int Num = 0;
+		for(int i = 0; i < CSoundMixer::NUM_VOICES; i++)
+			if(m_aVoices[i].m_pSample)
+				Num++;
+		return Num;
+	}
+
+	int Play(CSample *pSample, int Channel, int Flags, int x, int y)
+	{
+		for(int i = 0; i < CSoundMixer::NUM_VOICES; i++)
+		{
+			int id = (m_NextVoice + i) % CSoundMixer::NUM_VOICES;
+			if(!m_aVoices[id].m_pSample)
+			{
+				m_NextVoice = id+1;
+				m_aVoices[id].m_pSample = pSample;
+				m_aVoices[id].m_Channel = Channel;
+				m_aVoices[id].m_Tick = Flags&ISound::FLAG_LOOP ? pSample->m_PausedAt : 0;
+				m_aVoices[id].m_Flags = Flags;
+				m_aVoices[id].m_X = x;
+				m_aVoices[id].m_Y = y;
+				return id;
+			}
+		}
+		return -1;
+	}
+
+	void Stop(CSample *pSample)
+	{
+		for(int i = 0; i < CSoundMixer::NUM_VOICES; i++)
+		{
+			if(m_aVoices[i].m_pSample && (!pSample || m_aVoices[i].m_pSample == pSample))
+			{
+				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Flags&ISound::FLAG_LOOP ? m_aVoices[i].m_Tick : 0;
+				m_aVoices[i].m_pSample = 0;
+			}
+		}
+	}
+
+	bool IsPlaying(CSample *pSample) const
+	{
+		for(int i = 0; i < CSoundMixer::NUM_VOICES; i++)
+			if(m_aVoices[i].m_pSample == pSample)
+				return true;
+		return false;
+	}
+
+	void Mix(short *pFinalOut, unsigned Frames)
+	{
+		mem_zero(m_aMixBuffer, sizeof(m_aMixBuffer));
+
+		for(unsigned i = 0; i < CSoundMixer::NUM_VOICES; i++)
+		{
+			if(!m_aVoices[i].m_pSample)
+				continue;
+
+			CVoice *v = &m_aVoices[i];
+			int *pOut = m_aMixBuffer;
+
+			int Step = v->m_pSample->m_Channels;
+			short *pInL = &v->m_pSample->m_pData[v->m_Tick*Step];
+			short *pInR = &v->m_pSample->m_pData[v->m_Tick*Step+1];
+
+			unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
+
+			int Rvol = m_aChannelVolumes[v->m_Channel];
+			int Lvol = m_aChannelVolumes[v->m_Channel];
+
+			if(Frames < End)
+				End = Frames;
+
+			if(v->m_pSample->m_Channels == 1)
+				pInR = pInL;
+
+			if(v->m_Flags&ISound::FLAG_POS)
+			{
+				int dx = v->m_X - m_CenterX;
+				int dy = v->m_Y - m_CenterY;
+				float Dist = sqrtf((float)dx*dx+dy*dy);
+				if(Dist >= 0.0f && Dist < m_MaxDistance)
+				{
+					float a = 0.5f;
+					if(dx < 0)
+						a -= (Dist/m_MaxDistance)/2.0f;
+					else
+						a += (Dist/m_MaxDistance)/2.0f;
+
+					float Lgain = sinf((1-a)*pi/2.0f);
+					float Rgain = sinf(a*pi/2.0f);
+					float Falloff = 1.0f - Dist/m_MaxDistance;
+
+					Lvol = Lvol*Lgain*Falloff;
+					Rvol = Rvol*Rgain*Falloff;
+				}
+				else
+				{
+					Lvol = 0;
+					Rvol = 0;
+				}
+			}
+
+			for(unsigned s = 0; s < End; s++)
+			{
+				*pOut++ += (*pInL)*Lvol;
+				*pOut++ += (*pInR)*Rvol;
+				pInL += Step;
+				pInR += Step;
+				v->m_Tick++;
+			}
+
+			if(v->m_Tick == v->m_pSample->m_NumFrames)
+			{
+				if(v->m_Flags&ISound::FLAG_LOOP)
+					v->m_Tick = 0;
+				else
+					v->m_pSample = 0;
+			}
+		}
+
+		for(unsigned i = 0; i < Frames*2; i++)
+		{
+			// the old mixer multiplied with the volume as an int, which wraps around here
+			int64 Scaled = (int64)m_aMixBuffer[i]*m_Volume;
+			if(Scaled != (int)Scaled)
+				m_NumOverflows++;
+			int Value = (int)((Scaled/101)>>8);
+			pFinalOut[i] = clamp(Value, -0x7fff, 0x7fff);
+		}
+	}
+};
+
+static void CreateSamples()
+{
+	for(int i = 0; i < NUM_TEST_SAMPLES; i++)
+	{
+		// short effects mostly, a few long ones, all loud enough to clip when many play
+		CSample *pSample = &s_aSamples[i];
+		mem_zero(pSample, sizeof(*pSample));
+		pSample->m_Channels = i%3 == 0 ? 2 : 1;
+		pSample->m_Rate = MIXING_RATE;
+		pSample->m_NumFrames = i%8 == 0 ? MIXING_RATE*2 + Random()%MIXING_RATE : 200 + Random()%(MIXING_RATE/3);
+		pSample->m_pData = (short *)mem_alloc(pSample->m_NumFrames*pSample->m_Channels*sizeof(short), 1);
+		float Freq = 100.0f + Random()%2000;
+		for(int f = 0; f < pSample->m_NumFrames; f++)
+			for(int c = 0; c < pSample->m_Channels; c++)
+				pSample->m_pData[f*pSample->m_Channels+c] = (short)(sinf(f*Freq*(c+1)*2*pi/MIXING_RATE)*30000.0f) + (short)(Random()%2001) - 1000;
+	}
+}
+
+static void ResetSamples()
+{
+	for(int i = 0; i < NUM_TEST_SAMPLES; i++)
+	{
+		s_aSamples[i].m_PausedAt = 0;
+		s_aReferenceSamples[i] = s_aSamples[i];
+	}
+}
+
+// what the game does between two callbacks of the audio device, on all mixers at once
+static bool Step(CSoundMixer **ppMixers, int NumMixers, CReferenceMixer *pReference)
+{
+	int NumPlays = Random()%12;
+	for(int p = 0; p < NumPlays; p++)
+	{
+		int SampleID = Random()%NUM_TEST_SAMPLES;
+		int Channel = Random()%4;
+		int Flags = (Random()%16 == 0 ? ISound::FLAG_LOOP : 0) | (Random()%2 ? ISound::FLAG_POS : 0);
+		int x = (int)(Random()%4000)-2000;
+		int y = (int)(Random()%4000)-2000;
+		int Voice = -1;
+		for(int m = 0; m < NumMixers; m++)
+			Voice = ppMixers[m]->Play(&s_aSamples[SampleID], Channel, Flags, x, y);
+		if(pReference && pReference->Play(&s_aReferenceSamples[SampleID], Channel, Flags, x, y) != Voice)
+		{
+			dbg_msg("sound_mixer", "sample %d got voice %d, the old mixer gave it another one", SampleID, Voice);
+			return false;
+		}
+	}
+
+	if(Random()%8 == 0)
+	{
+		int SampleID = Random()%NUM_TEST_SAMPLES;
+		for(int m = 0; m < NumMixers; m++)
+			ppMixers[m]->Stop(&s_aSamples[SampleID]);
+		if(pReference)
+			pReference->Stop(&s_aReferenceSamples[SampleID]);
+	}
+	if(Random()%500 == 0)
+	{
+		for(int m = 0; m < NumMixers; m++)
+			ppMixers[m]->StopAll();
+		if(pReference)
+			pReference->Stop(0);
+	}
+
+	if(Random()%50 == 0)
+	{
+		int Channel = Random()%4;
+		int Volume = Random()%256;
+		for(int m = 0; m < NumMixers; m++)
+			ppMixers[m]->SetChannelVolume(Channel, Volume);
+		if(pReference)
+			pReference->m_aChannelVolumes[Channel] = Volume;
+	}
+	if(Random()%200 == 0)
+	{
+		int Volume = Random()%101;
+		for(int m = 0; m < NumMixers; m++)
+			ppMixers[m]->SetVolume(Volume);
+		if(pReference)
+			pReference->m_Volume = Volume;
+	}
+
+	int x = (int)(Random()%2000)-1000;
+	int y = (int)(Random()%2000)-1000;
+	for(int m = 0; m < NumMixers; m++)
+		ppMixers[m]->SetListenerPos(x, y);
+	if(pReference)
+	{
+		pReference->m_CenterX = x;
+		pReference->m_CenterY = y;
+
+		for(int i = 0; i < NUM_TEST_SAMPLES; i++)
+			for(int m = 0; m < NumMixers; m++)
+				if(ppMixers[m]->IsPlaying(&s_aSamples[i]) != pReference->IsPlaying(&s_aReferenceSamples[i]))
+				{
+					dbg_msg("sound_mixer", "%s says sample %d is %splaying", CSoundKernels::Get(m)->m_pName, i, pReference->IsPlaying(&s_aReferenceSamples[i]) ? "not " : "");
+					return false;
+				}
+	}
+	return true;
+}
+
+static unsigned BufferFrames()
+{
+	// the device asks for the same size mostly
+	return Random()%4 ? MAX_FRAMES/2 : 1 + Random()%MAX_FRAMES;
+}
+
+static bool Check()
+{
+	CSoundMixer *apMixers[8];
+	int NumMixers = CSoundKernels::Num();
+	for(int m = 0; m < NumMixers; m++)
+	{
+		apMixers[m] = new CSoundMixer;
+		apMixers[m]->Init(MAX_FRAMES, CSoundKernels::Get(m));
+	}
+	CReferenceMixer *pReference = new CReferenceMixer;
+
+	static short s_aReferenceOut[MAX_FRAMES*2];
+	static short s_aOut[MAX_FRAMES*2];
+	bool Result = true;
+	SeedRandom(1);
+	ResetSamples();
+	int64 NumVoices = 0;
+	for(int b = 0; b < NUM_BUFFERS && Result; b++)
+	{
+		Result = Step(apMixers, NumMixers, pReference);
+		NumVoices += pReference->NumPlaying();
+		unsigned Frames = BufferFrames();
+		pReference->Mix(s_aReferenceOut, Frames);
+		for(int m = 0; m < NumMixers && Result; m++)
+		{
+			if(!CSoundKernels::Get(m)->Supported())
+				continue;
+			apMixers[m]->Render(s_aOut, Frames);
+			if(mem_comp(s_aOut, s_aReferenceOut, Frames*2*sizeof(short)) != 0)
+			{
+				dbg_msg("sound_mixer", "%s mixed buffer %d differently", CSoundKernels::Get(m)->m_pName, b);
+				Result = false;
+			}
+		}
+	}
+
+	if(Result)
+		dbg_msg("sound_mixer", "%d buffers, %.1f voices on average, all kernel sets match the old mixer, %d of its samples had overflowed",
+			(int)NUM_BUFFERS, NumVoices/(double)NUM_BUFFERS, pReference->m_NumOverflows);
+
+	for(int m = 0; m < NumMixers; m++)
+		delete apMixers[m];
+	delete pReference;
+	return Result;
+}
+
+// all voices busy with long loops, as bad as it gets
+static void Measure(const char *pName, CSoundMixer *pMixer, CReferenceMixer *pReference)
+{
+	static short s_aOut[MAX_FRAMES/2*2];
+	ResetSamples();
+	for(int v = 0; v < CSoundMixer::NUM_VOICES; v++)
+	{
+		int SampleID = (v%(NUM_TEST_SAMPLES/8))*8;
+		if(pMixer)
+			pMixer->Play(&s_aSamples[SampleID], 0, ISound::FLAG_LOOP|(v%2 ? ISound::FLAG_POS : 0), v*20-640, 0);
+		else
+			pReference->Play(&s_aReferenceSamples[SampleID], 0, ISound::FLAG_LOOP|(v%2 ? ISound::FLAG_POS : 0), v*20-640, 0);
+	}
+
+	int64 Start = time_get();
+	for(int b = 0; b < NUM_BUFFERS; b++)
+	{
+		if(pMixer)
+			pMixer->Render(s_aOut, MAX_FRAMES/2);
+		else
+			pReference->Mix(s_aOut, MAX_FRAMES/2);
+	}
+	int64 Time = time_get()-Start;
+	double Us = Time*1000000.0/time_freq()/NUM_BUFFERS;
+	dbg_msg("sound_mixer", "%-8s %d voices: %7.2f us per %d frames, %.2f%% of the time they play",
+		pName, (int)CSoundMixer::NUM_VOICES, Us, MAX_FRAMES/2, Us/(MAX_FRAMES/2*1000000.0/MIXING_RATE)*100.0);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	if(argc > 1) // ignore_convention
+		SeedRandom(str_toint(argv[1])); // ignore_convention
+	CreateSamples();
+
+	if(!Check())
+		return -1;
+
+	CReferenceMixer *pReference = new CReferenceMixer;
+	Measure("old", 0, pReference);
+	delete pReference;
+	for(int m = 0; m < CSoundKernels::Num(); m++)
+	{
+		if(!CSoundKernels::Get(m)->Supported())
+			continue;
+		CSoundMixer *pMixer = new CSoundMixer;
+		pMixer->Init(MAX_FRAMES, CSoundKernels::Get(m));
+		Measure(CSoundKernels::Get(m)->m_pName, pMixer, 0);
+		delete pMixer;
+	}
+	return 0;
+}
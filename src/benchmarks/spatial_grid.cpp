@@ -0,0 +1,212 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/shared/protocol.h>
+#include <game/spatialgrid.h>
+
+#include "benchmark.h"
+
+// compares the character queries of projectiles in flight done over the
+// whole character list and over the spatial grid of the game world
+
+enum
+{
+	MAP_WIDTH=300,
+	MAP_HEIGHT=200,
+	NUM_CHARACTERS=MAX_CLIENTS,
+	MAX_PROJECTILES=2048,
+
+	PROJECTILE_RADIUS=6,
+	CHARACTER_RADIUS=28,
+	EXPLOSION_RADIUS=135,
+};
+
+class CBenchCharacter : public CSpatialGrid::CItem
+{
+public:
+	vec2 m_Pos;
+	vec2 m_Vel;
+	CBenchCharacter *m_pNext;
+};
+
+struct CBenchProjectile
+{
+	vec2 m_Pos;
+	vec2 m_Vel;
+};
+
+static float RandomFloat(float Max)
+{
+	return (Random()%10000)*Max/10000.0f;
+}
+
+static CSpatialGrid s_Grid;
+static CBenchCharacter s_aCharacters[NUM_CHARACTERS];
+static CBenchCharacter *s_pFirstCharacter;
+static CBenchProjectile s_aProjectiles[MAX_PROJECTILES];
+
+static vec2 RandomPos()
+{
+	return vec2(RandomFloat(MAP_WIDTH*32.0f), RandomFloat(MAP_HEIGHT*32.0f));
+}
+
+static void Setup(int NumProjectiles)
+{
+	SeedRandom(1);
+	s_Grid.Init(MAP_WIDTH, MAP_HEIGHT, 1);
+	s_pFirstCharacter = 0;
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		s_aCharacters[i] = CBenchCharacter();
+		s_aCharacters[i].m_Pos = RandomPos();
+		s_aCharacters[i].m_Vel = vec2(RandomFloat(20.0f)-10.0f, RandomFloat(20.0f)-10.0f);
+		s_aCharacters[i].m_pNext = s_pFirstCharacter;
+		s_pFirstCharacter = &s_aCharacters[i];
+		s_Grid.Insert(&s_aCharacters[i], 0, s_aCharacters[i].m_Pos);
+	}
+	for(int i = 0; i < NumProjectiles; i++)
+	{
+		s_aProjectiles[i].m_Pos = RandomPos();
+		s_aProjectiles[i].m_Vel = vec2(RandomFloat(60.0f)-30.0f, RandomFloat(60.0f)-30.0f);
+	}
+}
+
+static void Move(int NumProjectiles)
+{
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		CBenchCharacter *pChr = &s_aCharacters[i];
+		pChr->m_Pos += pChr->m_Vel;
+		if(pChr->m_Pos.x < 0 || pChr->m_Pos.x > MAP_WIDTH*32.0f)
+			pChr->m_Vel.x = -pChr->m_Vel.x;
+		if(pChr->m_Pos.y < 0 || pChr->m_Pos.y > MAP_HEIGHT*32.0f)
+			pChr->m_Vel.y = -pChr->m_Vel.y;
+		s_Grid.Move(pChr, 0, pChr->m_Pos);
+	}
+	for(int i = 0; i < NumProjectiles; i++)
+	{
+		CBenchProjectile *pProj = &s_aProjectiles[i];
+		pProj->m_Pos += pProj->m_Vel;
+		if(pProj->m_Pos.x < 0 || pProj->m_Pos.x > MAP_WIDTH*32.0f || pProj->m_Pos.y < 0 || pProj->m_Pos.y > MAP_HEIGHT*32.0f)
+			pProj->m_Pos = RandomPos();
+	}
+}
+
+static bool Hits(CBenchCharacter *pChr, vec2 Pos0, vec2 Pos1, float Radius, float *pClosestLen)
+{
+	vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, pChr->m_Pos);
+	if(distance(pChr->m_Pos, IntersectPos) >= CHARACTER_RADIUS+Radius)
+		return false;
+	float Len = distance(Pos0, IntersectPos);
+	if(Len >= *pClosestLen)
+		return false;
+	*pClosestLen = Len;
+	return true;
+}
+
+static CBenchCharacter *IntersectList(vec2 Pos0, vec2 Pos1, float Radius)
+{
+	float ClosestLen = distance(Pos0, Pos1)*100.0f;
+	CBenchCharacter *pClosest = 0;
+	for(CBenchCharacter *pChr = s_pFirstCharacter; pChr; pChr = pChr->m_pNext)
+		if(Hits(pChr, Pos0, Pos1, Radius, &ClosestLen))
+			pClosest = pChr;
+	return pClosest;
+}
+
+static CBenchCharacter *IntersectGrid(vec2 Pos0, vec2 Pos1, float Radius)
+{
+	float ClosestLen = distance(Pos0, Pos1)*100.0f;
+	CBenchCharacter *pClosest = 0;
+	float Range = Radius+CHARACTER_RADIUS;
+	int x0, y0, x1, y1;
+	if(!s_Grid.CellRange(vec2(min(Pos0.x, Pos1.x)-Range, min(Pos0.y, Pos1.y)-Range),
+		vec2(max(Pos0.x, Pos1.x)+Range, max(Pos0.y, Pos1.y)+Range), &x0, &y0, &x1, &y1))
+		return 0;
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			for(CSpatialGrid::CItem *pItem = s_Grid.First(0, x, y); pItem; pItem = pItem->CellNext())
+				if(Hits(static_cast<CBenchCharacter *>(pItem), Pos0, Pos1, Radius, &ClosestLen))
+					pClosest = static_cast<CBenchCharacter *>(pItem);
+	return pClosest;
+}
+
+static int FindList(vec2 Pos, float Radius)
+{
+	int Num = 0;
+	for(CBenchCharacter *pChr = s_pFirstCharacter; pChr; pChr = pChr->m_pNext)
+		if(distance(pChr->m_Pos, Pos) < Radius+CHARACTER_RADIUS)
+			Num++;
+	return Num;
+}
+
+static int FindGrid(vec2 Pos, float Radius)
+{
+	int Num = 0;
+	float Range = Radius+CHARACTER_RADIUS;
+	int x0, y0, x1, y1;
+	if(!s_Grid.CellRange(Pos-vec2(Range, Range), Pos+vec2(Range, Range), &x0, &y0, &x1, &y1))
+		return 0;
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			for(CSpatialGrid::CItem *pItem = s_Grid.First(0, x, y); pItem; pItem = pItem->CellNext())
+				if(distance(static_cast<CBenchCharacter *>(pItem)->m_Pos, Pos) < Radius+CHARACTER_RADIUS)
+					Num++;
+	return Num;
+}
+
+// every projectile tests its path of the tick and explodes where it is
+static void Run(int NumProjectiles, int Ticks, bool UseGrid, int64 *pTime, int *pChecksum)
+{
+	Setup(NumProjectiles);
+	int Checksum = 0;
+	int64 Time = 0;
+	for(int t = 0; t < Ticks; t++)
+	{
+		Move(NumProjectiles);
+		int64 Start = time_get();
+		for(int i = 0; i < NumProjectiles; i++)
+		{
+			CBenchProjectile *pProj = &s_aProjectiles[i];
+			vec2 PrevPos = pProj->m_Pos-pProj->m_Vel;
+			CBenchCharacter *pHit = UseGrid ? IntersectGrid(PrevPos, pProj->m_Pos, PROJECTILE_RADIUS) : IntersectList(PrevPos, pProj->m_Pos, PROJECTILE_RADIUS);
+			int Found = UseGrid ? FindGrid(pProj->m_Pos, EXPLOSION_RADIUS) : FindList(pProj->m_Pos, EXPLOSION_RADIUS);
+			Checksum = Checksum*31 + (pHit ? (int)(pHit-s_aCharacters)+1 : 0) + Found*65;
+		}
+		Time += time_get()-Start;
+	}
+	*pTime = Time;
+	*pChecksum = Checksum;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	int Ticks = argc > 1 ? max(str_toint(argv[1]), 1) : 500; // ignore_convention
+
+	static const int s_aProjectileCounts[] = {50, 200, 500, 1000, 2000};
+	for(unsigned p = 0; p < sizeof(s_aProjectileCounts)/sizeof(s_aProjectileCounts[0]); p++)
+	{
+		int NumProjectiles = s_aProjectileCounts[p];
+		int64 ListTime, GridTime;
+		int ListChecksum, GridChecksum;
+		Run(NumProjectiles, Ticks, false, &ListTime, &ListChecksum);
+		Run(NumProjectiles, Ticks, true, &GridTime, &GridChecksum);
+		if(ListChecksum != GridChecksum)
+		{
+			dbg_msg("spatial_grid", "%d projectiles: the grid found different characters", NumProjectiles);
+			return -1;
+		}
+
+		double ListUs = ListTime*1000000.0/time_freq()/Ticks;
+		double GridUs = GridTime*1000000.0/time_freq()/Ticks;
+		dbg_msg("spatial_grid", "%4d projectiles, %d characters: list %8.2f us/tick, grid %8.2f us/tick, %.2fx",
+			NumProjectiles, (int)NUM_CHARACTERS, ListUs, GridUs, ListUs/GridUs);
+	}
+
+	return 0;
+}
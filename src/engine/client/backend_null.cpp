@@ -0,0 +1,204 @@
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include "backend_null.h"
+
+static const char *CommandName(unsigned Cmd)
+{
+	switch(Cmd)
+	{
+	case CCommandBuffer::CMD_NOP: return "nop";
+	case CCommandBuffer::CMD_RUNBUFFER: return "runbuffer";
+	case CCommandBuffer::CMD_SIGNAL: return "signal";
+	case CCommandBuffer::CMD_TEXTURE_CREATE: return "texture_create";
+	case CCommandBuffer::CMD_TEXTURE_DESTROY: return "texture_destroy";
+	case CCommandBuffer::CMD_TEXTURE_UPDATE: return "texture_update";
+	case CCommandBuffer::CMD_QUADBUFFER_CREATE: return "quadbuffer_create";
+	case CCommandBuffer::CMD_QUADBUFFER_DESTROY: return "quadbuffer_destroy";
+	case CCommandBuffer::CMD_CLEAR: return "clear";
+	case CCommandBuffer::CMD_RENDER: return "render";
+	case CCommandBuffer::CMD_RENDER_QUADBUFFER: return "render_quadbuffer";
+	case CCommandBuffer::CMD_SWAP: return "swap";
+	case CCommandBuffer::CMD_VSYNC: return "vsync";
+	case CCommandBuffer::CMD_SCREENSHOT: return "screenshot";
+	case CCommandBuffer::CMD_VIDEOMODES: return "videomodes";
+	default: return "unknown";
+	}
+}
+
+CGraphicsBackend_Null::CGraphicsBackend_Null(IOHANDLE DumpFile)
+{
+	m_DumpFile = DumpFile;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	mem_zero(&m_FrameStart, sizeof(m_FrameStart));
+	mem_zero(&m_LastState, sizeof(m_LastState));
+	m_HasLastState = false;
+	mem_zero(m_apQuadBuffers, sizeof(m_apQuadBuffers));
+}
+
+int CGraphicsBackend_Null::Init(const char *pName, int *Screen, int *pWidth, int *pHeight, int FsaaSamples, int Flags, int *pDesktopWidth, int *pDesktopHeight)
+{
+	*Screen = 0;
+	*pDesktopWidth = 1920;
+	*pDesktopHeight = 1080;
+	if(*pWidth == 0 || *pHeight == 0)
+	{
+		*pWidth = *pDesktopWidth;
+		*pHeight = *pDesktopHeight;
+	}
+	dbg_msg("gfx", "rendering without a window at %dx%d", *pWidth, *pHeight);
+	return 0;
+}
+
+int CGraphicsBackend_Null::Shutdown()
+{
+	for(int i = 0; i < CCommandBuffer::MAX_QUADBUFFERS; i++)
+	{
+		mem_free(m_apQuadBuffers[i]);
+		m_apQuadBuffers[i] = 0;
+	}
+	if(m_DumpFile)
+	{
+		io_close(m_DumpFile);
+		m_DumpFile = 0;
+	}
+	return 0;
+}
+
+void CGraphicsBackend_Null::Dump(const char *pLine)
+{
+	io_write(m_DumpFile, pLine, str_length(pLine));
+	io_write_newline(m_DumpFile);
+}
+
+void CGraphicsBackend_Null::CountDraw(const CCommandBuffer::SState &State)
+{
+	m_Stats.m_NumDraws++;
+	if(!m_HasLastState || !CCommandBuffer::SameState(State, m_LastState))
+		m_Stats.m_NumStateChanges++;
+	if(!m_HasLastState || State.m_Texture != m_LastState.m_Texture || State.m_Dimension != m_LastState.m_Dimension)
+		m_Stats.m_NumTextureChanges++;
+	m_LastState = State;
+	m_HasLastState = true;
+}
+
+void CGraphicsBackend_Null::RunCommand(const CCommandBuffer::SCommand *pBaseCommand)
+{
+	m_Stats.m_NumCommands++;
+	char aBuf[256];
+	if(m_DumpFile)
+		str_copy(aBuf, CommandName(pBaseCommand->m_Cmd), sizeof(aBuf));
+
+	switch(pBaseCommand->m_Cmd)
+	{
+	case CCommandBuffer::CMD_SIGNAL:
+		static_cast<const CCommandBuffer::SCommand_Signal *>(pBaseCommand)->m_pSemaphore->signal();
+		break;
+	case CCommandBuffer::CMD_TEXTURE_CREATE:
+		{
+			const CCommandBuffer::SCommand_Texture_Create *pCommand = static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand);
+			m_Stats.m_NumTextureUploads++;
+			m_Stats.m_TextureUploadSize += pCommand->m_Width*pCommand->m_Height*pCommand->m_PixelSize;
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "texture_create slot=%d size=%dx%d pixelsize=%d flags=%d", pCommand->m_Slot,
+					pCommand->m_Width, pCommand->m_Height, pCommand->m_PixelSize, pCommand->m_Flags);
+			mem_free(pCommand->m_pData);
+		}
+		break;
+	case CCommandBuffer::CMD_TEXTURE_UPDATE:
+		{
+			const CCommandBuffer::SCommand_Texture_Update *pCommand = static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand);
+			m_Stats.m_NumTextureUploads++;
+			m_Stats.m_TextureUploadSize += pCommand->m_Width*pCommand->m_Height*(pCommand->m_Format == CCommandBuffer::TEXFORMAT_RGBA ? 4 :
+				pCommand->m_Format == CCommandBuffer::TEXFORMAT_RGB ? 3 : 1);
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "texture_update slot=%d rect=%d,%d,%d,%d", pCommand->m_Slot,
+					pCommand->m_X, pCommand->m_Y, pCommand->m_Width, pCommand->m_Height);
+			mem_free(pCommand->m_pData);
+		}
+		break;
+	case CCommandBuffer::CMD_TEXTURE_DESTROY:
+		if(m_DumpFile)
+			str_format(aBuf, sizeof(aBuf), "texture_destroy slot=%d", static_cast<const CCommandBuffer::SCommand_Texture_Destroy *>(pBaseCommand)->m_Slot);
+		break;
+	case CCommandBuffer::CMD_QUADBUFFER_CREATE:
+		{
+			const CCommandBuffer::SCommand_QuadBuffer_Create *pCommand = static_cast<const CCommandBuffer::SCommand_QuadBuffer_Create *>(pBaseCommand);
+			mem_free(m_apQuadBuffers[pCommand->m_Slot]);
+			m_apQuadBuffers[pCommand->m_Slot] = pCommand->m_pVertices;
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "quadbuffer_create slot=%d quads=%d", pCommand->m_Slot, pCommand->m_NumQuads);
+		}
+		break;
+	case CCommandBuffer::CMD_QUADBUFFER_DESTROY:
+		{
+			const CCommandBuffer::SCommand_QuadBuffer_Destroy *pCommand = static_cast<const CCommandBuffer::SCommand_QuadBuffer_Destroy *>(pBaseCommand);
+			mem_free(m_apQuadBuffers[pCommand->m_Slot]);
+			m_apQuadBuffers[pCommand->m_Slot] = 0;
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "quadbuffer_destroy slot=%d", pCommand->m_Slot);
+		}
+		break;
+	case CCommandBuffer::CMD_RENDER:
+		{
+			const CCommandBuffer::SCommand_Render *pCommand = static_cast<const CCommandBuffer::SCommand_Render *>(pBaseCommand);
+			CountDraw(pCommand->m_State);
+			int NumVertices = pCommand->m_PrimCount*(pCommand->m_PrimType == CCommandBuffer::PRIMTYPE_QUADS ? 4 : 2);
+			m_Stats.m_NumVertices += NumVertices;
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "render %s=%d texture=%d dimension=%d blend=%d clip=%d", pCommand->m_PrimType == CCommandBuffer::PRIMTYPE_QUADS ? "quads" : "lines",
+					pCommand->m_PrimCount, pCommand->m_State.m_Texture, pCommand->m_State.m_Dimension, pCommand->m_State.m_BlendMode, pCommand->m_State.m_ClipEnable);
+		}
+		break;
+	case CCommandBuffer::CMD_RENDER_QUADBUFFER:
+		{
+			const CCommandBuffer::SCommand_RenderQuadBuffer *pCommand = static_cast<const CCommandBuffer::SCommand_RenderQuadBuffer *>(pBaseCommand);
+			CountDraw(pCommand->m_State);
+			m_Stats.m_NumBufferedVertices += pCommand->m_NumQuads*4;
+			if(m_DumpFile)
+				str_format(aBuf, sizeof(aBuf), "render_quadbuffer slot=%d quads=%d+%d texture=%d dimension=%d blend=%d clip=%d", pCommand->m_Slot,
+					pCommand->m_FirstQuad, pCommand->m_NumQuads, pCommand->m_State.m_Texture, pCommand->m_State.m_Dimension, pCommand->m_State.m_BlendMode, pCommand->m_State.m_ClipEnable);
+		}
+		break;
+	case CCommandBuffer::CMD_SWAP:
+		m_Stats.m_NumFrames++;
+		if(m_DumpFile)
+			str_format(aBuf, sizeof(aBuf), "swap frame=%d commands=%d draws=%d vertices=%d buffered=%d statechanges=%d texturechanges=%d uploads=%d",
+				(int)m_Stats.m_NumFrames, (int)(m_Stats.m_NumCommands-m_FrameStart.m_NumCommands), (int)(m_Stats.m_NumDraws-m_FrameStart.m_NumDraws),
+				(int)(m_Stats.m_NumVertices-m_FrameStart.m_NumVertices), (int)(m_Stats.m_NumBufferedVertices-m_FrameStart.m_NumBufferedVertices),
+				(int)(m_Stats.m_NumStateChanges-m_FrameStart.m_NumStateChanges), (int)(m_Stats.m_NumTextureChanges-m_FrameStart.m_NumTextureChanges),
+				(int)(m_Stats.m_NumTextureUploads-m_FrameStart.m_NumTextureUploads));
+		m_FrameStart = m_Stats;
+		m_HasLastState = false;
+		break;
+	case CCommandBuffer::CMD_VSYNC:
+		*static_cast<const CCommandBuffer::SCommand_VSync *>(pBaseCommand)->m_pRetOk = true;
+		break;
+	case CCommandBuffer::CMD_VIDEOMODES:
+		*static_cast<const CCommandBuffer::SCommand_VideoModes *>(pBaseCommand)->m_pNumModes = 0;
+		break;
+	}
+
+	if(m_DumpFile)
+		Dump(aBuf);
+}
+
+void CGraphicsBackend_Null::RunBuffer(CCommandBuffer *pBuffer)
+{
+	unsigned CmdIndex = 0;
+	while(1)
+	{
+		const CCommandBuffer::SCommand *pBaseCommand = pBuffer->GetCommand(&CmdIndex);
+		if(pBaseCommand == 0x0)
+			break;
+		RunCommand(pBaseCommand);
+	}
+}
+
+bool CGraphicsBackend_Null::GetStats(CGraphicsStats *pStats) const
+{
+	*pStats = m_Stats;
+	return true;
+}
+
+IGraphicsBackend *CreateNullGraphicsBackend(IOHANDLE DumpFile) { return new CGraphicsBackend_Null(DumpFile); }
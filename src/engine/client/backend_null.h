@@ -0,0 +1,48 @@
+#pragma once
+
+#include "graphics_threaded.h"
+
+// graphics backend without a window or a gpu, runs the command buffers right
+// away and only counts what they would have done, for benchmarks on machines
+// without a display. every command can be written to a file as well
+class CGraphicsBackend_Null : public IGraphicsBackend
+{
+	IOHANDLE m_DumpFile;
+	CGraphicsStats m_Stats;
+	CGraphicsStats m_FrameStart;
+
+	CCommandBuffer::SState m_LastState;
+	bool m_HasLastState;
+
+	// the backend owns the vertices of quad buffers
+	CCommandBuffer::SBufferVertex *m_apQuadBuffers[CCommandBuffer::MAX_QUADBUFFERS];
+
+	void CountDraw(const CCommandBuffer::SState &State);
+	void Dump(const char *pLine);
+	void RunCommand(const CCommandBuffer::SCommand *pBaseCommand);
+
+public:
+	CGraphicsBackend_Null(IOHANDLE DumpFile);
+
+	virtual int Init(const char *pName, int *Screen, int *pWidth, int *pHeight, int FsaaSamples, int Flags, int *pDesktopWidth, int *pDesktopHeight);
+	virtual int Shutdown();
+
+	virtual int MemoryUsage() const { return 0; }
+
+	virtual int GetNumScreens() const { return 1; }
+
+	virtual void Minimize() {}
+	virtual void Maximize() {}
+	virtual bool Fullscreen(bool State) { return false; }
+	virtual void SetWindowBordered(bool State) {}
+	virtual bool SetWindowScreen(int Index) { return false; }
+	virtual int GetWindowScreen() { return 0; }
+	virtual int WindowActive() { return 1; }
+	virtual int WindowOpen() { return 1; }
+
+	virtual void RunBuffer(CCommandBuffer *pBuffer);
+	virtual bool IsIdle() const { return true; }
+	virtual void WaitForIdle() {}
+
+	virtual bool GetStats(CGraphicsStats *pStats) const;
+};
@@ -447,6 +447,36 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::SCommand
 	};
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_QuadBuffer_Create(const CCommandBuffer::SCommand_QuadBuffer_Create *pCommand)
+{
+	mem_free(m_apQuadBuffers[pCommand->m_Slot]);
+	m_apQuadBuffers[pCommand->m_Slot] = pCommand->m_pVertices;
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_QuadBuffer_Destroy(const CCommandBuffer::SCommand_QuadBuffer_Destroy *pCommand)
+{
+	mem_free(m_apQuadBuffers[pCommand->m_Slot]);
+	m_apQuadBuffers[pCommand->m_Slot] = 0;
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_RenderQuadBuffer(const CCommandBuffer::SCommand_RenderQuadBuffer *pCommand)
+{
+	const CCommandBuffer::SBufferVertex *pVertices = m_apQuadBuffers[pCommand->m_Slot];
+	if(!pVertices)
+		return;
+
+	SetState(pCommand->m_State);
+
+	glVertexPointer(3, GL_FLOAT, sizeof(CCommandBuffer::SBufferVertex), (const char*)pVertices);
+	glTexCoordPointer(3, GL_FLOAT, sizeof(CCommandBuffer::SBufferVertex), (const char*)pVertices + sizeof(float)*3);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, pCommand->m_Color.a);
+
+	glDrawArrays(GL_QUADS, pCommand->m_FirstQuad*4, pCommand->m_NumQuads*4);
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand)
 {
 	// fetch image data
@@ -488,6 +518,7 @@ CCommandProcessorFragment_OpenGL::CCommandProcessorFragment_OpenGL()
 {
 	mem_zero(m_aTextures, sizeof(m_aTextures));
 	m_pTextureMemoryUsage = 0;
+	mem_zero(m_apQuadBuffers, sizeof(m_apQuadBuffers));
 }
 
 bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand * pBaseCommand)
@@ -498,8 +529,11 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand
 	case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::SCommand_Texture_Destroy *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_QUADBUFFER_CREATE: Cmd_QuadBuffer_Create(static_cast<const CCommandBuffer::SCommand_QuadBuffer_Create *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_QUADBUFFER_DESTROY: Cmd_QuadBuffer_Destroy(static_cast<const CCommandBuffer::SCommand_QuadBuffer_Destroy *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_CLEAR: Cmd_Clear(static_cast<const CCommandBuffer::SCommand_Clear *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::SCommand_Render *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_RENDER_QUADBUFFER: Cmd_RenderQuadBuffer(static_cast<const CCommandBuffer::SCommand_RenderQuadBuffer *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::SCommand_Screenshot *>(pBaseCommand)); break;
 	default: return false;
 	}
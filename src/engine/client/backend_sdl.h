@@ -101,6 +101,9 @@ class CCommandProcessorFragment_OpenGL
 	CTexture m_aTextures[CCommandBuffer::MAX_TEXTURES];
 	volatile int *m_pTextureMemoryUsage;
 
+	// quad buffers are drawn straight from client memory
+	CCommandBuffer::SBufferVertex *m_apQuadBuffers[CCommandBuffer::MAX_QUADBUFFERS];
+
 public:
 	enum
 	{
@@ -124,8 +127,11 @@ private:
 	void Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand);
 	void Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand);
 	void Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand);
+	void Cmd_QuadBuffer_Create(const CCommandBuffer::SCommand_QuadBuffer_Create *pCommand);
+	void Cmd_QuadBuffer_Destroy(const CCommandBuffer::SCommand_QuadBuffer_Destroy *pCommand);
 	void Cmd_Clear(const CCommandBuffer::SCommand_Clear *pCommand);
 	void Cmd_Render(const CCommandBuffer::SCommand_Render *pCommand);
+	void Cmd_RenderQuadBuffer(const CCommandBuffer::SCommand_RenderQuadBuffer *pCommand);
 	void Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand);
 
 public:
@@ -205,4 +211,6 @@ public:
 	virtual int GetWindowScreen();
 	virtual int WindowActive();
 	virtual int WindowOpen();
+
+	virtual bool GetStats(CGraphicsStats *pStats) const { return false; }
 };
@@ -256,6 +256,11 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_RenderFrames = 0;
 	m_LastRenderTime = time_get();
 
+	m_BenchFrames = 0;
+	m_BenchNumFrames = 0;
+	m_pBenchFrameTimes = 0;
+	m_BenchStats = false;
+
 	m_GameTickSpeed = SERVER_TICK_SPEED;
 
 	m_WindowMustRefocus = 0;
@@ -611,12 +616,22 @@ void CClient::SnapInvalidateItem(int SnapID, int Index)
 
 const void *CClient::SnapFindItem(int SnapID, int Type, int ID) const
 {
-	// TODO: linear search. should be fixed.
 	int i;
 
 	if(!m_aSnapshots[SnapID])
 		return 0x0;
 
+	if(m_aSnapshots[SnapID]->m_KeyIndex.Valid())
+	{
+		// the alternative snapshot has the same items, unless they got invalidated
+		int Index = m_aSnapshots[SnapID]->m_KeyIndex.GetItemIndex((Type<<16)|ID);
+		if(Index == -1)
+			return 0x0;
+		CSnapshotItem *pItem = m_aSnapshots[SnapID]->m_pAltSnap->GetItem(Index);
+		return pItem->Type() == Type && pItem->ID() == ID ? (void *)pItem->Data() : 0x0;
+	}
+
+	// demo snapshots aren't indexed
 	for(i = 0; i < m_aSnapshots[SnapID]->m_pSnap->NumItems(); i++)
 	{
 		CSnapshotItem *pItem = m_aSnapshots[SnapID]->m_pAltSnap->GetItem(i);
@@ -1253,6 +1268,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 				{
 					static CSnapshot Emptysnap;
 					CSnapshot *pDeltaShot = &Emptysnap;
+					const CSnapshotKeyIndex *pDeltaShotIndex = 0;
 					int PurgeTick;
 					void *pDeltaData;
 					int DeltaSize;
@@ -1272,7 +1288,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					// find delta
 					if(DeltaTick >= 0)
 					{
-						int DeltashotSize = m_SnapshotStorage.Get(DeltaTick, 0, &pDeltaShot, 0);
+						int DeltashotSize = m_SnapshotStorage.Get(DeltaTick, 0, &pDeltaShot, 0, &pDeltaShotIndex);
 
 						if(DeltashotSize < 0)
 						{
@@ -1308,7 +1324,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					}
 
 					// unpack delta
-					SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize);
+					SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize, pDeltaShotIndex);
 					if(SnapSize < 0)
 					{
 						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", "delta unpack failed!");
@@ -1920,6 +1936,7 @@ void CClient::Run()
 				// when we are stress testing only render every 10th frame
 				if(!g_Config.m_DbgStress || (m_RenderFrames%10) == 0 )
 				{
+					int64 RenderStart = time_get();
 					if(!m_EditorActive)
 						Render();
 					else
@@ -1927,7 +1944,11 @@ void CClient::Run()
 						m_pEditor->UpdateAndRender();
 						DebugRender();
 					}
+					int64 RenderTime = time_get()-RenderStart;
 					m_pGraphics->Swap();
+
+					if(m_BenchFrames)
+						BenchDemoFrame(RenderTime);
 				}
 			}
 		}
@@ -2129,6 +2150,97 @@ void CClient::Con_Play(IConsole::IResult *pResult, void *pUserData)
 	pSelf->DemoPlayer_Play(pResult->GetString(0), IStorage::TYPE_ALL);
 }
 
+static int CompareFrameTimes(const void *pA, const void *pB)
+{
+	int64 A = *(const int64 *)pA;
+	int64 B = *(const int64 *)pB;
+	return A < B ? -1 : A > B;
+}
+
+void CClient::BenchDemoFrame(int64 RenderTime)
+{
+	if(State() != IClient::STATE_DEMOPLAYBACK)
+	{
+		BenchDemoFinish();
+		return;
+	}
+
+	// the first frame after loading the demo isn't counted
+	if(m_BenchNumFrames < 0)
+	{
+		m_BenchStats = m_pGraphics->GetStats(&m_BenchStartStats);
+		m_BenchNumFrames = 0;
+		return;
+	}
+
+	m_pBenchFrameTimes[m_BenchNumFrames++] = RenderTime;
+	if(m_BenchNumFrames == m_BenchFrames)
+		BenchDemoFinish();
+}
+
+void CClient::BenchDemoFinish()
+{
+	char aBuf[256];
+	int Num = m_BenchNumFrames;
+	if(Num > 0)
+	{
+		qsort(m_pBenchFrameTimes, Num, sizeof(*m_pBenchFrameTimes), CompareFrameTimes);
+		int64 Total = 0;
+		for(int i = 0; i < Num; i++)
+			Total += m_pBenchFrameTimes[i];
+		double Ms = 1000.0/time_freq();
+		str_format(aBuf, sizeof(aBuf), "%d frames, render time avg %.3f ms, median %.3f ms, 99%% %.3f ms, max %.3f ms",
+			Num, Total*Ms/Num, m_pBenchFrameTimes[Num/2]*Ms, m_pBenchFrameTimes[Num*99/100]*Ms, m_pBenchFrameTimes[Num-1]*Ms);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "bench_demo", aBuf);
+
+		CGraphicsStats Stats;
+		if(m_BenchStats && m_pGraphics->GetStats(&Stats))
+		{
+			const CGraphicsStats *pStart = &m_BenchStartStats;
+			str_format(aBuf, sizeof(aBuf), "per frame: %.1f commands, %.1f draws, %.0f vertices, %.0f buffered vertices, %.1f state changes, %.1f texture changes, %.2f texture uploads",
+				(Stats.m_NumCommands-pStart->m_NumCommands)/(double)Num, (Stats.m_NumDraws-pStart->m_NumDraws)/(double)Num,
+				(Stats.m_NumVertices-pStart->m_NumVertices)/(double)Num, (Stats.m_NumBufferedVertices-pStart->m_NumBufferedVertices)/(double)Num,
+				(Stats.m_NumStateChanges-pStart->m_NumStateChanges)/(double)Num, (Stats.m_NumTextureChanges-pStart->m_NumTextureChanges)/(double)Num,
+				(Stats.m_NumTextureUploads-pStart->m_NumTextureUploads)/(double)Num);
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "bench_demo", aBuf);
+		}
+	}
+	else
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "bench_demo", "the demo ended before a frame was rendered");
+
+	mem_free(m_pBenchFrameTimes);
+	m_pBenchFrameTimes = 0;
+	m_BenchFrames = 0;
+	m_BenchNumFrames = 0;
+	m_DemoPlayer.SetTimeStep(0);
+	if(State() == IClient::STATE_DEMOPLAYBACK)
+		Disconnect();
+
+	// without a window there is nothing left to look at
+	if(g_Config.m_GfxNull)
+		Quit();
+}
+
+void CClient::Con_BenchDemo(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	const char *pError = pSelf->DemoPlayer_Play(pResult->GetString(0), IStorage::TYPE_ALL);
+	if(pError)
+	{
+		pSelf->m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "bench_demo", pError);
+		if(g_Config.m_GfxNull)
+			pSelf->Quit();
+		return;
+	}
+
+	// the demo advances 10 ms every frame no matter how long the frames take
+	pSelf->m_DemoPlayer.SetTimeStep(time_freq()/100);
+	mem_free(pSelf->m_pBenchFrameTimes);
+	pSelf->m_BenchFrames = pResult->NumArguments() > 1 ? max(pResult->GetInteger(1), 1) : 1000;
+	pSelf->m_BenchNumFrames = -1;
+	pSelf->m_pBenchFrameTimes = (int64 *)mem_alloc(pSelf->m_BenchFrames*sizeof(int64), 1);
+}
+
 void CClient::DemoRecorder_Start(const char *pFilename, bool WithTimestamp)
 {
 	if(State() != IClient::STATE_ONLINE)
@@ -2303,6 +2415,7 @@ void CClient::RegisterCommands()
 	m_pConsole->Register("rcon", "r", CFGFLAG_CLIENT, Con_Rcon, this, "Send specified command to rcon");
 	m_pConsole->Register("rcon_auth", "s", CFGFLAG_CLIENT, Con_RconAuth, this, "Authenticate to rcon");
 	m_pConsole->Register("play", "r", CFGFLAG_CLIENT|CFGFLAG_STORE, Con_Play, this, "Play the file specified");
+	m_pConsole->Register("bench_demo", "s?i", CFGFLAG_CLIENT, Con_BenchDemo, this, "Render frames of a demo as fast as possible and print how long they took");
 	m_pConsole->Register("record", "?s", CFGFLAG_CLIENT, Con_Record, this, "Record to the file");
 	m_pConsole->Register("stoprecord", "", CFGFLAG_CLIENT, Con_StopRecord, this, "Stop recording");
 	m_pConsole->Register("add_demomarker", "", CFGFLAG_CLIENT, Con_AddDemoMarker, this, "Add demo timeline marker");
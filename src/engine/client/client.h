@@ -90,6 +90,13 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	float m_RenderFrameTimeHigh;
 	int m_RenderFrames;
 
+	// bench_demo, m_BenchNumFrames is -1 for the frame that isn't counted
+	int m_BenchFrames;
+	int m_BenchNumFrames;
+	int64 *m_pBenchFrameTimes;
+	bool m_BenchStats;
+	CGraphicsStats m_BenchStartStats;
+
 	NETADDR m_ServerAddress;
 	int m_WindowMustRefocus;
 	int m_SnapCrcErrors;
@@ -244,6 +251,8 @@ public:
 	void SnapSetStaticsize(int ItemType, int Size);
 
 	void Render();
+	void BenchDemoFrame(int64 RenderTime);
+	void BenchDemoFinish();
 	void DebugRender();
 
 	virtual void Quit();
@@ -287,6 +296,7 @@ public:
 	static void Con_AddFavorite(IConsole::IResult *pResult, void *pUserData);
 	static void Con_RemoveFavorite(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Play(IConsole::IResult *pResult, void *pUserData);
+	static void Con_BenchDemo(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Record(IConsole::IResult *pResult, void *pUserData);
 	static void Con_StopRecord(IConsole::IResult *pResult, void *pUserData);
 	static void Con_AddDemoMarker(IConsole::IResult *pResult, void *pUserData);
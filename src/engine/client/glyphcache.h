@@ -0,0 +1,160 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_CLIENT_GLYPHCACHE_H
+#define ENGINE_CLIENT_GLYPHCACHE_H
+
+#include <base/system.h>
+
+/*
+	Class: Glyph Cache
+		Keeps track of which character sits in which slot of a font
+		texture. Characters are found through a hash table and the
+		slots are kept in a list from the most to the least recently
+		touched one, so the slot to reuse is always at its end.
+		There is one cache per font and size.
+*/
+class CGlyphCache
+{
+public:
+	enum
+	{
+		MAX_SLOTS=64*64,
+	};
+
+private:
+	enum
+	{
+		HASH_SIZE=MAX_SLOTS*2,
+	};
+
+	struct CSlot
+	{
+		int m_Chr;
+		int m_HashNext;
+		int m_Prev; // more recently touched
+		int m_Next; // less recently touched
+	};
+
+	CSlot m_aSlots[MAX_SLOTS];
+	int m_aHash[HASH_SIZE];
+	int m_NumSlots;
+	int m_NumUsed;
+	int m_First;
+	int m_Last;
+
+	static unsigned Hash(int Chr) { return (((unsigned)Chr*2654435761u)>>16)&(HASH_SIZE-1); }
+
+	void Unlink(int Slot)
+	{
+		CSlot *pSlot = &m_aSlots[Slot];
+		if(pSlot->m_Prev >= 0)
+			m_aSlots[pSlot->m_Prev].m_Next = pSlot->m_Next;
+		else
+			m_First = pSlot->m_Next;
+		if(pSlot->m_Next >= 0)
+			m_aSlots[pSlot->m_Next].m_Prev = pSlot->m_Prev;
+		else
+			m_Last = pSlot->m_Prev;
+	}
+
+	void LinkFirst(int Slot)
+	{
+		CSlot *pSlot = &m_aSlots[Slot];
+		pSlot->m_Prev = -1;
+		pSlot->m_Next = m_First;
+		if(m_First >= 0)
+			m_aSlots[m_First].m_Prev = Slot;
+		else
+			m_Last = Slot;
+		m_First = Slot;
+	}
+
+	void RemoveHash(int Slot)
+	{
+		int *pIndex = &m_aHash[Hash(m_aSlots[Slot].m_Chr)];
+		while(*pIndex != Slot)
+			pIndex = &m_aSlots[*pIndex].m_HashNext;
+		*pIndex = m_aSlots[Slot].m_HashNext;
+	}
+
+public:
+	CGlyphCache() { Reset(0); }
+
+	/*
+		Function: Reset
+			Forgets all characters, for example when the texture
+			has been recreated with a different number of slots.
+	*/
+	void Reset(int NumSlots)
+	{
+		dbg_assert(NumSlots <= MAX_SLOTS, "too many glyph slots");
+		m_NumSlots = NumSlots;
+		m_NumUsed = 0;
+		m_First = -1;
+		m_Last = -1;
+		for(int i = 0; i < HASH_SIZE; i++)
+			m_aHash[i] = -1;
+	}
+
+	int NumSlots() const { return m_NumSlots; }
+	bool Full() const { return m_NumUsed == m_NumSlots; }
+
+	/*
+		Function: LeastRecent
+			Returns the slot that <Add> reuses next when the cache is
+			full, -1 if nothing has been added yet.
+	*/
+	int LeastRecent() const { return m_Last; }
+
+	/*
+		Function: Find
+			Returns the slot of a character and marks it as the most
+			recently used one, -1 if it is not in the cache.
+	*/
+	int Find(int Chr)
+	{
+		for(int Slot = m_aHash[Hash(Chr)]; Slot >= 0; Slot = m_aSlots[Slot].m_HashNext)
+		{
+			if(m_aSlots[Slot].m_Chr == Chr)
+			{
+				if(Slot != m_First)
+				{
+					Unlink(Slot);
+					LinkFirst(Slot);
+				}
+				return Slot;
+			}
+		}
+		return -1;
+	}
+
+	/*
+		Function: Add
+			Puts a character that isn't cached yet into a free slot,
+			or into the least recently used one if there are none
+			left, and returns the slot. -1 if there are no slots.
+	*/
+	int Add(int Chr)
+	{
+		int Slot;
+		if(m_NumUsed < m_NumSlots)
+			Slot = m_NumUsed++;
+		else if(m_Last >= 0)
+		{
+			Slot = m_Last;
+			Unlink(Slot);
+			RemoveHash(Slot);
+		}
+		else
+			return -1;
+
+		unsigned Key = Hash(Chr);
+		m_aSlots[Slot].m_Chr = Chr;
+		m_aSlots[Slot].m_HashNext = m_aHash[Key];
+		m_aHash[Key] = Slot;
+		LinkFirst(Slot);
+		return Slot;
+	}
+};
+
+#endif
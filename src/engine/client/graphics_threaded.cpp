@@ -33,29 +33,31 @@ static CVideoMode g_aFakeModes[] = {
 	{1920,1440,8,8,8}, {1920,2400,8,8,8}, {2048,1536,8,8,8}
 };
 
-void CGraphics_Threaded::FlushVertices()
+CCommandBuffer::SVertex *CGraphics_Threaded::AllocRenderCommand(const CCommandBuffer::SState &State, unsigned PrimType, int NumVerts)
 {
-	if(m_NumVertices == 0)
-		return;
-
-	int NumVerts = m_NumVertices;
-	m_NumVertices = 0;
-
-	CCommandBuffer::SCommand_Render Cmd;
-	Cmd.m_State = m_State;
+	int VerticesPerPrim = PrimType == CCommandBuffer::PRIMTYPE_QUADS ? 4 : 2;
 
-	if(m_Drawing == DRAWING_QUADS)
+	// the last draw has the same state and its vertices end where these start, let it draw these as well
+	CCommandBuffer::SCommand *pLast = m_pCommandBuffer->LastCommand();
+	if(g_Config.m_GfxBatchDraws && pLast && pLast->m_Cmd == CCommandBuffer::CMD_RENDER)
 	{
-		Cmd.m_PrimType = CCommandBuffer::PRIMTYPE_QUADS;
-		Cmd.m_PrimCount = NumVerts/4;
-	}
-	else if(m_Drawing == DRAWING_LINES)
-	{
-		Cmd.m_PrimType = CCommandBuffer::PRIMTYPE_LINES;
-		Cmd.m_PrimCount = NumVerts/2;
+		CCommandBuffer::SCommand_Render *pRender = (CCommandBuffer::SCommand_Render *)pLast;
+		if(pRender->m_PrimType == PrimType && CCommandBuffer::SameState(pRender->m_State, State) &&
+			m_pCommandBuffer->IsDataEnd(pRender->m_pVertices + pRender->m_PrimCount*VerticesPerPrim))
+		{
+			CCommandBuffer::SVertex *pVertices = (CCommandBuffer::SVertex *)m_pCommandBuffer->AllocData(sizeof(CCommandBuffer::SVertex)*NumVerts);
+			if(pVertices)
+			{
+				pRender->m_PrimCount += NumVerts/VerticesPerPrim;
+				return pVertices;
+			}
+		}
 	}
-	else
-		return;
+
+	CCommandBuffer::SCommand_Render Cmd;
+	Cmd.m_State = State;
+	Cmd.m_PrimType = PrimType;
+	Cmd.m_PrimCount = NumVerts/VerticesPerPrim;
 
 	Cmd.m_pVertices = (CCommandBuffer::SVertex *)m_pCommandBuffer->AllocData(sizeof(CCommandBuffer::SVertex)*NumVerts);
 	if(Cmd.m_pVertices == 0x0)
@@ -67,7 +69,7 @@ void CGraphics_Threaded::FlushVertices()
 		if(Cmd.m_pVertices == 0x0)
 		{
 			dbg_msg("graphics", "failed to allocate data for vertices");
-			return;
+			return 0;
 		}
 	}
 
@@ -81,17 +83,143 @@ void CGraphics_Threaded::FlushVertices()
 		if(Cmd.m_pVertices == 0x0)
 		{
 			dbg_msg("graphics", "failed to allocate data for vertices");
-			return;
+			return 0;
 		}
 
 		if(!m_pCommandBuffer->AddCommand(Cmd))
 		{
 			dbg_msg("graphics", "failed to allocate memory for render command");
-			return;
+			return 0;
+		}
+	}
+
+	return Cmd.m_pVertices;
+}
+
+void CGraphics_Threaded::ReorderVertices(unsigned PrimType, int NumVerts)
+{
+	int Batch = 0;
+	while(Batch < m_NumReorderBatches && (m_aReorderBatches[Batch].m_PrimType != PrimType || !CCommandBuffer::SameState(m_aReorderBatches[Batch].m_State, m_State)))
+		Batch++;
+
+	// draw what's waiting when there is no room left
+	if((Batch == m_NumReorderBatches && m_NumReorderBatches >= min(g_Config.m_GfxReorderWindow, (int)MAX_REORDER_BATCHES)) ||
+		m_NumReorderSegments == MAX_REORDER_SEGMENTS || m_NumReorderVertices+NumVerts > MAX_VERTICES)
+	{
+		FlushReorderWindow();
+		Batch = 0;
+	}
+
+	if(Batch == m_NumReorderBatches)
+	{
+		m_aReorderBatches[Batch].m_State = m_State;
+		m_aReorderBatches[Batch].m_PrimType = PrimType;
+		m_aReorderBatches[Batch].m_NumVertices = 0;
+		m_NumReorderBatches++;
+	}
+
+	CReorderSegment *pSegment = m_NumReorderSegments ? &m_aReorderSegments[m_NumReorderSegments-1] : 0;
+	if(!pSegment || pSegment->m_Batch != Batch)
+	{
+		pSegment = &m_aReorderSegments[m_NumReorderSegments++];
+		pSegment->m_Batch = Batch;
+		pSegment->m_FirstVertex = m_NumReorderVertices;
+		pSegment->m_NumVertices = 0;
+	}
+
+	mem_copy(&m_aReorderVertices[m_NumReorderVertices], m_aVertices, sizeof(CCommandBuffer::SVertex)*NumVerts);
+	m_NumReorderVertices += NumVerts;
+	pSegment->m_NumVertices += NumVerts;
+	m_aReorderBatches[Batch].m_NumVertices += NumVerts;
+}
+
+void CGraphics_Threaded::FlushReorderWindow()
+{
+	int NumBatches = m_NumReorderBatches;
+	int NumSegments = m_NumReorderSegments;
+	if(NumBatches == 0)
+		return;
+
+	// empty the window first, kicking the command buffer flushes it
+	m_NumReorderBatches = 0;
+	m_NumReorderSegments = 0;
+	m_NumReorderVertices = 0;
+
+	// one draw per batch, its segments stay in the order they came in
+	for(int b = 0; b < NumBatches; b++)
+	{
+		const CReorderBatch *pBatch = &m_aReorderBatches[b];
+		CCommandBuffer::SVertex *pVertices = AllocRenderCommand(pBatch->m_State, pBatch->m_PrimType, pBatch->m_NumVertices);
+		if(!pVertices)
+			continue;
+
+		for(int i = 0; i < NumSegments; i++)
+		{
+			const CReorderSegment *pSegment = &m_aReorderSegments[i];
+			if(pSegment->m_Batch != b)
+				continue;
+			mem_copy(pVertices, &m_aReorderVertices[pSegment->m_FirstVertex], sizeof(CCommandBuffer::SVertex)*pSegment->m_NumVertices);
+			pVertices += pSegment->m_NumVertices;
+		}
+	}
+}
+
+void CGraphics_Threaded::FlushVertices()
+{
+	if(m_NumVertices == 0)
+		return;
+
+	int NumVerts = m_NumVertices;
+	m_NumVertices = 0;
+
+	if(m_RecordingQuadBuffer)
+	{
+		RecordVertices(NumVerts);
+		return;
+	}
+
+	unsigned PrimType;
+	if(m_Drawing == DRAWING_QUADS)
+		PrimType = CCommandBuffer::PRIMTYPE_QUADS;
+	else if(m_Drawing == DRAWING_LINES)
+		PrimType = CCommandBuffer::PRIMTYPE_LINES;
+	else
+		return;
+
+	if(m_ReorderDepth && g_Config.m_GfxReorderWindow)
+	{
+		ReorderVertices(PrimType, NumVerts);
+		return;
+	}
+
+	FlushReorderWindow();
+	CCommandBuffer::SVertex *pVertices = AllocRenderCommand(m_State, PrimType, NumVerts);
+	if(pVertices)
+		mem_copy(pVertices, m_aVertices, sizeof(CCommandBuffer::SVertex)*NumVerts);
+}
+
+void CGraphics_Threaded::RecordVertices(int NumVerts)
+{
+	if(m_NumRecordedVertices+NumVerts > m_RecordedVerticesCapacity)
+	{
+		m_RecordedVerticesCapacity = max(m_RecordedVerticesCapacity*2, m_NumRecordedVertices+NumVerts);
+		CCommandBuffer::SBufferVertex *pVertices = (CCommandBuffer::SBufferVertex *)mem_alloc(sizeof(CCommandBuffer::SBufferVertex)*m_RecordedVerticesCapacity, sizeof(void*));
+		if(m_pRecordedVertices)
+		{
+			mem_copy(pVertices, m_pRecordedVertices, sizeof(CCommandBuffer::SBufferVertex)*m_NumRecordedVertices);
+			mem_free(m_pRecordedVertices);
 		}
+		m_pRecordedVertices = pVertices;
 	}
 
-	mem_copy(Cmd.m_pVertices, m_aVertices, sizeof(CCommandBuffer::SVertex)*NumVerts);
+	CCommandBuffer::SBufferVertex *pVertices = &m_pRecordedVertices[m_NumRecordedVertices];
+	for(int i = 0; i < NumVerts; i++)
+	{
+		pVertices[i].m_Pos = m_aVertices[i].m_Pos;
+		pVertices[i].m_Tex = m_aVertices[i].m_Tex;
+	}
+	m_NumRecordedVertices += NumVerts;
+	m_RecordedDimension = m_State.m_Dimension;
 }
 
 void CGraphics_Threaded::AddVertices(int Count)
@@ -140,6 +268,11 @@ CGraphics_Threaded::CGraphics_Threaded()
 
 	m_NumVertices = 0;
 
+	m_ReorderDepth = 0;
+	m_NumReorderVertices = 0;
+	m_NumReorderBatches = 0;
+	m_NumReorderSegments = 0;
+
 	m_ScreenWidth = -1;
 	m_ScreenHeight = -1;
 
@@ -148,6 +281,12 @@ CGraphics_Threaded::CGraphics_Threaded()
 
 	m_TextureMemoryUsage = 0;
 
+	m_RecordingQuadBuffer = false;
+	m_pRecordedVertices = 0;
+	m_NumRecordedVertices = 0;
+	m_RecordedVerticesCapacity = 0;
+	m_RecordedDimension = 2;
+
 	m_RenderEnable = true;
 	m_DoScreenshot = false;
 }
@@ -274,7 +413,7 @@ int CGraphics_Threaded::UnloadTexture(CTextureHandle Index)
 
 	CCommandBuffer::SCommand_Texture_Destroy Cmd;
 	Cmd.m_Slot = Index.Id();
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	m_aTextureIndices[Index.Id()] = m_FirstFreeTexture;
 	m_FirstFreeTexture = Index.Id();
@@ -319,7 +458,7 @@ int CGraphics_Threaded::LoadTextureRawSub(CTextureHandle TextureID, int x, int y
 	Cmd.m_pData = pTmpData;
 
 	//
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 	return 0;
 }
 
@@ -368,7 +507,7 @@ IGraphics::CTextureHandle CGraphics_Threaded::LoadTextureRaw(int Width, int Heig
 	
 
 	//
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	return CreateTextureHandle(Tex);
 }
@@ -447,6 +586,7 @@ int CGraphics_Threaded::LoadPNG(CImageInfo *pImg, const char *pFilename, int Sto
 
 void CGraphics_Threaded::KickCommandBuffer()
 {
+	FlushReorderWindow();
 	m_pBackend->RunBuffer(m_pCommandBuffer);
 
 	// swap buffer
@@ -465,7 +605,7 @@ void CGraphics_Threaded::ScreenshotDirect(const char *pFilename)
 	Cmd.m_pImage = &Image;
 	Cmd.m_X = 0; Cmd.m_Y = 0;
 	Cmd.m_W = -1; Cmd.m_H = -1;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	// kick the buffer and wait for the result
 	KickCommandBuffer();
@@ -507,7 +647,7 @@ void CGraphics_Threaded::Clear(float r, float g, float b)
 	Cmd.m_Color.g = g;
 	Cmd.m_Color.b = b;
 	Cmd.m_Color.a = 0;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 }
 
 void CGraphics_Threaded::QuadsBegin()
@@ -706,6 +846,121 @@ void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pTe
 	}
 }
 
+void CGraphics_Threaded::ReorderBegin()
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->ReorderBegin within begin");
+	m_ReorderDepth++;
+}
+
+void CGraphics_Threaded::ReorderEnd()
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->ReorderEnd within begin");
+	dbg_assert(m_ReorderDepth > 0, "called Graphics()->ReorderEnd without begin");
+	if(--m_ReorderDepth == 0)
+		FlushReorderWindow();
+}
+
+void CGraphics_Threaded::QuadBufferBegin()
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->QuadBufferBegin within begin");
+	m_Drawing = DRAWING_QUADS;
+	m_RecordingQuadBuffer = true;
+	m_NumRecordedVertices = 0;
+
+	QuadsSetSubset(0,0,1,1,-1);
+	QuadsSetRotation(0);
+	SetColor(1,1,1,1);
+}
+
+IGraphics::CBufferHandle CGraphics_Threaded::QuadBufferEnd()
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS && m_RecordingQuadBuffer, "called Graphics()->QuadBufferEnd without begin");
+	FlushVertices();
+	m_Drawing = 0;
+	m_RecordingQuadBuffer = false;
+
+	if(m_NumRecordedVertices == 0 || m_FirstFreeQuadBuffer < 0)
+	{
+		if(m_NumRecordedVertices)
+			dbg_msg("graphics", "out of quad buffers");
+		mem_free(m_pRecordedVertices);
+		m_pRecordedVertices = 0;
+		m_RecordedVerticesCapacity = 0;
+		return CBufferHandle();
+	}
+
+	// grab buffer
+	int Buffer = m_FirstFreeQuadBuffer;
+	m_FirstFreeQuadBuffer = m_aQuadBufferIndices[Buffer];
+	m_aQuadBufferIndices[Buffer] = -1;
+	m_aQuadBufferDimensions[Buffer] = m_RecordedDimension;
+
+	// the backend takes over the vertices
+	CCommandBuffer::SCommand_QuadBuffer_Create Cmd;
+	Cmd.m_Slot = Buffer;
+	Cmd.m_NumQuads = m_NumRecordedVertices/4;
+	Cmd.m_pVertices = m_pRecordedVertices;
+	AddCommand(Cmd);
+
+	m_pRecordedVertices = 0;
+	m_NumRecordedVertices = 0;
+	m_RecordedVerticesCapacity = 0;
+	return CreateBufferHandle(Buffer);
+}
+
+void CGraphics_Threaded::UnloadQuadBuffer(CBufferHandle Buffer)
+{
+	if(!Buffer.IsValid())
+		return;
+
+	CCommandBuffer::SCommand_QuadBuffer_Destroy Cmd;
+	Cmd.m_Slot = Buffer.Id();
+	AddCommand(Cmd);
+
+	m_aQuadBufferIndices[Buffer.Id()] = m_FirstFreeQuadBuffer;
+	m_FirstFreeQuadBuffer = Buffer.Id();
+}
+
+void CGraphics_Threaded::RenderQuadBuffer(CBufferHandle Buffer, int FirstQuad, int NumQuads, float r, float g, float b, float a)
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->RenderQuadBuffer within begin");
+	if(!Buffer.IsValid() || NumQuads <= 0)
+		return;
+
+	CCommandBuffer::SCommand_RenderQuadBuffer Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_State.m_Dimension = m_aQuadBufferDimensions[Buffer.Id()];
+	Cmd.m_Color.r = r;
+	Cmd.m_Color.g = g;
+	Cmd.m_Color.b = b;
+	Cmd.m_Color.a = a;
+	Cmd.m_Slot = Buffer.Id();
+	Cmd.m_FirstQuad = FirstQuad;
+	Cmd.m_NumQuads = NumQuads;
+
+	// continues the last draw of the same buffer
+	FlushReorderWindow();
+	CCommandBuffer::SCommand *pLast = m_pCommandBuffer->LastCommand();
+	if(g_Config.m_GfxBatchDraws && pLast && pLast->m_Cmd == CCommandBuffer::CMD_RENDER_QUADBUFFER)
+	{
+		CCommandBuffer::SCommand_RenderQuadBuffer *pRender = (CCommandBuffer::SCommand_RenderQuadBuffer *)pLast;
+		if(pRender->m_Slot == Cmd.m_Slot && pRender->m_FirstQuad+pRender->m_NumQuads == Cmd.m_FirstQuad &&
+			mem_comp(&pRender->m_Color, &Cmd.m_Color, sizeof(Cmd.m_Color)) == 0 && CCommandBuffer::SameState(pRender->m_State, Cmd.m_State))
+		{
+			pRender->m_NumQuads += NumQuads;
+			return;
+		}
+	}
+
+	if(!AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+		if(!AddCommand(Cmd))
+			dbg_msg("graphics", "failed to allocate memory for render command");
+	}
+}
+
 int CGraphics_Threaded::IssueInit()
 {
 	int Flags = 0;
@@ -768,7 +1023,21 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
-	m_pBackend = CreateGraphicsBackend();
+	// init quad buffers
+	m_FirstFreeQuadBuffer = 0;
+	for(int i = 0; i < MAX_QUADBUFFERS-1; i++)
+		m_aQuadBufferIndices[i] = i+1;
+	m_aQuadBufferIndices[MAX_QUADBUFFERS-1] = -1;
+
+	if(g_Config.m_GfxNull)
+	{
+		IOHANDLE DumpFile = 0;
+		if(g_Config.m_GfxNullDump[0] && m_pStorage)
+			DumpFile = m_pStorage->OpenFile(g_Config.m_GfxNullDump, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		m_pBackend = CreateNullGraphicsBackend(DumpFile);
+	}
+	else
+		m_pBackend = CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
 
@@ -881,6 +1150,11 @@ int CGraphics_Threaded::WindowOpen()
 
 }
 
+bool CGraphics_Threaded::GetStats(CGraphicsStats *pStats) const
+{
+	return m_pBackend->GetStats(pStats);
+}
+
 void CGraphics_Threaded::ReadBackbuffer(unsigned char **ppPixels, int x, int y, int w, int h)
 {
 	if(!ppPixels)
@@ -894,7 +1168,7 @@ void CGraphics_Threaded::ReadBackbuffer(unsigned char **ppPixels, int x, int y,
 	Cmd.m_pImage = &Image;
 	Cmd.m_X = x; Cmd.m_Y = y;
 	Cmd.m_W = w; Cmd.m_H = h;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	// kick the buffer and wait for the result
 	KickCommandBuffer();
@@ -925,7 +1199,7 @@ void CGraphics_Threaded::Swap()
 	// add swap command
 	CCommandBuffer::SCommand_Swap Cmd;
 	Cmd.m_Finish = g_Config.m_GfxFinish;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	// kick the command buffer
 	KickCommandBuffer();
@@ -938,7 +1212,7 @@ bool CGraphics_Threaded::SetVSync(bool State)
 	CCommandBuffer::SCommand_VSync Cmd;
 	Cmd.m_VSync = State ? 1 : 0;
 	Cmd.m_pRetOk = &RetOk;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	// kick the command buffer
 	KickCommandBuffer();
@@ -951,7 +1225,7 @@ void CGraphics_Threaded::InsertSignal(semaphore *pSemaphore)
 {
 	CCommandBuffer::SCommand_Signal Cmd;
 	Cmd.m_pSemaphore = pSemaphore;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 }
 
 bool CGraphics_Threaded::IsIdle() const
@@ -985,7 +1259,7 @@ int CGraphics_Threaded::GetVideoModes(CVideoMode *pModes, int MaxModes, int Scre
 	Cmd.m_MaxModes = MaxModes;
 	Cmd.m_pNumModes = &NumModes;
 	Cmd.m_Screen = Screen;
-	m_pCommandBuffer->AddCommand(Cmd);
+	AddCommand(Cmd);
 
 	// kick the buffer and wait for the result and return it
 	KickCommandBuffer();
@@ -51,6 +51,7 @@ public:
 	enum
 	{
 		MAX_TEXTURES=1024*4,
+		MAX_QUADBUFFERS=1024,
 	};
 
 	enum
@@ -74,9 +75,14 @@ public:
 		CMD_TEXTURE_DESTROY,
 		CMD_TEXTURE_UPDATE,
 
+		// quad buffer commands
+		CMD_QUADBUFFER_CREATE,
+		CMD_QUADBUFFER_DESTROY,
+
 		// rendering
 		CMD_CLEAR,
 		CMD_RENDER,
+		CMD_RENDER_QUADBUFFER,
 
 		// swap
 		CMD_SWAP,
@@ -128,6 +134,13 @@ public:
 		SColor m_Color;
 	};
 
+	// quad buffers get their color when they are rendered
+	struct SBufferVertex
+	{
+		SPoint m_Pos;
+		STexCoord m_Tex;
+	};
+
 	struct SCommand
 	{
 	public:
@@ -181,6 +194,16 @@ public:
 		SVertex *m_pVertices; // you should use the command buffer data to allocate vertices for this command
 	};
 
+	struct SCommand_RenderQuadBuffer : public SCommand
+	{
+		SCommand_RenderQuadBuffer() : SCommand(CMD_RENDER_QUADBUFFER) {}
+		SState m_State;
+		SColor m_Color;
+		int m_Slot;
+		unsigned m_FirstQuad;
+		unsigned m_NumQuads;
+	};
+
 	struct SCommand_Screenshot : public SCommand
 	{
 		SCommand_Screenshot() : SCommand(CMD_SCREENSHOT) {}
@@ -252,11 +275,43 @@ public:
 		// texture information
 		int m_Slot;
 	};
+
+	struct SCommand_QuadBuffer_Create : public SCommand
+	{
+		SCommand_QuadBuffer_Create() : SCommand(CMD_QUADBUFFER_CREATE) {}
+
+		int m_Slot;
+		int m_NumQuads;
+		SBufferVertex *m_pVertices; // will be kept by the command processor until the buffer is destroyed
+	};
+
+	struct SCommand_QuadBuffer_Destroy : public SCommand
+	{
+		SCommand_QuadBuffer_Destroy() : SCommand(CMD_QUADBUFFER_DESTROY) {}
+
+		int m_Slot;
+	};
 	
 	//
+private:
+	SCommand *m_pLastCommand;
+
+public:
 	CCommandBuffer(unsigned CmdBufferSize, unsigned DataBufferSize)
 	: m_CmdBuffer(CmdBufferSize), m_DataBuffer(DataBufferSize)
 	{
+		m_pLastCommand = 0;
+	}
+
+	static bool SameState(const SState &a, const SState &b)
+	{
+		if(a.m_BlendMode != b.m_BlendMode || a.m_WrapModeU != b.m_WrapModeU || a.m_WrapModeV != b.m_WrapModeV ||
+			a.m_Texture != b.m_Texture || a.m_Dimension != b.m_Dimension ||
+			a.m_ScreenTL.x != b.m_ScreenTL.x || a.m_ScreenTL.y != b.m_ScreenTL.y ||
+			a.m_ScreenBR.x != b.m_ScreenBR.x || a.m_ScreenBR.y != b.m_ScreenBR.y ||
+			a.m_ClipEnable != b.m_ClipEnable)
+			return false;
+		return !a.m_ClipEnable || (a.m_ClipX == b.m_ClipX && a.m_ClipY == b.m_ClipY && a.m_ClipW == b.m_ClipW && a.m_ClipH == b.m_ClipH);
 	}
 
 	void *AllocData(unsigned WantedSize)
@@ -276,9 +331,16 @@ public:
 			return false;
 		mem_copy(pCmd, &Command, sizeof(Command));
 		pCmd->m_Size = sizeof(Command);
+		m_pLastCommand = pCmd;
 		return true;
 	}
 
+	// the command that was added last, a draw can be merged into it while nothing else was added
+	SCommand *LastCommand() { return m_pLastCommand; }
+
+	// if the next allocated data starts right at the end of pData
+	bool IsDataEnd(const void *pData) { return pData == m_DataBuffer.DataPtr()+m_DataBuffer.DataUsed(); }
+
 	SCommand *GetCommand(unsigned *pIndex)
 	{
 		if(*pIndex >= m_CmdBuffer.DataUsed())
@@ -293,6 +355,7 @@ public:
 	{
 		m_CmdBuffer.Reset();
 		m_DataBuffer.Reset();
+		m_pLastCommand = 0;
 	}
 };
 
@@ -330,6 +393,8 @@ public:
 	virtual void RunBuffer(CCommandBuffer *pBuffer) = 0;
 	virtual bool IsIdle() const = 0;
 	virtual void WaitForIdle() = 0;
+
+	virtual bool GetStats(CGraphicsStats *pStats) const = 0;
 };
 
 class CGraphics_Threaded : public IEngineGraphics
@@ -340,6 +405,9 @@ class CGraphics_Threaded : public IEngineGraphics
 
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_QUADBUFFERS = CCommandBuffer::MAX_QUADBUFFERS,
+		MAX_REORDER_BATCHES = 32,
+		MAX_REORDER_SEGMENTS = 256,
 		
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -375,7 +443,54 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	// the quad buffer that gets recorded, its quads grow as they get flushed
+	bool m_RecordingQuadBuffer;
+	CCommandBuffer::SBufferVertex *m_pRecordedVertices;
+	int m_NumRecordedVertices;
+	int m_RecordedVerticesCapacity;
+	int m_RecordedDimension;
+
+	int m_aQuadBufferIndices[MAX_QUADBUFFERS];
+	int m_aQuadBufferDimensions[MAX_QUADBUFFERS];
+	int m_FirstFreeQuadBuffer;
+
+	// draws that don't depend on their order wait in the reorder window,
+	// a batch is one state and a segment consecutive vertices of a batch
+	struct CReorderBatch
+	{
+		CCommandBuffer::SState m_State;
+		unsigned m_PrimType;
+		int m_NumVertices;
+	};
+
+	struct CReorderSegment
+	{
+		int m_Batch;
+		int m_FirstVertex;
+		int m_NumVertices;
+	};
+
+	int m_ReorderDepth;
+	CCommandBuffer::SVertex m_aReorderVertices[MAX_VERTICES];
+	int m_NumReorderVertices;
+	CReorderBatch m_aReorderBatches[MAX_REORDER_BATCHES];
+	int m_NumReorderBatches;
+	CReorderSegment m_aReorderSegments[MAX_REORDER_SEGMENTS];
+	int m_NumReorderSegments;
+
+	// everything else that goes into the command buffer has to come after the waiting draws
+	template<class T>
+	bool AddCommand(const T &Command)
+	{
+		FlushReorderWindow();
+		return m_pCommandBuffer->AddCommand(Command);
+	}
+
+	CCommandBuffer::SVertex *AllocRenderCommand(const CCommandBuffer::SState &State, unsigned PrimType, int NumVerts);
+	void ReorderVertices(unsigned PrimType, int NumVerts);
+	void FlushReorderWindow();
 	void FlushVertices();
+	void RecordVertices(int NumVerts);
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints);
 
@@ -438,6 +553,14 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual void ReorderBegin();
+	virtual void ReorderEnd();
+
+	virtual void QuadBufferBegin();
+	virtual CBufferHandle QuadBufferEnd();
+	virtual void UnloadQuadBuffer(CBufferHandle Buffer);
+	virtual void RenderQuadBuffer(CBufferHandle Buffer, int FirstQuad, int NumQuads, float r, float g, float b, float a);
+
 	virtual int GetNumScreens() const;
 	virtual void Minimize();
 	virtual void Maximize();
@@ -449,6 +572,8 @@ public:
 	virtual int WindowActive();
 	virtual int WindowOpen();
 
+	virtual bool GetStats(CGraphicsStats *pStats) const;
+
 	virtual int Init();
 	virtual void Shutdown();
 
@@ -469,3 +594,4 @@ public:
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
+extern IGraphicsBackend *CreateNullGraphicsBackend(IOHANDLE DumpFile);
@@ -5,9 +5,14 @@
 
 #include <engine/sound.h>
 
+#include "soundmixer.h"
+
 class CSound : public IEngineSound
 {
 	int m_SoundEnabled;
+	CSoundMixer m_Mixer;
+
+	static void SdlCallback(void *pUser, unsigned char *pStream, int Len);
 
 public:
 	IEngineGraphics *m_pGraphics;
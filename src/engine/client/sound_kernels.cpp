@@ -0,0 +1,206 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include "sound_kernels.h"
+
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	#define SOUND_KERNELS_X86 1
+	#include <emmintrin.h>
+	#include <immintrin.h>
+#endif
+
+// the kernels are compiled for their instruction set no matter what the
+// rest of the engine gets built for, Best() makes sure they are only used
+// when the cpu supports them
+#if defined(__GNUC__)
+	#define KERNEL_TARGET(Target) __attribute__((target(Target)))
+#else
+	#define KERNEL_TARGET(Target)
+#endif
+
+
+// scalar
+
+static void MixScalar(int *pOut, const short *pIn, int Channels, unsigned Frames, int LeftVol, int RightVol)
+{
+	const short *pInR = pIn+Channels-1; // mono samples go to both sides
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pOut[i*2] += pIn[i*Channels]*LeftVol;
+		pOut[i*2+1] += pInR[i*Channels]*RightVol;
+	}
+}
+
+static void ClampScalar(const int *pIn, short *pOut, unsigned NumSamples, int Volume)
+{
+	for(unsigned i = 0; i < NumSamples; i++)
+	{
+		// a few loud voices times the volume don't fit into an int anymore
+		int Value = (int)(((int64)pIn[i]*Volume/101)>>8);
+		pOut[i] = clamp(Value, -0x7fff, 0x7fff);
+	}
+}
+
+
+#if defined(SOUND_KERNELS_X86)
+
+// sse2
+
+// adds the full 32 bit products of 8 shorts to pOut
+KERNEL_TARGET("sse2") static inline void MulAdd8(int *pOut, __m128i In, __m128i Vol)
+{
+	__m128i Low = _mm_mullo_epi16(In, Vol);
+	__m128i High = _mm_mulhi_epi16(In, Vol);
+	_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pOut), _mm_unpacklo_epi16(Low, High)));
+	_mm_storeu_si128((__m128i *)(pOut+4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pOut+4)), _mm_unpackhi_epi16(Low, High)));
+}
+
+KERNEL_TARGET("sse2") static void MixSSE2(int *pOut, const short *pIn, int Channels, unsigned Frames, int LeftVol, int RightVol)
+{
+	// the volumes are multiplied as shorts
+	if(LeftVol != (short)LeftVol || RightVol != (short)RightVol)
+	{
+		MixScalar(pOut, pIn, Channels, Frames, LeftVol, RightVol);
+		return;
+	}
+
+	__m128i Vol = _mm_setr_epi16(LeftVol, RightVol, LeftVol, RightVol, LeftVol, RightVol, LeftVol, RightVol);
+	unsigned i = 0;
+	if(Channels == 2)
+	{
+		for(; i+4 <= Frames; i += 4)
+			MulAdd8(pOut+i*2, _mm_loadu_si128((const __m128i *)(pIn+i*2)), Vol);
+	}
+	else
+	{
+		for(; i+8 <= Frames; i += 8)
+		{
+			__m128i In = _mm_loadu_si128((const __m128i *)(pIn+i));
+			MulAdd8(pOut+i*2, _mm_unpacklo_epi16(In, In), Vol);
+			MulAdd8(pOut+i*2+8, _mm_unpackhi_epi16(In, In), Vol);
+		}
+	}
+	MixScalar(pOut+i*2, pIn+i*Channels, Channels, Frames-i, LeftVol, RightVol);
+}
+
+// the products fit into doubles exactly and their truncated quotient is the one of the integer division
+KERNEL_TARGET("sse2") static inline __m128i Scale4(const int *pIn, __m128d Volume)
+{
+	__m128i In = _mm_loadu_si128((const __m128i *)pIn);
+	__m128d Divisor = _mm_set1_pd(101.0);
+	__m128i Low = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(In), Volume), Divisor));
+	__m128i High = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(In, _MM_SHUFFLE(1, 0, 3, 2))), Volume), Divisor));
+	return _mm_srai_epi32(_mm_unpacklo_epi64(Low, High), 8);
+}
+
+KERNEL_TARGET("sse2") static void ClampSSE2(const int *pIn, short *pOut, unsigned NumSamples, int Volume)
+{
+	__m128d Vol = _mm_set1_pd(Volume);
+	__m128i Min = _mm_set1_epi16(-0x7fff);
+	unsigned i = 0;
+	for(; i+8 <= NumSamples; i += 8)
+	{
+		// packing saturates to -0x8000..0x7fff
+		__m128i Packed = _mm_packs_epi32(Scale4(pIn+i, Vol), Scale4(pIn+i+4, Vol));
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_max_epi16(Packed, Min));
+	}
+	ClampScalar(pIn+i, pOut+i, NumSamples-i, Volume);
+}
+
+
+// avx2, the remainder goes through the sse2 kernels after the upper
+// register halves have been cleared
+
+KERNEL_TARGET("avx2") static inline void MulAdd8Wide(int *pOut, __m256i In, __m256i Vol)
+{
+	_mm256_storeu_si256((__m256i *)pOut, _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)pOut), _mm256_mullo_epi32(In, Vol)));
+}
+
+KERNEL_TARGET("avx2") static void MixAVX2(int *pOut, const short *pIn, int Channels, unsigned Frames, int LeftVol, int RightVol)
+{
+	__m256i Vol = _mm256_setr_epi32(LeftVol, RightVol, LeftVol, RightVol, LeftVol, RightVol, LeftVol, RightVol);
+	unsigned i = 0;
+	if(Channels == 2)
+	{
+		for(; i+4 <= Frames; i += 4)
+			MulAdd8Wide(pOut+i*2, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(pIn+i*2))), Vol);
+	}
+	else
+	{
+		__m256i LowFrames = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		__m256i HighFrames = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+		for(; i+8 <= Frames; i += 8)
+		{
+			__m256i In = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(pIn+i)));
+			MulAdd8Wide(pOut+i*2, _mm256_permutevar8x32_epi32(In, LowFrames), Vol);
+			MulAdd8Wide(pOut+i*2+8, _mm256_permutevar8x32_epi32(In, HighFrames), Vol);
+		}
+	}
+	_mm256_zeroupper();
+	MixSSE2(pOut+i*2, pIn+i*Channels, Channels, Frames-i, LeftVol, RightVol);
+}
+
+KERNEL_TARGET("avx2") static inline __m128i Scale4Wide(const int *pIn, __m256d Volume)
+{
+	__m256d Value = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)pIn)), Volume);
+	return _mm_srai_epi32(_mm256_cvttpd_epi32(_mm256_div_pd(Value, _mm256_set1_pd(101.0))), 8);
+}
+
+KERNEL_TARGET("avx2") static void ClampAVX2(const int *pIn, short *pOut, unsigned NumSamples, int Volume)
+{
+	__m256d Vol = _mm256_set1_pd(Volume);
+	__m128i Min = _mm_set1_epi16(-0x7fff);
+	unsigned i = 0;
+	for(; i+8 <= NumSamples; i += 8)
+	{
+		__m128i Packed = _mm_packs_epi32(Scale4Wide(pIn+i, Vol), Scale4Wide(pIn+i+4, Vol));
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_max_epi16(Packed, Min));
+	}
+	_mm256_zeroupper();
+	ClampSSE2(pIn+i, pOut+i, NumSamples-i, Volume);
+}
+
+#endif
+
+
+// new instruction sets (e.g. neon) only need an entry here, ordered from slowest to fastest
+static const CSoundKernels s_aKernels[] = {
+	{"scalar", 0, MixScalar, ClampScalar},
+#if defined(SOUND_KERNELS_X86)
+	{"sse2", CPU_FEATURE_SSE2, MixSSE2, ClampSSE2},
+	{"avx2", CPU_FEATURE_SSE2|CPU_FEATURE_AVX2, MixAVX2, ClampAVX2},
+#endif
+};
+
+static const CSoundKernels *s_pBestKernels = 0;
+
+bool CSoundKernels::Supported() const
+{
+	return (cpu_features()&m_RequiredFeatures) == m_RequiredFeatures;
+}
+
+const CSoundKernels *CSoundKernels::Best()
+{
+	if(!s_pBestKernels)
+	{
+		int i = Num()-1;
+		while(i > 0 && !s_aKernels[i].Supported())
+			i--;
+		s_pBestKernels = &s_aKernels[i];
+	}
+	return s_pBestKernels;
+}
+
+int CSoundKernels::Num()
+{
+	return sizeof(s_aKernels)/sizeof(s_aKernels[0]);
+}
+
+const CSoundKernels *CSoundKernels::Get(int Index)
+{
+	if(Index < 0 || Index >= Num())
+		return 0;
+	return &s_aKernels[Index];
+}
@@ -0,0 +1,30 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_CLIENT_SOUND_KERNELS_H
+#define ENGINE_CLIENT_SOUND_KERNELS_H
+
+// inner loops of the sound mixer, one set per instruction set
+class CSoundKernels
+{
+public:
+	// adds the frames of a mono or stereo sample times the volumes to the interleaved stereo pOut
+	typedef void (*FMix)(int *pOut, const short *pIn, int Channels, unsigned Frames, int LeftVol, int RightVol);
+	// writes ((pIn*Volume)/101)>>8, clamped to -0x7fff..0x7fff, to pOut
+	typedef void (*FClamp)(const int *pIn, short *pOut, unsigned NumSamples, int Volume);
+
+	const char *m_pName;
+	int m_RequiredFeatures; // CPU_FEATURE_* flags
+	FMix m_pfnMix;
+	FClamp m_pfnClamp;
+
+	bool Supported() const;
+
+	// the fastest set the cpu supports
+	static const CSoundKernels *Best();
+
+	// all compiled in sets, index 0 is the scalar one
+	static int Num();
+	static const CSoundKernels *Get(int Index);
+};
+
+#endif
@@ -0,0 +1,274 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/sound.h>
+
+#include "sound_kernels.h"
+#include "soundmixer.h"
+
+#include <math.h>
+
+CSoundMixer::CSoundMixer()
+{
+	m_QueueRead = 0;
+	m_QueueWrite = 0;
+	mem_zero(m_aVoices, sizeof(m_aVoices));
+	mem_zero(m_aVoiceStates, sizeof(m_aVoiceStates));
+	for(int i = 0; i < NUM_VOICES; i++)
+		m_aFinishedGeneration[i] = 0;
+	m_NextVoice = 0;
+
+	for(int i = 0; i < NUM_CHANNELS; i++)
+		m_aChannelVolumes[i] = i == 0 ? 255 : 0;
+	m_CenterX = 0;
+	m_CenterY = 0;
+	m_MaxDistance = 1500.0f;
+	m_Volume = 100;
+
+	m_pKernels = 0;
+	m_pMixBuffer = 0;
+	m_MaxFrames = 0;
+}
+
+CSoundMixer::~CSoundMixer()
+{
+	Shutdown();
+}
+
+void CSoundMixer::Init(unsigned MaxFrames, const CSoundKernels *pKernels)
+{
+	Shutdown();
+	m_pKernels = pKernels ? pKernels : CSoundKernels::Best();
+	m_MaxFrames = MaxFrames;
+	m_pMixBuffer = (int *)mem_alloc(m_MaxFrames*2*sizeof(int), 1);
+}
+
+void CSoundMixer::Shutdown()
+{
+	if(m_pMixBuffer)
+	{
+		mem_free(m_pMixBuffer);
+		m_pMixBuffer = 0;
+	}
+}
+
+bool CSoundMixer::Push(const CCommand *pCommand)
+{
+	int Write = m_QueueWrite;
+	int Next = (Write+1)&(QUEUE_SIZE-1);
+	if(Next == atomic_load_acquire(&m_QueueRead))
+		return false;
+
+	m_aQueue[Write] = *pCommand;
+	atomic_store_release(&m_QueueWrite, Next);
+	return true;
+}
+
+bool CSoundMixer::VoiceBusy(int Voice) const
+{
+	const CVoiceState *pState = &m_aVoiceStates[Voice];
+	return pState->m_pSample && atomic_load_acquire(&m_aFinishedGeneration[Voice]) != pState->m_Generation;
+}
+
+int CSoundMixer::Play(CSample *pSample, int Channel, int Flags, int x, int y)
+{
+	// search for voice
+	int VoiceID = -1;
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		int id = (m_NextVoice + i) % NUM_VOICES;
+		if(!VoiceBusy(id))
+		{
+			VoiceID = id;
+			break;
+		}
+	}
+	if(VoiceID == -1)
+		return -1;
+
+	CVoiceState *pState = &m_aVoiceStates[VoiceID];
+	CCommand Command;
+	Command.m_Type = CMD_PLAY;
+	Command.m_Voice = VoiceID;
+	Command.m_Generation = pState->m_Generation+1;
+	Command.m_pSample = pSample;
+	Command.m_Channel = Channel;
+	Command.m_Flags = Flags;
+	Command.m_X = x;
+	Command.m_Y = y;
+	if(!Push(&Command))
+		return -1;
+
+	pState->m_pSample = pSample;
+	pState->m_Generation++;
+	m_NextVoice = VoiceID+1;
+	return VoiceID;
+}
+
+void CSoundMixer::Stop(CSample *pSample)
+{
+	CCommand Command;
+	Command.m_Type = CMD_STOP;
+	Command.m_pSample = pSample;
+	if(!Push(&Command))
+		return;
+
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		if(m_aVoiceStates[i].m_pSample == pSample)
+			m_aVoiceStates[i].m_pSample = 0;
+	}
+}
+
+void CSoundMixer::StopAll()
+{
+	CCommand Command;
+	Command.m_Type = CMD_STOP_ALL;
+	if(!Push(&Command))
+		return;
+
+	for(int i = 0; i < NUM_VOICES; i++)
+		m_aVoiceStates[i].m_pSample = 0;
+}
+
+bool CSoundMixer::IsPlaying(CSample *pSample) const
+{
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		if(m_aVoiceStates[i].m_pSample == pSample && VoiceBusy(i))
+			return true;
+	}
+	return false;
+}
+
+void CSoundMixer::ProcessCommands()
+{
+	int Read = m_QueueRead;
+	int Write = atomic_load_acquire(&m_QueueWrite);
+	for(; Read != Write; Read = (Read+1)&(QUEUE_SIZE-1))
+	{
+		const CCommand *pCommand = &m_aQueue[Read];
+		if(pCommand->m_Type == CMD_PLAY)
+		{
+			CVoice *v = &m_aVoices[pCommand->m_Voice];
+			v->m_pSample = pCommand->m_pSample;
+			v->m_Channel = pCommand->m_Channel;
+			if(pCommand->m_Flags&ISound::FLAG_LOOP)
+				v->m_Tick = v->m_pSample->m_PausedAt;
+			else
+				v->m_Tick = 0;
+			v->m_Flags = pCommand->m_Flags;
+			v->m_X = pCommand->m_X;
+			v->m_Y = pCommand->m_Y;
+			v->m_Generation = pCommand->m_Generation;
+		}
+		else
+		{
+			// TODO: a nice fade out
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				CVoice *v = &m_aVoices[i];
+				if(!v->m_pSample || (pCommand->m_Type == CMD_STOP && v->m_pSample != pCommand->m_pSample))
+					continue;
+				if(v->m_Flags&ISound::FLAG_LOOP)
+					v->m_pSample->m_PausedAt = v->m_Tick;
+				else
+					v->m_pSample->m_PausedAt = 0;
+				v->m_pSample = 0;
+			}
+		}
+	}
+	atomic_store_release(&m_QueueRead, Read);
+}
+
+void CSoundMixer::Mix(short *pFinalOut, unsigned Frames)
+{
+	mem_zero(m_pMixBuffer, Frames*2*sizeof(int));
+
+	int CenterX = m_CenterX;
+	int CenterY = m_CenterY;
+	float MaxDistance = m_MaxDistance;
+
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		CVoice *v = &m_aVoices[i];
+		if(!v->m_pSample)
+			continue;
+
+		// make sure that we don't go outside the sound data
+		unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
+		if(Frames < End)
+			End = Frames;
+
+		int Rvol = m_aChannelVolumes[v->m_Channel];
+		int Lvol = Rvol;
+
+		// volume calculation
+		if(v->m_Flags&ISound::FLAG_POS)
+		{
+			int dx = v->m_X - CenterX;
+			int dy = v->m_Y - CenterY;
+			float Dist = sqrtf((float)dx*dx+dy*dy);
+			if(Dist >= 0.0f && Dist < MaxDistance)
+			{
+				// constant panning (-3dB center)
+				float a = 0.5f;
+				if(dx < 0)
+					a -= (Dist/MaxDistance)/2.0f;
+				else
+					a += (Dist/MaxDistance)/2.0f;
+
+				float Lgain = sinf((1-a)*pi/2.0f);
+				float Rgain = sinf(a*pi/2.0f);
+
+				// linear falloff
+				float Falloff = 1.0f - Dist/MaxDistance;
+
+				Lvol = Lvol*Lgain*Falloff;
+				Rvol = Rvol*Rgain*Falloff;
+			}
+			else
+			{
+				Lvol = 0;
+				Rvol = 0;
+			}
+		}
+
+		int Channels = v->m_pSample->m_Channels;
+		m_pKernels->m_pfnMix(m_pMixBuffer, &v->m_pSample->m_pData[v->m_Tick*Channels], Channels, End, Lvol, Rvol);
+		v->m_Tick += End;
+
+		// free voice if not used any more
+		if(v->m_Tick == v->m_pSample->m_NumFrames)
+		{
+			if(v->m_Flags&ISound::FLAG_LOOP)
+				v->m_Tick = 0;
+			else
+			{
+				v->m_pSample = 0;
+				atomic_store_release(&m_aFinishedGeneration[i], v->m_Generation);
+			}
+		}
+	}
+
+	m_pKernels->m_pfnClamp(m_pMixBuffer, pFinalOut, Frames*2, m_Volume);
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(pFinalOut, sizeof(short), Frames * 2);
+#endif
+}
+
+void CSoundMixer::Render(short *pFinalOut, unsigned Frames)
+{
+	ProcessCommands();
+
+	while(Frames)
+	{
+		unsigned Num = min(Frames, m_MaxFrames);
+		Mix(pFinalOut, Num);
+		pFinalOut += Num*2;
+		Frames -= Num;
+	}
+}
@@ -0,0 +1,149 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_CLIENT_SOUNDMIXER_H
+#define ENGINE_CLIENT_SOUNDMIXER_H
+
+#include <base/system.h>
+
+struct CSample
+{
+	short *m_pData;
+	int m_NumFrames;
+	int m_Rate;
+	int m_Channels;
+	int m_LoopStart;
+	int m_LoopEnd;
+	int m_PausedAt; // only touched by the mixer once the sample has been played
+};
+
+/*
+	Class: Sound Mixer
+		Mixes the playing voices to 16 bit stereo. The game thread
+		starts and stops voices by putting commands into a single
+		producer, single consumer queue, and the mixing thread takes
+		them out before each mix, so neither of them ever waits for
+		the other. Voices that run out are reported back through a
+		generation counter per voice.
+		Nothing in here needs an audio device, <Render> can just as
+		well mix into a buffer of any length.
+*/
+class CSoundMixer
+{
+public:
+	enum
+	{
+		NUM_VOICES=64,
+		NUM_CHANNELS=16,
+	};
+
+private:
+	enum
+	{
+		CMD_PLAY=0,
+		CMD_STOP,
+		CMD_STOP_ALL,
+
+		QUEUE_SIZE=1024, // power of two, one entry stays empty
+	};
+
+	struct CCommand
+	{
+		int m_Type;
+		int m_Voice;
+		int m_Generation;
+		CSample *m_pSample;
+		int m_Channel;
+		int m_Flags;
+		int m_X, m_Y;
+	};
+
+	// only touched by the mixing thread
+	struct CVoice
+	{
+		CSample *m_pSample;
+		int m_Channel;
+		int m_Tick;
+		int m_Flags;
+		int m_X, m_Y;
+		int m_Generation;
+	};
+
+	// what the game thread knows about a voice
+	struct CVoiceState
+	{
+		CSample *m_pSample;
+		int m_Generation;
+	};
+
+	CCommand m_aQueue[QUEUE_SIZE];
+	volatile int m_QueueRead; // written by the mixing thread
+	volatile int m_QueueWrite; // written by the game thread
+
+	CVoice m_aVoices[NUM_VOICES];
+	volatile int m_aFinishedGeneration[NUM_VOICES]; // written by the mixing thread
+
+	CVoiceState m_aVoiceStates[NUM_VOICES];
+	int m_NextVoice;
+
+	// single values that the mixer picks up as they are
+	volatile int m_aChannelVolumes[NUM_CHANNELS]; // 0 - 255
+	volatile int m_CenterX;
+	volatile int m_CenterY;
+	volatile float m_MaxDistance;
+	volatile int m_Volume; // 0 - 100
+
+	const class CSoundKernels *m_pKernels;
+	int *m_pMixBuffer;
+	unsigned m_MaxFrames;
+
+	bool Push(const CCommand *pCommand);
+	void ProcessCommands();
+	void Mix(short *pFinalOut, unsigned Frames);
+	bool VoiceBusy(int Voice) const;
+
+public:
+	CSoundMixer();
+	~CSoundMixer();
+
+	/*
+		Function: Init
+			Allocates the mix buffer. Has to be called before the
+			first <Render>.
+
+		Parameters:
+			MaxFrames - Number of frames mixed at once.
+			pKernels - Inner loops to mix with, the fastest ones
+				the cpu supports if 0.
+	*/
+	void Init(unsigned MaxFrames, const CSoundKernels *pKernels = 0);
+	void Shutdown();
+
+	// game thread
+	void SetVolume(int Volume) { m_Volume = Volume; }
+	void SetChannelVolume(int Channel, int Volume) { m_aChannelVolumes[Channel] = Volume; }
+	void SetListenerPos(int x, int y) { m_CenterX = x; m_CenterY = y; }
+	void SetMaxDistance(float Distance) { m_MaxDistance = Distance; }
+
+	/*
+		Function: Play
+			Starts a voice with the next mix.
+
+		Returns:
+			The voice, -1 if all voices are busy or the mixer has
+			fallen so far behind that the queue is full.
+	*/
+	int Play(CSample *pSample, int Channel, int Flags, int x, int y);
+	void Stop(CSample *pSample);
+	void StopAll();
+	bool IsPlaying(CSample *pSample) const;
+
+	/*
+		Function: Render
+			Takes the queued commands and mixes the given number of
+			interleaved stereo frames. Called by the audio device
+			callback, or directly to mix without a device.
+	*/
+	void Render(short *pFinalOut, unsigned Frames);
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <engine/graphics.h>
 #include <engine/textrender.h>
 
+#include "glyphcache.h"
+
 #ifdef CONF_FAMILY_WINDOWS
 	#include <windows.h>
 #endif
@@ -25,8 +27,6 @@ static int aFontSizes[] = {8,9,10,11,12,13,14,15,16,17,18,19,20,36,64};
 
 struct CFontChar
 {
-	int m_ID;
-
 	// these values are scaled to the pFont size
 	// width * font_size == real_size
 	float m_Width;
@@ -55,8 +55,7 @@ struct CFontSizeData
 	int m_CharMaxHeight;
 
 	CFontChar m_aCharacters[MAX_CHARACTERS*MAX_CHARACTERS];
-
-	int m_CurrentCharacter;
+	CGlyphCache m_Glyphs;
 };
 
 class CFont
@@ -165,7 +164,7 @@ class CTextRender : public IEngineTextRender
 		pSizeData->m_NumYChars = Ychars;
 		pSizeData->m_TextureWidth = Width;
 		pSizeData->m_TextureHeight = Height;
-		pSizeData->m_CurrentCharacter = 0;
+		pSizeData->m_Glyphs.Reset(Xchars*Ychars);
 		
 		dbg_msg("", "pFont memory usage: %d", FontMemoryUsage);
 
@@ -259,38 +258,18 @@ class CTextRender : public IEngineTextRender
 	unsigned char ms_aGlyphData[(1024/8) * (1024/8)];
 	unsigned char ms_aGlyphDataOutlined[(1024/8) * (1024/8)];
 
-	int GetSlot(CFontSizeData *pSizeData)
+	int GetSlot(CFontSizeData *pSizeData, int Chr, int64 Now)
 	{
-		int CharCount = pSizeData->m_NumXChars*pSizeData->m_NumYChars;
-		if(pSizeData->m_CurrentCharacter < CharCount)
-		{
-			int i = pSizeData->m_CurrentCharacter;
-			pSizeData->m_CurrentCharacter++;
-			return i;
-		}
-
-		// kick out the oldest
-		// TODO: remove this linear search
-		{
-			int Oldest = 0;
-			for(int i = 1; i < CharCount; i++)
-			{
-				if(pSizeData->m_aCharacters[i].m_TouchTime < pSizeData->m_aCharacters[Oldest].m_TouchTime)
-					Oldest = i;
-			}
-
-			if(time_get()-pSizeData->m_aCharacters[Oldest].m_TouchTime < time_freq() &&
-				(pSizeData->m_NumXChars < MAX_CHARACTERS || pSizeData->m_NumYChars < MAX_CHARACTERS))
-			{
-				IncreaseTextureSize(pSizeData);
-				return GetSlot(pSizeData);
-			}
+		// grow the texture rather than kicking out the oldest character if it was still used within the last second
+		CGlyphCache *pGlyphs = &pSizeData->m_Glyphs;
+		if(pGlyphs->Full() && Now-pSizeData->m_aCharacters[pGlyphs->LeastRecent()].m_TouchTime < time_freq() &&
+			(pSizeData->m_NumXChars < MAX_CHARACTERS || pSizeData->m_NumYChars < MAX_CHARACTERS))
+			IncreaseTextureSize(pSizeData);
 
-			return Oldest;
-		}
+		return pGlyphs->Add(Chr);
 	}
 
-	int RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int Chr)
+	int RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int Chr, int64 Now)
 	{
 		FT_Bitmap *pBitmap;
 		int SlotID = 0;
@@ -312,7 +291,7 @@ class CTextRender : public IEngineTextRender
 		pBitmap = &pFont->m_FtFace->glyph->bitmap; // ignore_convention
 
 		// fetch slot
-		SlotID = GetSlot(pSizeData);
+		SlotID = GetSlot(pSizeData, Chr, Now);
 		if(SlotID < 0)
 			return -1;
 
@@ -371,7 +350,6 @@ class CTextRender : public IEngineTextRender
 			int Height = pBitmap->rows + OutlineThickness*2 + 2; // ignore_convention
 			int Width = pBitmap->width + OutlineThickness*2 + 2; // ignore_convention
 
-			pFontchr->m_ID = Chr;
 			pFontchr->m_Height = Height * Scale;
 			pFontchr->m_Width = Width * Scale;
 			pFontchr->m_OffsetX = (pFont->m_FtFace->glyph->bitmap_left-1) * Scale; // ignore_convention
@@ -387,35 +365,18 @@ class CTextRender : public IEngineTextRender
 		return SlotID;
 	}
 
-	CFontChar *GetChar(CFont *pFont, CFontSizeData *pSizeData, int Chr)
+	CFontChar *GetChar(CFont *pFont, CFontSizeData *pSizeData, int Chr, int64 Now)
 	{
-		CFontChar *pFontchr = NULL;
-
-		// search for the character
-		// TODO: remove this linear search
-		int i;
-		for(i = 0; i < pSizeData->m_CurrentCharacter; i++)
-		{
-			if(pSizeData->m_aCharacters[i].m_ID == Chr)
-			{
-				pFontchr = &pSizeData->m_aCharacters[i];
-				break;
-			}
-		}
-
 		// check if we need to render the character
-		if(!pFontchr)
-		{
-			int Index = RenderGlyph(pFont, pSizeData, Chr);
-			if(Index >= 0)
-				pFontchr = &pSizeData->m_aCharacters[Index];
-		}
+		int Index = pSizeData->m_Glyphs.Find(Chr);
+		if(Index < 0)
+			Index = RenderGlyph(pFont, pSizeData, Chr, Now);
+		if(Index < 0)
+			return NULL;
 
 		// touch the character
-		// TODO: don't call time_get here
-		if(pFontchr)
-			pFontchr->m_TouchTime = time_get();
-
+		CFontChar *pFontchr = &pSizeData->m_aCharacters[Index];
+		pFontchr->m_TouchTime = Now;
 		return pFontchr;
 	}
 
@@ -594,6 +555,7 @@ public:
 		RenderSetup(pFont, ActualSize);
 
 		float Scale = 1.0f/pSizeData->m_FontSize;
+		int64 Now = time_get();
 
 		// set length
 		if(Length < 0)
@@ -687,7 +649,7 @@ public:
 						continue;
 					}
 
-					CFontChar *pChr = GetChar(pFont, pSizeData, Character);
+					CFontChar *pChr = GetChar(pFont, pSizeData, Character, Now);
 					if(pChr)
 					{
 						float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
@@ -26,7 +26,10 @@ public:
 	virtual void Init() = 0;
 	virtual void InitLogfile() = 0;
 	virtual void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype) = 0;
-	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData) = 0;
+	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority = CJobPool::PRIORITY_BACKGROUND) = 0;
+
+	// the job pool the engine subsystems share
+	CJobPool *JobPool() { return &m_JobPool; }
 };
 
 extern IEngine *CreateEngine(const char *pAppname);
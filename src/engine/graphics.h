@@ -48,6 +48,25 @@ public:
 	bool operator<(const CVideoMode &Other) { return Other.m_Width < m_Width; }
 };
 
+/*
+	Structure: CGraphicsStats
+		What the graphics backend did since it started, only backends
+		that count it fill this in.
+*/
+class CGraphicsStats
+{
+public:
+	int64 m_NumFrames;
+	int64 m_NumCommands;
+	int64 m_NumDraws;
+	int64 m_NumVertices; // copied into the command buffers
+	int64 m_NumBufferedVertices; // drawn from quad buffers
+	int64 m_NumStateChanges; // draws with another state than the draw before
+	int64 m_NumTextureChanges;
+	int64 m_NumTextureUploads;
+	int64 m_TextureUploadSize;
+};
+
 class IGraphics : public IInterface
 {
 	MACRO_INTERFACE("graphics", 0)
@@ -91,6 +110,19 @@ public:
 		int Id() const { return m_Id; }
 	};
 
+	class CBufferHandle
+	{
+		friend class IGraphics;
+		int m_Id;
+	public:
+		CBufferHandle()
+		: m_Id(-1)
+		{}
+
+		bool IsValid() const { return Id() >= 0; }
+		int Id() const { return m_Id; }
+	};
+
 	int ScreenWidth() const { return m_ScreenWidth; }
 	int ScreenHeight() const { return m_ScreenHeight; }
 	float ScreenAspect() const { return (float)ScreenWidth()/(float)ScreenHeight(); }
@@ -156,6 +188,26 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num) = 0;
 	virtual void QuadsText(float x, float y, float Size, const char *pText) = 0;
 
+	/*
+		Draws between ReorderBegin and ReorderEnd don't depend on their order,
+		like text that doesn't overlap. They get grouped by their texture,
+		blending, screen and clipping so each of those is drawn once.
+	*/
+	virtual void ReorderBegin() = 0;
+	virtual void ReorderEnd() = 0;
+
+	/*
+		Quad buffers hold quads that get drawn many times, like the tiles
+		of a map. The backend keeps them so a frame only refers to them.
+		Quads drawn between QuadBufferBegin and QuadBufferEnd go into the
+		buffer, their color is left out and given when rendering it.
+	*/
+	virtual void QuadBufferBegin() = 0;
+	virtual CBufferHandle QuadBufferEnd() = 0;
+	virtual void UnloadQuadBuffer(CBufferHandle Buffer) = 0;
+	// draws NumQuads quads of the buffer from FirstQuad on with the current texture, blending, screen and clipping
+	virtual void RenderQuadBuffer(CBufferHandle Buffer, int FirstQuad, int NumQuads, float r, float g, float b, float a) = 0;
+
 	struct CColorVertex
 	{
 		int m_Index;
@@ -190,6 +242,13 @@ protected:
 		Tex.m_Id = Index;
 		return Tex;
 	}
+
+	inline CBufferHandle CreateBufferHandle(int Index)
+	{
+		CBufferHandle Buffer;
+		Buffer.m_Id = Index;
+		return Buffer;
+	}
 };
 
 class IEngineGraphics : public IGraphics
@@ -211,6 +270,8 @@ public:
 	virtual int WindowActive() = 0;
 	virtual int WindowOpen() = 0;
 
+	// false if the backend doesn't count
+	virtual bool GetStats(CGraphicsStats *pStats) const = 0;
 };
 
 extern IEngineGraphics *CreateEngineGraphics();
@@ -55,6 +55,14 @@ public:
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
+	// shared snapshot: items created between SnapSharedBegin and SnapSharedEnd are built
+	// once per tick and can be copied into the snapshots of several clients. SnapSharedEnd
+	// returns false if not all of them fit, the shared snapshot can't be used then
+	virtual void SnapSharedBegin() = 0;
+	virtual bool SnapSharedEnd() = 0;
+	virtual int SnapSharedNumItems() const = 0;
+	virtual void SnapSharedCopy(int FirstItem, int NumItems) = 0;
+
 	enum
 	{
 		RCON_CID_SERV=-1,
@@ -167,7 +167,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 			return -1;
 		}
 
-		for(int i = 0; i < MAX_CLIENTS; ++i)
+		for(int i = 0; i < Server()->MaxClients(); ++i)
 		{
 			if(i == Server()->m_RconClientID || Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 				continue;
@@ -181,7 +181,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 	}
 	else if(Server()->m_RconClientID == IServer::RCON_CID_VOTE)
 	{
-		for(int i = 0; i < MAX_CLIENTS; ++i)
+		for(int i = 0; i < Server()->MaxClients(); ++i)
 		{
 			if(Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 				continue;
@@ -200,16 +200,15 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 
 	// drop banned clients
 	typename T::CDataType Data = *pData;
-	for(int i = 0; i < MAX_CLIENTS; ++i)
+	for(int i = 0; i < Server()->MaxClients(); ++i)
 	{
 		if(Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 			continue;
 
 		if(NetMatch(&Data, Server()->m_NetServer.ClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			MakeBanInfo(pBanPool->Find(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
 			Server()->m_NetServer.Drop(i, aBuf);
 		}
 	}
@@ -255,8 +254,8 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
-		m_aInputs[i].m_GameTick = -1;
+	for(int i = 0; i < INPUT_HISTORY; i++)
+		m_pInputs[i].m_GameTick = -1;
 	m_CurrentInput = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
@@ -285,6 +284,13 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_RconClientID = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_ADMIN;
 
+	m_SnapShared = false;
+	m_SharedSnapFull = false;
+	m_SharedSnapFallbacks = 0;
+	m_SharedSnapCopies = 0;
+	m_SharedSnapBytes = 0;
+	m_SharedSnapTicks = 0;
+
 	Init();
 }
 
@@ -311,7 +317,7 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 	pName = aTrimmedName;
 
 	// make sure that two clients doesn't have the same name
-	for(int i = 0; i < MAX_CLIENTS; i++)
+	for(int i = 0; i < MaxClients(); i++)
 		if(i != ClientID && m_aClients[i].m_State >= CClient::STATE_READY)
 		{
 			if(str_comp(pName, m_aClients[i].m_aName) == 0)
@@ -424,6 +430,7 @@ int CServer::Init()
 		m_aClients[i].m_aClan[0] = 0;
 		m_aClients[i].m_Country = -1;
 		m_aClients[i].m_Snapshots.Init();
+		m_aClients[i].m_pInputs = 0;
 	}
 
 	m_CurrentGameTick = 0;
@@ -534,7 +541,7 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 		{
 			// broadcast
 			int i;
-			for(i = 0; i < MAX_CLIENTS; i++)
+			for(i = 0; i < MaxClients(); i++)
 				if(m_aClients[i].m_State == CClient::STATE_INGAME && !m_aClients[i].m_Quitting)
 				{
 					Packet.m_ClientID = i;
@@ -549,6 +556,8 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 
 void CServer::DoSnapshot()
 {
+	m_SharedSnapTicks++;
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -567,7 +576,7 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
-	for(int i = 0; i < MAX_CLIENTS; i++)
+	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to recive snapshots
 		if(m_aClients[i].m_State != CClient::STATE_INGAME)
@@ -584,15 +593,10 @@ void CServer::DoSnapshot()
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
-			int SnapshotSize;
-			int Crc;
 			static CSnapshot EmptySnap;
-			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
+			CSnapJob Job;
+			CSnapJob *pJob = &Job;
+			int SnapshotSize;
 
 			m_SnapshotBuilder.Init();
 
@@ -600,7 +604,8 @@ void CServer::DoSnapshot()
 
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
-			Crc = pData->Crc();
+			pJob->m_ClientID = i;
+			pJob->m_Crc = pData->Crc();
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
@@ -608,14 +613,19 @@ void CServer::DoSnapshot()
 
 			// save it the snapshot
 			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+			pJob->m_pSnap = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			pJob->m_pSnapIndex = &m_aClients[i].m_Snapshots.m_pLast->m_KeyIndex;
 
 			// find snapshot that we can preform delta against
 			EmptySnap.Clear();
+			pJob->m_pDeltashot = &EmptySnap;
+			pJob->m_pDeltashotIndex = 0;
+			pJob->m_DeltaTick = -1;
 
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
+				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pJob->m_pDeltashot, 0, &pJob->m_pDeltashotIndex);
 				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+					pJob->m_DeltaTick = m_aClients[i].m_LastAckedSnapshot;
 				else
 				{
 					// no acked package found, force client to recover rate
@@ -624,65 +634,78 @@ void CServer::DoSnapshot()
 				}
 			}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			CreateSnapDelta(pJob);
+			SendSnapshot(pJob);
+		}
+	}
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+	GameServer()->OnPostSnap();
+}
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+void CServer::CreateSnapDelta(CSnapJob *pJob)
+{
+	char aDeltaData[CSnapshot::MAX_SIZE];
 
-				for(int n = 0, Left = SnapshotSize; Left; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	// create delta
+	int DeltaSize = m_SnapshotDelta.CreateDelta(pJob->m_pDeltashot, pJob->m_pSnap, aDeltaData, pJob->m_pDeltashotIndex, pJob->m_pSnapIndex);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+	// compress it
+	if(DeltaSize)
+		pJob->m_CompSize = CVariableInt::Compress(aDeltaData, DeltaSize, pJob->m_aCompData);
+	else
+		pJob->m_CompSize = 0;
+}
+
+void CServer::SendSnapshot(CSnapJob *pJob)
+{
+	if(pJob->m_CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		int NumPackets = (pJob->m_CompSize+MaxSize-1)/MaxSize;
+
+		for(int n = 0, Left = pJob->m_CompSize; Left; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-pJob->m_DeltaTick);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, pJob->m_ClientID);
 			}
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+				CMsgPacker Msg(NETMSG_SNAP, true);
 				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				Msg.AddInt(m_CurrentGameTick-pJob->m_DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pJob->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pJob->m_aCompData[n*MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, pJob->m_ClientID);
 			}
 		}
 	}
-
-	GameServer()->OnPostSnap();
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick-pJob->m_DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, pJob->m_ClientID);
+	}
 }
 
-
 int CServer::NewClientCallback(int ClientID, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
+	if(!pThis->m_aClients[ClientID].m_pInputs)
+		pThis->m_aClients[ClientID].m_pInputs = new CClient::CInput[CClient::INPUT_HISTORY];
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_AUTH;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -759,7 +782,7 @@ void CServer::SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighte
 	if(ReentryGuard) return;
 	ReentryGuard++;
 
-	for(i = 0; i < MAX_CLIENTS; i++)
+	for(i = 0; i < pThis->MaxClients(); i++)
 	{
 		if(pThis->m_aClients[i].m_State != CClient::STATE_EMPTY && pThis->m_aClients[i].m_Authed >= pThis->m_RconAuthLevel)
 			pThis->SendRconLine(i, pLine);
@@ -786,7 +809,7 @@ void CServer::SendRconCmdRem(const IConsole::CCommandInfo *pCommandInfo, int Cli
 
 void CServer::UpdateClientRconCommands()
 {
-	int ClientID = Tick() % MAX_CLIENTS;
+	int ClientID = Tick() % MaxClients();
 
 	if(m_aClients[ClientID].m_State != CClient::STATE_EMPTY && m_aClients[ClientID].m_Authed)
 	{
@@ -939,7 +962,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
 
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
+			pInput = &m_aClients[ClientID].m_pInputs[m_aClients[ClientID].m_CurrentInput];
 
 			if(IntendedTick <= Tick())
 				IntendedTick = Tick()+1;
@@ -1073,7 +1096,7 @@ void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
 {
 	// count the players
 	int PlayerCount = 0, ClientCount = 0;
-	for(int i = 0; i < MAX_CLIENTS; i++)
+	for(int i = 0; i < MaxClients(); i++)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
@@ -1111,7 +1134,7 @@ void CServer::GenerateServerInfo(CPacker *pPacker, int Token)
 
 	if(Token != -1)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		for(int i = 0; i < MaxClients(); i++)
 		{
 			if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			{
@@ -1131,7 +1154,7 @@ void CServer::SendServerInfo(int ClientID)
 	GenerateServerInfo(&Msg, -1);
 	if(ClientID == -1)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		for(int i = 0; i < MaxClients(); i++)
 		{
 			if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 				SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, i);
@@ -1300,6 +1323,12 @@ int CServer::Run()
 	{
 		int64 ReportTime = time_get();
 		int ReportInterval = 3;
+		int64 PrefTickTime = 0;
+		int64 PrefTickMax = 0;
+		int64 PrefSnapTime = 0;
+		int64 PrefSnapMax = 0;
+		int PrefTicks = 0;
+		int PrefSnaps = 0;
 
 		m_Lastheartbeat = 0;
 		m_GameStartTime = time_get();
@@ -1326,7 +1355,7 @@ int CServer::Run()
 					// new map loaded
 					GameServer()->OnShutdown();
 
-					for(int c = 0; c < MAX_CLIENTS; c++)
+					for(int c = 0; c < MaxClients(); c++)
 					{
 						if(m_aClients[c].m_State <= CClient::STATE_AUTH)
 							continue;
@@ -1355,29 +1384,45 @@ int CServer::Run()
 				NewTicks++;
 
 				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
+				for(int c = 0; c < MaxClients(); c++)
 				{
 					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
 						continue;
-					for(int i = 0; i < 200; i++)
+					for(int i = 0; i < CClient::INPUT_HISTORY; i++)
 					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+						if(m_aClients[c].m_pInputs[i].m_GameTick == Tick())
 						{
 							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
+								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_pInputs[i].m_aData);
 							break;
 						}
 					}
 				}
 
+				int64 TickStart = time_get();
 				GameServer()->OnTick();
+				int64 TickTime = time_get()-TickStart;
+				PrefTickTime += TickTime;
+				PrefTickMax = max(PrefTickMax, TickTime);
+				PrefTicks++;
 			}
 
+			// the snapshots and everything the network sends until the next
+			// sleep go out together with as few system calls as possible
+			CNetBase::BeginSendBatch();
+
 			// snap game
 			if(NewTicks)
 			{
 				if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+				{
+					int64 SnapStart = time_get();
 					DoSnapshot();
+					int64 SnapTime = time_get()-SnapStart;
+					PrefSnapTime += SnapTime;
+					PrefSnapMax = max(PrefSnapMax, SnapTime);
+					PrefSnaps++;
+				}
 
 				UpdateClientRconCommands();
 			}
@@ -1387,8 +1432,35 @@ int CServer::Run()
 
 			PumpNetwork();
 
+			CNetBase::EndSendBatch();
+
 			if(ReportTime < time_get())
 			{
+				if(g_Config.m_DbgPref && PrefTicks && PrefSnaps)
+				{
+					str_format(aBuf, sizeof(aBuf), "tick=%dus (worst %dus) snap=%dus (worst %dus)",
+						(int)(PrefTickTime*1000000/time_freq()/PrefTicks), (int)(PrefTickMax*1000000/time_freq()),
+						(int)(PrefSnapTime*1000000/time_freq()/PrefSnaps), (int)(PrefSnapMax*1000000/time_freq()));
+					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+				}
+				PrefTickTime = 0;
+				PrefTickMax = 0;
+				PrefSnapTime = 0;
+				PrefSnapMax = 0;
+				PrefTicks = 0;
+				PrefSnaps = 0;
+
+				if(g_Config.m_Debug && m_SharedSnapTicks)
+				{
+					str_format(aBuf, sizeof(aBuf), "shared snap saved %d snap calls and %d bytes per tick, %d of %d ticks didn't fit and were snapped per client",
+						m_SharedSnapCopies/m_SharedSnapTicks, m_SharedSnapBytes/m_SharedSnapTicks, m_SharedSnapFallbacks, m_SharedSnapTicks);
+					Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+				}
+				m_SharedSnapFallbacks = 0;
+				m_SharedSnapCopies = 0;
+				m_SharedSnapBytes = 0;
+				m_SharedSnapTicks = 0;
+
 				if(g_Config.m_Debug)
 				{
 					/*
@@ -1417,7 +1489,7 @@ int CServer::Run()
 		}
 	}
 	// disconnect all clients on shutdown
-	for(int i = 0; i < MAX_CLIENTS; ++i)
+	for(int i = 0; i < MaxClients(); ++i)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			m_NetServer.Drop(i, "Server shutdown");
@@ -1430,6 +1502,12 @@ int CServer::Run()
 
 	if(m_pCurrentMapData)
 		mem_free(m_pCurrentMapData);
+
+	for(int i = 0; i < MaxClients(); ++i)
+	{
+		delete[] m_aClients[i].m_pInputs;
+		m_aClients[i].m_pInputs = 0;
+	}
 	return 0;
 }
 
@@ -1451,7 +1529,7 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	CServer* pThis = static_cast<CServer *>(pUser);
 
-	for(int i = 0; i < MAX_CLIENTS; i++)
+	for(int i = 0; i < pThis->MaxClients(); i++)
 	{
 		if(pThis->m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
@@ -1573,7 +1651,7 @@ void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserDa
 		pfnCallback(pResult, pCallbackUserData);
 		if(pInfo && OldAccessLevel != pInfo->GetAccessLevel())
 		{
-			for(int i = 0; i < MAX_CLIENTS; ++i)
+			for(int i = 0; i < pThis->MaxClients(); ++i)
 			{
 				if(pThis->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY || pThis->m_aClients[i].m_Authed != CServer::AUTHED_MOD ||
 					(pThis->m_aClients[i].m_pRconCmdToSend && str_comp(pResult->GetString(0), pThis->m_aClients[i].m_pRconCmdToSend->m_pName) >= 0))
@@ -1646,7 +1724,16 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 {
 	dbg_assert(Type >= 0 && Type <=0xffff, "incorrect type");
 	dbg_assert(ID >= 0 && ID <=0xffff, "incorrect id");
-	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(ID < 0)
+		return 0;
+	if(!m_SnapShared)
+		return m_SnapshotBuilder.NewItem(Type, ID, Size);
+
+	// all entities go into the shared snapshot, unlike into a client's one
+	void *pData = m_SharedSnapshotBuilder.NewItem(Type, ID, Size);
+	if(!pData)
+		m_SharedSnapFull = true;
+	return pData;
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
@@ -1654,6 +1741,43 @@ void CServer::SnapSetStaticsize(int ItemType, int Size)
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
 }
 
+void CServer::SnapSharedBegin()
+{
+	m_SharedSnapshotBuilder.Init();
+	m_SnapShared = true;
+	m_SharedSnapFull = false;
+}
+
+bool CServer::SnapSharedEnd()
+{
+	m_SnapShared = false;
+	if(m_SharedSnapFull)
+		m_SharedSnapFallbacks++;
+	return !m_SharedSnapFull;
+}
+
+int CServer::SnapSharedNumItems() const
+{
+	return m_SharedSnapshotBuilder.NumItems();
+}
+
+void CServer::SnapSharedCopy(int FirstItem, int NumItems)
+{
+	for(int i = FirstItem; i < FirstItem+NumItems; i++)
+	{
+		CSnapshotItem *pItem = m_SharedSnapshotBuilder.GetItem(i);
+		int Size = m_SharedSnapshotBuilder.GetItemSize(i);
+		void *pData = m_SnapshotBuilder.NewItem(pItem->Type(), pItem->ID(), Size);
+		if(!pData)
+			return;
+		mem_copy(pData, pItem->Data(), Size);
+		m_SharedSnapBytes += Size;
+	}
+
+	// every copy stands in for one Snap() call of an entity
+	m_SharedSnapCopies++;
+}
+
 static CServer *CreateServer() { return new CServer(); }
 
 int main(int argc, const char **argv) // ignore_convention
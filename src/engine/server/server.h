@@ -92,7 +92,9 @@ public:
 
 			SNAPRATE_INIT=0,
 			SNAPRATE_FULL,
-			SNAPRATE_RECOVER
+			SNAPRATE_RECOVER,
+
+			INPUT_HISTORY=200,
 		};
 
 		class CInput
@@ -112,7 +114,7 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
+		CInput *m_pInputs; // INPUT_HISTORY entries, allocated when the slot gets used first, TODO: handle input better
 		int m_CurrentInput;
 
 		char m_aName[MAX_NAME_LENGTH];
@@ -132,8 +134,31 @@ public:
 
 	CClient m_aClients[MAX_CLIENTS];
 
+	// a client snapshot from the game snapping it until it is sent
+	class CSnapJob
+	{
+	public:
+		int m_ClientID;
+		int m_DeltaTick;
+		int m_Crc;
+		CSnapshot *m_pSnap;
+		CSnapshot *m_pDeltashot;
+		const CSnapshotKeyIndex *m_pSnapIndex;
+		const CSnapshotKeyIndex *m_pDeltashotIndex;
+
+		int m_CompSize;
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	CSnapshotBuilder m_SharedSnapshotBuilder;
+	bool m_SnapShared;
+	bool m_SharedSnapFull;
+	int m_SharedSnapFallbacks;
+	int m_SharedSnapCopies;
+	int m_SharedSnapBytes;
+	int m_SharedSnapTicks;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -197,6 +222,8 @@ public:
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 
 	void DoSnapshot();
+	void CreateSnapDelta(CSnapJob *pJob);
+	void SendSnapshot(CSnapJob *pJob);
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
@@ -243,6 +270,11 @@ public:
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
 	void SnapSetStaticsize(int ItemType, int Size);
+
+	virtual void SnapSharedBegin();
+	virtual bool SnapSharedEnd();
+	virtual int SnapSharedNumItems() const;
+	virtual void SnapSharedCopy(int FirstItem, int NumItems);
 };
 
 #endif
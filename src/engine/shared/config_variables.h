@@ -69,6 +69,10 @@ MACRO_CONFIG_INT(GfxFsaaSamples, gfx_fsaa_samples, 0, 0, 16, CFGFLAG_SAVE|CFGFLA
 MACRO_CONFIG_INT(GfxRefreshRate, gfx_refresh_rate, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Screen refresh rate")
 MACRO_CONFIG_INT(GfxFinish, gfx_finish, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "")
 MACRO_CONFIG_INT(GfxAsyncRender, gfx_asyncrender, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Do rendering async from the the update")
+MACRO_CONFIG_INT(GfxBatchDraws, gfx_batch_draws, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Merge consecutive draws with the same state into one")
+MACRO_CONFIG_INT(GfxReorderWindow, gfx_reorder_window, 8, 0, 32, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Number of states draws that don't depend on their order get grouped by (0 keeps them in order)")
+MACRO_CONFIG_INT(GfxNull, gfx_null, 0, 0, 1, CFGFLAG_CLIENT, "Render without a window and only count the graphics commands (for benchmarks)")
+MACRO_CONFIG_STR(GfxNullDump, gfx_null_dump, 128, "", CFGFLAG_CLIENT, "File to write every graphics command to when rendering with gfx_null")
 
 MACRO_CONFIG_INT(InpMousesens, inp_mousesens, 100, 5, 100000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Mouse sensitivity")
 
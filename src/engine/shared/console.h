@@ -12,6 +12,7 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -87,10 +88,10 @@ class CConsole : public IConsole
 
 		CResult() : IResult()
 		{
-			mem_zero(m_aStringStorage, sizeof(m_aStringStorage));
-			m_pArgsStart = 0;
-			m_pCommand = 0;
-			mem_zero(m_apArgs, sizeof(m_apArgs));
+			// the arguments are only set up to m_NumArgs
+			m_aStringStorage[0] = 0;
+			m_pArgsStart = m_aStringStorage;
+			m_pCommand = m_aStringStorage;
 		}
 
 		CResult &operator =(const CResult &Other)
@@ -151,6 +152,19 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	enum
+	{
+		COMMAND_HASH_SIZE=512,
+	};
+
+	// commands by their lower case name, in the order of the command list
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
+	static unsigned HashName(const char *pName);
+	void AddCommandHash(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
+	void RebuildCommandHash();
+
 	void AddCommandSorted(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
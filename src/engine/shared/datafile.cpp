@@ -4,6 +4,7 @@
 #include <base/system.h>
 #include <engine/storage.h>
 #include "datafile.h"
+#include "jobs.h"
 #include <zlib.h>
 
 static const int DEBUG=0;
@@ -55,18 +56,65 @@ struct CDatafileInfo
 	char *m_pDataStart;
 };
 
+struct CDatafileBlock
+{
+	char *m_pData;
+	int m_Size;
+	int m_Mapped; // points into the mapping, nothing to free
+	int m_Cached; // unloaded, but kept until the cache runs full
+	int m_CachePrev;
+	int m_CacheNext;
+};
+
 struct CDatafile
 {
-	IOHANDLE m_File;
+	IOHANDLE m_File; // 0 if the file is mapped
+	unsigned char *m_pMapping;
+	unsigned m_MappingSize;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
 	int m_DataStartOffset;
-	char **m_ppDataPtrs;
+	CDatafileBlock *m_pBlocks;
 	char *m_pData;
+
+	// unloaded blocks, most recently unloaded first
+	int m_CacheFirst;
+	int m_CacheLast;
+	int m_CacheUsage;
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+// a block that is being loaded
+struct CDatafileLoad
+{
+	int m_Index;
+	int m_Compressed;
+	const char *m_pSrc;
+	char *m_pTemp; // compressed data read from the file
+	unsigned long m_SrcSize;
+	char *m_pDst;
+	unsigned long m_DstSize;
+	int m_Result;
+};
+
+static void Decompress(CDatafileLoad *pLoad)
+{
+	if(!pLoad->m_Compressed)
+		return;
+
+	unsigned long s = pLoad->m_DstSize;
+	pLoad->m_Result = uncompress((Bytef*)pLoad->m_pDst, &s, (const Bytef*)pLoad->m_pSrc, pLoad->m_SrcSize); // ignore_convention
+	pLoad->m_DstSize = s;
+}
+
+static void DecompressRange(int Start, int End, void *pUser)
+{
+	CDatafileLoad *pLoads = (CDatafileLoad *)pUser;
+	for(int i = Start; i < End; i++)
+		Decompress(&pLoads[i]);
+}
+
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Map)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
 
@@ -77,9 +125,23 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	unsigned FileSize = 0;
+	unsigned char *pMapping = 0;
+	if(Map)
+	{
+		long Length = io_length(File);
+		if(Length > 0)
+		{
+			FileSize = (unsigned)Length;
+			pMapping = (unsigned char *)io_map(File, FileSize);
+		}
+	}
 
 	// take the CRC of the file and store it
 	unsigned Crc = crc32(0L, 0x0, 0);
+	if(pMapping)
+		Crc = crc32(Crc, pMapping, FileSize); // ignore_convention
+	else
 	{
 		enum
 		{
@@ -102,12 +164,25 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	if(pMapping)
+	{
+		if(FileSize < sizeof(Header))
+		{
+			dbg_msg("datafile", "file too small. size=%d", FileSize);
+			io_unmap(pMapping, FileSize);
+			io_close(File);
+			return false;
+		}
+		mem_copy(&Header, pMapping, sizeof(Header));
+	}
+	else
+		io_read(File, &Header, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_unmap(pMapping, FileSize);
 			io_close(File);
 			return 0;
 		}
@@ -119,6 +194,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_unmap(pMapping, FileSize);
 		io_close(File);
 		return 0;
 	}
@@ -131,30 +207,59 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
 	Size += Header.m_ItemSize;
 
-	unsigned AllocSize = Size;
+	unsigned AllocSize = Size; // types, offsets, sizes and item data, also for mapped files
 	AllocSize += sizeof(CDatafile); // add space for info structure
-	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
+	AllocSize += Header.m_NumRawData*sizeof(CDatafileBlock); // add space for data blocks
+
+	// types, offsets, sizes and item data have to be in the mapping
+	unsigned ReadSize = Size;
+	if(pMapping && FileSize-sizeof(CDatafileHeader) < Size)
+	{
+		ReadSize = FileSize-sizeof(CDatafileHeader);
+		io_unmap(pMapping, FileSize);
+		io_close(File);
+		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
+		return false;
+	}
 
 	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
-	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
+	pTmpDataFile->m_pBlocks = (CDatafileBlock*)(pTmpDataFile+1);
+	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pBlocks+Header.m_NumRawData);
 	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pMapping = pMapping;
+	pTmpDataFile->m_MappingSize = FileSize;
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_CacheFirst = -1;
+	pTmpDataFile->m_CacheLast = -1;
+	pTmpDataFile->m_CacheUsage = 0;
 
-	// clear the data pointers
-	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
+	// clear the data blocks
+	mem_zero(pTmpDataFile->m_pBlocks, Header.m_NumRawData*sizeof(CDatafileBlock));
 
-	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
-	if(ReadSize != Size)
+	if(pMapping)
 	{
-		io_close(pTmpDataFile->m_File);
-		mem_free(pTmpDataFile);
-		pTmpDataFile = 0;
-		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
-		return false;
+		// the items stay in use as long as the file is open, keep them
+		// out of the mapping in case the file gets written over anyway
+		mem_copy(pTmpDataFile->m_pData, pMapping+sizeof(CDatafileHeader), Size);
+
+		// the mapping stays valid without the file
+		io_close(File);
+		pTmpDataFile->m_File = 0;
+	}
+	else
+	{
+		// read types, offsets, sizes and item data
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+		if(ReadSize != Size)
+		{
+			io_close(pTmpDataFile->m_File);
+			mem_free(pTmpDataFile);
+			pTmpDataFile = 0;
+			dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
+			return false;
+		}
 	}
 
 	Close();
@@ -170,6 +275,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		dbg_msg("datafile", "readsize=%d", ReadSize);
 		dbg_msg("datafile", "swaplen=%d", Header.m_Swaplen);
 		dbg_msg("datafile", "item_size=%d", m_pDataFile->m_Header.m_ItemSize);
+		dbg_msg("datafile", "mapped=%d", pMapping != 0);
 	}
 
 	m_pDataFile->m_Info.m_pItemTypes = (CDatafileItemType *)m_pDataFile->m_pData;
@@ -224,6 +330,11 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	return true;
 }
 
+bool CDataFileReader::IsMapped() const
+{
+	return m_pDataFile && m_pDataFile->m_pMapping;
+}
+
 int CDataFileReader::NumData() const
 {
 	if(!m_pDataFile) { return 0; }
@@ -240,59 +351,127 @@ int CDataFileReader::GetDataSize(int Index) const
 	return m_pDataFile->m_Info.m_pDataOffsets[Index+1]-m_pDataFile->m_Info.m_pDataOffsets[Index];
 }
 
-void *CDataFileReader::GetDataImpl(int Index, int Swap)
+int CDataFileReader::GetUncompressedDataSize(int Index) const
 {
 	if(!m_pDataFile) { return 0; }
 
-	// load it if needed
-	if(!m_pDataFile->m_ppDataPtrs[Index])
+	if(m_pDataFile->m_Header.m_Version == 4)
+		return m_pDataFile->m_Info.m_pDataSizes[Index];
+	return GetDataSize(Index);
+}
+
+// returns false if the block is there already or can't be loaded
+bool CDataFileReader::BeginLoad(int Index, CDatafileLoad *pLoad)
+{
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+	if(pBlock->m_pData)
 	{
-		// fetch the data size
-		int DataSize = GetDataSize(Index);
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		int SwapSize = DataSize;
-#endif
+		// in use again
+		if(pBlock->m_Cached)
+			CacheRemove(Index);
+		return false;
+	}
 
-		if(m_pDataFile->m_Header.m_Version == 4)
-		{
-			// v4 has compressed data
-			void *pTemp = (char *)mem_alloc(DataSize, 1);
-			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long s;
+	// fetch the data size
+	int DataSize = GetDataSize(Index);
+	int Offset = m_pDataFile->m_Info.m_pDataOffsets[Index];
+	int UncompressedSize = m_pDataFile->m_Header.m_Version == 4 ? m_pDataFile->m_Info.m_pDataSizes[Index] : DataSize;
+	if(Offset < 0 || DataSize < 0 || UncompressedSize < 0 ||
+		(m_pDataFile->m_pMapping && (int64)m_pDataFile->m_DataStartOffset+Offset+DataSize > (int64)m_pDataFile->m_MappingSize))
+	{
+		dbg_msg("datafile", "invalid data index=%d offset=%d size=%d", Index, Offset, DataSize);
+		return false;
+	}
 
-			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+	const char *pSrc = 0;
+	if(m_pDataFile->m_pMapping)
+		pSrc = (const char *)m_pDataFile->m_pMapping+m_pDataFile->m_DataStartOffset+Offset;
 
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+	pLoad->m_Index = Index;
+	pLoad->m_pTemp = 0;
+	pLoad->m_SrcSize = DataSize;
+	pLoad->m_DstSize = UncompressedSize;
+	pLoad->m_Result = Z_OK;
 
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize); // ignore_convention
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
-#endif
+	if(m_pDataFile->m_Header.m_Version == 4)
+	{
+		// v4 has compressed data
+		dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
+		if(!pSrc)
+		{
+			// read the compressed data
+			pLoad->m_pTemp = (char *)mem_alloc(DataSize, 1);
+			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+Offset, IOSEEK_START);
+			io_read(m_pDataFile->m_File, pLoad->m_pTemp, DataSize);
+			pSrc = pLoad->m_pTemp;
+		}
 
-			// clean up the temporary buffers
-			mem_free(pTemp);
+		pLoad->m_Compressed = 1;
+		pLoad->m_pSrc = pSrc;
+		pLoad->m_pDst = (char *)mem_alloc(UncompressedSize, 1);
+		pBlock->m_pData = pLoad->m_pDst;
+		pBlock->m_Size = UncompressedSize;
+	}
+	else
+	{
+		// load the data
+		dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+		pLoad->m_Compressed = 0;
+		pLoad->m_pSrc = pSrc;
+		if(pSrc && ((m_pDataFile->m_DataStartOffset+Offset)&(sizeof(int)-1)) == 0)
+		{
+			// the mapping is page aligned, so is the data
+			pBlock->m_pData = (char *)pSrc;
+			pBlock->m_Mapped = 1;
 		}
 		else
 		{
-			// load the data
-			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			pBlock->m_pData = (char *)mem_alloc(DataSize, 1);
+			if(pSrc)
+				mem_copy(pBlock->m_pData, pSrc, DataSize);
+			else
+			{
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+Offset, IOSEEK_START);
+				io_read(m_pDataFile->m_File, pBlock->m_pData, DataSize);
+			}
 		}
+		pLoad->m_pDst = pBlock->m_pData;
+		pBlock->m_Size = DataSize;
+	}
+
+	return true;
+}
+
+void CDataFileReader::EndLoad(CDatafileLoad *pLoad, int Swap)
+{
+	// clean up the temporary buffers
+	mem_free(pLoad->m_pTemp);
+	pLoad->m_pTemp = 0;
+
+	if(pLoad->m_Result != Z_OK)
+		dbg_msg("datafile", "failed to decompress data index=%d error=%d", pLoad->m_Index, pLoad->m_Result);
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
-		if(Swap && SwapSize)
-			swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize/sizeof(int));
+	if(Swap && pLoad->m_DstSize)
+		swap_endian(pLoad->m_pDst, sizeof(int), pLoad->m_DstSize/sizeof(int));
 #endif
+}
+
+void *CDataFileReader::GetDataImpl(int Index, int Swap)
+{
+	if(!m_pDataFile) { return 0; }
+	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+		return 0;
+
+	// load it if needed
+	CDatafileLoad Load;
+	if(BeginLoad(Index, &Load))
+	{
+		Decompress(&Load);
+		EndLoad(&Load, Swap);
 	}
 
-	return m_pDataFile->m_ppDataPtrs[Index];
+	return m_pDataFile->m_pBlocks[Index].m_pData;
 }
 
 void *CDataFileReader::GetData(int Index)
@@ -305,22 +484,106 @@ void *CDataFileReader::GetDataSwapped(int Index)
 	return GetDataImpl(Index, 1);
 }
 
+void CDataFileReader::LoadData(const int *pIndices, int Num, CJobPool *pPool)
+{
+	if(!m_pDataFile || Num <= 0)
+		return;
+
+	CDatafileLoad *pLoads = (CDatafileLoad *)mem_alloc(Num*sizeof(CDatafileLoad), 1);
+	int NumLoads = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pIndices[i] >= 0 && pIndices[i] < m_pDataFile->m_Header.m_NumRawData && BeginLoad(pIndices[i], &pLoads[NumLoads]))
+			NumLoads++;
+	}
+
+	if(NumLoads)
+	{
+		// decompress, on the worker threads if there are any
+		if(pPool)
+			pPool->ParallelFor(NumLoads, 1, DecompressRange, pLoads);
+		else
+			DecompressRange(0, NumLoads, pLoads);
+
+		for(int i = 0; i < NumLoads; i++)
+			EndLoad(&pLoads[i], 0);
+	}
+
+	mem_free(pLoads);
+}
+
+void CDataFileReader::CacheRemove(int Index)
+{
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+	if(pBlock->m_CachePrev != -1)
+		m_pDataFile->m_pBlocks[pBlock->m_CachePrev].m_CacheNext = pBlock->m_CacheNext;
+	else
+		m_pDataFile->m_CacheFirst = pBlock->m_CacheNext;
+	if(pBlock->m_CacheNext != -1)
+		m_pDataFile->m_pBlocks[pBlock->m_CacheNext].m_CachePrev = pBlock->m_CachePrev;
+	else
+		m_pDataFile->m_CacheLast = pBlock->m_CachePrev;
+
+	pBlock->m_Cached = 0;
+	m_pDataFile->m_CacheUsage -= pBlock->m_Size;
+}
+
+// frees the blocks that were unloaded the longest time ago until at most Size bytes are cached
+void CDataFileReader::CacheShrink(int Size)
+{
+	while(m_pDataFile->m_CacheUsage > Size && m_pDataFile->m_CacheLast != -1)
+	{
+		int Index = m_pDataFile->m_CacheLast;
+		CacheRemove(Index);
+		mem_free(m_pDataFile->m_pBlocks[Index].m_pData);
+		m_pDataFile->m_pBlocks[Index].m_pData = 0x0;
+	}
+}
+
+void CDataFileReader::SetCacheSize(int Size)
+{
+	m_CacheSize = max(Size, 0);
+	if(m_pDataFile)
+		CacheShrink(m_CacheSize);
+}
+
 void CDataFileReader::UnloadData(int Index)
 {
-	if(Index < 0)
+	if(!m_pDataFile || Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	//
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
+	// blocks in the mapping cost nothing to keep
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+	if(!pBlock->m_pData || pBlock->m_Mapped || pBlock->m_Cached)
+		return;
+
+	if(pBlock->m_Size > m_CacheSize)
+	{
+		mem_free(pBlock->m_pData);
+		pBlock->m_pData = 0x0;
+		return;
+	}
+
+	// keep it, but make room for it first
+	CacheShrink(m_CacheSize-pBlock->m_Size);
+	pBlock->m_Cached = 1;
+	pBlock->m_CachePrev = -1;
+	pBlock->m_CacheNext = m_pDataFile->m_CacheFirst;
+	if(m_pDataFile->m_CacheFirst != -1)
+		m_pDataFile->m_pBlocks[m_pDataFile->m_CacheFirst].m_CachePrev = Index;
+	else
+		m_pDataFile->m_CacheLast = Index;
+	m_pDataFile->m_CacheFirst = Index;
+	m_pDataFile->m_CacheUsage += pBlock->m_Size;
 }
 
 int CDataFileReader::GetItemSize(int Index) const
 {
 	if(!m_pDataFile) { return 0; }
+	// the offsets include the item header
 	if(Index == m_pDataFile->m_Header.m_NumItems-1)
-		return m_pDataFile->m_Header.m_ItemSize-m_pDataFile->m_Info.m_pItemOffsets[Index];
-	return m_pDataFile->m_Info.m_pItemOffsets[Index+1]-m_pDataFile->m_Info.m_pItemOffsets[Index];
+		return m_pDataFile->m_Header.m_ItemSize-m_pDataFile->m_Info.m_pItemOffsets[Index]-sizeof(CDatafileItem);
+	return m_pDataFile->m_Info.m_pItemOffsets[Index+1]-m_pDataFile->m_Info.m_pItemOffsets[Index]-sizeof(CDatafileItem);
 }
 
 void *CDataFileReader::GetItem(int Index, int *pType, int *pID)
@@ -384,9 +647,14 @@ bool CDataFileReader::Close()
 	// free the data that is loaded
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	{
+		if(!m_pDataFile->m_pBlocks[i].m_Mapped)
+			mem_free(m_pDataFile->m_pBlocks[i].m_pData);
+	}
 
-	io_close(m_pDataFile->m_File);
+	if(m_pDataFile->m_File)
+		io_close(m_pDataFile->m_File);
+	io_unmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -399,9 +667,20 @@ unsigned CDataFileReader::Crc() const
 }
 
 
+
+
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_DataFile = 0;
+	m_pStorage = 0;
+	m_aFilename[0] = 0;
+	m_aTempFilename[0] = 0;
+	m_aDataFilename[0] = 0;
+	m_pPool = 0;
+	m_CompressionLevel = COMPRESSION_DEFAULT;
+	m_NumDatas = 0;
+	m_NumWrittenDatas = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
@@ -409,6 +688,29 @@ CDataFileWriter::CDataFileWriter()
 
 CDataFileWriter::~CDataFileWriter()
 {
+	// the pool might still be compressing into the data infos
+	for(int i = m_NumWrittenDatas; i < m_NumDatas; i++)
+	{
+		if(m_pDatas[i].m_pUncompressedData)
+			m_pPool->Wait(&m_pDatas[i].m_Job);
+		mem_free(m_pDatas[i].m_pUncompressedData);
+		mem_free(m_pDatas[i].m_pCompressedData);
+	}
+	if(m_DataFile)
+	{
+		io_close(m_DataFile);
+		m_pStorage->RemoveFile(m_aDataFilename, IStorage::TYPE_SAVE);
+	}
+
+	// never finished, the old file stays as it is
+	if(m_File)
+	{
+		for(int i = 0; i < m_NumItems; i++)
+			mem_free(m_pItems[i].m_pData);
+		io_close(m_File);
+		m_pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+	}
+
 	mem_free(m_pItemTypes);
 	m_pItemTypes = 0;
 	mem_free(m_pItems);
@@ -417,15 +719,35 @@ CDataFileWriter::~CDataFileWriter()
 	m_pDatas = 0;
 }
 
-bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
+bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename, CJobPool *pPool, int CompressionLevel)
 {
 	dbg_assert(!m_File, "a file already exists");
-	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+
+	// the file gets written next to the old one and replaces it when it is complete,
+	// writing over it would pull the data from under readers that have it mapped
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+	str_format(m_aTempFilename, sizeof(m_aTempFilename), "%s.tmp", pFilename);
+	m_File = pStorage->OpenFile(m_aTempFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!m_File)
 		return false;
 
+	// the data goes to a file of its own until the header can be written
+	str_format(m_aDataFilename, sizeof(m_aDataFilename), "%s.data.tmp", pFilename);
+	m_DataFile = pStorage->OpenFile(m_aDataFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!m_DataFile)
+	{
+		io_close(m_File);
+		m_File = 0;
+		pStorage->RemoveFile(m_aTempFilename, IStorage::TYPE_SAVE);
+		return false;
+	}
+
+	m_pStorage = pStorage;
+	m_pPool = pPool;
+	m_CompressionLevel = CompressionLevel;
 	m_NumItems = 0;
 	m_NumDatas = 0;
+	m_NumWrittenDatas = 0;
 	m_NumItemTypes = 0;
 	mem_zero(m_pItemTypes, sizeof(CItemTypeInfo) * MAX_ITEM_TYPES);
 
@@ -474,6 +796,49 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems-1;
 }
 
+int CDataFileWriter::CompressThread(void *pUser)
+{
+	CDataInfo *pInfo = (CDataInfo *)pUser;
+	const void *pData = pInfo->m_pUncompressedData;
+	unsigned long s = compressBound(pInfo->m_UncompressedSize);
+	int Result = compress2((Bytef*)pInfo->m_pCompressedData, &s, (const Bytef*)pData, pInfo->m_UncompressedSize, pInfo->m_CompressionLevel); // ignore_convention
+	pInfo->m_CompressedSize = (int)s;
+	return Result;
+}
+
+// writes the compressed blocks in order, waits for the pool if more than MAX_PENDING_DATAS are left or Wait is set
+void CDataFileWriter::WriteDatas(bool Wait)
+{
+	while(m_NumWrittenDatas < m_NumDatas)
+	{
+		CDataInfo *pInfo = &m_pDatas[m_NumWrittenDatas];
+		if(pInfo->m_pUncompressedData)
+		{
+			if(pInfo->m_Job.Status() != CJob::STATE_DONE)
+			{
+				if(!Wait && m_NumDatas-m_NumWrittenDatas <= MAX_PENDING_DATAS)
+					break;
+				m_pPool->Wait(&pInfo->m_Job);
+			}
+
+			if(pInfo->m_Job.Result() != Z_OK)
+			{
+				dbg_msg("datafile", "compression error %d", pInfo->m_Job.Result());
+				dbg_assert(0, "zlib error");
+			}
+			mem_free(pInfo->m_pUncompressedData);
+			pInfo->m_pUncompressedData = 0;
+		}
+
+		if(DEBUG)
+			dbg_msg("datafile", "writing data id=%d size=%d", m_NumWrittenDatas, pInfo->m_CompressedSize);
+		io_write(m_DataFile, pInfo->m_pCompressedData, pInfo->m_CompressedSize);
+		mem_free(pInfo->m_pCompressedData);
+		pInfo->m_pCompressedData = 0;
+		m_NumWrittenDatas++;
+	}
+}
+
 int CDataFileWriter::AddData(int Size, void *pData)
 {
 	if(!m_File) return 0;
@@ -481,23 +846,32 @@ int CDataFileWriter::AddData(int Size, void *pData)
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
 	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = mem_alloc(s, 1); // temporary buffer that we use during compression
+	pInfo->m_UncompressedSize = Size;
+	pInfo->m_CompressionLevel = m_CompressionLevel;
+	pInfo->m_pCompressedData = mem_alloc(compressBound(Size), 1);
+	pInfo->m_pUncompressedData = 0;
 
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size); // ignore_convention
-	if(Result != Z_OK)
+	if(m_pPool && Size >= MIN_JOB_SIZE)
 	{
-		dbg_msg("datafile", "compression error %d", Result);
-		dbg_assert(0, "zlib error");
+		// the caller may free the data right away
+		pInfo->m_pUncompressedData = mem_alloc(Size, 1);
+		mem_copy(pInfo->m_pUncompressedData, pData, Size);
+		m_pPool->Add(&pInfo->m_Job, CompressThread, pInfo, CJobPool::PRIORITY_BACKGROUND);
+	}
+	else
+	{
+		unsigned long s = compressBound(Size);
+		int Result = compress2((Bytef*)pInfo->m_pCompressedData, &s, (Bytef*)pData, Size, m_CompressionLevel); // ignore_convention
+		if(Result != Z_OK)
+		{
+			dbg_msg("datafile", "compression error %d", Result);
+			dbg_assert(0, "zlib error");
+		}
+		pInfo->m_CompressedSize = (int)s;
 	}
-
-	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize, 1);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	mem_free(pCompData);
 
 	m_NumDatas++;
+	WriteDatas(false);
 	return m_NumDatas-1;
 }
 
@@ -527,6 +901,11 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	// the data has to be complete to know its size
+	WriteDatas(true);
+	io_close(m_DataFile);
+	m_DataFile = 0;
+
 	// we should now write this file!
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
@@ -676,23 +1055,44 @@ int CDataFileWriter::Finish()
 		}
 	}
 
-	// write data
-	for(int i = 0; i < m_NumDatas; i++)
+	// append the data
+	IOHANDLE DataFile = m_pStorage->OpenFile(m_aDataFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(DataFile)
 	{
-		if(DEBUG)
-			dbg_msg("datafile", "writing data id=%d size=%d", i, m_pDatas[i].m_CompressedSize);
-		io_write(m_File, m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
+		enum
+		{
+			BUFFER_SIZE = 64*1024
+		};
+
+		unsigned char aBuffer[BUFFER_SIZE];
+		unsigned Bytes;
+		while((Bytes = io_read(DataFile, aBuffer, BUFFER_SIZE)) > 0)
+			io_write(m_File, aBuffer, Bytes);
+		io_close(DataFile);
 	}
+	else
+		dbg_msg("datafile", "couldn't read back the data from '%s'", m_aDataFilename);
+	m_pStorage->RemoveFile(m_aDataFilename, IStorage::TYPE_SAVE);
 
 	// free data
 	for(int i = 0; i < m_NumItems; i++)
 		mem_free(m_pItems[i].m_pData);
-	for(int i = 0; i < m_NumDatas; ++i)
-		mem_free(m_pDatas[i].m_pCompressedData);
 
 	io_close(m_File);
 	m_File = 0;
 
+	// rename replaces the old file in one go, except on systems where it
+	// can't replace files, there it has to be removed first
+	if(!m_pStorage->RenameFile(m_aTempFilename, m_aFilename, IStorage::TYPE_SAVE))
+	{
+		m_pStorage->RemoveFile(m_aFilename, IStorage::TYPE_SAVE);
+		if(!m_pStorage->RenameFile(m_aTempFilename, m_aFilename, IStorage::TYPE_SAVE))
+		{
+			dbg_msg("datafile", "couldn't replace '%s', the new file is '%s'", m_aFilename, m_aTempFilename);
+			return 1;
+		}
+	}
+
 	if(DEBUG)
 		dbg_msg("datafile", "done");
 	return 0;
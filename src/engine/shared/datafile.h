@@ -3,24 +3,86 @@
 #ifndef ENGINE_SHARED_DATAFILE_H
 #define ENGINE_SHARED_DATAFILE_H
 
+#include "jobs.h"
+
 // raw datafile access
+/*
+	Class: Data File Reader
+		Reads the items and data blocks of a datafile. The file gets
+		mapped into memory if possible. The header and the items are
+		copied out of the mapping, uncompressed data blocks are handed
+		out without a copy. Compressed blocks get decompressed when
+		they are first requested. Blocks that are unloaded stay around
+		until the cache runs full, so requesting them again is cheap.
+		The mapping is private, changing items or data in place is
+		fine. Data blocks are read from the mapping until they are
+		loaded, so the file has to be replaced instead of written over
+		while it is open, which is what <Data File Writer> does.
+*/
 class CDataFileReader
 {
+	enum
+	{
+		DEFAULT_CACHE_SIZE=16*1024*1024,
+	};
+
 	struct CDatafile *m_pDataFile;
+	int m_CacheSize;
+
 	void *GetDataImpl(int Index, int Swap);
+	bool BeginLoad(int Index, struct CDatafileLoad *pLoad);
+	void EndLoad(struct CDatafileLoad *pLoad, int Swap);
+	void CacheRemove(int Index);
+	void CacheShrink(int Size);
 public:
-	CDataFileReader() : m_pDataFile(0) {}
+	CDataFileReader() : m_pDataFile(0), m_CacheSize(DEFAULT_CACHE_SIZE) {}
 	~CDataFileReader() { Close(); }
 
 	bool IsOpen() const { return m_pDataFile != 0; }
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	/*
+		Function: Open
+			Opens a datafile and reads its header and items.
+
+		Parameters:
+			pStorage - Storage to open the file from.
+			pFilename - File to open.
+			StorageType - Where to look for the file.
+			Map - Map the file into memory, the file gets read
+				into allocated buffers instead if false or if
+				mapping isn't possible.
+	*/
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Map = true);
 	bool Close();
+	bool IsMapped() const;
 
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index) const;
+	int GetUncompressedDataSize(int Index) const;
 	void UnloadData(int Index);
+
+	/*
+		Function: LoadData
+			Loads several data blocks at once, like <GetData> does,
+			and decompresses them in parallel.
+
+		Parameters:
+			pIndices - Blocks to load.
+			Num - Number of blocks.
+			pPool - Job pool to decompress on, the calling thread
+				takes a share of the work too. Everything gets
+				done on the calling thread if 0.
+	*/
+	void LoadData(const int *pIndices, int Num, class CJobPool *pPool);
+
+	/*
+		Function: SetCacheSize
+			Sets how many bytes of unloaded data blocks are kept
+			around. 0 frees blocks as soon as they are unloaded.
+	*/
+	void SetCacheSize(int Size);
+
 	void *GetItem(int Index, int *pType, int *pID);
 	int GetItemSize(int Index) const;
 	void GetType(int Type, int *pStart, int *pNum);
@@ -33,13 +95,37 @@ public:
 };
 
 // write access
+/*
+	Class: Data File Writer
+		Writes a datafile. Data blocks get compressed on the job pool
+		that is passed to <Open>, and written to a temporary file next
+		to the datafile in the order they were added as soon as they
+		are done, so only the blocks that are still being compressed
+		are kept in memory. <Finish> writes the header and the items
+		and appends the data to another temporary file, which then
+		replaces the datafile. Readers that still have the old file
+		open or mapped keep reading the old one.
+*/
 class CDataFileWriter
 {
+public:
+	enum
+	{
+		COMPRESSION_DEFAULT=-1,
+		COMPRESSION_NONE=0, // still zlib, just stored
+		COMPRESSION_FAST=1,
+		COMPRESSION_BEST=9,
+	};
+
+private:
 	struct CDataInfo
 	{
 		int m_UncompressedSize;
 		int m_CompressedSize;
+		void *m_pUncompressedData; // copy that gets compressed on the pool
 		void *m_pCompressedData;
+		int m_CompressionLevel;
+		CJob m_Job;
 	};
 
 	struct CItemInfo
@@ -64,20 +150,46 @@ class CDataFileWriter
 		MAX_ITEM_TYPES=0xffff,
 		MAX_ITEMS=1024,
 		MAX_DATAS=1024,
+		MAX_PENDING_DATAS=16, // blocks that may wait to be written
+		MIN_JOB_SIZE=4*1024, // smaller blocks get compressed right away
 	};
 
 	IOHANDLE m_File;
+	IOHANDLE m_DataFile;
+	class IStorage *m_pStorage;
+	char m_aFilename[512];
+	char m_aTempFilename[512];
+	char m_aDataFilename[512];
+	CJobPool *m_pPool;
+	int m_CompressionLevel;
 	int m_NumItems;
 	int m_NumDatas;
+	int m_NumWrittenDatas;
 	int m_NumItemTypes;
 	CItemTypeInfo *m_pItemTypes;
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 
+	static int CompressThread(void *pUser);
+	void WriteDatas(bool Wait);
+
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
-	bool Open(class IStorage *pStorage, const char *Filename);
+
+	/*
+		Function: Open
+			Creates the datafile.
+
+		Parameters:
+			pStorage - Storage to save the file to.
+			Filename - File to create.
+			pPool - Job pool to compress the data blocks on, they
+				get compressed by <AddData> itself if 0.
+			CompressionLevel - zlib compression level, one of the
+				COMPRESSION_* values or anything from 0 to 9.
+	*/
+	bool Open(class IStorage *pStorage, const char *Filename, CJobPool *pPool = 0, int CompressionLevel = COMPRESSION_DEFAULT);
 	int AddData(int Size, void *pData);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
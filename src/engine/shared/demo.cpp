@@ -23,6 +23,14 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_pKeyFrames = 0;
+	m_NumKeyFrames = 0;
+	m_MaxKeyFrames = 0;
+}
+
+CDemoRecorder::~CDemoRecorder()
+{
+	mem_free(m_pKeyFrames);
 }
 
 // Record
@@ -109,6 +117,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_NumKeyFrames = 0;
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
@@ -139,6 +148,7 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_INDEX = 0, // players that don't know it skip it
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
@@ -146,6 +156,26 @@ enum
 	CHUNKFLAG_BIGSIZE = 0x10
 };
 
+/*
+	Seek index
+		Appended by the recorder when it stops. The keyframes are
+		stored as file position and tick deltas in index chunks of
+		up to INDEX_CHUNK_KEYFRAMES keyframes each. The last chunk of
+		the file is the footer:
+			magic, position of the first index chunk,
+			number of keyframes, first tick, last tick
+		The player finds it by looking for the chunk that ends at
+		the end of the file.
+*/
+
+enum
+{
+	INDEX_MAGIC = 0x54574958, // "TWIX"
+	INDEX_CHUNK_KEYFRAMES = 1024, // keeps the chunks far below the chunk size limit
+	INDEX_FOOTER_INTS = 5,
+	INDEX_MAX_FOOTER_SIZE = 64,
+};
+
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 {
 	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
@@ -222,6 +252,19 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
 	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
 	{
+		// remember where it starts for the seek index
+		if(m_NumKeyFrames == m_MaxKeyFrames)
+		{
+			m_MaxKeyFrames = max(m_MaxKeyFrames*2, 256);
+			CKeyFrame *pKeyFrames = (CKeyFrame *)mem_alloc(m_MaxKeyFrames*sizeof(CKeyFrame), 1);
+			mem_copy(pKeyFrames, m_pKeyFrames, m_NumKeyFrames*sizeof(CKeyFrame));
+			mem_free(m_pKeyFrames);
+			m_pKeyFrames = pKeyFrames;
+		}
+		m_pKeyFrames[m_NumKeyFrames].m_Filepos = io_tell(m_File);
+		m_pKeyFrames[m_NumKeyFrames].m_Tick = Tick;
+		m_NumKeyFrames++;
+
 		// write full tickmarker
 		WriteTickMarker(Tick, 1);
 
@@ -255,11 +298,39 @@ void CDemoRecorder::RecordMessage(const void *pData, int Size)
 	Write(CHUNKTYPE_MESSAGE, pData, Size);
 }
 
+void CDemoRecorder::WriteIndex()
+{
+	if(!m_NumKeyFrames)
+		return;
+
+	int IndexPos = io_tell(m_File);
+	int aData[INDEX_CHUNK_KEYFRAMES*2];
+	CKeyFrame Last = {0, 0};
+	for(int Start = 0; Start < m_NumKeyFrames; Start += INDEX_CHUNK_KEYFRAMES)
+	{
+		int Num = min((int)INDEX_CHUNK_KEYFRAMES, m_NumKeyFrames-Start);
+		for(int i = 0; i < Num; i++)
+		{
+			// deltas pack into fewer bytes
+			const CKeyFrame *pKeyFrame = &m_pKeyFrames[Start+i];
+			aData[i*2] = pKeyFrame->m_Filepos-Last.m_Filepos;
+			aData[i*2+1] = pKeyFrame->m_Tick-Last.m_Tick;
+			Last = *pKeyFrame;
+		}
+		Write(CHUNKTYPE_INDEX, aData, Num*2*sizeof(int));
+	}
+
+	int aFooter[INDEX_FOOTER_INTS] = {INDEX_MAGIC, IndexPos, m_NumKeyFrames, m_FirstTick, m_LastTickMarker};
+	Write(CHUNKTYPE_INDEX, aFooter, sizeof(aFooter));
+}
+
 int CDemoRecorder::Stop()
 {
 	if(!m_File)
 		return -1;
 
+	WriteIndex();
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -321,6 +392,7 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_aErrorMsg[0] = 0;
 	m_pKeyFrames = 0;
+	m_TimeStep = 0;
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
@@ -387,6 +459,119 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+// decompresses a chunk of ints, returns how many there are or -1 if they don't fit
+static int DecompressInts(const void *pData, int Size, int *pOut, int MaxInts, unsigned char *pBuffer, int BufferSize)
+{
+	int DataSize = CNetBase::Decompress(pData, Size, pBuffer, BufferSize-4); // room for a truncated int
+	if(DataSize < 0)
+		return -1;
+
+	mem_zero(pBuffer+DataSize, 4);
+	const unsigned char *pSrc = pBuffer;
+	int Num = 0;
+	while(pSrc < pBuffer+DataSize)
+	{
+		if(Num == MaxInts)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, &pOut[Num++]);
+	}
+	return Num;
+}
+
+bool CDemoPlayer::ReadIndex()
+{
+	long StartPos = io_tell(m_File);
+	io_seek(m_File, 0, IOSEEK_END);
+	long EndPos = io_tell(m_File);
+	int TailSize = (int)min((long)INDEX_MAX_FOOTER_SIZE, EndPos-StartPos);
+
+	// the footer is the index chunk that ends at the end of the file
+	unsigned char aTail[INDEX_MAX_FOOTER_SIZE];
+	int aFooter[INDEX_MAX_FOOTER_SIZE];
+	int FooterPos = -1;
+	io_seek(m_File, EndPos-TailSize, IOSEEK_START);
+	if(TailSize > 0 && io_read(m_File, aTail, TailSize) == (unsigned)TailSize)
+	{
+		for(int p = 0; p < TailSize && FooterPos < 0; p++)
+		{
+			if(aTail[p]&CHUNKTYPEFLAG_TICKMARKER || ((aTail[p]&CHUNKMASK_TYPE)>>5) != CHUNKTYPE_INDEX)
+				continue;
+
+			int Size = aTail[p]&CHUNKMASK_SIZE;
+			int HeaderSize = 1;
+			if(Size == 30 && p+1 < TailSize)
+			{
+				Size = aTail[p+1];
+				HeaderSize = 2;
+			}
+			else if(Size == 31 && p+2 < TailSize)
+			{
+				Size = (aTail[p+2]<<8) | aTail[p+1];
+				HeaderSize = 3;
+			}
+			else if(Size >= 30)
+				continue;
+
+			if(p+HeaderSize+Size == TailSize && DecompressInts(&aTail[p+HeaderSize], Size, aFooter, INDEX_MAX_FOOTER_SIZE,
+				(unsigned char *)m_aDecompressedData, sizeof(m_aDecompressedData)) == INDEX_FOOTER_INTS &&
+				aFooter[0] == INDEX_MAGIC)
+				FooterPos = EndPos-TailSize+p;
+		}
+	}
+
+	int IndexPos = FooterPos >= 0 ? aFooter[1] : -1;
+	int NumKeyFrames = FooterPos >= 0 ? aFooter[2] : 0;
+	if(FooterPos < 0 || IndexPos < StartPos || IndexPos >= FooterPos || NumKeyFrames <= 0 || NumKeyFrames > FooterPos-StartPos)
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	// read the keyframes
+	int *pData = (int *)m_aChunkData;
+	CKeyFrame *pKeyFrames = (CKeyFrame*)mem_alloc(NumKeyFrames*sizeof(CKeyFrame), 1);
+	CKeyFrame Last = {0, 0};
+	int Num = 0;
+	io_seek(m_File, IndexPos, IOSEEK_START);
+	while(Num < NumKeyFrames)
+	{
+		int ChunkType, ChunkSize, ChunkTick = 0;
+		if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) || ChunkType != CHUNKTYPE_INDEX || !ChunkSize ||
+			io_read(m_File, m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+			break;
+
+		int NumInts = DecompressInts(m_aCompressedData, ChunkSize, pData, INDEX_CHUNK_KEYFRAMES*2,
+			(unsigned char *)m_aDecompressedData, sizeof(m_aDecompressedData));
+		if(NumInts <= 0 || NumInts&1 || Num+NumInts/2 > NumKeyFrames)
+			break;
+
+		bool Valid = true;
+		for(int i = 0; i < NumInts && Valid; i += 2)
+		{
+			CKeyFrame *pKeyFrame = &pKeyFrames[Num++];
+			pKeyFrame->m_Filepos = Last.m_Filepos+pData[i];
+			pKeyFrame->m_Tick = Last.m_Tick+pData[i+1];
+			Valid = pKeyFrame->m_Filepos >= StartPos && pKeyFrame->m_Filepos < IndexPos && (Num == 1 || (pKeyFrame->m_Filepos > Last.m_Filepos && pKeyFrame->m_Tick >= Last.m_Tick));
+			Last = *pKeyFrame;
+		}
+		if(!Valid)
+			break;
+	}
+
+	io_seek(m_File, StartPos, IOSEEK_START);
+	if(Num != NumKeyFrames)
+	{
+		mem_free(pKeyFrames);
+		return false;
+	}
+
+	m_pKeyFrames = pKeyFrames;
+	m_Info.m_SeekablePoints = NumKeyFrames;
+	m_Info.m_Info.m_FirstTick = aFooter[3];
+	m_Info.m_Info.m_LastTick = aFooter[4];
+	return true;
+}
+
 void CDemoPlayer::ScanFile()
 {
 	long StartPos;
@@ -447,9 +632,6 @@ void CDemoPlayer::ScanFile()
 
 void CDemoPlayer::DoTick()
 {
-	static char aCompresseddata[CSnapshot::MAX_SIZE];
-	static char aDecompressed[CSnapshot::MAX_SIZE];
-	static char aData[CSnapshot::MAX_SIZE];
 	int ChunkType, ChunkTick, ChunkSize;
 	int DataSize = 0;
 	int GotSnapshot = 0;
@@ -478,7 +660,7 @@ void CDemoPlayer::DoTick()
 		// read the chunk
 		if(ChunkSize)
 		{
-			if(io_read(m_File, aCompresseddata, ChunkSize) != (unsigned)ChunkSize)
+			if(io_read(m_File, m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
 			{
 				// stop on error or eof
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error reading chunk");
@@ -486,7 +668,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CNetBase::Decompress(aCompresseddata, ChunkSize, aDecompressed, sizeof(aDecompressed));
+			DataSize = CNetBase::Decompress(m_aCompressedData, ChunkSize, m_aDecompressedData, sizeof(m_aDecompressedData));
 			if(DataSize < 0)
 			{
 				// stop on error or eof
@@ -495,7 +677,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData);
+			DataSize = CVariableInt::Decompress(m_aDecompressedData, DataSize, m_aChunkData);
 
 			if(DataSize < 0)
 			{
@@ -508,19 +690,17 @@ void CDemoPlayer::DoTick()
 		if(ChunkType == CHUNKTYPE_DELTA)
 		{
 			// process delta snapshot
-			static char aNewsnap[CSnapshot::MAX_SIZE];
-
 			GotSnapshot = 1;
 
-			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)aNewsnap, aData, DataSize);
+			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)m_aNewSnapshotData, m_aChunkData, DataSize);
 
 			if(DataSize >= 0)
 			{
 				if(m_pListner)
-					m_pListner->OnDemoPlayerSnapshot(aNewsnap, DataSize);
+					m_pListner->OnDemoPlayerSnapshot(m_aNewSnapshotData, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewsnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnapshotData, DataSize);
 			}
 			else
 			{
@@ -535,9 +715,9 @@ void CDemoPlayer::DoTick()
 			GotSnapshot = 1;
 
 			m_LastSnapshotDataSize = DataSize;
-			mem_copy(m_aLastSnapshotData, aData, DataSize);
+			mem_copy(m_aLastSnapshotData, m_aChunkData, DataSize);
 			if(m_pListner)
-				m_pListner->OnDemoPlayerSnapshot(aData, DataSize);
+				m_pListner->OnDemoPlayerSnapshot(m_aChunkData, DataSize);
 		}
 		else
 		{
@@ -557,7 +737,7 @@ void CDemoPlayer::DoTick()
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
 				if(m_pListner)
-					m_pListner->OnDemoPlayerMessage(aData, DataSize);
+					m_pListner->OnDemoPlayerMessage(m_aChunkData, DataSize);
 			}
 		}
 	}
@@ -682,8 +862,9 @@ const char *CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole
 												((pTimelineMarker[2]<<8)&0xFF00) | (pTimelineMarker[3]&0xFF);
 	}
 
-	// scan the file for interessting points
-	ScanFile();
+	// get the interessting points from the seek index, or scan the file for them
+	if(!ReadIndex())
+		ScanFile();
 
 	// ready for playback
 	return 0;
@@ -724,13 +905,18 @@ int CDemoPlayer::SetPos(float Percent)
 	if(Keyframe < 0 || Keyframe >= m_Info.m_SeekablePoints)
 		return -1;
 
-	// get correct key frame
-	if(m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-		while(Keyframe < m_Info.m_SeekablePoints-1 && m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-			Keyframe++;
-
-	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
-		Keyframe--;
+	// get correct key frame, the last one that isn't past the wanted tick
+	int Low = 0;
+	int High = m_Info.m_SeekablePoints-1;
+	while(Low < High)
+	{
+		int Mid = (Low+High+1)/2;
+		if(m_pKeyFrames[Mid].m_Tick > WantedTick)
+			High = Mid-1;
+		else
+			Low = Mid;
+	}
+	Keyframe = Low;
 
 	// seek to the correct keyframe
 	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
@@ -757,7 +943,7 @@ void CDemoPlayer::SetSpeed(float Speed)
 int CDemoPlayer::Update()
 {
 	int64 Now = time_get();
-	int64 Deltatime = Now-m_Info.m_LastUpdate;
+	int64 Deltatime = m_TimeStep ? m_TimeStep : Now-m_Info.m_LastUpdate;
 	m_Info.m_LastUpdate = Now;
 
 	if(!IsPlaying())
@@ -783,7 +969,7 @@ int CDemoPlayer::Update()
 			// do one more tick
 			DoTick();
 
-			if(m_Info.m_Info.m_Paused)
+			if(m_Info.m_Info.m_Paused || !IsPlaying())
 				return 0;
 		}
 
@@ -818,6 +1004,7 @@ int CDemoPlayer::Stop()
 	m_File = 0;
 	mem_free(m_pKeyFrames);
 	m_pKeyFrames = 0;
+	m_TimeStep = 0;
 	str_copy(m_aFilename, "", sizeof(m_aFilename));
 	return 0;
 }
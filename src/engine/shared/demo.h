@@ -20,10 +20,22 @@ class CDemoRecorder : public IDemoRecorder
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	// keyframes for the seek index
+	struct CKeyFrame
+	{
+		int m_Filepos;
+		int m_Tick;
+	};
+	CKeyFrame *m_pKeyFrames;
+	int m_NumKeyFrames;
+	int m_MaxKeyFrames;
+
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
+	void WriteIndex();
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
+	~CDemoRecorder();
 
 	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
 	int Stop();
@@ -90,15 +102,22 @@ private:
 	CKeyFrame *m_pKeyFrames;
 
 	CPlaybackInfo m_Info;
+	int64 m_TimeStep;
 	int m_DemoType;
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 
+	// chunk buffers, per player so that players on different threads don't share them
+	char m_aCompressedData[CSnapshot::MAX_SIZE];
+	char m_aDecompressedData[CSnapshot::MAX_SIZE];
+	char m_aChunkData[CSnapshot::MAX_SIZE];
+	char m_aNewSnapshotData[CSnapshot::MAX_SIZE];
+
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
+	bool ReadIndex();
 	void ScanFile();
-	int NextFrame();
 
 public:
 
@@ -112,6 +131,8 @@ public:
 	void Unpause();
 	int Stop();
 	void SetSpeed(float Speed);
+	// every update advances the demo by TimeStep instead of the time that passed, 0 plays in real time
+	void SetTimeStep(int64 TimeStep) { m_TimeStep = TimeStep; }
 	int SetPos(float Percent);
 	const CInfo *BaseInfo() const { return &m_Info.m_Info; }
 	void GetDemoName(char *pBuffer, int BufferSize) const;
@@ -119,6 +140,7 @@ public:
 	int GetDemoType() const;
 
 	int Update();
+	int NextFrame(); // decodes the next tick right away, for processing demos without playing them
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
 	int IsPlaying() const { return m_File != 0; }
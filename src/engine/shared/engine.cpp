@@ -19,6 +19,11 @@ static int HostLookupThread(void *pUser)
 
 class CEngine : public IEngine
 {
+	enum
+	{
+		NUM_JOB_THREADS=3,
+	};
+
 public:
 	IConsole *m_pConsole;
 	IStorage *m_pStorage;
@@ -76,7 +81,7 @@ public:
 		net_init();
 		CNetBase::Init();
 
-		m_JobPool.Init(1);
+		m_JobPool.Init(NUM_JOB_THREADS);
 
 		m_Logging = false;
 	}
@@ -104,14 +109,14 @@ public:
 	{
 		str_copy(pLookup->m_aHostname, pHostname, sizeof(pLookup->m_aHostname));
 		pLookup->m_Nettype = Nettype;
-		AddJob(&pLookup->m_Job, HostLookupThread, pLookup);
+		AddJob(&pLookup->m_Job, HostLookupThread, pLookup, CJobPool::PRIORITY_BACKGROUND);
 	}
 
-	void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+	void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority)
 	{
 		if(g_Config.m_Debug)
 			dbg_msg("engine", "job added");
-		m_JobPool.Add(pJob, pfnFunc, pData);
+		m_JobPool.Add(pJob, pfnFunc, pData, Priority);
 	}
 };
 
@@ -104,9 +104,10 @@ void CHuffman::Init(const unsigned *pFrequencies)
 	// construct the tree
 	ConstructTree(pFrequencies);
 
-	// build decode LUT
+	// build decode LUT, every entry decodes as many symbols as fit into its bits
 	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
+		CDecodeEntry *pEntry = &m_aDecodeLut[i];
 		unsigned Bits = i;
 		int k;
 		CNode *pNode = m_pStartNode;
@@ -115,87 +116,118 @@ void CHuffman::Init(const unsigned *pFrequencies)
 			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
 			Bits >>= 1;
 
-			if(!pNode)
+			if(!pNode->m_NumBits)
+				continue;
+
+			// the eof symbol always ends an entry
+			if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 				break;
 
-			if(pNode->m_NumBits)
-			{
-				m_apDecodeLut[i] = pNode;
+			pEntry->m_aSymbols[pEntry->m_NumSymbols++] = pNode->m_Symbol;
+			pEntry->m_NumBits = k+1;
+			pNode = m_pStartNode;
+
+			if(pEntry->m_NumSymbols == HUFFMAN_LUTSYMBOLS)
 				break;
-			}
 		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+		// the eof symbol or a code longer than the lut, decompression continues from the node
+		if(!pEntry->m_NumSymbols)
+		{
+			pEntry->m_Node = (unsigned short)(pNode - m_aNodes);
+			pEntry->m_NumBits = k == HUFFMAN_LUTBITS ? HUFFMAN_LUTBITS : k+1;
+		}
 	}
 
 }
 
+// the bit stream is little endian, the compiler turns these into single loads and stores
+static inline uint64 LoadWord(const unsigned char *pSrc)
+{
+	return (uint64)pSrc[0] | ((uint64)pSrc[1]<<8) | ((uint64)pSrc[2]<<16) | ((uint64)pSrc[3]<<24) |
+		((uint64)pSrc[4]<<32) | ((uint64)pSrc[5]<<40) | ((uint64)pSrc[6]<<48) | ((uint64)pSrc[7]<<56);
+}
+
+static inline void StoreWord(unsigned char *pDst, uint64 Word)
+{
+	for(int i = 0; i < 8; i++)
+		pDst[i] = (unsigned char)(Word>>(i*8));
+}
+
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-	Bitcount += m_aNodes[Sym].m_NumBits;
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	while(Bitcount >= 8) \
-	{ \
-		*pDst++ = (unsigned char)(Bits&0xff); \
-		if(pDst == pDstEnd) \
-			return -1; \
-		Bits >>= 8; \
-		Bitcount -= 8; \
-	}
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// symbol variables, the bits get written out a 64 bit word at a time
+	uint64 Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	while(1)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		int Symbol = pSrc != pSrcEnd ? *pSrc++ : HUFFMAN_EOF_SYMBOL;
+		uint64 SymbolBits = m_aNodes[Symbol].m_Bits;
+		unsigned SymbolBitcount = m_aNodes[Symbol].m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		Bits |= SymbolBits << Bitcount;
+		Bitcount += SymbolBitcount;
+		if(Bitcount >= 64)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			// the output has to keep room for the last byte
+			if(pDstEnd - pDst <= 8)
+				return -1;
+			StoreWord(pDst, Bits);
+			pDst += 8;
+
+			// the part of the symbol that didn't fit into the word
+			Bitcount -= 64;
+			Bits = Bitcount ? SymbolBits >> (SymbolBitcount-Bitcount) : 0;
 		}
 
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-		HUFFMAN_MACRO_WRITE()
+		if(Symbol == HUFFMAN_EOF_SYMBOL)
+			break;
 	}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
-	HUFFMAN_MACRO_WRITE()
+	// write out the remaining full bytes
+	while(Bitcount >= 8)
+	{
+		*pDst++ = (unsigned char)(Bits&0xff);
+		if(pDst == pDstEnd)
+			return -1;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
 
 	// write out the last bits
-	*pDst++ = Bits;
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
+}
 
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
+// fills up the bits to at least 57 as long as there is input left
+static inline void FillBits(const unsigned char **ppSrc, const unsigned char *pSrcEnd, uint64 *pBits, unsigned *pBitcount)
+{
+	if(pSrcEnd - *ppSrc >= 8)
+	{
+		// bits past the bitcount already hold the same input, or are 0
+		unsigned Bytes = (63 - *pBitcount) >> 3;
+		*pBits |= LoadWord(*ppSrc) << *pBitcount;
+		*ppSrc += Bytes;
+		*pBitcount += Bytes*8;
+	}
+	else
+	{
+		while(*pBitcount <= 56 && *ppSrc != pSrcEnd)
+		{
+			*pBits |= (uint64)(*(*ppSrc)++) << *pBitcount;
+			*pBitcount += 8;
+		}
+	}
 }
 
 //***************************************************************
@@ -203,68 +235,67 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	uint64 Bits = 0;
 	unsigned Bitcount = 0;
 
 	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
-	CNode *pNode = 0;
 
 	while(1)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
-		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
-		}
-
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
+		// {A} fill with new bits
+		if(Bitcount < 32)
+			FillBits(&pSrc, pSrcEnd, &Bits, &Bitcount);
 
-		if(!pNode)
+		// {B} look up the next symbols, bits past the end of the input read as 0
+		const CDecodeEntry *pEntry = &m_aDecodeLut[Bits&HUFFMAN_LUTMASK];
+		if(pEntry->m_NumBits > Bitcount)
 			return -1;
+		Bits >>= pEntry->m_NumBits;
+		Bitcount -= pEntry->m_NumBits;
 
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		// {C} output the symbols
+		int NumSymbols = pEntry->m_NumSymbols;
+		if(NumSymbols)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			if(pDstEnd - pDst >= HUFFMAN_LUTSYMBOLS)
+			{
+				for(int i = 0; i < HUFFMAN_LUTSYMBOLS; i++)
+					pDst[i] = pEntry->m_aSymbols[i];
+			}
+			else if(pDstEnd - pDst >= NumSymbols)
+			{
+				for(int i = 0; i < NumSymbols; i++)
+					pDst[i] = pEntry->m_aSymbols[i];
+			}
+			else
+				return -1;
+			pDst += NumSymbols;
+			continue;
 		}
-		else
-		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
 
-			// walk the tree bit by bit
-			while(1)
+		// {D} the eof symbol or a longer code, walk the rest of the tree bit by bit
+		CNode *pNode = &m_aNodes[pEntry->m_Node];
+		while(!pNode->m_NumBits)
+		{
+			if(Bitcount == 0)
 			{
-				// traverse tree
-				pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
-
-				// remove bit
-				Bitcount--;
-				Bits >>= 1;
-
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
+				FillBits(&pSrc, pSrcEnd, &Bits, &Bitcount);
 
 				// no more bits, decoding error
 				if(Bitcount == 0)
 					return -1;
 			}
+
+			// traverse tree
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+
+			// remove bit
+			Bitcount--;
+			Bits >>= 1;
 		}
 
 		// check for eof
@@ -1,89 +1,314 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 #include "jobs.h"
 
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+// the worker the current thread is, 0 for threads that aren't workers
+static THREAD_LOCAL void *gs_pCurrentWorker = 0;
+
+static void SpinLock(volatile unsigned *pLock)
+{
+	while(atomic_compswap(pLock, 0, 1) != 0)
+		thread_yield();
+}
+
+static void SpinUnlock(volatile unsigned *pLock)
+{
+	atomic_compswap(pLock, 1, 0);
+}
+
 CJobPool::CJobPool()
 {
 	// empty the pool
 	m_NumThreads = 0;
+	m_pWorkers = 0;
 	m_Shutdown = false;
-	m_Lock = lock_create();
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	m_NextWorker = 0;
+	m_NumSleeping = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_init(&m_Semaphore);
+#endif
 }
 
 CJobPool::~CJobPool()
 {
 	m_Shutdown = true;
+	sync_barrier();
+#if !defined(CONF_PLATFORM_MACOSX)
+	// wake up all workers so they notice the shutdown
+	for(int i = 0; i < m_NumThreads; i++)
+		semaphore_signal(&m_Semaphore);
+#endif
 	for(int i = 0; i < m_NumThreads; i++)
 	{
-		thread_wait(m_apThreads[i]);
-		thread_destroy(m_apThreads[i]);
+		thread_wait(m_pWorkers[i].m_pThread);
+		thread_destroy(m_pWorkers[i].m_pThread);
 	}
-	lock_destroy(m_Lock);
+	for(int i = 0; i < m_NumThreads; i++)
+		for(int p = 0; p < NUM_PRIORITIES; p++)
+			lock_destroy(m_pWorkers[i].m_aQueues[p].m_Lock);
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_destroy(&m_Semaphore);
+#endif
+	mem_free(m_pWorkers);
+}
+
+CJobPool::CWorker *CJobPool::CurrentWorker() const
+{
+	CWorker *pWorker = (CWorker *)gs_pCurrentWorker;
+	return pWorker && pWorker->m_pPool == this ? pWorker : 0;
 }
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
+	gs_pCurrentWorker = pWorker;
 
 	while(!pPool->m_Shutdown)
 	{
-		CJob *pJob = 0;
-
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
+		CJob *pJob = pPool->Pop(pWorker, NUM_PRIORITIES-1);
+		if(pJob)
 		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
-			else
-				pPool->m_pLastJob = 0;
+			pPool->Run(pJob);
+			continue;
 		}
-		lock_unlock(pPool->m_Lock);
 
-		// do the job if we have one
+#if !defined(CONF_PLATFORM_MACOSX)
+		// sleep until a job gets added, look once more after counting as
+		// sleeping so a job that was added just now doesn't go unnoticed
+		atomic_inc(&pPool->m_NumSleeping);
+		pJob = pPool->Pop(pWorker, NUM_PRIORITIES-1);
+		if(!pJob && !pPool->m_Shutdown)
+			semaphore_wait(&pPool->m_Semaphore);
+		atomic_dec(&pPool->m_NumSleeping);
 		if(pJob)
+			pPool->Run(pJob);
+#else
+		thread_sleep(1);
+#endif
+	}
+}
+
+void CJobPool::Push(CJob *pJob)
+{
+	// jobs added by a worker go to its own queue, the others spread over all
+	CWorker *pWorker = CurrentWorker();
+	if(!pWorker)
+		pWorker = &m_pWorkers[atomic_inc(&m_NextWorker)%m_NumThreads];
+
+	CQueue *pQueue = &pWorker->m_aQueues[pJob->m_Priority];
+	lock_wait(pQueue->m_Lock);
+	pJob->m_pNext = 0;
+	pJob->m_pPrev = pQueue->m_pLast;
+	if(pQueue->m_pLast)
+		pQueue->m_pLast->m_pNext = pJob;
+	else
+		pQueue->m_pFirst = pJob;
+	pQueue->m_pLast = pJob;
+	lock_unlock(pQueue->m_Lock);
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	sync_barrier();
+	if(m_NumSleeping)
+		semaphore_signal(&m_Semaphore);
+#endif
+}
+
+CJob *CJobPool::Pop(CWorker *pWorker, int MaxPriority)
+{
+	int Start = pWorker ? pWorker->m_Index : (int)(m_NextWorker%m_NumThreads);
+	for(int p = 0; p <= MaxPriority; p++)
+	{
+		// the newest job of its own queue, it's likely still in the cache
+		if(pWorker && pWorker->m_aQueues[p].m_pLast)
 		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
+			CQueue *pQueue = &pWorker->m_aQueues[p];
+			lock_wait(pQueue->m_Lock);
+			CJob *pJob = pQueue->m_pLast;
+			if(pJob)
+			{
+				pQueue->m_pLast = pJob->m_pPrev;
+				if(pQueue->m_pLast)
+					pQueue->m_pLast->m_pNext = 0;
+				else
+					pQueue->m_pFirst = 0;
+			}
+			lock_unlock(pQueue->m_Lock);
+			if(pJob)
+				return pJob;
 		}
-		else
-			thread_sleep(10);
+
+		// the oldest job of another queue
+		for(int i = pWorker ? 1 : 0; i < m_NumThreads; i++)
+		{
+			CQueue *pQueue = &m_pWorkers[(Start+i)%m_NumThreads].m_aQueues[p];
+			if(!pQueue->m_pFirst)
+				continue;
+			lock_wait(pQueue->m_Lock);
+			CJob *pJob = pQueue->m_pFirst;
+			if(pJob)
+			{
+				pQueue->m_pFirst = pJob->m_pNext;
+				if(pQueue->m_pFirst)
+					pQueue->m_pFirst->m_pPrev = 0;
+				else
+					pQueue->m_pLast = 0;
+			}
+			lock_unlock(pQueue->m_Lock);
+			if(pJob)
+				return pJob;
+		}
+	}
+	return 0;
+}
+
+void CJobPool::Run(CJob *pJob)
+{
+	pJob->m_Status = CJob::STATE_RUNNING;
+	pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+
+	// take the jobs that wait for this one, nothing can be added to them afterwards
+	SpinLock(&pJob->m_ContinuationLock);
+	CJob::CContinuation *pContinuation = pJob->m_pFirstContinuation;
+	pJob->m_pFirstContinuation = 0;
+	pJob->m_ContinuationsClosed = true;
+	SpinUnlock(&pJob->m_ContinuationLock);
+
+	// the job may be gone after this
+	atomic_store_release(&pJob->m_Status, CJob::STATE_DONE);
+
+	while(pContinuation)
+	{
+		CJob *pWaiting = pContinuation->m_pJob;
+		pContinuation = pContinuation->m_pNext;
+		if(atomic_dec(&pWaiting->m_NumDependencies) == 0)
+			Push(pWaiting);
 	}
+}
 
+int CJobPool::ParallelTaskThread(void *pUser)
+{
+	CParallelTask *pTask = (CParallelTask *)pUser;
+	pTask->m_pfnFunc(pTask->m_Start, pTask->m_End, pTask->m_pData);
+	return 0;
 }
 
 int CJobPool::Init(int NumThreads)
 {
+	if(m_NumThreads)
+		return -1;
+
 	// start threads
-	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
+	m_NumThreads = max(NumThreads, 0);
+	m_pWorkers = (CWorker *)mem_alloc(max(m_NumThreads, 1)*sizeof(CWorker), 1);
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		m_pWorkers[i].m_pPool = this;
+		m_pWorkers[i].m_Index = i;
+		for(int p = 0; p < NUM_PRIORITIES; p++)
+		{
+			m_pWorkers[i].m_aQueues[p].m_Lock = lock_create();
+			m_pWorkers[i].m_aQueues[p].m_pFirst = 0;
+			m_pWorkers[i].m_aQueues[p].m_pLast = 0;
+		}
+	}
 	for(int i = 0; i < m_NumThreads; i++)
-		m_apThreads[i] = thread_init(WorkerThread, this);
+		m_pWorkers[i].m_pThread = thread_init(WorkerThread, &m_pWorkers[i]);
 	return 0;
 }
 
-int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority, CJob **ppDependencies, int NumDependencies)
 {
-	mem_zero(pJob, sizeof(CJob));
+	dbg_assert(NumDependencies <= CJob::MAX_DEPENDENCIES, "too many dependencies");
+
+	pJob->m_pPrev = 0;
+	pJob->m_pNext = 0;
+	pJob->m_Result = 0;
+	pJob->m_Priority = clamp(Priority, 0, NUM_PRIORITIES-1);
 	pJob->m_pfnFunc = pfnFunc;
 	pJob->m_pFuncData = pData;
+	pJob->m_ContinuationLock = 0;
+	pJob->m_ContinuationsClosed = false;
+	pJob->m_pFirstContinuation = 0;
+	pJob->m_Status = CJob::STATE_PENDING;
 
-	lock_wait(m_Lock);
-
-	// add job to queue
-	pJob->m_pPrev = m_pLastJob;
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = pJob;
-	if(!m_pFirstJob)
-		m_pFirstJob = pJob;
+	if(!m_NumThreads)
+	{
+		for(int i = 0; i < NumDependencies; i++)
+			Wait(ppDependencies[i]);
+		Run(pJob);
+		return 0;
+	}
 
-	lock_unlock(m_Lock);
+	// hold it back until it's added to all dependencies
+	pJob->m_NumDependencies = 1;
+	for(int i = 0; i < NumDependencies; i++)
+	{
+		CJob *pDependency = ppDependencies[i];
+		SpinLock(&pDependency->m_ContinuationLock);
+		if(!pDependency->m_ContinuationsClosed)
+		{
+			CJob::CContinuation *pContinuation = &pJob->m_aDependencies[i];
+			pContinuation->m_pJob = pJob;
+			pContinuation->m_pNext = pDependency->m_pFirstContinuation;
+			pDependency->m_pFirstContinuation = pContinuation;
+			atomic_inc(&pJob->m_NumDependencies);
+		}
+		SpinUnlock(&pDependency->m_ContinuationLock);
+	}
+	if(atomic_dec(&pJob->m_NumDependencies) == 0)
+		Push(pJob);
 	return 0;
 }
 
+void CJobPool::Wait(CJob *pJob)
+{
+	CWorker *pWorker = CurrentWorker();
+	while(pJob->Status() != CJob::STATE_DONE)
+	{
+		CJob *pOther = m_NumThreads ? Pop(pWorker, pJob->m_Priority) : 0;
+		if(pOther)
+			Run(pOther);
+		else
+			thread_yield();
+	}
+}
+
+void CJobPool::ParallelFor(int Num, int MinRange, PARALLELFUNC pfnFunc, void *pData, int Priority)
+{
+	if(Num <= 0)
+		return;
+
+	int NumTasks = min((m_NumThreads+1)*TASKS_PER_THREAD, (int)MAX_PARALLEL_TASKS);
+	NumTasks = min(NumTasks, (Num+max(MinRange, 1)-1)/max(MinRange, 1));
+	if(!m_NumThreads || NumTasks <= 1)
+	{
+		pfnFunc(0, Num, pData);
+		return;
+	}
+
+	CParallelTask aTasks[MAX_PARALLEL_TASKS];
+	for(int t = 0; t < NumTasks; t++)
+	{
+		aTasks[t].m_pfnFunc = pfnFunc;
+		aTasks[t].m_pData = pData;
+		aTasks[t].m_Start = (int)((int64)Num*t/NumTasks);
+		aTasks[t].m_End = (int)((int64)Num*(t+1)/NumTasks);
+	}
+
+	// the calling thread takes the first range and helps with the others
+	for(int t = 1; t < NumTasks; t++)
+		Add(&aTasks[t].m_Job, ParallelTaskThread, &aTasks[t], Priority);
+	pfnFunc(aTasks[0].m_Start, aTasks[0].m_End, pData);
+	for(int t = 1; t < NumTasks; t++)
+		Wait(&aTasks[t].m_Job);
+}
@@ -2,27 +2,58 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+
+#include <base/system.h>
+
 typedef int (*JOBFUNC)(void *pData);
+typedef void (*PARALLELFUNC)(int Start, int End, void *pData);
 
 class CJobPool;
 
+/*
+	Class: CJob
+		A unit of work for a <CJobPool> and the future of its result.
+		The job has to stay alive until its status is STATE_DONE.
+*/
 class CJob
 {
 	friend class CJobPool;
 
+	enum
+	{
+		MAX_DEPENDENCIES=4,
+	};
+
+	// links a job to one it waits for
+	struct CContinuation
+	{
+		CJob *m_pJob;
+		CContinuation *m_pNext;
+	};
+
 	CJob *m_pPrev;
 	CJob *m_pNext;
 
 	volatile int m_Status;
 	volatile int m_Result;
+	int m_Priority;
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
+
+	volatile unsigned m_NumDependencies; // jobs it still waits for
+	volatile unsigned m_ContinuationLock;
+	bool m_ContinuationsClosed; // done or finishing, nothing can wait for it anymore
+	CContinuation *m_pFirstContinuation; // jobs that wait for this one
+	CContinuation m_aDependencies[MAX_DEPENDENCIES];
 public:
 	CJob()
 	{
 		m_Status = STATE_DONE;
 		m_pFuncData = 0;
+		m_ContinuationLock = 0;
+		m_ContinuationsClosed = true;
+		m_pFirstContinuation = 0;
 	}
 
 	enum
@@ -32,31 +63,121 @@ public:
 		STATE_DONE
 	};
 
-	int Status() const { return m_Status; }
-	int Result() const {return m_Result; }
+	int Status() const { return atomic_load_acquire(&m_Status); }
+	int Result() const { return m_Result; }
 };
 
+/*
+	Class: CJobPool
+		Runs jobs on worker threads. Every worker has a queue per
+		priority, it takes its newest job first and steals the oldest
+		ones of the other workers when it has none left. Idle workers
+		sleep until jobs get added.
+
+		Threads that wait for a job with <Wait> help with the work in
+		the meantime, so jobs can wait for other jobs and the calling
+		thread is never idle.
+*/
 class CJobPool
 {
+public:
 	enum
 	{
-		MAX_THREADS=32
+		PRIORITY_HIGH=0, // the current tick waits for it, like snapshots
+		PRIORITY_NORMAL,
+		PRIORITY_BACKGROUND, // loading, saving and lookups
+		NUM_PRIORITIES,
+
+		MAX_PARALLEL_TASKS=64,
 	};
+
+private:
+	enum
+	{
+		TASKS_PER_THREAD=4, // more tasks than threads evens out uneven work
+	};
+
+	struct CQueue
+	{
+		LOCK m_Lock;
+		CJob *m_pFirst;
+		CJob *m_pLast;
+	};
+
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		int m_Index;
+		void *m_pThread;
+		CQueue m_aQueues[NUM_PRIORITIES];
+	};
+
+	struct CParallelTask
+	{
+		CJob m_Job;
+		PARALLELFUNC m_pfnFunc;
+		void *m_pData;
+		int m_Start;
+		int m_End;
+	};
+
 	int m_NumThreads;
-	void *m_apThreads[MAX_THREADS];
+	CWorker *m_pWorkers;
 	volatile bool m_Shutdown;
-
-	LOCK m_Lock;
-	CJob *m_pFirstJob;
-	CJob *m_pLastJob;
+	volatile unsigned m_NextWorker;
+	volatile unsigned m_NumSleeping;
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE m_Semaphore;
+#endif
 
 	static void WorkerThread(void *pUser);
+	static int ParallelTaskThread(void *pUser);
+
+	CWorker *CurrentWorker() const;
+	void Push(CJob *pJob);
+	CJob *Pop(CWorker *pWorker, int MaxPriority);
+	void Run(CJob *pJob);
 
 public:
 	CJobPool();
 	~CJobPool();
 
 	int Init(int NumThreads);
-	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	int NumThreads() const { return m_NumThreads; }
+
+	/*
+		Function: Add
+			Adds a job. Without threads it runs right away.
+
+		Parameters:
+			pJob - The job, it has to stay alive until it's done.
+			pfnFunc - Function that does the work, its return value is the result of the job.
+			pData - Passed to the function.
+			Priority - One of the PRIORITY_* values.
+			ppDependencies - Jobs that have to be done before this one starts, up to 4.
+			NumDependencies - Number of them.
+	*/
+	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, int Priority = PRIORITY_NORMAL, CJob **ppDependencies = 0, int NumDependencies = 0);
+
+	/*
+		Function: Wait
+			Waits for a job to be done, running other jobs of the same or a
+			higher priority in the meantime.
+	*/
+	void Wait(CJob *pJob);
+
+	/*
+		Function: ParallelFor
+			Calls pfnFunc for ranges of [0, Num) on the workers and the
+			calling thread and returns when all are done.
+
+		Parameters:
+			Num - Size of the range.
+			MinRange - Smallest range a call gets, keeps small work from being split up.
+			pfnFunc - Function that works on a range.
+			pData - Passed to the function.
+			Priority - One of the PRIORITY_* values.
+	*/
+	void ParallelFor(int Num, int MinRange, PARALLELFUNC pfnFunc, void *pData, int Priority = PRIORITY_NORMAL);
 };
 #endif
@@ -1,20 +1,45 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/map.h>
 #include <engine/storage.h>
 #include <game/mapitems.h>
 #include "datafile.h"
+#include "jobs.h"
 
 class CMap : public IEngineMap
 {
+	enum
+	{
+		NUM_LOAD_THREADS=3,
+	};
+
 	CDataFileReader m_DataFile;
+	CJobPool *m_pPool;
+	CJobPool m_LoadPool; // for tools without an engine
 public:
-	CMap() {}
+	CMap() { m_pPool = 0; }
 
 	virtual void *GetData(int Index) { return m_DataFile.GetData(Index); }
 	virtual void *GetDataSwapped(int Index) { return m_DataFile.GetDataSwapped(Index); }
 	virtual void UnloadData(int Index) { m_DataFile.UnloadData(Index); }
+	virtual void LoadData(const int *pIndices, int Num)
+	{
+		// share the engine's workers, own threads are only started once they are needed
+		if(!m_pPool)
+		{
+			IEngine *pEngine = Kernel() ? Kernel()->RequestInterface<IEngine>() : 0;
+			if(pEngine)
+				m_pPool = pEngine->JobPool();
+			else
+			{
+				m_LoadPool.Init(NUM_LOAD_THREADS);
+				m_pPool = &m_LoadPool;
+			}
+		}
+		m_DataFile.LoadData(pIndices, Num, m_pPool);
+	}
 	virtual void *GetItem(int Index, int *pType, int *pID) { return m_DataFile.GetItem(Index, pType, pID); }
 	virtual void GetType(int Type, int *pStart, int *pNum) { m_DataFile.GetType(Type, pStart, pNum); }
 	virtual void *FindItem(int Type, int ID) { return m_DataFile.FindItem(Type, ID); }
@@ -19,110 +19,183 @@ bool CNetBan::StrAllnum(const char *pStr)
 }
 
 
-CNetBan::CNetHash::CNetHash(const NETADDR *pAddr)
+template<class T>
+CNetBan::CBanList<T>::CBanList()
 {
-	if(pAddr->type==NETTYPE_IPV4)
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3])&0xFF;
-	else
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3]+pAddr->ip[4]+pAddr->ip[5]+pAddr->ip[6]+pAddr->ip[7]+
-			pAddr->ip[8]+pAddr->ip[9]+pAddr->ip[10]+pAddr->ip[11]+pAddr->ip[12]+pAddr->ip[13]+pAddr->ip[14]+pAddr->ip[15])&0xFF;
-	m_HashIndex = 0;
+	mem_zero(m_apWheel, sizeof(m_apWheel));
+	m_pFirstUsed = 0;
+	m_pLastUsed = 0;
+	m_CountUsed = 0;
 }
 
-CNetBan::CNetHash::CNetHash(const CNetRange *pRange)
+template<class T>
+CNetBan::CBanList<T>::~CBanList()
 {
-	m_Hash = 0;
-	m_HashIndex = 0;
-	for(int i = 0; pRange->m_LB.ip[i] == pRange->m_UB.ip[i]; ++i)
-	{
-		m_Hash += pRange->m_LB.ip[i];
-		++m_HashIndex;
-	}
-	m_Hash &= 0xFF;
+	Clear();
 }
 
-int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+template<class T>
+void CNetBan::CBanList<T>::LinkWheel(CBan<T> *pBan)
 {
-	int Length = pAddr->type==NETTYPE_IPV4 ? 4 : 16;
-	aHash[0].m_Hash = 0;
-	aHash[0].m_HashIndex = 0;
-	for(int i = 1, Sum = 0; i <= Length; ++i)
-	{
-		Sum += pAddr->ip[i-1];
-		aHash[i].m_Hash = Sum&0xFF;
-		aHash[i].m_HashIndex = i%Length;
-	}
-	return Length;
-}
+	pBan->m_pWheelPrev = 0;
+	pBan->m_pWheelNext = 0;
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+		return;
 
+	CBan<T> **ppSlot = &m_apWheel[pBan->m_Info.m_Expires&(WHEEL_SIZE-1)];
+	pBan->m_pWheelNext = *ppSlot;
+	if(*ppSlot)
+		(*ppSlot)->m_pWheelPrev = pBan;
+	*ppSlot = pBan;
+}
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo,  const CNetHash *pNetHash)
+template<class T>
+void CNetBan::CBanList<T>::UnlinkWheel(CBan<T> *pBan)
 {
-	if(!m_pFirstFree)
-		return 0;
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+		return;
 
+	if(pBan->m_pWheelNext)
+		pBan->m_pWheelNext->m_pWheelPrev = pBan->m_pWheelPrev;
+	if(pBan->m_pWheelPrev)
+		pBan->m_pWheelPrev->m_pWheelNext = pBan->m_pWheelNext;
+	else
+		m_apWheel[pBan->m_Info.m_Expires&(WHEEL_SIZE-1)] = pBan->m_pWheelNext;
+	pBan->m_pWheelNext = pBan->m_pWheelPrev = 0;
+}
+
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanList<T>::Link(const T *pData, const CBanInfo *pInfo)
+{
 	// create new ban
-	CBan<T> *pBan = m_pFirstFree;
+	CBan<T> *pBan = new CBan<T>;
 	pBan->m_Data = *pData;
 	pBan->m_Info = *pInfo;
-	pBan->m_NetHash = *pNetHash;
+	pBan->m_pHashNext = pBan->m_pHashPrev = 0;
+	pBan->m_FirstEntry = -1;
+
+	// append it to the used list
+	pBan->m_pNext = 0;
+	pBan->m_pPrev = m_pLastUsed;
+	if(m_pLastUsed)
+		m_pLastUsed->m_pNext = pBan;
+	else
+		m_pFirstUsed = pBan;
+	m_pLastUsed = pBan;
+
+	LinkWheel(pBan);
+
+	// update ban count
+	++m_CountUsed;
+
+	return pBan;
+}
+
+template<class T>
+void CNetBan::CBanList<T>::Unlink(CBan<T> *pBan)
+{
+	UnlinkWheel(pBan);
+
+	// remove from used list
 	if(pBan->m_pNext)
 		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
+	else
+		m_pLastUsed = pBan->m_pPrev;
 	if(pBan->m_pPrev)
 		pBan->m_pPrev->m_pNext = pBan->m_pNext;
 	else
-		m_pFirstFree = pBan->m_pNext;
+		m_pFirstUsed = pBan->m_pNext;
 
-	// add it to the hash list
-	if(m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash])
-		m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]->m_pHashPrev = pBan;
-	pBan->m_pHashPrev = 0;
-	pBan->m_pHashNext = m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash];
-	m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash] = pBan;
-
-	// insert it into the used list
-	if(m_pFirstUsed)
+	// update ban count
+	--m_CountUsed;
+
+	delete pBan;
+}
+
+template<class T>
+void CNetBan::CBanList<T>::Update(CBan<T> *pBan, const CBanInfo *pInfo)
+{
+	// move it to the slot of its new expire time
+	UnlinkWheel(pBan);
+	pBan->m_Info = *pInfo;
+	LinkWheel(pBan);
+}
+
+template<class T>
+void CNetBan::CBanList<T>::Clear()
+{
+	while(m_pFirstUsed)
 	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
-		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
-			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
-			}
+		CBan<T> *pBan = m_pFirstUsed;
+		m_pFirstUsed = pBan->m_pNext;
+		delete pBan;
+	}
 
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
-		}
+	mem_zero(m_apWheel, sizeof(m_apWheel));
+	m_pLastUsed = 0;
+	m_CountUsed = 0;
+}
+
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanList<T>::Get(int Index) const
+{
+	if(Index < 0 || Index >= Num())
+		return 0;
+
+	for(CNetBan::CBan<T> *pBan = m_pFirstUsed; pBan; pBan = pBan->m_pNext, --Index)
+	{
+		if(Index == 0)
+			return pBan;
 	}
-	else
+
+	return 0;
+}
+
+template class CNetBan::CBanList<NETADDR>;
+template class CNetBan::CBanList<CNetRange>;
+
+
+CNetBan::CBanAddrPool::CBanAddrPool()
+{
+	Rehash(MIN_HASH_SIZE);
+}
+
+void CNetBan::CBanAddrPool::Rehash(int Size)
+{
+	m_apHash.set_size(Size);
+	for(int i = 0; i < Size; i++)
+		m_apHash[i] = 0;
+
+	for(CBanAddr *pBan = First(); pBan; pBan = pBan->m_pNext)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		CBanAddr **ppBucket = &m_apHash[Hash(&pBan->m_Data)&(Size-1)];
+		pBan->m_pHashPrev = 0;
+		pBan->m_pHashNext = *ppBucket;
+		if(*ppBucket)
+			(*ppBucket)->m_pHashPrev = pBan;
+		*ppBucket = pBan;
 	}
+}
 
-	// update ban count
-	++m_CountUsed;
+CNetBan::CBanAddr *CNetBan::CBanAddrPool::Add(const NETADDR *pData, const CBanInfo *pInfo)
+{
+	// keep the chains short
+	if(Num() >= m_apHash.size())
+		Rehash(m_apHash.size()*2);
+
+	CBanAddr *pBan = Link(pData, pInfo);
+
+	// add it to the hash list
+	CBanAddr **ppBucket = &m_apHash[Hash(pData)&(m_apHash.size()-1)];
+	pBan->m_pHashNext = *ppBucket;
+	if(*ppBucket)
+		(*ppBucket)->m_pHashPrev = pBan;
+	*ppBucket = pBan;
 
 	return pBan;
 }
 
-template<class T, int HashCount>
-int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
+int CNetBan::CBanAddrPool::Remove(CBanAddr *pBan)
 {
 	if(pBan == 0)
 		return -1;
@@ -133,112 +206,255 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 	if(pBan->m_pHashPrev)
 		pBan->m_pHashPrev->m_pHashNext = pBan->m_pHashNext;
 	else
-		m_paaHashList[pBan->m_NetHash.m_HashIndex][pBan->m_NetHash.m_Hash] = pBan->m_pHashNext;
-	pBan->m_pHashNext = pBan->m_pHashPrev = 0;
+		m_apHash[Hash(&pBan->m_Data)&(m_apHash.size()-1)] = pBan->m_pHashNext;
 
-	// remove from used list
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstUsed = pBan->m_pNext;
+	Unlink(pBan);
+	return 0;
+}
 
-	// add to recycle list
-	if(m_pFirstFree)
-		m_pFirstFree->m_pPrev = pBan;
-	pBan->m_pPrev = 0;
-	pBan->m_pNext = m_pFirstFree;
-	m_pFirstFree = pBan;
+void CNetBan::CBanAddrPool::Reset()
+{
+	Clear();
+	Rehash(MIN_HASH_SIZE);
+}
 
-	// update ban count
-	--m_CountUsed;
 
-	return 0;
+static int AddrBits(const NETADDR *pAddr)
+{
+	return pAddr->type==NETTYPE_IPV4 ? 32 : 128;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
+static int AddrBit(const NETADDR *pAddr, int Bit)
 {
-	pBan->m_Info = *pInfo;
+	return (pAddr->ip[Bit>>3]>>(7-(Bit&7)))&1;
+}
 
-	// remove from used list
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstUsed = pBan->m_pNext;
+static int AddrNibble(const NETADDR *pAddr, int Bit)
+{
+	return (pAddr->ip[Bit>>3]>>(4-(Bit&4)))&0xf;
+}
+
+// the bits from the returned one on are all equal to Value
+static int AddrTailStart(const NETADDR *pAddr, int Value)
+{
+	int Bit = AddrBits(pAddr);
+	while(Bit > 0 && AddrBit(pAddr, Bit-1) == Value)
+		Bit--;
+	return Bit;
+}
+
+// the prefix up to Depth lies in the range once it's off the bounds or
+// the bounds only go on with zeros (lower) or ones (upper)
+static bool PrefixInRange(int Depth, bool LowerBound, bool UpperBound, int LowerEnd, int UpperEnd)
+{
+	return (!LowerBound || Depth >= LowerEnd) && (!UpperBound || Depth >= UpperEnd);
+}
+
+CNetBan::CBanRangePool::CBanRangePool()
+{
+	Reset();
+}
 
-	// insert it into the used list
-	if(m_pFirstUsed)
+int CNetBan::CBanRangePool::NewNode(int Parent)
+{
+	CNode Node;
+	for(int i = 0; i < NODE_SIZE; i++)
+		Node.m_aChildren[i] = -1;
+	Node.m_Parent = Parent;
+	Node.m_FirstEntry = -1;
+	Node.m_CoverMask = 0;
+
+	if(m_FirstFreeNode < 0)
+		return m_aNodes.add(Node);
+
+	int Index = m_FirstFreeNode;
+	m_FirstFreeNode = m_aNodes[Index].m_Parent;
+	m_aNodes[Index] = Node;
+	return Index;
+}
+
+void CNetBan::CBanRangePool::FreeNode(int Node)
+{
+	// drop the node and all parents that are no longer needed
+	while(Node >= NUM_ROOTS && m_aNodes[Node].m_FirstEntry < 0)
 	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
+		for(int i = 0; i < NODE_SIZE; i++)
 		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
-			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
-			}
+			if(m_aNodes[Node].m_aChildren[i] >= 0)
+				return;
+		}
 
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
+		int Parent = m_aNodes[Node].m_Parent;
+		for(int i = 0; i < NODE_SIZE; i++)
+		{
+			if(m_aNodes[Parent].m_aChildren[i] == Node)
+				m_aNodes[Parent].m_aChildren[i] = -1;
 		}
+
+		m_aNodes[Node].m_Parent = m_FirstFreeNode;
+		m_FirstFreeNode = Node;
+		Node = Parent;
 	}
+}
+
+void CNetBan::CBanRangePool::Attach(CBanRange *pBan, int Node, unsigned CoverMask)
+{
+	CEntry Entry;
+	Entry.m_pBan = pBan;
+	Entry.m_Node = Node;
+	Entry.m_CoverMask = CoverMask;
+	Entry.m_NextInNode = m_aNodes[Node].m_FirstEntry;
+	Entry.m_PrevInNode = -1;
+	Entry.m_NextOfBan = pBan->m_FirstEntry;
+
+	int Index;
+	if(m_FirstFreeEntry < 0)
+		Index = m_aEntries.add(Entry);
 	else
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		Index = m_FirstFreeEntry;
+		m_FirstFreeEntry = m_aEntries[Index].m_NextOfBan;
+		m_aEntries[Index] = Entry;
 	}
+
+	if(Entry.m_NextInNode >= 0)
+		m_aEntries[Entry.m_NextInNode].m_PrevInNode = Index;
+	m_aNodes[Node].m_FirstEntry = Index;
+	m_aNodes[Node].m_CoverMask |= CoverMask;
+	pBan->m_FirstEntry = Index;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Reset()
+void CNetBan::CBanRangePool::Insert(CBanRange *pBan, int Node, int Depth, bool LowerBound, bool UpperBound, int LowerEnd, int UpperEnd)
 {
-	mem_zero(m_paaHashList, sizeof(m_paaHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
-	m_pFirstUsed = 0;
-	m_CountUsed = 0;
+	int LowerNibble = LowerBound ? AddrNibble(&pBan->m_Data.m_LB, Depth) : 0;
+	int UpperNibble = UpperBound ? AddrNibble(&pBan->m_Data.m_UB, Depth) : NODE_SIZE-1;
+	unsigned CoverMask = 0;
+	for(int Nibble = LowerNibble; Nibble <= UpperNibble; Nibble++)
+	{
+		bool ChildLowerBound = LowerBound && Nibble == LowerNibble;
+		bool ChildUpperBound = UpperBound && Nibble == UpperNibble;
+		if(PrefixInRange(Depth+NODE_BITS, ChildLowerBound, ChildUpperBound, LowerEnd, UpperEnd))
+			CoverMask |= 1<<Nibble;
+		else
+		{
+			if(m_aNodes[Node].m_aChildren[Nibble] < 0)
+			{
+				int Child = NewNode(Node);
+				m_aNodes[Node].m_aChildren[Nibble] = Child;
+			}
+			Insert(pBan, m_aNodes[Node].m_aChildren[Nibble], Depth+NODE_BITS, ChildLowerBound, ChildUpperBound, LowerEnd, UpperEnd);
+		}
+	}
+
+	if(CoverMask)
+		Attach(pBan, Node, CoverMask);
+}
+
+CNetBan::CBanRange *CNetBan::CBanRangePool::Add(const CNetRange *pData, const CBanInfo *pInfo)
+{
+	CBanRange *pBan = Link(pData, pInfo);
+	Insert(pBan, pData->m_LB.type==NETTYPE_IPV4 ? ROOT_IPV4 : ROOT_IPV6, 0, true, true, AddrTailStart(&pData->m_LB, 0), AddrTailStart(&pData->m_UB, 1));
+	return pBan;
+}
+
+int CNetBan::CBanRangePool::Remove(CBanRange *pBan)
+{
+	if(pBan == 0)
+		return -1;
 
-	for(int i = 1; i < MAX_BANS-1; ++i)
+	// detach it from all its nodes
+	while(pBan->m_FirstEntry >= 0)
 	{
-		m_aBans[i].m_pNext = &m_aBans[i+1];
-		m_aBans[i].m_pPrev = &m_aBans[i-1];
+		int Index = pBan->m_FirstEntry;
+		CEntry *pEntry = &m_aEntries[Index];
+		CNode *pNode = &m_aNodes[pEntry->m_Node];
+		if(pEntry->m_NextInNode >= 0)
+			m_aEntries[pEntry->m_NextInNode].m_PrevInNode = pEntry->m_PrevInNode;
+		if(pEntry->m_PrevInNode >= 0)
+			m_aEntries[pEntry->m_PrevInNode].m_NextInNode = pEntry->m_NextInNode;
+		else
+			pNode->m_FirstEntry = pEntry->m_NextInNode;
+
+		pNode->m_CoverMask = 0;
+		for(int i = pNode->m_FirstEntry; i >= 0; i = m_aEntries[i].m_NextInNode)
+			pNode->m_CoverMask |= m_aEntries[i].m_CoverMask;
+
+		pBan->m_FirstEntry = pEntry->m_NextOfBan;
+		pEntry->m_NextOfBan = m_FirstFreeEntry;
+		m_FirstFreeEntry = Index;
+
+		FreeNode(pEntry->m_Node);
 	}
 
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS-1].m_pPrev = &m_aBans[MAX_BANS-2];
-	m_pFirstFree = &m_aBans[0];
+	Unlink(pBan);
+	return 0;
 }
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Get(int Index) const
+void CNetBan::CBanRangePool::Reset()
 {
-	if(Index < 0 || Index >= Num())
-		return 0;
+	Clear();
+	m_aNodes.clear();
+	m_aEntries.clear();
+	m_FirstFreeNode = -1;
+	m_FirstFreeEntry = -1;
+	for(int i = 0; i < NUM_ROOTS; i++)
+		NewNode(-1);
+}
 
-	for(CNetBan::CBan<T> *pBan = m_pFirstUsed; pBan; pBan = pBan->m_pNext, --Index)
+CNetBan::CBanRange *CNetBan::CBanRangePool::Find(const CNetRange *pData) const
+{
+	// the part of the range that starts at its lower bound is in the node
+	// where the lower bound path first lies in the range
+	int LowerEnd = AddrTailStart(&pData->m_LB, 0);
+	int UpperEnd = AddrTailStart(&pData->m_UB, 1);
+	int Node = pData->m_LB.type==NETTYPE_IPV4 ? ROOT_IPV4 : ROOT_IPV6;
+	bool UpperBound = true;
+	for(int Depth = 0; Node >= 0; Depth += NODE_BITS)
 	{
-		if(Index == 0)
-			return pBan;
+		int Nibble = AddrNibble(&pData->m_LB, Depth);
+		UpperBound = UpperBound && Nibble == AddrNibble(&pData->m_UB, Depth);
+		if(PrefixInRange(Depth+NODE_BITS, true, UpperBound, LowerEnd, UpperEnd))
+		{
+			for(int i = m_aNodes[Node].m_FirstEntry; i >= 0; i = m_aEntries[i].m_NextInNode)
+			{
+				if(NetComp(&m_aEntries[i].m_pBan->m_Data, pData) == 0)
+					return m_aEntries[i].m_pBan;
+			}
+			return 0;
+		}
+
+		Node = m_aNodes[Node].m_aChildren[Nibble];
 	}
 
 	return 0;
 }
 
+CNetBan::CBanRange *CNetBan::CBanRangePool::Match(const NETADDR *pAddr) const
+{
+	int Bits = AddrBits(pAddr);
+	int Node = pAddr->type==NETTYPE_IPV4 ? ROOT_IPV4 : ROOT_IPV6;
+	int MatchNode = -1, MatchNibble = 0;
+	for(int Depth = 0; Node >= 0 && Depth < Bits; Depth += NODE_BITS)
+	{
+		const CNode *pNode = &m_aNodes[Node];
+		int Nibble = AddrNibble(pAddr, Depth);
+		if(pNode->m_CoverMask&(1<<Nibble))
+		{
+			MatchNode = Node;
+			MatchNibble = Nibble;
+		}
+		Node = pNode->m_aChildren[Nibble];
+	}
+
+	if(MatchNode < 0)
+		return 0;
+	for(int i = m_aNodes[MatchNode].m_FirstEntry; ; i = m_aEntries[i].m_NextInNode)
+	{
+		if(m_aEntries[i].m_CoverMask&(1<<MatchNibble))
+			return m_aEntries[i].m_pBan;
+	}
+}
+
 
 template<class T>
 void CNetBan::MakeBanInfo(const CBan<T> *pBan, char *pBuf, unsigned BuffSize, int Type) const
@@ -300,9 +516,11 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	Info.m_Expires = Stamp;
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
+	// addresses that weren't banned so far might be now
+	m_Generation++;
+
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		// adjust the ban
@@ -314,24 +532,17 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	}
 
 	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
-	if(pBan)
-	{
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
-	}
-	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+	pBan = pBanPool->Add(pData, &Info);
+	char aBuf[128];
+	MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return 0;
 }
 
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		char aBuf[256];
@@ -345,10 +556,29 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 	return -1;
 }
 
+template<class T>
+void CNetBan::Expire(T *pBanPool, int Second, int Now)
+{
+	char aBuf[256], aNetStr[256];
+	CBan<typename T::CDataType> *pNext;
+	for(CBan<typename T::CDataType> *pBan = pBanPool->FirstInSlot(Second); pBan; pBan = pNext)
+	{
+		pNext = pBan->m_pWheelNext;
+		if(pBan->m_Info.m_Expires < Now)
+		{
+			str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&pBan->m_Data, aNetStr, sizeof(aNetStr)));
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+			pBanPool->Remove(pBan);
+		}
+	}
+}
+
 void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 {
 	m_pConsole = pConsole;
 	m_pStorage = pStorage;
+	m_Generation = 1;
+	m_ExpireCheck = time_timestamp();
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
 
@@ -368,19 +598,14 @@ void CNetBan::Update()
 {
 	int Now = time_timestamp();
 
-	// remove expired bans
-	char aBuf[256], aNetStr[256];
-	while(m_BanAddrPool.First() && m_BanAddrPool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanAddrPool.First()->m_Info.m_Expires < Now)
+	// remove expired bans, each second of the wheel is checked once when
+	// it has passed. bans further ahead than a turn stay in their slot
+	if(Now-m_ExpireCheck > CBanAddrPool::WHEEL_SIZE)
+		m_ExpireCheck = Now-CBanAddrPool::WHEEL_SIZE;
+	for(; m_ExpireCheck < Now; ++m_ExpireCheck)
 	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanAddrPool.Remove(m_BanAddrPool.First());
-	}
-	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
-	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanRangePool.Remove(m_BanRangePool.First());
+		Expire(&m_BanAddrPool, m_ExpireCheck, Now);
+		Expire(&m_BanRangePool, m_ExpireCheck, Now);
 	}
 }
 
@@ -451,11 +676,8 @@ void CNetBan::UnbanAll()
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
 {
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
-
 	// check ban adresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
+	CBanAddr *pBan = m_BanAddrPool.Find(pAddr);
 	if(pBan)
 	{
 		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
@@ -463,18 +685,13 @@ bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) co
 	}
 
 	// check ban ranges
-	for(int i = Length-1; i >= 0; --i)
+	CBanRange *pBanRange = m_BanRangePool.Match(pAddr);
+	if(pBanRange)
 	{
-		for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
-		{
-			if(NetMatch(&pBan->m_Data, pAddr, i, Length))
-			{
-				MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
-				return true;
-			}
-		}
+		MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER);
+		return true;
 	}
-	
+
 	return false;
 }
 
@@ -2,6 +2,7 @@
 #define ENGINE_SHARED_NETBAN_H
 
 #include <base/system.h>
+#include <base/tl/array.h>
 
 
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
@@ -63,19 +64,6 @@ protected:
 	// todo: move?
 	static bool StrAllnum(const char *pStr);
 
-	class CNetHash
-	{
-	public:
-		int m_Hash;
-		int m_HashIndex;	// matching parts for ranges, 0 for addr
-
-		CNetHash() {}	
-		CNetHash(const NETADDR *pAddr);
-		CNetHash(const CNetRange *pRange);
-
-		static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17]);
-	};
-
 	struct CBanInfo
 	{
 		enum
@@ -91,35 +79,84 @@ protected:
 	{
 		T m_Data;
 		CBanInfo m_Info;
-		CNetHash m_NetHash;
 
-		// hash list
+		// hash list (addresses)
 		CBan *m_pHashNext;
 		CBan *m_pHashPrev;
 
-		// used or free list
+		// trie entries (ranges)
+		int m_FirstEntry;
+
+		// expire wheel slot
+		CBan *m_pWheelNext;
+		CBan *m_pWheelPrev;
+
+		// used list
 		CBan *m_pNext;
 		CBan *m_pPrev;
 	};
 
-	template<class T, int HashCount> class CBanPool
+	typedef CBan<NETADDR> CBanAddr;
+	typedef CBan<CNetRange> CBanRange;
+
+	/*
+		Class: Ban List
+			Keeps the bans of a pool in the order they were added and
+			sorts them into the slots of a timer wheel by the second
+			they expire in. Bans that never expire aren't in the wheel.
+	*/
+	template<class T> class CBanList
 	{
 	public:
 		typedef T CDataType;
 
-		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
-		int Remove(CBan<CDataType> *pBan);
+		enum
+		{
+			WHEEL_SIZE=1024, // seconds, has to be a power of two
+		};
+
+		CBanList();
+		~CBanList();
+
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
-		void Reset();
-	
+
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
 
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
-		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
-		CBan<CDataType> *Find(const CDataType *pData, const CNetHash *pNetHash) const
+		CBan<CDataType> *FirstInSlot(int Second) const { return m_apWheel[Second&(WHEEL_SIZE-1)]; }
+		CBan<CDataType> *Get(int Index) const;
+
+	protected:
+		CBan<CDataType> *Link(const CDataType *pData, const CBanInfo *pInfo);
+		void Unlink(CBan<CDataType> *pBan);
+		void Clear();
+
+	private:
+		void LinkWheel(CBan<CDataType> *pBan);
+		void UnlinkWheel(CBan<CDataType> *pBan);
+
+		CBan<CDataType> *m_apWheel[WHEEL_SIZE];
+		CBan<CDataType> *m_pFirstUsed;
+		CBan<CDataType> *m_pLastUsed;
+		int m_CountUsed;
+	};
+
+	/*
+		Class: Ban Address Pool
+			Address bans in a hash table that grows with them.
+	*/
+	class CBanAddrPool : public CBanList<NETADDR>
+	{
+	public:
+		CBanAddrPool();
+
+		CBanAddr *Add(const NETADDR *pData, const CBanInfo *pInfo);
+		int Remove(CBanAddr *pBan);
+		void Reset();
+
+		CBanAddr *Find(const NETADDR *pData) const
 		{
-			for(CBan<CDataType> *pBan = m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; pBan; pBan = pBan->m_pHashNext)
+			for(CBanAddr *pBan = m_apHash[Hash(pData)&(m_apHash.size()-1)]; pBan; pBan = pBan->m_pHashNext)
 			{
 				if(NetComp(&pBan->m_Data, pData) == 0)
 					return pBan;
@@ -127,35 +164,100 @@ protected:
 
 			return 0;
 		}
-		CBan<CDataType> *Get(int Index) const;
 
 	private:
 		enum
 		{
-			MAX_BANS=1024,
+			MIN_HASH_SIZE=256,
 		};
 
-		CBan<CDataType> *m_paaHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
-		CBan<CDataType> *m_pFirstFree;
-		CBan<CDataType> *m_pFirstUsed;
-		int m_CountUsed;
+		static unsigned Hash(const NETADDR *pAddr)
+		{
+			unsigned Hash = pAddr->type;
+			int Size = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
+			for(int i = 0; i < Size; i++)
+				Hash = Hash*31 + pAddr->ip[i];
+			return Hash ^ (Hash>>15);
+		}
+
+		void Rehash(int Size);
+
+		array<CBanAddr *> m_apHash;
+	};
+
+	/*
+		Class: Ban Range Pool
+			Range bans in a trie over the nibbles of the addresses, one
+			for IPv4 and one for IPv6. A range is split into the nibble
+			ranges of the nodes it covers completely, so an address is
+			banned when a node on its path covers the next nibble.
+	*/
+	class CBanRangePool : public CBanList<CNetRange>
+	{
+	public:
+		CBanRangePool();
+
+		CBanRange *Add(const CNetRange *pData, const CBanInfo *pInfo);
+		int Remove(CBanRange *pBan);
+		void Reset();
+
+		CBanRange *Find(const CNetRange *pData) const;
+
+		// returns the ban of the longest prefix that contains the address
+		CBanRange *Match(const NETADDR *pAddr) const;
+
+	private:
+		enum
+		{
+			NODE_BITS=4,
+			NODE_SIZE=1<<NODE_BITS,
+
+			ROOT_IPV4=0,
+			ROOT_IPV6,
+			NUM_ROOTS,
+		};
+
+		struct CNode
+		{
+			int m_aChildren[NODE_SIZE];
+			int m_Parent;
+			int m_FirstEntry;
+			unsigned m_CoverMask; // nibbles covered by the entries
+		};
+
+		struct CEntry
+		{
+			CBanRange *m_pBan;
+			int m_Node;
+			unsigned m_CoverMask;
+			int m_NextInNode;
+			int m_PrevInNode;
+			int m_NextOfBan;
+		};
+
+		int NewNode(int Parent);
+		void FreeNode(int Node);
+		void Attach(CBanRange *pBan, int Node, unsigned CoverMask);
+		void Insert(CBanRange *pBan, int Node, int Depth, bool LowerBound, bool UpperBound, int LowerEnd, int UpperEnd);
+
+		array<CNode> m_aNodes; // free nodes are chained by m_Parent
+		array<CEntry> m_aEntries; // free entries are chained by m_NextOfBan
+		int m_FirstFreeNode;
+		int m_FirstFreeEntry;
 	};
 
-	typedef CBanPool<NETADDR, 1> CBanAddrPool;
-	typedef CBanPool<CNetRange, 16> CBanRangePool;
-	typedef CBan<NETADDR> CBanAddr;
-	typedef CBan<CNetRange> CBanRange;
-	
 	template<class T> void MakeBanInfo(const CBan<T> *pBan, char *pBuf, unsigned BuffSize, int Type) const;
 	template<class T> int Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason);
 	template<class T> int Unban(T *pBanPool, const typename T::CDataType *pData);
+	template<class T> void Expire(T *pBanPool, int Second, int Now);
 
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
 	CBanAddrPool m_BanAddrPool;
 	CBanRangePool m_BanRangePool;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
+	unsigned m_Generation;
+	int m_ExpireCheck;
 
 public:
 	enum
@@ -181,6 +283,10 @@ public:
 	void UnbanAll();
 	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const;
 
+	// changes whenever a ban gets added, an address that wasn't banned
+	// stays unbanned as long as this stays the same
+	unsigned Generation() const { return m_Generation; }
+
 	static void ConBan(class IConsole::IResult *pResult, void *pUser);
 	static void ConBanRange(class IConsole::IResult *pResult, void *pUser);
 	static void ConUnban(class IConsole::IResult *pResult, void *pUser);
@@ -21,6 +21,34 @@ void CNetRecvUnpacker::Start(const NETADDR *pAddr, CNetConnection *pConnection,
 	m_Valid = true;
 }
 
+int CNetRecvUnpacker::FetchDatagram(NETSOCKET Socket, NETADDR *pAddr, unsigned char **ppData)
+{
+	while(1)
+	{
+		// receive the next batch once all packets of the last one are handled
+		if(m_NextDatagram >= m_NumDatagrams)
+		{
+			for(int i = 0; i < NET_MAX_DATAGRAMS; i++)
+			{
+				m_aDatagrams[i].data = m_aaDatagramData[i];
+				m_aDatagrams[i].size = NET_MAX_PACKETSIZE;
+			}
+			m_NumDatagrams = net_udp_recv_batch(Socket, m_aDatagrams, NET_MAX_DATAGRAMS);
+			m_NextDatagram = 0;
+			if(m_NumDatagrams <= 0)
+				return 0;
+		}
+
+		const NETDATAGRAM *pDatagram = &m_aDatagrams[m_NextDatagram++];
+		if(pDatagram->size <= 0)
+			continue;
+
+		*pAddr = pDatagram->addr;
+		*ppData = (unsigned char *)pDatagram->data;
+		return pDatagram->size;
+	}
+}
+
 // TODO: rename this function
 int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 {
@@ -109,7 +137,7 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, const NETADDR *pAddr, TOKEN
 	dbg_assert(i == NET_PACKETHEADERSIZE_CONNLESS, "inconsistency");
 
 	mem_copy(&aBuffer[i], pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, i+DataSize);
+	SendDatagram(Socket, pAddr, aBuffer, i+DataSize);
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketConstruct *pPacket)
@@ -164,7 +192,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketCons
 
 		dbg_assert(i == NET_PACKETHEADERSIZE, "inconsistency");
 
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		SendDatagram(Socket, pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -366,6 +394,11 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+NETSOCKET CNetBase::ms_SendBatchSocket;
+NETDATAGRAM CNetBase::ms_aSendBatch[NET_MAX_DATAGRAMS];
+unsigned char CNetBase::ms_aaSendBatchData[NET_MAX_DATAGRAMS][NET_MAX_PACKETSIZE];
+int CNetBase::ms_SendBatchSize = 0;
+int CNetBase::ms_SendBatchDepth = 0;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
@@ -404,6 +437,46 @@ void CNetBase::CloseLog()
 	}
 }
 
+void CNetBase::SendDatagram(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize)
+{
+	if(!ms_SendBatchDepth)
+	{
+		net_udp_send(Socket, pAddr, pData, DataSize);
+		return;
+	}
+
+	// a batch only goes out over one socket
+	if(ms_SendBatchSize == NET_MAX_DATAGRAMS || (ms_SendBatchSize && (ms_SendBatchSocket.ipv4sock != Socket.ipv4sock || ms_SendBatchSocket.ipv6sock != Socket.ipv6sock)))
+		FlushSendBatch();
+
+	NETDATAGRAM *pDatagram = &ms_aSendBatch[ms_SendBatchSize];
+	mem_copy(ms_aaSendBatchData[ms_SendBatchSize], pData, DataSize);
+	pDatagram->addr = *pAddr;
+	pDatagram->data = ms_aaSendBatchData[ms_SendBatchSize];
+	pDatagram->size = DataSize;
+	ms_SendBatchSocket = Socket;
+	ms_SendBatchSize++;
+}
+
+void CNetBase::FlushSendBatch()
+{
+	if(ms_SendBatchSize)
+		net_udp_send_batch(ms_SendBatchSocket, ms_aSendBatch, ms_SendBatchSize);
+	ms_SendBatchSize = 0;
+}
+
+void CNetBase::BeginSendBatch()
+{
+	ms_SendBatchDepth++;
+}
+
+void CNetBase::EndSendBatch()
+{
+	dbg_assert(ms_SendBatchDepth > 0, "send batch not started");
+	if(--ms_SendBatchDepth == 0)
+		FlushSendBatch();
+}
+
 int CNetBase::Compress(const void *pData, int DataSize, void *pOutput, int OutputSize)
 {
 	return ms_Huffman.Compress(pData, DataSize, pOutput, OutputSize);
@@ -434,3 +507,8 @@ void CNetBase::Init()
 {
 	ms_Huffman.Init(gs_aFreqTable);
 }
+
+const unsigned *CNetBase::HuffmanFrequencies()
+{
+	return gs_aFreqTable;
+}
@@ -76,6 +76,8 @@ enum
 	NET_MAX_PACKETSIZE = 1400,
 	NET_MAX_PAYLOAD = NET_MAX_PACKETSIZE-NET_MAX_PACKETHEADERSIZE,
 
+	NET_MAX_DATAGRAMS = 32, // packets received or sent with one system call
+
 	NET_PACKETVERSION=1,
 
 	NET_PACKETFLAG_CONTROL=1,
@@ -364,29 +366,54 @@ public:
 	int m_CurrentChunk;
 	int m_ClientID;
 	CNetPacketConstruct m_Data;
-	unsigned char m_aBuffer[NET_MAX_PACKETSIZE];
 
-	CNetRecvUnpacker() { Clear(); }
+	// packets received with one call, handed out one at a time
+	unsigned char m_aaDatagramData[NET_MAX_DATAGRAMS][NET_MAX_PACKETSIZE];
+	NETDATAGRAM m_aDatagrams[NET_MAX_DATAGRAMS];
+	int m_NumDatagrams;
+	int m_NextDatagram;
+
+	CNetRecvUnpacker() : m_NumDatagrams(0), m_NextDatagram(0) { Clear(); }
 	void Clear();
 	void Start(const NETADDR *pAddr, CNetConnection *pConnection, int ClientID);
 	int FetchChunk(CNetChunk *pChunk);
+	int FetchDatagram(NETSOCKET Socket, NETADDR *pAddr, unsigned char **ppData);
 };
 
 // server side
 class CNetServer
 {
+	enum
+	{
+		PEER_HASH_SIZE=NET_MAX_CLIENTS*2,
+		BAN_CACHE_SIZE=256,
+	};
+
 	struct CSlot
 	{
 	public:
 		CNetConnection m_Connection;
+		int m_PeerBucket; // -1 while the slot isn't in the peer hash
+		int m_NextPeer;
+	};
+
+	// an address that wasn't banned at the given ban generation
+	struct CBanCheck
+	{
+		NETADDR m_Addr;
+		unsigned m_Generation;
 	};
 
 	NETSOCKET m_Socket;
 	class CNetBan *m_pNetBan;
-	CSlot m_aSlots[NET_MAX_CLIENTS];
+	CSlot *m_pSlots; // one per client the server got opened for
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
+	// slots by peer address, kept up to date on connect and drop
+	int m_aPeerHash[PEER_HASH_SIZE];
+	CBanCheck m_aBanChecks[BAN_CACHE_SIZE];
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_DELCLIENT m_pfnDelClient;
 	void *m_UserPtr;
@@ -397,7 +424,15 @@ class CNetServer
 	CNetTokenCache m_TokenCache;
 
 	int m_Flags;
+
+	static unsigned IPHash(const NETADDR *pAddr);
+	int FindSlot(const NETADDR *pAddr) const;
+	void AddPeer(int ClientID);
+	void RemovePeer(int ClientID);
+	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize);
 public:
+	CNetServer() : m_pSlots(0), m_MaxClients(0) {}
+
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
 	//
@@ -413,7 +448,7 @@ public:
 	int Drop(int ClientID, const char *pReason);
 
 	// status requests
-	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	const NETADDR *ClientAddr(int ClientID) const { return m_pSlots[ClientID].m_Connection.PeerAddress(); }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 	int NetType() const { return m_Socket.type; }
@@ -508,10 +543,21 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+
+	// packets queued between BeginSendBatch and EndSendBatch
+	static NETSOCKET ms_SendBatchSocket;
+	static NETDATAGRAM ms_aSendBatch[NET_MAX_DATAGRAMS];
+	static unsigned char ms_aaSendBatchData[NET_MAX_DATAGRAMS][NET_MAX_PACKETSIZE];
+	static int ms_SendBatchSize;
+	static int ms_SendBatchDepth;
+
+	static void SendDatagram(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize);
+	static void FlushSendBatch();
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
 	static void Init();
+	static const unsigned *HuffmanFrequencies();
 	static int Compress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 	static int Decompress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 
@@ -521,6 +567,11 @@ public:
 	static void SendPacket(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketConstruct *pPacket);
 	static int UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket);
 
+	// packets sent between these get queued and go out with as few system calls as
+	// possible, at the latest with the outermost EndSendBatch. only for the main thread
+	static void BeginSendBatch();
+	static void EndSendBatch();
+
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
 	static int IsSeqInBackroom(int Seq, int Ack);
 };
@@ -32,8 +32,14 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 
 	m_MaxClientsPerIP = MaxClientsPerIP;
 
-	for(int i = 0; i < NET_MAX_CLIENTS; i++)
-		m_aSlots[i].m_Connection.Init(m_Socket, true);
+	m_pSlots = new CSlot[m_MaxClients];
+	for(int i = 0; i < m_MaxClients; i++)
+	{
+		m_pSlots[i].m_Connection.Init(m_Socket, true);
+		m_pSlots[i].m_PeerBucket = -1;
+	}
+	for(int i = 0; i < PEER_HASH_SIZE; i++)
+		m_aPeerHash[i] = -1;
 
 	m_Flags = Flags;
 
@@ -51,9 +57,69 @@ int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT p
 int CNetServer::Close()
 {
 	// TODO: implement me
+	delete[] m_pSlots;
+	m_pSlots = 0;
 	return 0;
 }
 
+unsigned CNetServer::IPHash(const NETADDR *pAddr)
+{
+	unsigned Hash = pAddr->type;
+	int Size = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
+	for(int i = 0; i < Size; i++)
+		Hash = Hash*31 + pAddr->ip[i];
+	return Hash ^ (Hash>>15);
+}
+
+int CNetServer::FindSlot(const NETADDR *pAddr) const
+{
+	for(int i = m_aPeerHash[(IPHash(pAddr)^pAddr->port)&(PEER_HASH_SIZE-1)]; i != -1; i = m_pSlots[i].m_NextPeer)
+	{
+		if(net_addr_comp(m_pSlots[i].m_Connection.PeerAddress(), pAddr) == 0)
+			return i;
+	}
+	return -1;
+}
+
+void CNetServer::AddPeer(int ClientID)
+{
+	RemovePeer(ClientID);
+
+	const NETADDR *pAddr = m_pSlots[ClientID].m_Connection.PeerAddress();
+	int Bucket = (IPHash(pAddr)^pAddr->port)&(PEER_HASH_SIZE-1);
+	m_pSlots[ClientID].m_PeerBucket = Bucket;
+	m_pSlots[ClientID].m_NextPeer = m_aPeerHash[Bucket];
+	m_aPeerHash[Bucket] = ClientID;
+}
+
+void CNetServer::RemovePeer(int ClientID)
+{
+	int Bucket = m_pSlots[ClientID].m_PeerBucket;
+	if(Bucket == -1)
+		return;
+
+	int *pLink = &m_aPeerHash[Bucket];
+	while(*pLink != ClientID)
+		pLink = &m_pSlots[*pLink].m_NextPeer;
+	*pLink = m_pSlots[ClientID].m_NextPeer;
+	m_pSlots[ClientID].m_PeerBucket = -1;
+}
+
+// every packet gets checked, remember the addresses that weren't banned until the banlist grows
+bool CNetServer::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize)
+{
+	CBanCheck *pCheck = &m_aBanChecks[IPHash(pAddr)&(BAN_CACHE_SIZE-1)];
+	if(pCheck->m_Generation == NetBan()->Generation() && NetComp(&pCheck->m_Addr, pAddr) == 0)
+		return false;
+
+	if(NetBan()->IsBanned(pAddr, pBuf, BufferSize))
+		return true;
+
+	pCheck->m_Addr = *pAddr;
+	pCheck->m_Generation = NetBan()->Generation();
+	return false;
+}
+
 int CNetServer::Drop(int ClientID, const char *pReason)
 {
 	// TODO: insert lots of checks here
@@ -67,7 +133,8 @@ int CNetServer::Drop(int ClientID, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
-	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+	RemovePeer(ClientID);
+	m_pSlots[ClientID].m_Connection.Disconnect(pReason);
 
 	return 0;
 }
@@ -75,20 +142,22 @@ int CNetServer::Drop(int ClientID, const char *pReason)
 int CNetServer::Update()
 {
 	int64 Now = time_get();
+	CNetBase::BeginSendBatch();
 	for(int i = 0; i < MaxClients(); i++)
 	{
-		m_aSlots[i].m_Connection.Update();
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
+		m_pSlots[i].m_Connection.Update();
+		if(m_pSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
 		{
-			if(Now - m_aSlots[i].m_Connection.ConnectTime() < time_freq() && NetBan())
+			if(Now - m_pSlots[i].m_Connection.ConnectTime() < time_freq() && NetBan())
 			{
 				if(NetBan()->BanAddr(ClientAddr(i), 60, "Stressing network") == -1)
-					Drop(i, m_aSlots[i].m_Connection.ErrorString());
+					Drop(i, m_pSlots[i].m_Connection.ErrorString());
 			}
 			else
-				Drop(i, m_aSlots[i].m_Connection.ErrorString());
+				Drop(i, m_pSlots[i].m_Connection.ErrorString());
 		}
 	}
+	CNetBase::EndSendBatch();
 
 	m_TokenManager.Update();
 	m_TokenCache.Update();
@@ -110,54 +179,49 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 			return 1;
 
 		// TODO: empty the recvinfo
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+		unsigned char *pData;
+		int Bytes = m_RecvUnpacker.FetchDatagram(m_Socket, &Addr, &pData);
 
 		// no more packets for now
 		if(Bytes <= 0)
 			break;
 
-		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data) == 0)
 		{
 			// check for bans
 			char aBuf[128];
-			if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+			if(NetBan() && IsBanned(&Addr, aBuf, sizeof(aBuf)))
 			{
 				// banned, reply with a message
 				CNetBase::SendControlMsg(m_Socket, &Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
 				continue;
 			}
 
-			bool Found = false;
 			// try to find matching slot
-			for(int i = 0; i < MaxClients(); i++)
+			int Slot = FindSlot(&Addr);
+			if(Slot != -1)
 			{
-				if(net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+				if(m_pSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
 				{
-					if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
+					if(m_RecvUnpacker.m_Data.m_DataSize)
 					{
-						if(m_RecvUnpacker.m_Data.m_DataSize)
+						if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
+							m_RecvUnpacker.Start(&Addr, &m_pSlots[Slot].m_Connection, Slot);
+						else
 						{
-							if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
-								m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
-							else
-							{
-								pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-								pChunk->m_Address = *m_aSlots[i].m_Connection.PeerAddress();
-								pChunk->m_ClientID = i;
-								pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-								pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-								if(pResponseToken)
-									*pResponseToken = NET_TOKEN_NONE;
-								return 1;
-							}
+							pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+							pChunk->m_Address = *m_pSlots[Slot].m_Connection.PeerAddress();
+							pChunk->m_ClientID = Slot;
+							pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+							pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+							if(pResponseToken)
+								*pResponseToken = NET_TOKEN_NONE;
+							return 1;
 						}
 					}
-					Found = true;
 				}
-			}
-
-			if(Found)
 				continue;
+			}
 
 			int Accept = m_TokenManager.ProcessMessage(&Addr, &m_RecvUnpacker.m_Data, true);
 
@@ -175,10 +239,10 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 					ThisAddr.port = 0;
 					for(int i = 0; i < MaxClients(); i++)
 					{
-						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+						if(m_pSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
 							continue;
 
-						OtherAddr = *m_aSlots[i].m_Connection.PeerAddress();
+						OtherAddr = *m_pSlots[i].m_Connection.PeerAddress();
 						OtherAddr.port = 0;
 						if(!net_addr_comp(&ThisAddr, &OtherAddr))
 						{
@@ -194,12 +258,14 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 
 					for(int i = 0; i < MaxClients(); i++)
 					{
-						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+						if(m_pSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
 						{
 							Found = true;
-							m_aSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token);
-							m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
-							m_aSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token); // HACK!
+							m_pSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token);
+							m_pSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
+							m_pSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token); // HACK!
+							if(m_pSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE)
+								AddPeer(i);
 							if(m_pfnNewClient)
 								m_pfnNewClient(i, m_UserPtr);
 							break;
@@ -248,14 +314,15 @@ int CNetServer::Send(CNetChunk *pChunk, TOKEN Token)
 		}
 
 		if(pChunk->m_ClientID == -1)
-			for(int i = 0; i < MaxClients(); i++)
-				if(net_addr_comp(&pChunk->m_Address, m_aSlots[i].m_Connection.PeerAddress()) == 0)
-				{
-					// upgrade the packet, now that we know its recipent
-					pChunk->m_Flags &= ~NETSENDFLAG_STATELESS;
-					pChunk->m_ClientID = i;
-					break;
-				}
+		{
+			int Slot = FindSlot(&pChunk->m_Address);
+			if(Slot != -1)
+			{
+				// upgrade the packet, now that we know its recipent
+				pChunk->m_Flags &= ~NETSENDFLAG_STATELESS;
+				pChunk->m_ClientID = Slot;
+			}
+		}
 
 		if(pChunk->m_Flags&NETSENDFLAG_STATELESS || Token != NET_TOKEN_NONE)
 		{
@@ -277,7 +344,7 @@ int CNetServer::Send(CNetChunk *pChunk, TOKEN Token)
 				dbg_assert(pChunk->m_ClientID >= 0, "errornous client id");
 				dbg_assert(pChunk->m_ClientID < MaxClients(), "errornous client id");
 
-				m_aSlots[pChunk->m_ClientID].m_Connection.SendPacketConnless((const char *)pChunk->m_pData, pChunk->m_DataSize);
+				m_pSlots[pChunk->m_ClientID].m_Connection.SendPacketConnless((const char *)pChunk->m_pData, pChunk->m_DataSize);
 			}
 		}
 	}
@@ -296,10 +363,10 @@ int CNetServer::Send(CNetChunk *pChunk, TOKEN Token)
 		if(pChunk->m_Flags&NETSENDFLAG_VITAL)
 			Flags = NET_CHUNKFLAG_VITAL;
 
-		if(m_aSlots[pChunk->m_ClientID].m_Connection.QueueChunk(Flags, pChunk->m_DataSize, pChunk->m_pData) == 0)
+		if(m_pSlots[pChunk->m_ClientID].m_Connection.QueueChunk(Flags, pChunk->m_DataSize, pChunk->m_pData) == 0)
 		{
 			if(pChunk->m_Flags&NETSENDFLAG_FLUSH)
-				m_aSlots[pChunk->m_ClientID].m_Connection.Flush();
+				m_pSlots[pChunk->m_ClientID].m_Connection.Flush();
 		}
 		else
 		{
@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include "snapshot.h"
+#include "snapshot_kernels.h"
 #include "compression.h"
 
 // CSnapshot
@@ -30,16 +31,11 @@ int CSnapshot::GetItemIndex(int Key)
 
 int CSnapshot::Crc()
 {
+	CSnapshotKernels::FSum pfnSum = CSnapshotKernels::Best()->m_pfnSum;
 	int Crc = 0;
 
 	for(int i = 0; i < m_NumItems; i++)
-	{
-		CSnapshotItem *pItem = GetItem(i);
-		int Size = GetItemSize(i);
-
-		for(int b = 0; b < Size/4; b++)
-			Crc += pItem->Data()[b];
-	}
+		Crc += pfnSum(GetItem(i)->Data(), GetItemSize(i)/4);
 	return Crc;
 }
 
@@ -57,86 +53,72 @@ void CSnapshot::DebugDump()
 }
 
 
-// CSnapshotDelta
+// CSnapshotKeyIndex
 
-struct CItemList
+static inline unsigned KeyHash(int Key)
 {
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
+	unsigned Hash = (unsigned)Key*0x9E3779B1u;
+	return Hash^(Hash>>15);
+}
 
-enum
+int CSnapshotKeyIndex::NumSlots(int NumItems)
 {
-	HASHLIST_SIZE = 256,
-};
+	// keep the load factor at or below one half
+	int Num = 16;
+	while(Num < NumItems*2)
+		Num <<= 1;
+	return Num;
+}
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+void CSnapshotKeyIndex::Init(CSnapshot *pSnapshot, void *pMem)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	int Num = NumSlots(pSnapshot->NumItems());
+	m_Mask = Num-1;
+	m_pSlots = (int *)pMem;
+	for(int i = 0; i < Num; i++)
+		m_pSlots[i*2+1] = -1;
 
 	for(int i = 0; i < pSnapshot->NumItems(); i++)
 	{
 		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		unsigned Slot = KeyHash(Key)&m_Mask;
+		while(m_pSlots[Slot*2+1] != -1)
+		{
+			if(m_pSlots[Slot*2] == Key)
+				break; // keep the first item with this key, like the linear search
+			Slot = (Slot+1)&m_Mask;
+		}
+		if(m_pSlots[Slot*2+1] == -1)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			m_pSlots[Slot*2] = Key;
+			m_pSlots[Slot*2+1] = i;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotKeyIndex::GetItemIndex(int Key) const
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+	unsigned Slot = KeyHash(Key)&m_Mask;
+	while(m_pSlots[Slot*2+1] != -1)
+	{
+		if(m_pSlots[Slot*2] == Key)
+			return m_pSlots[Slot*2+1];
+		Slot = (Slot+1)&m_Mask;
 	}
-
 	return -1;
 }
 
-static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
-{
-	int Needed = 0;
-	while(Size)
-	{
-		*pOut = *pCurrent-*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
-	}
 
-	return Needed;
+// CSnapshotDelta
+
+int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+{
+	return m_pKernels->m_pfnDiff(pPast, pCurrent, pOut, Size);
 }
 
 void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
 {
-	while(Size)
-	{
-		*pOut = *pPast+*pDiff;
-
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
-		else
-		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
-		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
-	}
+	m_aSnapshotDataRate[m_SnapshotCurrent] += m_pKernels->m_pfnUndiff(pPast, pDiff, pOut, Size);
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -146,6 +128,7 @@ CSnapshotDelta::CSnapshotDelta()
 	mem_zero(m_aSnapshotDataUpdates, sizeof(m_aSnapshotDataUpdates));
 	m_SnapshotCurrent = 0;
 	mem_zero(&m_Empty, sizeof(m_Empty));
+	m_pKernels = CSnapshotKernels::Best();
 }
 
 void CSnapshotDelta::SetStaticsize(int ItemType, int Size)
@@ -158,8 +141,7 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData, const CSnapshotKeyIndex *pFromIndex, const CSnapshotKeyIndex *pToIndex)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_pData;
@@ -174,14 +156,28 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	// index the snapshots that aren't indexed yet
+	int aFromSlots[CSnapshotKeyIndex::MAX_SLOTS*2];
+	int aToSlots[CSnapshotKeyIndex::MAX_SLOTS*2];
+	CSnapshotKeyIndex FromIndex, ToIndex;
+	if(!pFromIndex)
+	{
+		dbg_assert(pFrom->NumItems() <= CSnapshot::MAX_ITEMS, "too many items");
+		FromIndex.Init(pFrom, aFromSlots);
+		pFromIndex = &FromIndex;
+	}
+	if(!pToIndex)
+	{
+		dbg_assert(pTo->NumItems() <= CSnapshot::MAX_ITEMS, "too many items");
+		ToIndex.Init(pTo, aToSlots);
+		pToIndex = &ToIndex;
+	}
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(pToIndex->GetItemIndex(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -190,16 +186,15 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
+	int aPastIndecies[CSnapshot::MAX_ITEMS];
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
 	const int NumItems = pTo->NumItems();
 	for(i = 0; i < NumItems; i++)
 	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
+		pCurItem = pTo->GetItem(i);
+		aPastIndecies[i] = pFromIndex->GetItemIndex(pCurItem->Key());
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -276,7 +271,7 @@ static int RangeCheck(void *pEnd, void *pPtr, int Size)
 	return 0;
 }
 
-int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData, int DataSize)
+int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData, int DataSize, const CSnapshotKeyIndex *pFromIndex)
 {
 	CSnapshotBuilder Builder;
 	CData *pDelta = (CData *)pSrcData;
@@ -284,7 +279,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 	int *pEnd = (int *)(((char *)pSrcData + DataSize));
 
 	CSnapshotItem *pFromItem;
-	int Keep, ItemSize;
+	int ItemSize;
 	int *pDeleted;
 	int ID, Type, Key;
 	int FromIndex;
@@ -292,35 +287,49 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	Builder.Init();
 
+	if(pFrom->NumItems() > CSnapshot::MAX_ITEMS)
+		return -1;
+
+	// index the old snapshot if it isn't indexed yet
+	int aFromSlots[CSnapshotKeyIndex::MAX_SLOTS*2];
+	CSnapshotKeyIndex Index;
+	if(!pFromIndex)
+	{
+		Index.Init(pFrom, aFromSlots);
+		pFromIndex = &Index;
+	}
+
 	// unpack deleted stuff
 	pDeleted = pData;
 	pData += pDelta->m_NumDeletedItems;
 	if(pData > pEnd)
 		return -1;
 
+	// the builder index of every old item, -1 for deleted ones
+	int aBuilderIndex[CSnapshot::MAX_ITEMS];
+	for(int i = 0; i < pFrom->NumItems(); i++)
+		aBuilderIndex[i] = 0;
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		FromIndex = pFromIndex->GetItemIndex(pDeleted[d]);
+		if(FromIndex != -1)
+			aBuilderIndex[FromIndex] = -1;
+	}
+
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
-		// dbg_assert(0, "fail!");
+		if(aBuilderIndex[i] == -1)
+			continue;
+
+		// keep it
 		pFromItem = pFrom->GetItem(i);
 		ItemSize = pFrom->GetItemSize(i);
-		Keep = 1;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = 0;
-				break;
-			}
-		}
-
-		if(Keep)
-		{
-			// keep it
-			mem_copy(
-				Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize),
-				pFromItem->Data(), ItemSize);
-		}
+		aBuilderIndex[i] = Builder.NumItems();
+		void *pKeep = Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize);
+		if(!pKeep)
+			return -1;
+		mem_copy(pKeep, pFromItem->Data(), ItemSize);
 	}
 
 	// unpack updated stuff
@@ -346,15 +355,21 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		if(RangeCheck(pEnd, pData, ItemSize) || ItemSize < 0) return -3;
 
 		Key = (Type<<16)|ID;
+		FromIndex = pFromIndex->GetItemIndex(Key);
 
 		// create the item if needed
-		pNewData = Builder.GetItemData(Key);
-		if(!pNewData)
-			pNewData = (int *)Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
+		if(FromIndex != -1 && aBuilderIndex[FromIndex] != -1)
+			pNewData = Builder.GetItem(aBuilderIndex[FromIndex])->Data();
+		else
+		{
+			pNewData = Builder.GetItemData(Key);
+			if(!pNewData)
+				pNewData = (int *)Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
+		}
 
-		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
+		if(!pNewData)
+			return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -430,8 +445,9 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 
 void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder)+DataSize;
+	// allocate memory for holder + snapshot_data + key index
+	int IndexSize = CSnapshotKeyIndex::MemSize(((CSnapshot *)pData)->NumItems());
+	int TotalSize = sizeof(CHolder)+DataSize+IndexSize;
 
 	if(CreateAlt)
 		TotalSize += DataSize;
@@ -453,6 +469,9 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	else
 		pHolder->m_pAltSnap = 0;
 
+	// index the item keys once, they are looked up for every delta
+	pHolder->m_KeyIndex.Init(pHolder->m_pSnap, ((char *)pHolder)+TotalSize-IndexSize);
+
 
 	// link
 	pHolder->m_pNext = 0;
@@ -464,7 +483,7 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	m_pLast = pHolder;
 }
 
-int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
+int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData, const CSnapshotKeyIndex **ppKeyIndex)
 {
 	CHolder *pHolder = m_pFirst;
 
@@ -478,6 +497,8 @@ int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapsh
 				*ppData = pHolder->m_pSnap;
 			if(ppAltData)
 				*ppAltData = pHolder->m_pAltSnap;
+			if(ppKeyIndex)
+				*ppKeyIndex = &pHolder->m_KeyIndex;
 			return pHolder->m_SnapSize;
 		}
 
@@ -518,6 +539,13 @@ CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
 	return (CSnapshotItem *)&(m_aData[m_aOffsets[Index]]);
 }
 
+int CSnapshotBuilder::GetItemSize(int Index)
+{
+	if(Index == m_NumItems-1)
+		return (m_DataSize - m_aOffsets[Index]) - sizeof(CSnapshotItem);
+	return (m_aOffsets[Index+1] - m_aOffsets[Index]) - sizeof(CSnapshotItem);
+}
+
 int *CSnapshotBuilder::GetItemData(int Key)
 {
 	int i;
@@ -31,7 +31,8 @@ class CSnapshot
 public:
 	enum
 	{
-		MAX_SIZE=64*1024
+		MAX_SIZE=64*1024,
+		MAX_ITEMS=1024,
 	};
 
 	void Clear() { m_DataSize = 0; m_NumItems = 0; }
@@ -45,6 +46,32 @@ public:
 };
 
 
+// CSnapshotKeyIndex
+
+// open addressing hash from item keys to item indices of one snapshot
+class CSnapshotKeyIndex
+{
+	int m_Mask;
+	int *m_pSlots; // pairs of key and index, index is -1 for empty slots
+
+	static int NumSlots(int NumItems);
+
+public:
+	enum
+	{
+		MAX_SLOTS=CSnapshot::MAX_ITEMS*2,
+	};
+
+	CSnapshotKeyIndex() : m_Mask(0), m_pSlots(0) {}
+
+	static int MemSize(int NumItems) { return NumSlots(NumItems)*2*sizeof(int); }
+	void Init(CSnapshot *pSnapshot, void *pMem);
+	void Clear() { m_Mask = 0; m_pSlots = 0; }
+	bool Valid() const { return m_pSlots != 0; }
+
+	int GetItemIndex(int Key) const;
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -66,7 +93,9 @@ private:
 	int m_aSnapshotDataUpdates[0xffff];
 	int m_SnapshotCurrent;
 	CData m_Empty;
+	const class CSnapshotKernels *m_pKernels; // picked on construction, so the threads creating deltas only read it
 
+	int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
 	void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size);
 
 public:
@@ -75,8 +104,8 @@ public:
 	int GetDataUpdates(int Index) { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	CData *EmptyDelta();
-	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData);
-	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, int DataSize);
+	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, const CSnapshotKeyIndex *pFromIndex = 0, const CSnapshotKeyIndex *pToIndex = 0);
+	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, int DataSize, const CSnapshotKeyIndex *pFromIndex = 0);
 };
 
 
@@ -97,6 +126,7 @@ public:
 		int m_SnapSize;
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+		CSnapshotKeyIndex m_KeyIndex;
 	};
 
 
@@ -107,14 +137,14 @@ public:
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
-	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData, const CSnapshotKeyIndex **ppKeyIndex = 0);
 };
 
 class CSnapshotBuilder
 {
 	enum
 	{
-		MAX_ITEMS = 1024
+		MAX_ITEMS = CSnapshot::MAX_ITEMS
 	};
 
 	char m_aData[CSnapshot::MAX_SIZE];
@@ -130,7 +160,9 @@ public:
 	void *NewItem(int Type, int ID, int Size);
 
 	CSnapshotItem *GetItem(int Index);
+	int GetItemSize(int Index);
 	int *GetItemData(int Key);
+	int NumItems() const { return m_NumItems; }
 
 	int Finish(void *pSnapdata);
 };
@@ -0,0 +1,238 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include "compression.h"
+#include "snapshot_kernels.h"
+
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	#define SNAPSHOT_KERNELS_X86 1
+	#include <emmintrin.h>
+	#include <immintrin.h>
+#endif
+
+// the kernels are compiled for their instruction set no matter what the
+// rest of the engine gets built for, Best() makes sure they are only used
+// when the cpu supports them
+#if defined(__GNUC__)
+	#define KERNEL_TARGET(Target) __attribute__((target(Target)))
+#else
+	#define KERNEL_TARGET(Target)
+#endif
+
+
+// scalar
+
+static int DiffScalar(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = pCurrent[i]-pPast[i];
+		Needed |= pOut[i];
+	}
+	return Needed;
+}
+
+static int UndiffScalar(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	int Bits = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = pPast[i]+pDiff[i];
+
+		if(pDiff[i] == 0)
+			Bits += 1;
+		else
+		{
+			unsigned char aBuf[16];
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[i]);
+			Bits += (int)(pEnd - (unsigned char*)aBuf) * 8;
+		}
+	}
+	return Bits;
+}
+
+static int SumScalar(const int *pData, int Size)
+{
+	int Sum = 0;
+	for(int i = 0; i < Size; i++)
+		Sum += pData[i];
+	return Sum;
+}
+
+
+#if defined(SNAPSHOT_KERNELS_X86)
+
+// sse2
+
+KERNEL_TARGET("sse2") static inline int HorizontalOr4(__m128i Value)
+{
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(1, 0, 3, 2)));
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Value);
+}
+
+KERNEL_TARGET("sse2") static inline int HorizontalSum4(__m128i Value)
+{
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(1, 0, 3, 2)));
+	Value = _mm_add_epi32(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Value);
+}
+
+// same count as CVariableInt::Pack, which puts 6 bits into the first byte and 7 into every further one
+KERNEL_TARGET("sse2") static inline __m128i PackedBits4(__m128i Diff)
+{
+	__m128i Folded = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+	__m128i Extra = _mm_add_epi32(
+		_mm_add_epi32(_mm_cmpgt_epi32(Folded, _mm_set1_epi32(0x3f)), _mm_cmpgt_epi32(Folded, _mm_set1_epi32(0x1fff))),
+		_mm_add_epi32(_mm_cmpgt_epi32(Folded, _mm_set1_epi32(0xfffff)), _mm_cmpgt_epi32(Folded, _mm_set1_epi32(0x7ffffff))));
+	__m128i Bits = _mm_sub_epi32(_mm_set1_epi32(8), _mm_slli_epi32(Extra, 3)); // Extra holds -1 per extra byte
+	__m128i Zero = _mm_cmpeq_epi32(Diff, _mm_setzero_si128());
+	return _mm_or_si128(_mm_andnot_si128(Zero, Bits), _mm_and_si128(Zero, _mm_set1_epi32(1)));
+}
+
+KERNEL_TARGET("sse2") static int DiffSSE2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m128i Needed = _mm_setzero_si128();
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent+i)), _mm_loadu_si128((const __m128i *)(pPast+i)));
+		_mm_storeu_si128((__m128i *)(pOut+i), Diff);
+		Needed = _mm_or_si128(Needed, Diff);
+	}
+	return HorizontalOr4(Needed) | DiffScalar(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
+
+KERNEL_TARGET("sse2") static int UndiffSSE2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	__m128i Bits = _mm_setzero_si128();
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff+i));
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast+i)), Diff));
+		Bits = _mm_add_epi32(Bits, PackedBits4(Diff));
+	}
+	return HorizontalSum4(Bits) + UndiffScalar(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+
+KERNEL_TARGET("sse2") static int SumSSE2(const int *pData, int Size)
+{
+	__m128i Sum = _mm_setzero_si128();
+	int i = 0;
+	for(; i+4 <= Size; i += 4)
+		Sum = _mm_add_epi32(Sum, _mm_loadu_si128((const __m128i *)(pData+i)));
+	return HorizontalSum4(Sum) + SumScalar(pData+i, Size-i);
+}
+
+
+// avx2, the remainder of less than 8 ints goes through the sse2 kernels. the
+// upper register halves get cleared before that, mixing in legacy sse
+// instructions is very slow otherwise and not all compilers do it on their own
+
+KERNEL_TARGET("avx2") static inline __m256i PackedBits8(__m256i Diff)
+{
+	__m256i Folded = _mm256_xor_si256(Diff, _mm256_srai_epi32(Diff, 31));
+	__m256i Extra = _mm256_add_epi32(
+		_mm256_add_epi32(_mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(0x3f)), _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(0x1fff))),
+		_mm256_add_epi32(_mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(0xfffff)), _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(0x7ffffff))));
+	__m256i Bits = _mm256_sub_epi32(_mm256_set1_epi32(8), _mm256_slli_epi32(Extra, 3));
+	__m256i Zero = _mm256_cmpeq_epi32(Diff, _mm256_setzero_si256());
+	return _mm256_blendv_epi8(Bits, _mm256_set1_epi32(1), Zero);
+}
+
+KERNEL_TARGET("avx2") static inline __m128i Fold8(__m256i Value, bool Add)
+{
+	__m128i Low = _mm256_castsi256_si128(Value);
+	__m128i High = _mm256_extracti128_si256(Value, 1);
+	return Add ? _mm_add_epi32(Low, High) : _mm_or_si128(Low, High);
+}
+
+KERNEL_TARGET("avx2") static int DiffAVX2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m256i Needed = _mm256_setzero_si256();
+	int i = 0;
+	for(; i+8 <= Size; i += 8)
+	{
+		__m256i Diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pCurrent+i)), _mm256_loadu_si256((const __m256i *)(pPast+i)));
+		_mm256_storeu_si256((__m256i *)(pOut+i), Diff);
+		Needed = _mm256_or_si256(Needed, Diff);
+	}
+	int Result = HorizontalOr4(Fold8(Needed, false));
+	_mm256_zeroupper();
+	return Result | DiffSSE2(pPast+i, pCurrent+i, pOut+i, Size-i);
+}
+
+KERNEL_TARGET("avx2") static int UndiffAVX2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	__m256i Bits = _mm256_setzero_si256();
+	int i = 0;
+	for(; i+8 <= Size; i += 8)
+	{
+		__m256i Diff = _mm256_loadu_si256((const __m256i *)(pDiff+i));
+		_mm256_storeu_si256((__m256i *)(pOut+i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pPast+i)), Diff));
+		Bits = _mm256_add_epi32(Bits, PackedBits8(Diff));
+	}
+	int Result = HorizontalSum4(Fold8(Bits, true));
+	_mm256_zeroupper();
+	return Result + UndiffSSE2(pPast+i, pDiff+i, pOut+i, Size-i);
+}
+
+KERNEL_TARGET("avx2") static int SumAVX2(const int *pData, int Size)
+{
+	__m256i Sum = _mm256_setzero_si256();
+	int i = 0;
+	for(; i+8 <= Size; i += 8)
+		Sum = _mm256_add_epi32(Sum, _mm256_loadu_si256((const __m256i *)(pData+i)));
+	int Result = HorizontalSum4(Fold8(Sum, true));
+	_mm256_zeroupper();
+	return Result + SumSSE2(pData+i, Size-i);
+}
+
+#endif
+
+
+// new instruction sets (e.g. neon) only need an entry here, ordered from slowest to fastest
+static const CSnapshotKernels s_aKernels[] = {
+	{"scalar", 0, DiffScalar, UndiffScalar, SumScalar},
+#if defined(SNAPSHOT_KERNELS_X86)
+	{"sse2", CPU_FEATURE_SSE2, DiffSSE2, UndiffSSE2, SumSSE2},
+	{"avx2", CPU_FEATURE_SSE2|CPU_FEATURE_AVX2, DiffAVX2, UndiffAVX2, SumAVX2},
+#endif
+};
+
+// index into s_aKernels, -1 until the first call. published with an atomic
+// store as the first call can come from several threads at once
+static volatile int s_BestKernels = -1;
+
+bool CSnapshotKernels::Supported() const
+{
+	return (cpu_features()&m_RequiredFeatures) == m_RequiredFeatures;
+}
+
+const CSnapshotKernels *CSnapshotKernels::Best()
+{
+	int Best = atomic_load_acquire(&s_BestKernels);
+	if(Best == -1)
+	{
+		Best = Num()-1;
+		while(Best > 0 && !s_aKernels[Best].Supported())
+			Best--;
+		atomic_store_release(&s_BestKernels, Best);
+	}
+	return &s_aKernels[Best];
+}
+
+int CSnapshotKernels::Num()
+{
+	return sizeof(s_aKernels)/sizeof(s_aKernels[0]);
+}
+
+const CSnapshotKernels *CSnapshotKernels::Get(int Index)
+{
+	if(Index < 0 || Index >= Num())
+		return 0;
+	return &s_aKernels[Index];
+}
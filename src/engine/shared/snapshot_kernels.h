@@ -0,0 +1,33 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_SNAPSHOT_KERNELS_H
+#define ENGINE_SHARED_SNAPSHOT_KERNELS_H
+
+// inner loops of the snapshot delta coding, one set per instruction set
+class CSnapshotKernels
+{
+public:
+	// writes pCurrent-pPast to pOut, returns 0 if all differences are 0
+	typedef int (*FDiff)(const int *pPast, const int *pCurrent, int *pOut, int Size);
+	// writes pPast+pDiff to pOut, returns the bits the differences take when packed
+	typedef int (*FUndiff)(const int *pPast, const int *pDiff, int *pOut, int Size);
+	// returns the sum of all ints
+	typedef int (*FSum)(const int *pData, int Size);
+
+	const char *m_pName;
+	int m_RequiredFeatures; // CPU_FEATURE_* flags
+	FDiff m_pfnDiff;
+	FUndiff m_pfnUndiff;
+	FSum m_pfnSum;
+
+	bool Supported() const;
+
+	// the fastest set the cpu supports
+	static const CSnapshotKernels *Best();
+
+	// all compiled in sets, index 0 is the scalar one
+	static int Num();
+	static const CSnapshotKernels *Get(int Index);
+};
+
+#endif
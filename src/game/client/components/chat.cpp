@@ -510,6 +510,9 @@ void CChat::OnRender()
 	float FontSize = 6.0f;
 	CTextCursor Cursor;
 	int OffsetType = m_pClient->m_pScoreboard->Active() ? 1 : 0;
+
+	// the lines don't overlap, all outlines and all texts can be drawn at once
+	Graphics()->ReorderBegin();
 	for(int i = 0; i < MAX_LINES; i++)
 	{
 		int r = ((m_CurrentLine-i)+MAX_LINES)%MAX_LINES;
@@ -565,6 +568,7 @@ void CChat::OnRender()
 
 		TextRender()->TextEx(&Cursor, m_aLines[r].m_aText, -1);
 	}
+	Graphics()->ReorderEnd();
 
 	TextRender()->TextColor(1.0f, 1.0f, 1.0f, 1.0f);
 }
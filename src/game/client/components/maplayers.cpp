@@ -35,6 +35,7 @@ void CMapLayers::LoadBackgroundMap()
 	int HourOfTheDay = time_houroftheday();
 	char aBuf[128];
 	str_format(aBuf, sizeof(aBuf), "ui/%s_%s.map", g_Config.m_ClMenuMap, (HourOfTheDay >= 6 && HourOfTheDay < 18) ? "day" : "night");
+	DestroyTileBuffers(m_lTileBuffersMenu);
 	if(!m_pMenuMap->Load(aBuf, m_pClient->Storage()))
 	{
 		str_format(aBuf, sizeof(aBuf), "map '%s' not found", g_Config.m_ClMenuMap);
@@ -49,6 +50,7 @@ void CMapLayers::LoadBackgroundMap()
 	RenderTools()->RenderTilemapGenerateSkip(m_pMenuLayers);
 	m_pClient->m_pMapimages->OnMenuMapLoad(m_pMenuMap);
 	LoadEnvPoints(m_pMenuLayers, m_lEnvPointsMenu);
+	CreateTileBuffers(m_pMenuLayers, m_lTileBuffersMenu, true);
 }
 
 void CMapLayers::OnInit()
@@ -65,7 +67,47 @@ void CMapLayers::OnInit()
 void CMapLayers::OnMapLoad()
 {
 	if(Layers())
+	{
 		LoadEnvPoints(Layers(), m_lEnvPoints);
+		CreateTileBuffers(Layers(), m_lTileBuffers, false);
+	}
+}
+
+void CMapLayers::CreateTileBuffers(CLayers *pLayers, array<CTilemapBuffer>& lBuffers, bool AllLayers)
+{
+	DestroyTileBuffers(lBuffers);
+	for(int i = 0; i < pLayers->NumLayers(); i++)
+		lBuffers.add(CTilemapBuffer());
+
+	// the game map is split between background and foreground, only build what gets rendered here
+	bool PassedGameLayer = false;
+	for(int g = 0; g < pLayers->NumGroups(); g++)
+	{
+		CMapItemGroup *pGroup = pLayers->GetGroup(g);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			CMapItemLayer *pLayer = pLayers->GetLayer(pGroup->m_StartLayer+l);
+			if(pLayer == (CMapItemLayer*)pLayers->GameLayer())
+			{
+				PassedGameLayer = true;
+				continue;
+			}
+			if(pLayer->m_Type != LAYERTYPE_TILES || (!AllLayers && m_Type != -1 && PassedGameLayer != (m_Type == TYPE_FOREGROUND)))
+				continue;
+
+			CMapItemLayerTilemap *pTMap = (CMapItemLayerTilemap *)pLayer;
+			CTile *pTiles = (CTile *)pLayers->Map()->GetData(pTMap->m_Data);
+			RenderTools()->CreateTilemapBuffer(&lBuffers[pGroup->m_StartLayer+l], pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f);
+		}
+	}
+}
+
+void CMapLayers::DestroyTileBuffers(array<CTilemapBuffer>& lBuffers)
+{
+	for(int i = 0; i < lBuffers.size(); i++)
+		if(lBuffers[i].m_pOpaqueStarts)
+			RenderTools()->DestroyTilemapBuffer(&lBuffers[i]);
+	lBuffers.clear();
 }
 
 void CMapLayers::LoadEnvPoints(const CLayers *pLayers, array<CEnvPoint>& lEnvPoints)
@@ -233,6 +275,7 @@ void CMapLayers::OnRender()
 	vec2 Center = m_pClient->m_pCamera->m_Center;
 
 	bool PassedGameLayer = false;
+	array<CTilemapBuffer>& lTileBuffers = pLayers == m_pMenuLayers ? m_lTileBuffersMenu : m_lTileBuffers;
 
 	for(int g = 0; g < pLayers->NumGroups(); g++)
 	{
@@ -319,11 +362,25 @@ void CMapLayers::OnRender()
 					CTile *pTiles = (CTile *)pLayers->Map()->GetData(pTMap->m_Data);
 					Graphics()->BlendNone();
 					vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f);
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
-					Graphics()->BlendNormal();
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					int LayerIndex = pGroup->m_StartLayer+l;
+					if(LayerIndex < lTileBuffers.size() && lTileBuffers[LayerIndex].m_Buffer.IsValid())
+					{
+						// the quads are built already, only refer to the chunks on screen
+						const CTilemapBuffer *pBuffer = &lTileBuffers[LayerIndex];
+						RenderTools()->RenderTilemapBuffer(pBuffer, pTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemapBuffer(pBuffer, pTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
+					else
+					{
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
 				}
 				else if(pLayer->m_Type == LAYERTYPE_QUADS)
 				{
@@ -18,10 +18,16 @@ class CMapLayers : public CComponent
 	array<CEnvPoint> m_lEnvPoints;
 	array<CEnvPoint> m_lEnvPointsMenu;
 
+	// the quads of the tile layers, by layer index
+	array<CTilemapBuffer> m_lTileBuffers;
+	array<CTilemapBuffer> m_lTileBuffersMenu;
+
 	static void EnvelopeEval(float TimeOffset, int Env, float *pChannels, void *pUser);
 
 	void LoadBackgroundMap();
 	void LoadEnvPoints(const CLayers *pLayers, array<CEnvPoint>& lEnvPoints);
+	void CreateTileBuffers(CLayers *pLayers, array<CTilemapBuffer>& lBuffers, bool AllLayers);
+	void DestroyTileBuffers(array<CTilemapBuffer>& lBuffers);
 
 public:
 	enum
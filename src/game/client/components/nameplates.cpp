@@ -62,6 +62,8 @@ void CNamePlates::OnRender()
 	if (!g_Config.m_ClNameplates)
 		return;
 
+	// draws the outlines of all names first and their texts over them
+	Graphics()->ReorderBegin();
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// only render active characters
@@ -79,4 +81,5 @@ void CNamePlates::OnRender()
 				i);
 		}
 	}
+	Graphics()->ReorderEnd();
 }
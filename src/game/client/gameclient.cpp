@@ -288,6 +288,7 @@ void CGameClient::OnInit()
 		m_pMenus->RenderLoading();
 	}
 
+	m_Prediction.Init(Collision());
 	OnReset();
 
 	int64 End = time_get();
@@ -337,6 +338,7 @@ void CGameClient::OnConnected()
 {
 	m_Layers.Init(Kernel());
 	m_Collision.Init(Layers());
+	m_Prediction.Reset();
 
 	RenderTools()->RenderTilemapGenerateSkip(Layers());
 
@@ -356,6 +358,7 @@ void CGameClient::OnReset()
 {
 	// clear out the invalid pointers
 	m_LastNewPredictedTick = -1;
+	m_Prediction.Reset();
 	mem_zero(&m_Snap, sizeof(m_Snap));
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -1183,69 +1186,36 @@ void CGameClient::OnPredict()
 		return;
 	}
 
-	// repredict character
-	CWorldCore World;
-	World.m_Tuning = m_Tuning;
-
-	// search for players
+	// repredict the characters, only the ticks that weren't predicted from this snapshot before
+	int GameTick = Client()->GameTick();
+	int PredTick = Client()->PredGameTick();
+	const CNetObj_CharacterCore *apSnapCores[MAX_CLIENTS];
 	for(int i = 0; i < MAX_CLIENTS; i++)
-	{
-		if(!m_Snap.m_aCharacters[i].m_Active)
-			continue;
+		apSnapCores[i] = m_Snap.m_aCharacters[i].m_Active ? &m_Snap.m_aCharacters[i].m_Cur : 0;
 
-		m_aClients[i].m_Predicted.Init(&World, Collision());
-		World.m_apCharacters[i] = &m_aClients[i].m_Predicted;
-		m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
-	}
-
-	// predict
-	for(int Tick = Client()->GameTick()+1; Tick <= Client()->PredGameTick(); Tick++)
+	CNetObj_PlayerInput aInputs[CPrediction::HISTORY_SIZE];
+	for(int Tick = GameTick+1; Tick <= PredTick; Tick++)
 	{
-		// fetch the local
-		if(Tick == Client()->PredGameTick() && World.m_apCharacters[m_LocalClientID])
-			m_PredictedPrevChar = *World.m_apCharacters[m_LocalClientID];
-
-		// first calculate where everyone should move
-		for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if(!World.m_apCharacters[c])
-				continue;
-
-			mem_zero(&World.m_apCharacters[c]->m_Input, sizeof(World.m_apCharacters[c]->m_Input));
-			if(m_LocalClientID == c)
-			{
-				// apply player input
-				const int *pInput = Client()->GetInput(Tick);
-				if(pInput)
-					World.m_apCharacters[c]->m_Input = *((const CNetObj_PlayerInput*)pInput);
-				World.m_apCharacters[c]->Tick(true);
-			}
-			else
-				World.m_apCharacters[c]->Tick(false);
-
-		}
-
-		// move all players and quantize their data
-		for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if(!World.m_apCharacters[c])
-				continue;
-
-			World.m_apCharacters[c]->Move();
-			World.m_apCharacters[c]->Quantize();
-		}
+		const int *pInput = Client()->GetInput(Tick);
+		if(pInput)
+			aInputs[Tick-GameTick-1] = *((const CNetObj_PlayerInput*)pInput);
+		else
+			mem_zero(&aInputs[Tick-GameTick-1], sizeof(aInputs[Tick-GameTick-1]));
+	}
 
-		// check if we want to trigger effects
-		if(Tick > m_LastNewPredictedTick)
-		{
-			m_LastNewPredictedTick = Tick;
+	m_Prediction.Predict(&m_Tuning, apSnapCores, GameTick, PredTick, m_LocalClientID, aInputs);
 
-			if(m_LocalClientID != -1 && World.m_apCharacters[m_LocalClientID])
-				ProcessTriggeredEvents(World.m_apCharacters[m_LocalClientID]->m_TriggeredEvents, World.m_apCharacters[m_LocalClientID]->m_Pos);
-		}
+	// fetch the local
+	m_Prediction.GetCharacter(PredTick-1, m_LocalClientID, &m_PredictedPrevChar);
+	m_Prediction.GetCharacter(PredTick, m_LocalClientID, &m_PredictedChar);
 
-		if(Tick == Client()->PredGameTick() && World.m_apCharacters[m_LocalClientID])
-			m_PredictedChar = *World.m_apCharacters[m_LocalClientID];
+	// check if we want to trigger effects
+	for(int Tick = max(m_LastNewPredictedTick+1, GameTick+1); Tick <= PredTick; Tick++)
+	{
+		m_LastNewPredictedTick = Tick;
+		CCharacterCore Local;
+		if(m_Prediction.GetCharacter(Tick, m_LocalClientID, &Local))
+			ProcessTriggeredEvents(m_Prediction.TriggeredEvents(Tick), Local.m_Pos);
 	}
 
 	if(g_Config.m_Debug && g_Config.m_ClPredict && m_PredictedTick == Client()->PredGameTick())
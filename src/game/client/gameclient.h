@@ -8,6 +8,7 @@
 #include <engine/console.h>
 #include <game/layers.h>
 #include <game/gamecore.h>
+#include "prediction.h"
 #include "render.h"
 
 class CGameClient : public IGameClient
@@ -55,6 +56,7 @@ class CGameClient : public IGameClient
 
 	int m_PredictedTick;
 	int m_LastNewPredictedTick;
+	CPrediction m_Prediction;
 
 	static void ConKill(IConsole::IResult *pResult, void *pUserData);
 	static void ConReadyChange(IConsole::IResult *pResult, void *pUserData);
@@ -86,6 +88,7 @@ public:
 	const char *NetobjFailedOn() { return m_NetObjHandler.FailedObjOn(); };
 	int NetobjNumFailures() { return m_NetObjHandler.NumObjFailures(); };
 	const char *NetmsgFailedOn() { return m_NetObjHandler.FailedMsgOn(); };
+	const CPrediction::CStats *PredictionStats() const { return m_Prediction.Stats(); }
 	
 	bool m_SuppressEvents;
 
@@ -174,7 +177,6 @@ public:
 		int m_Team;
 		int m_Emoticon;
 		int m_EmoticonStart;
-		CCharacterCore m_Predicted;
 
 		CTeeRenderInfo m_SkinInfo; // this is what the server reports
 		CTeeRenderInfo m_RenderInfo; // this is what we use
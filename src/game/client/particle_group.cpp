@@ -0,0 +1,238 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <game/collision.h>
+
+#include "particle_group.h"
+
+#if defined(CONF_ARCH_IA32) || defined(CONF_ARCH_AMD64)
+	#define PARTICLES_X86 1
+	#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__)
+	#define KERNEL_TARGET(Target) __attribute__((target(Target)))
+#else
+	#define KERNEL_TARGET(Target)
+#endif
+
+
+// scalar passes, they also do what is left over after the vectorized ones
+
+static void IntegrateScalar(float *pVelX, float *pVelY, const float *pGravity, const float *pFriction, int Num, float TimePassed, int FrictionCount)
+{
+	for(int i = 0; i < Num; i++)
+		pVelY[i] += pGravity[i]*TimePassed;
+	for(int f = 0; f < FrictionCount; f++)
+		for(int i = 0; i < Num; i++)
+		{
+			pVelX[i] *= pFriction[i];
+			pVelY[i] *= pFriction[i];
+		}
+}
+
+static void StepScalar(const float *pPos, const float *pVel, float *pStep, float *pTarget, int Num, float TimePassed)
+{
+	for(int i = 0; i < Num; i++)
+	{
+		pStep[i] = pVel[i]*TimePassed;
+		pTarget[i] = pPos[i]+pStep[i];
+	}
+}
+
+static void AgeScalar(float *pLife, float *pRot, const float *pRotspeed, int Num, float TimePassed)
+{
+	for(int i = 0; i < Num; i++)
+	{
+		pLife[i] += TimePassed;
+		pRot[i] += TimePassed*pRotspeed[i];
+	}
+}
+
+
+#if defined(PARTICLES_X86)
+
+// sse2, four particles at a time
+
+KERNEL_TARGET("sse2") static void IntegrateSSE2(float *pVelX, float *pVelY, const float *pGravity, const float *pFriction, int Num, float TimePassed, int FrictionCount)
+{
+	__m128 Time = _mm_set1_ps(TimePassed);
+	int i = 0;
+	for(; i+4 <= Num; i += 4)
+	{
+		__m128 VelX = _mm_loadu_ps(pVelX+i);
+		__m128 VelY = _mm_add_ps(_mm_loadu_ps(pVelY+i), _mm_mul_ps(_mm_loadu_ps(pGravity+i), Time));
+		__m128 Friction = _mm_loadu_ps(pFriction+i);
+		for(int f = 0; f < FrictionCount; f++)
+		{
+			VelX = _mm_mul_ps(VelX, Friction);
+			VelY = _mm_mul_ps(VelY, Friction);
+		}
+		_mm_storeu_ps(pVelX+i, VelX);
+		_mm_storeu_ps(pVelY+i, VelY);
+	}
+	IntegrateScalar(pVelX+i, pVelY+i, pGravity+i, pFriction+i, Num-i, TimePassed, FrictionCount);
+}
+
+KERNEL_TARGET("sse2") static void StepSSE2(const float *pPos, const float *pVel, float *pStep, float *pTarget, int Num, float TimePassed)
+{
+	__m128 Time = _mm_set1_ps(TimePassed);
+	int i = 0;
+	for(; i+4 <= Num; i += 4)
+	{
+		__m128 Step = _mm_mul_ps(_mm_loadu_ps(pVel+i), Time);
+		_mm_storeu_ps(pStep+i, Step);
+		_mm_storeu_ps(pTarget+i, _mm_add_ps(_mm_loadu_ps(pPos+i), Step));
+	}
+	StepScalar(pPos+i, pVel+i, pStep+i, pTarget+i, Num-i, TimePassed);
+}
+
+KERNEL_TARGET("sse2") static void AgeSSE2(float *pLife, float *pRot, const float *pRotspeed, int Num, float TimePassed)
+{
+	__m128 Time = _mm_set1_ps(TimePassed);
+	int i = 0;
+	for(; i+4 <= Num; i += 4)
+	{
+		_mm_storeu_ps(pLife+i, _mm_add_ps(_mm_loadu_ps(pLife+i), Time));
+		_mm_storeu_ps(pRot+i, _mm_add_ps(_mm_loadu_ps(pRot+i), _mm_mul_ps(Time, _mm_loadu_ps(pRotspeed+i))));
+	}
+	AgeScalar(pLife+i, pRot+i, pRotspeed+i, Num-i, TimePassed);
+}
+
+#endif
+
+static bool UseSSE2()
+{
+#if defined(PARTICLES_X86)
+	static int s_Supported = -1;
+	if(s_Supported < 0)
+		s_Supported = (cpu_features()&CPU_FEATURE_SSE2) ? 1 : 0;
+	return s_Supported != 0;
+#else
+	return false;
+#endif
+}
+
+CParticleGroups::CParticleGroups()
+{
+	m_NumParticles = 0;
+}
+
+bool CParticleGroups::Add(int Group, const CParticle *pPart)
+{
+	if(m_NumParticles == MAX_PARTICLES)
+		return false;
+
+	int i = m_NumParticles++;
+	m_aPosX[i] = pPart->m_Pos.x;
+	m_aPosY[i] = pPart->m_Pos.y;
+	m_aVelX[i] = pPart->m_Vel.x;
+	m_aVelY[i] = pPart->m_Vel.y;
+	m_aGravity[i] = pPart->m_Gravity;
+	m_aFriction[i] = pPart->m_Friction;
+	m_aLife[i] = 0;
+	m_aLifeSpan[i] = pPart->m_LifeSpan;
+	m_aRot[i] = pPart->m_Rot;
+	m_aRotspeed[i] = pPart->m_Rotspeed;
+	m_aStartSize[i] = pPart->m_StartSize;
+	m_aEndSize[i] = pPart->m_EndSize;
+	m_aSpr[i] = pPart->m_Spr;
+	m_aColor[i] = pPart->m_Color;
+	m_aGroup[i] = Group;
+	return true;
+}
+
+void CParticleGroups::MoveDown(int To, int From, int Num)
+{
+	mem_move(&m_aPosX[To], &m_aPosX[From], Num*sizeof(m_aPosX[0]));
+	mem_move(&m_aPosY[To], &m_aPosY[From], Num*sizeof(m_aPosY[0]));
+	mem_move(&m_aVelX[To], &m_aVelX[From], Num*sizeof(m_aVelX[0]));
+	mem_move(&m_aVelY[To], &m_aVelY[From], Num*sizeof(m_aVelY[0]));
+	mem_move(&m_aGravity[To], &m_aGravity[From], Num*sizeof(m_aGravity[0]));
+	mem_move(&m_aFriction[To], &m_aFriction[From], Num*sizeof(m_aFriction[0]));
+	mem_move(&m_aLife[To], &m_aLife[From], Num*sizeof(m_aLife[0]));
+	mem_move(&m_aLifeSpan[To], &m_aLifeSpan[From], Num*sizeof(m_aLifeSpan[0]));
+	mem_move(&m_aRot[To], &m_aRot[From], Num*sizeof(m_aRot[0]));
+	mem_move(&m_aRotspeed[To], &m_aRotspeed[From], Num*sizeof(m_aRotspeed[0]));
+	mem_move(&m_aStartSize[To], &m_aStartSize[From], Num*sizeof(m_aStartSize[0]));
+	mem_move(&m_aEndSize[To], &m_aEndSize[From], Num*sizeof(m_aEndSize[0]));
+	mem_move(&m_aSpr[To], &m_aSpr[From], Num*sizeof(m_aSpr[0]));
+	mem_move(&m_aColor[To], &m_aColor[From], Num*sizeof(m_aColor[0]));
+	mem_move(&m_aGroup[To], &m_aGroup[From], Num*sizeof(m_aGroup[0]));
+}
+
+int CParticleGroups::Update(float TimePassed, int FrictionCount, const CCollision *pCollision, float Elasticity)
+{
+	int Num = m_NumParticles;
+	if(Num == 0)
+		return 0;
+
+	// gravity and friction, then where the particles would move to
+#if defined(PARTICLES_X86)
+	if(UseSSE2())
+	{
+		IntegrateSSE2(m_aVelX, m_aVelY, m_aGravity, m_aFriction, Num, TimePassed, FrictionCount);
+		StepSSE2(m_aPosX, m_aVelX, m_aStepX, m_aTargetX, Num, TimePassed);
+		StepSSE2(m_aPosY, m_aVelY, m_aStepY, m_aTargetY, Num, TimePassed);
+	}
+	else
+#endif
+	{
+		IntegrateScalar(m_aVelX, m_aVelY, m_aGravity, m_aFriction, Num, TimePassed, FrictionCount);
+		StepScalar(m_aPosX, m_aVelX, m_aStepX, m_aTargetX, Num, TimePassed);
+		StepScalar(m_aPosY, m_aVelY, m_aStepY, m_aTargetY, Num, TimePassed);
+	}
+
+	// the ones with a free target just move there, the others bounce like in MovePoint
+	pCollision->CheckPoints(m_aTargetX, m_aTargetY, Num, m_aBlocked);
+	float InvTime = 1.0f/TimePassed;
+	for(int i = 0; i < Num; i++)
+	{
+		if(!m_aBlocked[i])
+		{
+			m_aPosX[i] = m_aTargetX[i];
+			m_aPosY[i] = m_aTargetY[i];
+			m_aVelX[i] = m_aStepX[i]*InvTime;
+			m_aVelY[i] = m_aStepY[i]*InvTime;
+			continue;
+		}
+
+		vec2 Pos(m_aPosX[i], m_aPosY[i]);
+		vec2 Step(m_aStepX[i], m_aStepY[i]);
+		pCollision->MovePoint(&Pos, &Step, Elasticity < 0.0f ? 0.1f+0.9f*frandom() : Elasticity, 0);
+		m_aPosX[i] = Pos.x;
+		m_aPosY[i] = Pos.y;
+		m_aVelX[i] = Step.x*InvTime;
+		m_aVelY[i] = Step.y*InvTime;
+	}
+
+#if defined(PARTICLES_X86)
+	if(UseSSE2())
+		AgeSSE2(m_aLife, m_aRot, m_aRotspeed, Num, TimePassed);
+	else
+#endif
+		AgeScalar(m_aLife, m_aRot, m_aRotspeed, Num, TimePassed);
+
+	// remove the dead ones, the others keep their order. the oldest die first
+	// so the ones left mostly move down as one run
+	int Alive = 0;
+	for(int i = 0; i < Num;)
+	{
+		if(m_aLife[i] > m_aLifeSpan[i])
+		{
+			i++;
+			continue;
+		}
+		int End = i+1;
+		while(End < Num && m_aLife[End] <= m_aLifeSpan[End])
+			End++;
+		if(Alive != i)
+			MoveDown(Alive, i, End-i);
+		Alive += End-i;
+		i = End;
+	}
+	m_NumParticles = Alive;
+	return Num-Alive;
+}
@@ -0,0 +1,124 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_CLIENT_PARTICLE_GROUP_H
+#define GAME_CLIENT_PARTICLE_GROUP_H
+
+#include <base/vmath.h>
+
+// what a particle starts with
+struct CParticle
+{
+	void SetDefault()
+	{
+		m_Vel = vec2(0,0);
+		m_LifeSpan = 0;
+		m_StartSize = 32;
+		m_EndSize = 32;
+		m_Rot = 0;
+		m_Rotspeed = 0;
+		m_Gravity = 0;
+		m_Friction = 0;
+		m_FlowAffected = 1.0f;
+		m_Color = vec4(1,1,1,1);
+	}
+
+	vec2 m_Pos;
+	vec2 m_Vel;
+
+	int m_Spr;
+
+	float m_FlowAffected;
+
+	float m_LifeSpan;
+
+	float m_StartSize;
+	float m_EndSize;
+
+	float m_Rot;
+	float m_Rotspeed;
+
+	float m_Gravity;
+	float m_Friction;
+
+	vec4 m_Color;
+};
+
+/*
+	Class: CParticleGroups
+		Keeps the particles of all groups in one array per attribute, so
+		the groups share one budget like the free list did before. The
+		living ones are at the front in the order they were added, each
+		tagged with its group. Update runs each step as one pass over the
+		arrays, the moves check all target points against the tiles first
+		and only the particles that hit something bounce off the long way.
+*/
+class CParticleGroups
+{
+public:
+	enum
+	{
+		MAX_PARTICLES=1024*8, // of all groups together
+	};
+
+private:
+	int m_NumParticles;
+
+	float m_aPosX[MAX_PARTICLES];
+	float m_aPosY[MAX_PARTICLES];
+	float m_aVelX[MAX_PARTICLES];
+	float m_aVelY[MAX_PARTICLES];
+	float m_aGravity[MAX_PARTICLES];
+	float m_aFriction[MAX_PARTICLES];
+	float m_aLife[MAX_PARTICLES];
+	float m_aLifeSpan[MAX_PARTICLES];
+	float m_aRot[MAX_PARTICLES];
+	float m_aRotspeed[MAX_PARTICLES];
+	float m_aStartSize[MAX_PARTICLES];
+	float m_aEndSize[MAX_PARTICLES];
+	int m_aSpr[MAX_PARTICLES];
+	vec4 m_aColor[MAX_PARTICLES];
+	unsigned char m_aGroup[MAX_PARTICLES];
+
+	// where the particles move to this update
+	float m_aStepX[MAX_PARTICLES];
+	float m_aStepY[MAX_PARTICLES];
+	float m_aTargetX[MAX_PARTICLES];
+	float m_aTargetY[MAX_PARTICLES];
+	bool m_aBlocked[MAX_PARTICLES];
+
+	void MoveDown(int To, int From, int Num);
+
+public:
+	CParticleGroups();
+
+	void Reset() { m_NumParticles = 0; }
+	bool Add(int Group, const CParticle *pPart);
+
+	/*
+		Function: Update
+			Moves the particles and removes the ones that lived out their life span.
+
+		Parameters:
+			TimePassed - Seconds since the last update.
+			FrictionCount - How many times the friction gets applied.
+			pCollision - The tiles the particles bounce off.
+			Elasticity - How much of its speed a particle keeps when it bounces,
+				a random amount for every bounce when it is negative.
+
+		Returns:
+			The number of particles that got removed.
+	*/
+	int Update(float TimePassed, int FrictionCount, const class CCollision *pCollision, float Elasticity=-1.0f);
+
+	int Num() const { return m_NumParticles; }
+	int Group(int Index) const { return m_aGroup[Index]; }
+	vec2 Pos(int Index) const { return vec2(m_aPosX[Index], m_aPosY[Index]); }
+	vec2 Vel(int Index) const { return vec2(m_aVelX[Index], m_aVelY[Index]); }
+	float Life(int Index) const { return m_aLife[Index]; }
+	float Size(int Index) const { return mix(m_aStartSize[Index], m_aEndSize[Index], m_aLife[Index]/m_aLifeSpan[Index]); }
+	float Rot(int Index) const { return m_aRot[Index]; }
+	int Sprite(int Index) const { return m_aSpr[Index]; }
+	const vec4 &Color(int Index) const { return m_aColor[Index]; }
+};
+
+#endif
@@ -0,0 +1,181 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include "prediction.h"
+
+CPrediction::CPrediction()
+{
+	m_pCollision = 0;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	Reset();
+}
+
+void CPrediction::Init(CCollision *pCollision)
+{
+	m_pCollision = pCollision;
+	Reset();
+}
+
+void CPrediction::Reset()
+{
+	m_FirstTick = 0;
+	m_LastTick = -1;
+	m_LocalClientID = -1;
+	for(int i = 0; i < HISTORY_SIZE; i++)
+		m_aHistory[i].m_Tick = -1;
+}
+
+bool CPrediction::Matches(int Tick, const CNetObj_CharacterCore **ppSnapCores) const
+{
+	const CTickState *pState = State(Tick);
+	if(pState->m_Tick != Tick)
+		return false;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pState->m_aActive[i] != (ppSnapCores[i] != 0))
+			return false;
+		if(!ppSnapCores[i])
+			continue;
+
+		// the snapshot has the tick of the character in it, the prediction doesn't
+		CNetObj_CharacterCore Core = *ppSnapCores[i];
+		Core.m_Tick = 0;
+		if(mem_comp(&Core, &pState->m_aCores[i], sizeof(Core)) != 0)
+			return false;
+	}
+	return true;
+}
+
+int CPrediction::Predict(const CTuningParams *pTuning, const CNetObj_CharacterCore **ppSnapCores, int SnapTick, int PredTick,
+	int LocalClientID, const CNetObj_PlayerInput *pInputs)
+{
+	dbg_assert(PredTick-SnapTick < HISTORY_SIZE, "predicting too far ahead");
+	m_Stats.m_NumPredictions++;
+
+	// the predicted ticks hold as long as the snapshot matches them and
+	// the inputs are still the same, only what comes after gets simulated
+	int From = SnapTick;
+	if(SnapTick >= m_FirstTick && SnapTick <= m_LastTick && LocalClientID == m_LocalClientID &&
+		mem_comp(pTuning, &m_Tuning, sizeof(m_Tuning)) == 0 && Matches(SnapTick, ppSnapCores))
+	{
+		int Last = min(m_LastTick, PredTick);
+		while(From < Last && mem_comp(&State(From+1)->m_Input, &pInputs[From-SnapTick], sizeof(CNetObj_PlayerInput)) == 0)
+			From++;
+	}
+	else
+	{
+		// start over from the snapshot
+		m_Stats.m_NumReplays++;
+		m_FirstTick = SnapTick;
+		m_LastTick = SnapTick;
+		m_LocalClientID = LocalClientID;
+		m_Tuning = *pTuning;
+
+		CTickState *pState = State(SnapTick);
+		pState->m_Tick = SnapTick;
+		pState->m_Events = 0;
+		mem_zero(&pState->m_Input, sizeof(pState->m_Input));
+		mem_zero(pState->m_aCores, sizeof(pState->m_aCores));
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			pState->m_aActive[i] = ppSnapCores[i] != 0;
+			if(ppSnapCores[i])
+			{
+				pState->m_aCores[i] = *ppSnapCores[i];
+				pState->m_aCores[i].m_Tick = 0;
+			}
+		}
+	}
+
+	m_Stats.m_LastTicks = max(PredTick-From, 0);
+	if(From >= PredTick)
+		return 0;
+
+	// continue from the last tick that still holds
+	m_World.m_Tuning = m_Tuning;
+	const CTickState *pFrom = State(From);
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_World.m_apCharacters[i] = 0;
+		if(!pFrom->m_aActive[i])
+			continue;
+
+		m_aCharacters[i].Init(&m_World, m_pCollision);
+		m_aCharacters[i].Read(&pFrom->m_aCores[i]);
+		m_World.m_apCharacters[i] = &m_aCharacters[i];
+	}
+
+	for(int Tick = From+1; Tick <= PredTick; Tick++)
+	{
+		const CNetObj_PlayerInput *pInput = &pInputs[Tick-SnapTick-1];
+
+		// first calculate where everyone should move
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(!m_World.m_apCharacters[c])
+				continue;
+
+			if(c == LocalClientID)
+			{
+				// apply player input
+				m_World.m_apCharacters[c]->m_Input = *pInput;
+				m_World.m_apCharacters[c]->Tick(true);
+			}
+			else
+			{
+				mem_zero(&m_World.m_apCharacters[c]->m_Input, sizeof(m_World.m_apCharacters[c]->m_Input));
+				m_World.m_apCharacters[c]->Tick(false);
+			}
+		}
+
+		// move all players and quantize their data
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(!m_World.m_apCharacters[c])
+				continue;
+
+			m_World.m_apCharacters[c]->Move();
+			m_World.m_apCharacters[c]->Quantize();
+		}
+
+		// remember the tick
+		CTickState *pState = State(Tick);
+		pState->m_Tick = Tick;
+		pState->m_Input = *pInput;
+		pState->m_Events = m_World.m_apCharacters[LocalClientID] ? m_World.m_apCharacters[LocalClientID]->m_TriggeredEvents : 0;
+		mem_zero(pState->m_aCores, sizeof(pState->m_aCores));
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			pState->m_aActive[c] = m_World.m_apCharacters[c] != 0;
+			if(m_World.m_apCharacters[c])
+				m_World.m_apCharacters[c]->Write(&pState->m_aCores[c]);
+		}
+	}
+
+	m_LastTick = PredTick;
+	m_FirstTick = max(m_FirstTick, PredTick-HISTORY_SIZE+1);
+	m_Stats.m_NumTicks += PredTick-From;
+	return PredTick-From;
+}
+
+bool CPrediction::GetCharacter(int Tick, int ClientID, CCharacterCore *pCharacter) const
+{
+	const CTickState *pState = State(Tick);
+	if(Tick < m_FirstTick || Tick > m_LastTick || pState->m_Tick != Tick || !pState->m_aActive[ClientID])
+		return false;
+
+	pCharacter->Reset();
+	pCharacter->Read(&pState->m_aCores[ClientID]);
+	return true;
+}
+
+int CPrediction::TriggeredEvents(int Tick) const
+{
+	const CTickState *pState = State(Tick);
+	if(Tick < m_FirstTick || Tick > m_LastTick || pState->m_Tick != Tick)
+		return 0;
+	return pState->m_Events;
+}
@@ -0,0 +1,92 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_CLIENT_PREDICTION_H
+#define GAME_CLIENT_PREDICTION_H
+
+#include <game/gamecore.h>
+
+/*
+	Class: CPrediction
+		Predicts the characters from a snapshot up to the predicted tick
+		and keeps the predicted world of every tick. While the snapshots
+		match what was predicted for their tick only the new ticks are
+		simulated, otherwise the prediction starts over from the snapshot.
+*/
+class CPrediction
+{
+public:
+	enum
+	{
+		HISTORY_SIZE=64, // the client predicts less than 50 ticks ahead
+	};
+
+	struct CStats
+	{
+		int64 m_NumPredictions;
+		int64 m_NumTicks; // simulated ticks
+		int64 m_NumReplays; // predictions that started over from the snapshot
+		int m_LastTicks;
+	};
+
+private:
+	struct CTickState
+	{
+		int m_Tick;
+		CNetObj_PlayerInput m_Input; // of the local character
+		int m_Events; // triggered by the local character
+		bool m_aActive[MAX_CLIENTS];
+		CNetObj_CharacterCore m_aCores[MAX_CLIENTS];
+	};
+
+	CCollision *m_pCollision;
+	CWorldCore m_World;
+	CCharacterCore m_aCharacters[MAX_CLIENTS];
+
+	// the ticks from m_FirstTick to m_LastTick are predicted from the same snapshot
+	CTickState m_aHistory[HISTORY_SIZE];
+	int m_FirstTick;
+	int m_LastTick;
+	int m_LocalClientID;
+	CTuningParams m_Tuning;
+
+	CStats m_Stats;
+
+	CTickState *State(int Tick) { return &m_aHistory[Tick%HISTORY_SIZE]; }
+	const CTickState *State(int Tick) const { return &m_aHistory[Tick%HISTORY_SIZE]; }
+	bool Matches(int Tick, const CNetObj_CharacterCore **ppSnapCores) const;
+
+public:
+	CPrediction();
+
+	void Init(CCollision *pCollision);
+
+	// forgets the predicted ticks, for when the map changes
+	void Reset();
+
+	/*
+		Function: Predict
+			Brings the prediction up to PredTick.
+
+		Parameters:
+			pTuning - The tuning to predict with.
+			ppSnapCores - The characters of the snapshot, 0 for the ones that aren't in it.
+			SnapTick - Tick of the snapshot.
+			PredTick - Tick to predict to, less than HISTORY_SIZE ticks after SnapTick.
+			LocalClientID - The character that gets the inputs.
+			pInputs - Inputs of the local character for the ticks after SnapTick.
+
+		Returns:
+			The number of ticks that were simulated.
+	*/
+	int Predict(const CTuningParams *pTuning, const CNetObj_CharacterCore **ppSnapCores, int SnapTick, int PredTick,
+		int LocalClientID, const CNetObj_PlayerInput *pInputs);
+
+	// predicted character at a tick, false if it isn't in the world or the tick isn't predicted
+	bool GetCharacter(int Tick, int ClientID, CCharacterCore *pCharacter) const;
+	// events the local character triggered at a predicted tick
+	int TriggeredEvents(int Tick) const;
+
+	const CStats *Stats() const { return &m_Stats; }
+};
+
+#endif
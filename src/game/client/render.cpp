@@ -525,6 +525,17 @@ void CRenderTools::MapScreenToGroup(float CenterX, float CenterY, CMapItemGroup
 
 void CRenderTools::RenderTilemapGenerateSkip(class CLayers *pLayers)
 {
+	// every tile layer is needed, decompress them all at once
+	int *pIndices = (int *)mem_alloc(max(pLayers->NumLayers(), 1)*sizeof(int), 1);
+	int NumIndices = 0;
+	for(int l = 0; l < pLayers->NumLayers(); l++)
+	{
+		CMapItemLayer *pLayer = pLayers->GetLayer(l);
+		if(pLayer->m_Type == LAYERTYPE_TILES)
+			pIndices[NumIndices++] = ((CMapItemLayerTilemap *)pLayer)->m_Data;
+	}
+	pLayers->Map()->LoadData(pIndices, NumIndices);
+	mem_free(pIndices);
 
 	for(int g = 0; g < pLayers->NumGroups(); g++)
 	{
@@ -37,6 +37,36 @@ enum
 	TILERENDERFLAG_EXTEND=4,
 };
 
+/*
+	Class: CTilemapBuffer
+		The quads of a tile layer, built once and kept by the graphics
+		backend. The layer is split into chunks of CHUNK_SIZE*CHUNK_SIZE
+		tiles so a frame only refers to the chunks that are on screen.
+		The quads of opaque tiles come first, then the others, both in
+		chunk order so a row of chunks is one range of quads.
+*/
+class CTilemapBuffer
+{
+public:
+	enum
+	{
+		CHUNK_SIZE=32,
+	};
+
+	IGraphics::CBufferHandle m_Buffer;
+	int m_Width;
+	int m_Height;
+	float m_Scale;
+	int m_NumChunksX;
+	int m_NumChunksY;
+
+	// first quad of every chunk and one past the last chunk
+	int *m_pOpaqueStarts;
+	int *m_pTransparentStarts;
+
+	CTilemapBuffer() : m_pOpaqueStarts(0), m_pTransparentStarts(0) {}
+};
+
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
 
 class CRenderTools
@@ -73,6 +103,11 @@ public:
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
 
+	// tile layers that don't change, the tiles have to stay around for the extended borders
+	void CreateTilemapBuffer(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale);
+	void DestroyTilemapBuffer(CTilemapBuffer *pBuffer);
+	void RenderTilemapBuffer(const CTilemapBuffer *pBuffer, CTile *pTiles, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+
 	// helpers
 	void MapScreenToWorld(float CenterX, float CenterY, float ParallaxX, float ParallaxY,
 		float OffsetX, float OffsetY, float Aspect, float Zoom, float aPoints[4]);
@@ -330,6 +330,52 @@ void CRenderTools::RenderQuads(CQuad *pQuads, int NumQuads, int RenderFlags, ENV
 	Graphics()->WrapNormal();
 }
 
+static void RenderTile(IGraphics *pGraphics, const CTile *pTile, float x, float y, float Scale)
+{
+	float x0 = 0;
+	float y0 = 0;
+	float x1 = 1;
+	float y1 = 0;
+	float x2 = 1;
+	float y2 = 1;
+	float x3 = 0;
+	float y3 = 1;
+
+	if(pTile->m_Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(pTile->m_Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(pTile->m_Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pGraphics->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3, pTile->m_Index);
+	IGraphics::CQuadItem QuadItem(x, y, Scale, Scale);
+	pGraphics->QuadsDrawTL(&QuadItem, 1);
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -404,54 +450,135 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 				}
 
 				if(Render)
+					RenderTile(Graphics(), &pTiles[c], x*Scale, y*Scale, Scale);
+			}
+			x += pTiles[c].m_Skip;
+		}
+
+	Graphics()->QuadsEnd();
+	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
+}
+
+void CRenderTools::CreateTilemapBuffer(CTilemapBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale)
+{
+	pBuffer->m_Width = w;
+	pBuffer->m_Height = h;
+	pBuffer->m_Scale = Scale;
+	pBuffer->m_NumChunksX = (w+CTilemapBuffer::CHUNK_SIZE-1)/CTilemapBuffer::CHUNK_SIZE;
+	pBuffer->m_NumChunksY = (h+CTilemapBuffer::CHUNK_SIZE-1)/CTilemapBuffer::CHUNK_SIZE;
+	int NumChunks = pBuffer->m_NumChunksX*pBuffer->m_NumChunksY;
+	pBuffer->m_pOpaqueStarts = (int *)mem_alloc(2*(NumChunks+1)*sizeof(int), 1);
+	pBuffer->m_pTransparentStarts = pBuffer->m_pOpaqueStarts+NumChunks+1;
+
+	// opaque tiles first, then the others
+	int NumQuads = 0;
+	Graphics()->QuadBufferBegin();
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		int *pStarts = Pass == 0 ? pBuffer->m_pOpaqueStarts : pBuffer->m_pTransparentStarts;
+		for(int c = 0; c < NumChunks; c++)
+		{
+			pStarts[c] = NumQuads;
+			int StartX = (c%pBuffer->m_NumChunksX)*CTilemapBuffer::CHUNK_SIZE;
+			int StartY = (c/pBuffer->m_NumChunksX)*CTilemapBuffer::CHUNK_SIZE;
+			int EndX = min(StartX+(int)CTilemapBuffer::CHUNK_SIZE, w);
+			int EndY = min(StartY+(int)CTilemapBuffer::CHUNK_SIZE, h);
+			for(int y = StartY; y < EndY; y++)
+				for(int x = StartX; x < EndX; x++)
 				{
-					float x0 = 0;
-					float y0 = 0;
-					float x1 = 1;
-					float y1 = 0;
-					float x2 = 1;
-					float y2 = 1;
-					float x3 = 0;
-					float y3 = 1;
-
-					if(Flags&TILEFLAG_VFLIP)
+					const CTile *pTile = &pTiles[y*w+x];
+					if(pTile->m_Index && ((pTile->m_Flags&TILEFLAG_OPAQUE) != 0) == (Pass == 0))
 					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
+						RenderTile(Graphics(), pTile, x*Scale, y*Scale, Scale);
+						NumQuads++;
 					}
+				}
+		}
+		pStarts[NumChunks] = NumQuads;
+	}
+	pBuffer->m_Buffer = Graphics()->QuadBufferEnd();
+}
 
-					if(Flags&TILEFLAG_HFLIP)
-					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
-					}
+void CRenderTools::DestroyTilemapBuffer(CTilemapBuffer *pBuffer)
+{
+	Graphics()->UnloadQuadBuffer(pBuffer->m_Buffer);
+	pBuffer->m_Buffer = IGraphics::CBufferHandle();
+	mem_free(pBuffer->m_pOpaqueStarts);
+	pBuffer->m_pOpaqueStarts = 0;
+	pBuffer->m_pTransparentStarts = 0;
+}
 
-					if(Flags&TILEFLAG_ROTATE)
-					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
- 					}
-
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3, Index);
-					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
-					Graphics()->QuadsDrawTL(&QuadItem, 1);
-				}
-			}
-			x += pTiles[c].m_Skip;
+void CRenderTools::RenderTilemapBuffer(const CTilemapBuffer *pBuffer, CTile *pTiles, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	float r=1, g=1, b=1, a=1;
+	if(ColorEnv >= 0)
+	{
+		float aChannels[4];
+		pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+		r = aChannels[0];
+		g = aChannels[1];
+		b = aChannels[2];
+		a = aChannels[3];
+	}
+
+	int w = pBuffer->m_Width;
+	int h = pBuffer->m_Height;
+	float Scale = pBuffer->m_Scale;
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	// opaque tiles only count as opaque while the layer is
+	bool Opaque = Color.a*a > 254.0f/255.0f;
+	bool RenderOpaque = (RenderFlags&(Opaque ? LAYERRENDERFLAG_OPAQUE : LAYERRENDERFLAG_TRANSPARENT)) != 0;
+	bool RenderTransparent = (RenderFlags&LAYERRENDERFLAG_TRANSPARENT) != 0;
+
+	// the chunks on screen, every row of them is one range of quads
+	if(max(StartX, 0) < min(EndX, w) && max(StartY, 0) < min(EndY, h))
+	{
+		int ChunkX0 = max(StartX, 0)/CTilemapBuffer::CHUNK_SIZE;
+		int ChunkX1 = (min(EndX, w)-1)/CTilemapBuffer::CHUNK_SIZE;
+		int ChunkY0 = max(StartY, 0)/CTilemapBuffer::CHUNK_SIZE;
+		int ChunkY1 = (min(EndY, h)-1)/CTilemapBuffer::CHUNK_SIZE;
+		for(int cy = ChunkY0; cy <= ChunkY1; cy++)
+		{
+			int First = cy*pBuffer->m_NumChunksX+ChunkX0;
+			int End = cy*pBuffer->m_NumChunksX+ChunkX1+1;
+			if(RenderOpaque)
+				Graphics()->RenderQuadBuffer(pBuffer->m_Buffer, pBuffer->m_pOpaqueStarts[First], pBuffer->m_pOpaqueStarts[End]-pBuffer->m_pOpaqueStarts[First],
+					Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+			if(RenderTransparent)
+				Graphics()->RenderQuadBuffer(pBuffer->m_Buffer, pBuffer->m_pTransparentStarts[First], pBuffer->m_pTransparentStarts[End]-pBuffer->m_pTransparentStarts[First],
+					Color.r*r, Color.g*g, Color.b*b, Color.a*a);
 		}
+	}
+
+	// outside of the map the border tiles get extended, those aren't in the buffer
+	if(!(RenderFlags&TILERENDERFLAG_EXTEND) || (StartX >= 0 && StartY >= 0 && EndX <= w && EndY <= h))
+		return;
+
+	Graphics()->QuadsBegin();
+	Graphics()->SetColor(Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+	for(int y = StartY; y < EndY; y++)
+	{
+		int my = clamp(y, 0, h-1);
+		for(int x = StartX; x < EndX; x++)
+		{
+			if(x >= 0 && x < w && y == my)
+			{
+				x = w-1;
+				continue;
+			}
 
+			const CTile *pTile = &pTiles[my*w+clamp(x, 0, w-1)];
+			if(pTile->m_Index && (pTile->m_Flags&TILEFLAG_OPAQUE ? RenderOpaque : RenderTransparent))
+				RenderTile(Graphics(), pTile, x*Scale, y*Scale, Scale);
+		}
+	}
 	Graphics()->QuadsEnd();
-	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
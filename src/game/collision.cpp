@@ -51,12 +51,18 @@ void CCollision::Init(class CLayers *pLayers)
 	}
 }
 
-int CCollision::GetTile(int x, int y) const
+int CCollision::GetTileIndex(int x, int y) const
 {
 	int Nx = clamp(x/32, 0, m_Width-1);
 	int Ny = clamp(y/32, 0, m_Height-1);
 
-	return m_pTiles[Ny*m_Width+Nx].m_Index > 128 ? 0 : m_pTiles[Ny*m_Width+Nx].m_Index;
+	return Ny*m_Width+Nx;
+}
+
+int CCollision::GetTile(int x, int y) const
+{
+	int Index = GetTileIndex(x, y);
+	return m_pTiles[Index].m_Index > 128 ? 0 : m_pTiles[Index].m_Index;
 }
 
 bool CCollision::IsTileSolid(int x, int y) const
@@ -64,26 +70,56 @@ bool CCollision::IsTileSolid(int x, int y) const
 	return GetTile(x, y)&COLFLAG_SOLID;
 }
 
-// TODO: rewrite this smarter!
+// the samples of the line are the points the original per pixel walk tested. the
+// tile of a sample only moves forward along the line, so all samples that fall
+// into a free tile can be skipped at once without changing which one hits first
+static vec2 LineSample(vec2 Pos0, vec2 Pos1, int i, int End)
+{
+	float a = i/float(End);
+	return mix(Pos0, Pos1, a);
+}
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance+1);
-	vec2 Last = Pos0;
+	vec2 Dir = Pos1-Pos0;
 
-	for(int i = 0; i < End; i++)
+	int i = 0;
+	while(i < End)
 	{
-		float a = i/float(End);
-		vec2 Pos = mix(Pos0, Pos1, a);
-		if(CheckPoint(Pos.x, Pos.y))
+		vec2 Pos = LineSample(Pos0, Pos1, i, End);
+		int Tile = GetTileIndex(round_to_int(Pos.x), round_to_int(Pos.y));
+		if(m_pTiles[Tile].m_Index <= 128 && m_pTiles[Tile].m_Index&COLFLAG_SOLID)
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(Pos.x, Pos.y);
+				*pOutBeforeCollision = i > 0 ? LineSample(Pos0, Pos1, i-1, End) : Pos0;
+			return m_pTiles[Tile].m_Index;
 		}
-		Last = Pos;
+
+		// estimate the last sample in this tile from where the line crosses
+		// its borders, pixels are rounded so the borders are half a pixel off
+		int Tx = Tile%m_Width;
+		int Ty = Tile/m_Width;
+		float Exit = 1.0f;
+		if(Dir.x > 0 && Tx < m_Width-1)
+			Exit = min(Exit, ((Tx+1)*32-0.5f-Pos0.x)/Dir.x);
+		else if(Dir.x < 0 && Tx > 0)
+			Exit = min(Exit, (Tx*32-0.5f-Pos0.x)/Dir.x);
+		if(Dir.y > 0 && Ty < m_Height-1)
+			Exit = min(Exit, ((Ty+1)*32-0.5f-Pos0.y)/Dir.y);
+		else if(Dir.y < 0 && Ty > 0)
+			Exit = min(Exit, (Ty*32-0.5f-Pos0.y)/Dir.y);
+
+		// and correct it with the exact samples
+		int Last = clamp((int)(max(Exit, 0.0f)*End), i, End-1);
+		while(Last+1 < End && GetSampleTile(Pos0, Pos1, Last+1, End) == Tile)
+			Last++;
+		while(Last > i && GetSampleTile(Pos0, Pos1, Last, End) != Tile)
+			Last--;
+		i = Last+1;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -92,6 +128,12 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	return 0;
 }
 
+int CCollision::GetSampleTile(vec2 Pos0, vec2 Pos1, int i, int End) const
+{
+	vec2 Pos = LineSample(Pos0, Pos1, i, End);
+	return GetTileIndex(round_to_int(Pos.x), round_to_int(Pos.y));
+}
+
 // TODO: OPT: rewrite this smarter!
 void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces) const
 {
@@ -131,6 +173,15 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 	}
 }
 
+void CCollision::CheckPoints(const float *pX, const float *pY, int Num, bool *pSolid) const
+{
+	for(int i = 0; i < Num; i++)
+	{
+		int Index = GetTileIndex(round_to_int(pX[i]), round_to_int(pY[i]));
+		pSolid[i] = m_pTiles[Index].m_Index <= 128 && (m_pTiles[Index].m_Index&COLFLAG_SOLID);
+	}
+}
+
 bool CCollision::TestBox(vec2 Pos, vec2 Size) const
 {
 	Size *= 0.5f;
@@ -145,6 +196,45 @@ bool CCollision::TestBox(vec2 Pos, vec2 Size) const
 	return false;
 }
 
+// checks if the box can't hit anything when it moves Steps times by Step.
+// only tiles that a corner can get into are looked at, the range of the
+// corners is widened by the error the repeated adding of Step can have
+bool CCollision::TestBoxPathFree(vec2 Pos, vec2 Step, int Steps, vec2 Size) const
+{
+	Size *= 0.5f;
+	vec2 End = Pos + Step*(float)Steps;
+	float Margin = (Steps+2)*(max(absolute(Pos.x), absolute(Pos.y))+max(absolute(End.x), absolute(End.y))+1.0f)/(1<<20);
+
+	vec2 Min = Pos;
+	vec2 Max = Pos;
+	if(Step.x != 0.0f)
+	{
+		Min.x = min(Pos.x, End.x)-Margin;
+		Max.x = max(Pos.x, End.x)+Margin;
+	}
+	if(Step.y != 0.0f)
+	{
+		Min.y = min(Pos.y, End.y)-Margin;
+		Max.y = max(Pos.y, End.y)+Margin;
+	}
+
+	int Tx0 = clamp(round_to_int(Min.x-Size.x)/32, 0, m_Width-1);
+	int Ty0 = clamp(round_to_int(Min.y-Size.y)/32, 0, m_Height-1);
+	int Tx1 = clamp(round_to_int(Max.x+Size.x)/32, 0, m_Width-1);
+	int Ty1 = clamp(round_to_int(Max.y+Size.y)/32, 0, m_Height-1);
+	if((Tx1-Tx0+1)*(Ty1-Ty0+1) > MAX_BOX_PATH_TILES)
+		return false;
+
+	for(int y = Ty0; y <= Ty1; y++)
+		for(int x = Tx0; x <= Tx1; x++)
+		{
+			int Index = m_pTiles[y*m_Width+x].m_Index;
+			if(Index <= 128 && Index&COLFLAG_SOLID)
+				return false;
+		}
+	return true;
+}
+
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
 {
 	// do the move
@@ -158,8 +248,21 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 	{
 		//vec2 old_pos = pos;
 		float Fraction = 1.0f/(float)(Max+1);
+		bool CheckPath = true;
 		for(int i = 0; i <= Max; i++)
 		{
+			// when nothing is in the way of the rest of the move only the steps are left
+			if(CheckPath)
+			{
+				CheckPath = false;
+				if(TestBoxPathFree(Pos, Vel*Fraction, Max+1-i, Size))
+				{
+					for(; i <= Max; i++)
+						Pos = Pos + Vel*Fraction;
+					break;
+				}
+			}
+
 			//float amount = i/(float)max;
 			//if(max == 0)
 				//amount = 0;
@@ -193,6 +296,9 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 					NewPos.x = Pos.x;
 					Vel.x *= -Elasticity;
 				}
+
+				// the velocity changed
+				CheckPath = true;
 			}
 
 			Pos = NewPos;
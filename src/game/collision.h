@@ -12,8 +12,16 @@ class CCollision
 	int m_Height;
 	class CLayers *m_pLayers;
 
+	enum
+	{
+		MAX_BOX_PATH_TILES=16,
+	};
+
 	bool IsTileSolid(int x, int y) const;
+	int GetTileIndex(int x, int y) const;
 	int GetTile(int x, int y) const;
+	int GetSampleTile(vec2 Pos0, vec2 Pos1, int i, int End) const;
+	bool TestBoxPathFree(vec2 Pos, vec2 Step, int Steps, vec2 Size) const;
 
 public:
 	enum
@@ -27,6 +35,8 @@ public:
 	void Init(class CLayers *pLayers);
 	bool CheckPoint(float x, float y) const { return IsTileSolid(round_to_int(x), round_to_int(y)); }
 	bool CheckPoint(vec2 Pos) const { return CheckPoint(Pos.x, Pos.y); }
+	// CheckPoint for Num points at once
+	void CheckPoints(const float *pX, const float *pY, int Num, bool *pSolid) const;
 	int GetCollisionAt(float x, float y) const { return GetTile(round_to_int(x), round_to_int(y)); }
 	int GetWidth() const { return m_Width; };
 	int GetHeight() const { return m_Height; };
@@ -8,6 +8,7 @@
 #include <engine/shared/config.h>
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/input.h>
 #include <engine/keys.h>
@@ -4509,6 +4510,7 @@ void CEditorMap::CreateDefault()
 void CEditor::Init()
 {
 	m_pInput = Kernel()->RequestInterface<IInput>();
+	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pClient = Kernel()->RequestInterface<IClient>();
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
 	m_pGraphics = Kernel()->RequestInterface<IGraphics>();
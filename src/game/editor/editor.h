@@ -500,6 +500,7 @@ public:
 class CEditor : public IEditor
 {
 	class IInput *m_pInput;
+	class IEngine *m_pEngine;
 	class IClient *m_pClient;
 	class IConsole *m_pConsole;
 	class IGraphics *m_pGraphics;
@@ -509,6 +510,7 @@ class CEditor : public IEditor
 	CUI m_UI;
 public:
 	class IInput *Input() { return m_pInput; };
+	class IEngine *Engine() { return m_pEngine; };
 	class IClient *Client() { return m_pClient; };
 	class IConsole *Console() { return m_pConsole; };
 	class IGraphics *Graphics() { return m_pGraphics; };
@@ -520,6 +522,7 @@ public:
 	CEditor() : m_TilesetPicker(16, 16)
 	{
 		m_pInput = 0;
+		m_pEngine = 0;
 		m_pClient = 0;
 		m_pGraphics = 0;
 		m_pTextRender = 0;
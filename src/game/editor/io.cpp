@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/serverbrowser.h>
 #include <engine/storage.h>
@@ -23,7 +24,7 @@ int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
 	str_format(aBuf, sizeof(aBuf), "saving to '%s'...", pFileName);
 	m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
 	CDataFileWriter df;
-	if(!df.Open(pStorage, pFileName))
+	if(!df.Open(pStorage, pFileName, m_pEditor->Engine()->JobPool()))
 	{
 		str_format(aBuf, sizeof(aBuf), "failed to open file '%s'...", pFileName);
 		m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
@@ -212,7 +213,12 @@ int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
 	mem_free(pPoints);
 
 	// finish the data file
-	df.Finish();
+	if(df.Finish() != 0)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to replace file '%s'...", pFileName);
+		m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
+		return 0;
+	}
 	m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "editor", "saving done");
 
 	// send rcon.. if we can
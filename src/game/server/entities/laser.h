@@ -14,6 +14,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual int SnapClipped(int SnappingClient);
 
 protected:
 	bool HitCharacter(vec2 From, vec2 To);
@@ -97,11 +97,15 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
-void CProjectile::Snap(int SnappingClient)
+int CProjectile::SnapClipped(int SnappingClient)
 {
 	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
+	return NetworkClipped(SnappingClient, GetPos(Ct));
+}
 
-	if(NetworkClipped(SnappingClient, GetPos(Ct)))
+void CProjectile::Snap(int SnappingClient)
+{
+	if(SnapClipped(SnappingClient))
 		return;
 
 	CNetObj_Projectile *pProj = static_cast<CNetObj_Projectile *>(Server()->SnapNewItem(NETOBJTYPE_PROJECTILE, GetID(), sizeof(CNetObj_Projectile)));
@@ -4,6 +4,7 @@
 #define GAME_SERVER_ENTITY_H
 
 #include <base/vmath.h>
+#include <game/spatialgrid.h>
 
 #include "alloc.h"
 #include "gameworld.h"
@@ -12,7 +13,7 @@
 	Class: Entity
 		Basic entity class.
 */
-class CEntity
+class CEntity : public CSpatialGrid::CItem
 {
 	MACRO_ALLOC_HEAP()
 
@@ -28,6 +29,7 @@ private:
 
 	int m_ID;
 	int m_ObjType;
+	int64 m_InsertOrder; // entities inserted later come first in the type list
 
 	/*
 		Variable: m_ProximityRadius
@@ -50,6 +52,15 @@ protected:
 	/* Getters */
 	int GetID() const					{ return m_ID; }
 
+	/* Setters */
+
+	/*
+		Function: SetPos
+			Moves the entity. Has to be used instead of writing
+			m_Pos, so that the entity can be found by position.
+	*/
+	void SetPos(vec2 Pos);
+
 public:
 	/* Constructor */
 	CEntity(CGameWorld *pGameWorld, int Objtype, vec2 Pos, int ProximityRadius=0);
@@ -115,12 +126,43 @@ public:
 			SnappingClient - ID of the client which snapshot is
 				being generated. Could be -1 to create a complete
 				snapshot of everything in the game for demo
-				recording.
+				recording, or CGameWorld::SNAP_SHARED to create
+				the items that are the same for every client.
 	*/
 	virtual void Snap(int SnappingClient) {}
 
 	virtual void PostSnap() {}
 
+	/*
+		Function: SnapClipped
+			Checks if the entity can be left out of the snapshot of
+			a client. Snap() should use it so that the shared
+			snapshot items get clipped the same way.
+
+		Arguments:
+			SnappingClient - ID of the client which snapshot is
+				being generated.
+
+		Returns:
+			Non-zero if the entity doesn't have to be in the snapshot.
+	*/
+	virtual int SnapClipped(int SnappingClient) { return NetworkClipped(SnappingClient); }
+
+	/*
+		Function: SnapPersonal
+			Checks if the entity creates different items for a
+			client than for everybody else, so that the shared
+			snapshot items can't be used for it.
+
+		Arguments:
+			SnappingClient - ID of the client which snapshot is
+				being generated.
+
+		Returns:
+			True if Snap() has to be called for this client.
+	*/
+	virtual bool SnapPersonal(int SnappingClient) { return false; }
+
 	/*
 		Function: networkclipped(int snapping_client)
 			Performs a series of test to see if a client can see the
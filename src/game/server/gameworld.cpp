@@ -19,7 +19,14 @@ CGameWorld::CGameWorld()
 	m_Paused = false;
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aMaxProximityRadius[i] = 0.0f;
+	}
+	m_NextInsertOrder = 0;
+
+	m_NumSharedSnapEntries = 0;
+	m_SharedSnapValid = false;
 }
 
 CGameWorld::~CGameWorld()
@@ -36,6 +43,11 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pServer = m_pGameServer->Server();
 }
 
+void CGameWorld::InitGrid(int MapWidth, int MapHeight)
+{
+	m_Grid.Init(MapWidth, MapHeight, NUM_ENTTYPES);
+}
+
 CEntity *CGameWorld::FindFirst(int Type)
 {
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
@@ -43,21 +55,42 @@ CEntity *CGameWorld::FindFirst(int Type)
 
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
-	if(Type < 0 || Type >= NUM_ENTTYPES)
+	if(Type < 0 || Type >= NUM_ENTTYPES || Max <= 0)
+		return 0;
+
+	float Range = Radius+m_aMaxProximityRadius[Type];
+	int x0, y0, x1, y1;
+	if(!m_Grid.CellRange(Pos-vec2(Range, Range), Pos+vec2(Range, Range), &x0, &y0, &x1, &y1))
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
-		if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
-		{
-			if(ppEnts)
-				ppEnts[Num] = pEnt;
-			Num++;
-			if(Num == Max)
-				break;
-		}
-	}
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			for(CSpatialGrid::CItem *pItem = m_Grid.First(Type, x, y); pItem; pItem = pItem->CellNext())
+			{
+				CEntity *pEnt = static_cast<CEntity *>(pItem);
+				if(distance(pEnt->m_Pos, Pos) >= Radius+pEnt->m_ProximityRadius)
+					continue;
+
+				if(!ppEnts)
+				{
+					Num = min(Num+1, Max);
+					continue;
+				}
+
+				// return the entities in the order of the type list, so that
+				// the first Max of it are found like before
+				if(Num == Max)
+				{
+					if(pEnt->m_InsertOrder < ppEnts[Num-1]->m_InsertOrder)
+						continue;
+					Num--;
+				}
+				int i = Num++;
+				for(; i > 0 && ppEnts[i-1]->m_InsertOrder < pEnt->m_InsertOrder; i--)
+					ppEnts[i] = ppEnts[i-1];
+				ppEnts[i] = pEnt;
+			}
 
 	return Num;
 }
@@ -75,6 +108,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	pEnt->m_InsertOrder = m_NextInsertOrder++;
+	m_Grid.Insert(pEnt, pEnt->m_ObjType, pEnt->m_Pos);
+	m_aMaxProximityRadius[pEnt->m_ObjType] = max(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -102,11 +139,31 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_Grid.Remove(pEnt);
+}
+
+void CGameWorld::MoveEntity(CEntity *pEnt)
+{
+	m_Grid.Move(pEnt, pEnt->m_ObjType, pEnt->m_Pos);
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(m_SharedSnapValid)
+	{
+		for(int i = 0; i < m_NumSharedSnapEntries; i++)
+		{
+			CSharedSnapEntry *pEntry = &m_aSharedSnapEntries[i];
+			if(pEntry->m_pEntity->SnapPersonal(SnappingClient))
+				pEntry->m_pEntity->Snap(SnappingClient);
+			else if(pEntry->m_NumItems && !pEntry->m_pEntity->SnapClipped(SnappingClient))
+				Server()->SnapSharedCopy(pEntry->m_FirstItem, pEntry->m_NumItems);
+		}
+		return;
+	}
+
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
@@ -116,8 +173,41 @@ void CGameWorld::Snap(int SnappingClient)
 		}
 }
 
+void CGameWorld::SnapShared()
+{
+	m_NumSharedSnapEntries = 0;
+	m_SharedSnapValid = true;
+
+	Server()->SnapSharedBegin();
+	for(int i = 0; i < NUM_ENTTYPES && m_SharedSnapValid; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		{
+			if(m_NumSharedSnapEntries == MAX_SHARED_SNAP_ENTRIES)
+			{
+				// too many entities, snap them for every client instead
+				m_SharedSnapValid = false;
+				break;
+			}
+
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			CSharedSnapEntry *pEntry = &m_aSharedSnapEntries[m_NumSharedSnapEntries++];
+			pEntry->m_pEntity = pEnt;
+			pEntry->m_FirstItem = Server()->SnapSharedNumItems();
+			pEnt->Snap(SNAP_SHARED);
+			pEntry->m_NumItems = Server()->SnapSharedNumItems()-pEntry->m_FirstItem;
+			pEnt = m_pNextTraverseEntity;
+		}
+
+	// everything is snapped unclipped here, so it can run full where the
+	// snapshots of the clients wouldn't. those get snapped per client then
+	if(!Server()->SnapSharedEnd())
+		m_SharedSnapValid = false;
+}
+
 void CGameWorld::PostSnap()
 {
+	m_SharedSnapValid = false;
+
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
@@ -198,6 +288,12 @@ void CGameWorld::Tick()
 	}
 
 	RemoveEntities();
+
+#ifdef CONF_DEBUG
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			dbg_assert(m_Grid.InCell(pEnt, i, pEnt->m_Pos), "entity moved without SetPos");
+#endif
 }
 
 
@@ -208,25 +304,35 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
- 	{
-		if(p == pNotThis)
-			continue;
+	float Range = Radius+m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	vec2 Min(min(Pos0.x, Pos1.x)-Range, min(Pos0.y, Pos1.y)-Range);
+	vec2 Max(max(Pos0.x, Pos1.x)+Range, max(Pos0.y, Pos1.y)+Range);
+	int x0, y0, x1, y1;
+	if(!m_Grid.CellRange(Min, Max, &x0, &y0, &x1, &y1))
+		return 0;
 
-		vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
-		float Len = distance(p->m_Pos, IntersectPos);
-		if(Len < p->m_ProximityRadius+Radius)
-		{
-			Len = distance(Pos0, IntersectPos);
-			if(Len < ClosestLen)
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			for(CSpatialGrid::CItem *pItem = m_Grid.First(ENTTYPE_CHARACTER, x, y); pItem; pItem = pItem->CellNext())
 			{
-				NewPos = IntersectPos;
-				ClosestLen = Len;
-				pClosest = p;
+				CCharacter *p = static_cast<CCharacter *>(static_cast<CEntity *>(pItem));
+				if(p == pNotThis)
+					continue;
+
+				vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
+				float Len = distance(p->m_Pos, IntersectPos);
+				if(Len < p->m_ProximityRadius+Radius)
+				{
+					// on a tie the character first in the type list wins
+					Len = distance(Pos0, IntersectPos);
+					if(Len < ClosestLen || (Len == ClosestLen && pClosest && p->m_InsertOrder > pClosest->m_InsertOrder))
+					{
+						NewPos = IntersectPos;
+						ClosestLen = Len;
+						pClosest = p;
+					}
+				}
 			}
-		}
-	}
 
 	return pClosest;
 }
@@ -238,22 +344,30 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius*2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
- 	{
-		if(p == pNotThis)
-			continue;
+	float Range = Radius+m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	int x0, y0, x1, y1;
+	if(!m_Grid.CellRange(Pos-vec2(Range, Range), Pos+vec2(Range, Range), &x0, &y0, &x1, &y1))
+		return 0;
 
-		float Len = distance(Pos, p->m_Pos);
-		if(Len < p->m_ProximityRadius+Radius)
-		{
-			if(Len < ClosestRange)
+	for(int y = y0; y <= y1; y++)
+		for(int x = x0; x <= x1; x++)
+			for(CSpatialGrid::CItem *pItem = m_Grid.First(ENTTYPE_CHARACTER, x, y); pItem; pItem = pItem->CellNext())
 			{
-				ClosestRange = Len;
-				pClosest = p;
+				CCharacter *p = static_cast<CCharacter *>(static_cast<CEntity *>(pItem));
+				if(p == pNotThis)
+					continue;
+
+				float Len = distance(Pos, p->m_Pos);
+				if(Len < p->m_ProximityRadius+Radius)
+				{
+					// on a tie the character first in the type list wins
+					if(Len < ClosestRange || (Len == ClosestRange && pClosest && p->m_InsertOrder > pClosest->m_InsertOrder))
+					{
+						ClosestRange = Len;
+						pClosest = p;
+					}
+				}
 			}
-		}
-	}
 
 	return pClosest;
 }
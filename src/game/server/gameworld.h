@@ -4,6 +4,7 @@
 #define GAME_SERVER_GAMEWORLD_H
 
 #include <game/gamecore.h>
+#include <game/spatialgrid.h>
 
 class CEntity;
 class CCharacter;
@@ -26,6 +27,12 @@ public:
 		NUM_ENTTYPES
 	};
 
+	enum
+	{
+		SNAP_SHARED = -2,
+		MAX_SHARED_SNAP_ENTRIES = 1024,
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
@@ -33,6 +40,20 @@ private:
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	CSpatialGrid m_Grid;
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+	int64 m_NextInsertOrder;
+
+	struct CSharedSnapEntry
+	{
+		CEntity *m_pEntity;
+		int m_FirstItem;
+		int m_NumItems;
+	};
+	CSharedSnapEntry m_aSharedSnapEntries[MAX_SHARED_SNAP_ENTRIES];
+	int m_NumSharedSnapEntries;
+	bool m_SharedSnapValid;
+
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
@@ -49,6 +70,17 @@ public:
 
 	void SetGameServer(CGameContext *pGameServer);
 
+	/*
+		Function: InitGrid
+			Sets up the grid the entities are found by position
+			with. Has to be called before entities are inserted.
+
+		Arguments:
+			MapWidth - Width of the game layer in tiles.
+			MapHeight - Height of the game layer in tiles.
+	*/
+	void InitGrid(int MapWidth, int MapHeight);
+
 	CEntity *FindFirst(int Type);
 
 	/*
@@ -116,6 +148,16 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: MoveEntity
+			Updates the grid cell of an entity after its position
+			changed.
+
+		Arguments:
+			entity - Entity that moved
+	*/
+	void MoveEntity(CEntity *pEntity);
+
 	/*
 		Function: destroy_entity
 			Destroys an entity in the world.
@@ -135,7 +177,17 @@ public:
 			is being created.
 	*/
 	void Snap(int SnappingClient);
-	
+
+	/*
+		Function: SnapShared
+			Snaps all entities once for the current tick. The
+			following Snap() calls copy these items for every client
+			that can see an entity and only call Snap() on entities
+			that look different for the client. If the items don't
+			all fit, Snap() snaps every entity per client instead.
+	*/
+	void SnapShared();
+
 	void PostSnap();
 
 	/*
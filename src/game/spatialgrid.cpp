@@ -0,0 +1,67 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <base/math.h>
+
+#include <game/spatialgrid.h>
+
+CSpatialGrid::CSpatialGrid()
+{
+	m_ppCells = 0;
+	m_Width = 0;
+	m_Height = 0;
+	m_NumTypes = 0;
+}
+
+CSpatialGrid::~CSpatialGrid()
+{
+	delete[] m_ppCells;
+}
+
+void CSpatialGrid::Init(int MapWidth, int MapHeight, int NumTypes)
+{
+	delete[] m_ppCells;
+
+	// tiles are 32 units
+	m_Width = max(((MapWidth*32)>>CELL_SHIFT)+1, 1);
+	m_Height = max(((MapHeight*32)>>CELL_SHIFT)+1, 1);
+	m_NumTypes = NumTypes;
+	m_ppCells = new CItem*[m_Width*m_Height*m_NumTypes];
+	mem_zero(m_ppCells, sizeof(CItem*)*m_Width*m_Height*m_NumTypes);
+}
+
+void CSpatialGrid::Link(CItem *pItem, int Cell)
+{
+	pItem->m_Cell = Cell;
+	pItem->m_pPrevCellItem = 0;
+	pItem->m_pNextCellItem = m_ppCells[Cell];
+	if(m_ppCells[Cell])
+		m_ppCells[Cell]->m_pPrevCellItem = pItem;
+	m_ppCells[Cell] = pItem;
+}
+
+void CSpatialGrid::Unlink(CItem *pItem)
+{
+	if(pItem->m_pPrevCellItem)
+		pItem->m_pPrevCellItem->m_pNextCellItem = pItem->m_pNextCellItem;
+	else
+		m_ppCells[pItem->m_Cell] = pItem->m_pNextCellItem;
+	if(pItem->m_pNextCellItem)
+		pItem->m_pNextCellItem->m_pPrevCellItem = pItem->m_pPrevCellItem;
+
+	pItem->m_pPrevCellItem = 0;
+	pItem->m_pNextCellItem = 0;
+	pItem->m_Cell = -1;
+}
+
+void CSpatialGrid::Insert(CItem *pItem, int Type, vec2 Pos)
+{
+	if(m_ppCells && pItem->m_Cell < 0)
+		Link(pItem, Cell(Type, Pos));
+}
+
+void CSpatialGrid::Remove(CItem *pItem)
+{
+	if(m_ppCells && pItem->m_Cell >= 0)
+		Unlink(pItem);
+}
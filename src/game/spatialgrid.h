@@ -0,0 +1,111 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_SPATIALGRID_H
+#define GAME_SPATIALGRID_H
+
+#include <base/math.h>
+#include <base/vmath.h>
+
+/*
+	Class: Spatial Grid
+		Uniform grid over the map that keeps a list of items per
+		cell and item type, so that range queries only have to
+		look at the items in the cells the range overlaps.
+		Positions outside of the map are clamped to the border
+		cells.
+*/
+class CSpatialGrid
+{
+public:
+	enum
+	{
+		CELL_SHIFT=8, // 256 units, 8 tiles per cell
+		CELL_SIZE=1<<CELL_SHIFT,
+	};
+
+	class CItem
+	{
+		friend class CSpatialGrid;
+
+		CItem *m_pPrevCellItem;
+		CItem *m_pNextCellItem;
+		int m_Cell;
+
+	public:
+		CItem() : m_pPrevCellItem(0), m_pNextCellItem(0), m_Cell(-1) {}
+
+		CItem *CellNext() const { return m_pNextCellItem; }
+		bool InGrid() const { return m_Cell >= 0; }
+	};
+
+private:
+	CItem **m_ppCells;
+	int m_Width;
+	int m_Height;
+	int m_NumTypes;
+
+	int CellCoord(float Value, int Size) const { return clamp(int(Value)>>CELL_SHIFT, 0, Size-1); }
+	int Cell(int Type, vec2 Pos) const { return (Type*m_Height+CellCoord(Pos.y, m_Height))*m_Width+CellCoord(Pos.x, m_Width); }
+	void Link(CItem *pItem, int Cell);
+	void Unlink(CItem *pItem);
+
+public:
+	CSpatialGrid();
+	~CSpatialGrid();
+
+	/*
+		Function: Init
+			Allocates the cells for a map. Has to be called
+			before any items are inserted.
+
+		Arguments:
+			MapWidth - Width of the map in tiles.
+			MapHeight - Height of the map in tiles.
+			NumTypes - Number of item types that are kept apart.
+	*/
+	void Init(int MapWidth, int MapHeight, int NumTypes);
+
+	void Insert(CItem *pItem, int Type, vec2 Pos);
+	void Remove(CItem *pItem);
+
+	/*
+		Function: Move
+			Moves an item into the cell of its new position. Cheap
+			when the item stays in its cell.
+	*/
+	void Move(CItem *pItem, int Type, vec2 Pos)
+	{
+		if(pItem->m_Cell >= 0 && m_ppCells)
+		{
+			int NewCell = Cell(Type, Pos);
+			if(NewCell != pItem->m_Cell)
+			{
+				Unlink(pItem);
+				Link(pItem, NewCell);
+			}
+		}
+	}
+
+	/*
+		Function: CellRange
+			Gets the cells that overlap a rectangle.
+
+		Returns:
+			False when the grid isn't initialised.
+	*/
+	bool CellRange(vec2 Min, vec2 Max, int *pX0, int *pY0, int *pX1, int *pY1) const
+	{
+		if(!m_ppCells)
+			return false;
+		*pX0 = CellCoord(Min.x, m_Width);
+		*pY0 = CellCoord(Min.y, m_Height);
+		*pX1 = CellCoord(Max.x, m_Width);
+		*pY1 = CellCoord(Max.y, m_Height);
+		return true;
+	}
+
+	CItem *First(int Type, int x, int y) const { return m_ppCells[(Type*m_Height+y)*m_Width+x]; }
+	bool InCell(const CItem *pItem, int Type, vec2 Pos) const { return !m_ppCells || pItem->m_Cell == Cell(Type, Pos); }
+};
+
+#endif
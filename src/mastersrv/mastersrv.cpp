@@ -1,6 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <base/tl/array.h>
 
 #include <engine/config.h>
 #include <engine/console.h>
@@ -17,11 +19,13 @@
 enum {
 	MTU = 1400,
 	MAX_SERVERS_PER_PACKET=75,
-	MAX_PACKETS=16,
-	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
+	MIN_HASH_SIZE=256,
 	EXPIRE_TIME = 90
 };
 
+// servers and servers being checked are kept in arrays with stable indices,
+// chained by the hash of their address. freed entries are reused
+
 struct CCheckServer
 {
 	enum ServerType m_Type;
@@ -30,20 +34,35 @@ struct CCheckServer
 	int m_TryCount;
 	int64 m_TryTime;
 	TOKEN m_Token;
+	bool m_Used;
+	int m_aNextInBucket[2]; // for the address and the alt address
 };
 
-static CCheckServer m_aCheckServers[MAX_SERVERS];
+static array<CCheckServer> m_aCheckServers;
+static array<int> m_aCheckServerHash; // node is the check server index*2+1 for the alt address
 static int m_NumCheckServers = 0;
+static int m_FirstFreeCheckServer = -1;
 
 struct CServerEntry
 {
 	enum ServerType m_Type;
 	NETADDR m_Address;
 	int64 m_Expire;
+	int m_Slot; // position in the list packets, -1 while the entry is free
+	int m_NextInBucket; // or the next free entry
+	int m_PrevExpire;
+	int m_NextExpire;
 };
 
-static CServerEntry m_aServers[MAX_SERVERS];
-static int m_NumServers = 0;
+static array<CServerEntry> m_aServers;
+static array<int> m_aServerHash;
+static array<int> m_aServerSlots; // the servers in the order of the list packets
+static int m_FirstFreeServer = -1;
+
+// the expire time is the same for all servers, so the servers expire in the
+// order they were updated last and the list is kept in that order
+static int m_FirstExpire = -1;
+static int m_LastExpire = -1;
 
 struct CPacketData
 {
@@ -54,8 +73,8 @@ struct CPacketData
 	} m_Data;
 };
 
-CPacketData m_aPackets[MAX_PACKETS];
-static int m_NumPackets = 0;
+// updated in place when servers are added or removed
+static array<CPacketData> m_aPackets;
 
 
 struct CCountPacketData
@@ -75,59 +94,186 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
-void BuildPackets()
+static unsigned AddrHash(const NETADDR *pAddr)
+{
+	unsigned Hash = pAddr->type;
+	int Size = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
+	for(int i = 0; i < Size; i++)
+		Hash = Hash*31 + pAddr->ip[i];
+	Hash = Hash*31 + pAddr->port;
+	return Hash ^ (Hash>>15);
+}
+
+static void InitHash(array<int> *paHash, int Size)
+{
+	paHash->set_size(Size);
+	for(int i = 0; i < Size; i++)
+		(*paHash)[i] = -1;
+}
+
+static int CheckServerNodeNext(int Node)
+{
+	return m_aCheckServers[Node/2].m_aNextInBucket[Node%2];
+}
+
+static const NETADDR *CheckServerNodeAddr(int Node)
+{
+	return Node%2 ? &m_aCheckServers[Node/2].m_AltAddress : &m_aCheckServers[Node/2].m_Address;
+}
+
+static void LinkCheckServerNode(int Node)
+{
+	int Bucket = AddrHash(CheckServerNodeAddr(Node))&(m_aCheckServerHash.size()-1);
+	m_aCheckServers[Node/2].m_aNextInBucket[Node%2] = m_aCheckServerHash[Bucket];
+	m_aCheckServerHash[Bucket] = Node;
+}
+
+static void UnlinkCheckServerNode(int Node)
+{
+	int *pLink = &m_aCheckServerHash[AddrHash(CheckServerNodeAddr(Node))&(m_aCheckServerHash.size()-1)];
+	while(*pLink != Node)
+		pLink = &m_aCheckServers[*pLink/2].m_aNextInBucket[*pLink%2];
+	*pLink = CheckServerNodeNext(Node);
+}
+
+static int FindCheckServer(const NETADDR *pAddr)
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
-	m_NumPackets = 0;
-	int PacketIndex = 0;
-	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && m_NumPackets < MAX_PACKETS)
+	if(!m_aCheckServerHash.size())
+		return -1;
+	for(int Node = m_aCheckServerHash[AddrHash(pAddr)&(m_aCheckServerHash.size()-1)]; Node != -1; Node = CheckServerNodeNext(Node))
 	{
-		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
-		{
-			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndex = 0;
-				m_NumPackets++;
-			}
+		if(net_addr_comp(CheckServerNodeAddr(Node), pAddr) == 0)
+			return Node/2;
+	}
+	return -1;
+}
 
-			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+static void RemoveCheckServer(int Index)
+{
+	UnlinkCheckServerNode(Index*2);
+	UnlinkCheckServerNode(Index*2+1);
+	m_aCheckServers[Index].m_Used = false;
+	m_aCheckServers[Index].m_aNextInBucket[0] = m_FirstFreeCheckServer;
+	m_FirstFreeCheckServer = Index;
+	m_NumCheckServers--;
+}
 
-			// copy server addresses
-			if(pCurrent->m_Address.type == NETTYPE_IPV6)
-			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
-			}
-			else
-			{
-				static unsigned char s_aIPV4Mapping[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF};
+static int FindServer(const NETADDR *pAddr)
+{
+	if(!m_aServerHash.size())
+		return -1;
+	for(int i = m_aServerHash[AddrHash(pAddr)&(m_aServerHash.size()-1)]; i != -1; i = m_aServers[i].m_NextInBucket)
+	{
+		if(net_addr_comp(&m_aServers[i].m_Address, pAddr) == 0)
+			return i;
+	}
+	return -1;
+}
 
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, s_aIPV4Mapping, sizeof(s_aIPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
-			}
+static void LinkServer(int Index)
+{
+	int Bucket = AddrHash(&m_aServers[Index].m_Address)&(m_aServerHash.size()-1);
+	m_aServers[Index].m_NextInBucket = m_aServerHash[Bucket];
+	m_aServerHash[Bucket] = Index;
+}
+
+static void UnlinkServer(int Index)
+{
+	int *pLink = &m_aServerHash[AddrHash(&m_aServers[Index].m_Address)&(m_aServerHash.size()-1)];
+	while(*pLink != Index)
+		pLink = &m_aServers[*pLink].m_NextInBucket;
+	*pLink = m_aServers[Index].m_NextInBucket;
+}
+
+static void UnlinkExpire(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
+	if(pServer->m_PrevExpire != -1)
+		m_aServers[pServer->m_PrevExpire].m_NextExpire = pServer->m_NextExpire;
+	else
+		m_FirstExpire = pServer->m_NextExpire;
+	if(pServer->m_NextExpire != -1)
+		m_aServers[pServer->m_NextExpire].m_PrevExpire = pServer->m_PrevExpire;
+	else
+		m_LastExpire = pServer->m_PrevExpire;
+}
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
+static void LinkExpire(int Index)
+{
+	m_aServers[Index].m_PrevExpire = m_LastExpire;
+	m_aServers[Index].m_NextExpire = -1;
+	if(m_LastExpire != -1)
+		m_aServers[m_LastExpire].m_NextExpire = Index;
+	else
+		m_FirstExpire = Index;
+	m_LastExpire = Index;
+}
 
-			PacketIndex++;
+static void UpdateCountPacket()
+{
+	int NumServers = min(m_aServerSlots.size(), 0xffff);
+	m_CountData.m_High = (NumServers>>8)&0xff;
+	m_CountData.m_Low = NumServers&0xff;
+}
 
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
+static void WriteServerAddr(int Slot)
+{
+	const NETADDR *pAddress = &m_aServers[m_aServerSlots[Slot]].m_Address;
+	CMastersrvAddr *pAddr = &m_aPackets[Slot/MAX_SERVERS_PER_PACKET].m_Data.m_aServers[Slot%MAX_SERVERS_PER_PACKET];
 
-			pCurrent++;
-		}
-		else
-		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
-			dbg_msg("mastersrv", "error: server of invalid type, dropping it");
-		}
+	// copy server addresses
+	if(pAddress->type == NETTYPE_IPV6)
+	{
+		mem_copy(pAddr->m_aIp, pAddress->ip, sizeof(pAddr->m_aIp));
+	}
+	else
+	{
+		static unsigned char s_aIPV4Mapping[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF};
+
+		mem_copy(pAddr->m_aIp, s_aIPV4Mapping, sizeof(s_aIPV4Mapping));
+		pAddr->m_aIp[12] = pAddress->ip[0];
+		pAddr->m_aIp[13] = pAddress->ip[1];
+		pAddr->m_aIp[14] = pAddress->ip[2];
+		pAddr->m_aIp[15] = pAddress->ip[3];
+	}
+
+	pAddr->m_aPort[0] = (pAddress->port>>8)&0xff;
+	pAddr->m_aPort[1] = pAddress->port&0xff;
+}
+
+// sets the sizes of the packets after the number of servers changed
+static void ResizePackets()
+{
+	int NumServers = m_aServerSlots.size();
+	int NumPackets = (NumServers+MAX_SERVERS_PER_PACKET-1)/MAX_SERVERS_PER_PACKET;
+	int OldNumPackets = m_aPackets.size();
+	m_aPackets.set_size(NumPackets);
+	for(int i = OldNumPackets; i < NumPackets; i++)
+		mem_copy(m_aPackets[i].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+	for(int i = max(min(OldNumPackets, NumPackets)-1, 0); i < NumPackets; i++)
+		m_aPackets[i].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*min(NumServers-i*MAX_SERVERS_PER_PACKET, (int)MAX_SERVERS_PER_PACKET);
+	UpdateCountPacket();
+}
+
+static void RemoveServer(int Index)
+{
+	// the last server in the packets takes the slot of the removed one
+	int Slot = m_aServers[Index].m_Slot;
+	int LastSlot = m_aServerSlots.size()-1;
+	if(Slot != LastSlot)
+	{
+		m_aServerSlots[Slot] = m_aServerSlots[LastSlot];
+		m_aServers[m_aServerSlots[Slot]].m_Slot = Slot;
+		WriteServerAddr(Slot);
 	}
+	m_aServerSlots.remove_index_fast(LastSlot);
+	ResizePackets();
+
+	UnlinkServer(Index);
+	UnlinkExpire(Index);
+	m_aServers[Index].m_Slot = -1;
+	m_aServers[Index].m_NextInBucket = m_FirstFreeServer;
+	m_FirstFreeServer = Index;
 }
 
 void SendOk(NETADDR *pAddr, TOKEN Token)
@@ -168,65 +314,109 @@ void SendCheck(NETADDR *pAddr, TOKEN Token)
 
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type, TOKEN Token)
 {
-	// add server
-	if(m_NumCheckServers == MAX_SERVERS)
+	// a server that is still being checked only gets its token updated
+	int Index = FindCheckServer(pInfo);
+	if(Index != -1 && net_addr_comp(&m_aCheckServers[Index].m_Address, pInfo) == 0 &&
+		net_addr_comp(&m_aCheckServers[Index].m_AltAddress, pAlt) == 0)
 	{
-		dbg_msg("mastersrv", "error: mastersrv is full");
+		m_aCheckServers[Index].m_Token = Token;
 		return;
 	}
 
+	// add server
+	if(m_NumCheckServers >= m_aCheckServerHash.size())
+	{
+		// keep the chains short
+		InitHash(&m_aCheckServerHash, max(m_aCheckServerHash.size()*2, (int)MIN_HASH_SIZE));
+		for(int i = 0; i < m_aCheckServers.size(); i++)
+			if(m_aCheckServers[i].m_Used)
+			{
+				LinkCheckServerNode(i*2);
+				LinkCheckServerNode(i*2+1);
+			}
+	}
+
+	Index = m_FirstFreeCheckServer;
+	if(Index != -1)
+		m_FirstFreeCheckServer = m_aCheckServers[Index].m_aNextInBucket[0];
+	else
+		Index = m_aCheckServers.add(CCheckServer());
+
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	char aAltAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pAlt, aAltAddrStr, sizeof(aAltAddrStr), true);
 	dbg_msg("mastersrv", "checking: %s (%s)", aAddrStr, aAltAddrStr);
-	m_aCheckServers[m_NumCheckServers].m_Address = *pInfo;
-	m_aCheckServers[m_NumCheckServers].m_AltAddress = *pAlt;
-	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
-	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
-	m_aCheckServers[m_NumCheckServers].m_Type = Type;
-	m_aCheckServers[m_NumCheckServers].m_Token = Token;
+	m_aCheckServers[Index].m_Address = *pInfo;
+	m_aCheckServers[Index].m_AltAddress = *pAlt;
+	m_aCheckServers[Index].m_TryCount = 0;
+	m_aCheckServers[Index].m_TryTime = 0;
+	m_aCheckServers[Index].m_Type = Type;
+	m_aCheckServers[Index].m_Token = Token;
+	m_aCheckServers[Index].m_Used = true;
+	LinkCheckServerNode(Index*2);
+	LinkCheckServerNode(Index*2+1);
 	m_NumCheckServers++;
 }
 
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
+	if(Type != SERVERTYPE_NORMAL)
+	{
+		dbg_msg("mastersrv", "error: server of invalid type, dropping it");
+		return;
+	}
+
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	int Index = FindServer(pInfo);
+	if(Index != -1)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		m_aServers[Index].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+		UnlinkExpire(Index);
+		LinkExpire(Index);
+		return;
 	}
 
 	// add server
-	if(m_NumServers == MAX_SERVERS)
+	if(m_aServerSlots.size() >= m_aServerHash.size())
 	{
-		dbg_msg("mastersrv", "error: mastersrv is full");
-		return;
+		// keep the chains short
+		InitHash(&m_aServerHash, max(m_aServerHash.size()*2, (int)MIN_HASH_SIZE));
+		for(int i = 0; i < m_aServers.size(); i++)
+			if(m_aServers[i].m_Slot != -1)
+				LinkServer(i);
 	}
 
+	Index = m_FirstFreeServer;
+	if(Index != -1)
+		m_FirstFreeServer = m_aServers[Index].m_NextInBucket;
+	else
+		Index = m_aServers.add(CServerEntry());
+
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
-	m_NumServers++;
+	m_aServers[Index].m_Address = *pInfo;
+	m_aServers[Index].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+	m_aServers[Index].m_Type = Type;
+	m_aServers[Index].m_Slot = m_aServerSlots.add(Index);
+	LinkServer(Index);
+	LinkExpire(Index);
+
+	ResizePackets();
+	WriteServerAddr(m_aServers[Index].m_Slot);
 }
 
 void UpdateServers()
 {
 	int64 Now = time_get();
 	int64 Freq = time_freq();
-	for(int i = 0; i < m_NumCheckServers; i++)
+	for(int i = 0; i < m_aCheckServers.size(); i++)
 	{
-		if(Now > m_aCheckServers[i].m_TryTime+Freq)
+		if(m_aCheckServers[i].m_Used && Now > m_aCheckServers[i].m_TryTime+Freq)
 		{
 			if(m_aCheckServers[i].m_TryCount == 10)
 			{
@@ -238,9 +428,7 @@ void UpdateServers()
 
 				// FAIL!!
 				SendError(&m_aCheckServers[i].m_Address, m_aCheckServers[i].m_Token);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
-				i--;
+				RemoveCheckServer(i);
 			}
 			else
 			{
@@ -258,20 +446,13 @@ void UpdateServers()
 void PurgeServers()
 {
 	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	while(m_FirstExpire != -1 && m_aServers[m_FirstExpire].m_Expire < Now)
 	{
-		if(m_aServers[i].m_Expire < Now)
-		{
-			// remove server
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
-		}
-		else
-			i++;
+		// remove server
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(&m_aServers[m_FirstExpire].m_Address, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "expired: %s", aAddrStr);
+		RemoveServer(m_FirstExpire);
 	}
 }
 
@@ -283,7 +464,7 @@ void ReloadBans()
 
 int main(int argc, const char **argv) // ignore_convention
 {
-	int64 LastBuild = 0, LastBanReload = 0;
+	int64 LastPurge = 0, LastBanReload = 0;
 	ServerType Type = SERVERTYPE_INVALID;
 	NETADDR BindAddr;
 
@@ -291,6 +472,7 @@ int main(int argc, const char **argv) // ignore_convention
 	net_init();
 
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
+	UpdateCountPacket();
 
 	int FlagMask = CFGFLAG_MASTER;
 	IKernel *pKernel = IKernel::Create();
@@ -342,6 +524,9 @@ int main(int argc, const char **argv) // ignore_convention
 
 	while(1)
 	{
+		// list responses go out with as few system calls as possible
+		CNetBase::BeginSendBatch();
+
 		m_NetOp.Update();
 		m_NetChecker.Update();
 
@@ -370,7 +555,7 @@ int main(int argc, const char **argv) // ignore_convention
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETCOUNT) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETCOUNT, sizeof(SERVERBROWSE_GETCOUNT)) == 0)
 			{
-				dbg_msg("mastersrv", "count requested, responding with %d", m_NumServers);
+				dbg_msg("mastersrv", "count requested, responding with %d", m_aServerSlots.size());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
@@ -378,22 +563,20 @@ int main(int argc, const char **argv) // ignore_convention
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 				p.m_DataSize = sizeof(m_CountData);
 				p.m_pData = &m_CountData;
-				m_CountData.m_High = (m_NumServers>>8)&0xff;
-				m_CountData.m_Low = m_NumServers&0xff;
 				m_NetOp.Send(&p, Token);
 			}
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST)) == 0)
 			{
 				// someone requested the list
-				dbg_msg("mastersrv", "requested, responding with %d servers", m_NumServers);
+				dbg_msg("mastersrv", "requested, responding with %d servers", m_aServerSlots.size());
 
 				CNetChunk p;
 				p.m_ClientID = -1;
 				p.m_Address = Packet.m_Address;
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 
-				for(int i = 0; i < m_NumPackets; i++)
+				for(int i = 0; i < m_aPackets.size(); i++)
 				{
 					p.m_DataSize = m_aPackets[i].m_Size;
 					p.m_pData = &m_aPackets[i].m_Data;
@@ -414,16 +597,11 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				Type = SERVERTYPE_INVALID;
 				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
+				int CheckServer = FindCheckServer(&Packet.m_Address);
+				if(CheckServer != -1)
 				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
+					Type = m_aCheckServers[CheckServer].m_Type;
+					RemoveCheckServer(CheckServer);
 				}
 
 				// drops servers that were not in the CheckServers list
@@ -442,15 +620,16 @@ int main(int argc, const char **argv) // ignore_convention
 			ReloadBans();
 		}
 
-		if(time_get()-LastBuild > time_freq()*5)
+		if(time_get()-LastPurge > time_freq()*5)
 		{
-			LastBuild = time_get();
+			LastPurge = time_get();
 
 			PurgeServers();
 			UpdateServers();
-			BuildPackets();
 		}
 
+		CNetBase::EndSendBatch();
+
 		// be nice to the CPU
 		thread_sleep(1);
 	}
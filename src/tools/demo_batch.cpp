@@ -0,0 +1,433 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h> // qsort
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+
+#include <generated/protocol.h>
+#include <game/version.h>
+
+#include <zlib.h>
+
+/*
+	demo_batch decodes demos without playing them, several at once, and
+	exports the snapshot items of every tick for offline stats.
+
+	usage: demo_batch [-j <threads>] [-o <output directory>] <demo or directory>...
+
+	Every demo gets a .cols file in the output directory, "columns" in the
+	save directory by default. Except for the magic all numbers are packed
+	with CVariableInt.
+
+		"TWCOLS" 0 1		magic and version, 8 bytes
+		blocks until the end of the file:
+			item type, item size in ints, number of rows
+			for the id, the tick and every int of the items:
+				size of the packed column, size of the compressed column,
+				the column compressed with zlib
+
+	The rows of a block are sorted by id, then tick. Every value of a
+	column is packed as the difference to the value of the row before, so
+	the columns of items that change little are mostly zeros and compress
+	well. Ticks in which nothing changed have no rows.
+*/
+
+enum
+{
+	MAX_DEMOS=4096,
+	MAX_THREADS=32,
+	DEFAULT_THREADS=4,
+
+	BUFFER_INTS=1<<20, // item data buffered before it's written in blocks
+	MAX_ROWS=BUFFER_INTS/4,
+};
+
+static const unsigned char gs_aColumnsMagic[8] = {'T', 'W', 'C', 'O', 'L', 'S', 0, 1};
+
+struct CDemoList
+{
+	char m_aaNames[MAX_DEMOS][256];
+	int m_aStorageTypes[MAX_DEMOS];
+	int m_Num;
+	const char *m_pDirectory;
+};
+
+static int ListDemosCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CDemoList *pList = (CDemoList *)pUser;
+	int Length = str_length(pName);
+	if(IsDir || Length < 5 || str_comp(pName+Length-5, ".demo") != 0 || pList->m_Num == MAX_DEMOS)
+		return 0;
+	str_format(pList->m_aaNames[pList->m_Num], sizeof(pList->m_aaNames[0]), "%s/%s", pList->m_pDirectory, pName);
+	pList->m_aStorageTypes[pList->m_Num++] = StorageType;
+	return 0;
+}
+
+class CColumnWriter : public CDemoPlayer::IListner
+{
+	struct CRow
+	{
+		int m_Type;
+		int m_Size;
+		int m_ID;
+		int m_Tick;
+		int m_Offset;
+	};
+
+	const CDemoPlayer *m_pPlayer;
+	IOHANDLE m_File;
+
+	int *m_pData;
+	int m_DataSize;
+	CRow *m_pRows;
+	int m_NumRows;
+	unsigned char *m_pColumn;
+	unsigned char *m_pCompressedColumn;
+	unsigned long m_CompressedColumnSize;
+
+	static int CompareRows(const void *pA, const void *pB)
+	{
+		const CRow *pRowA = (const CRow *)pA;
+		const CRow *pRowB = (const CRow *)pB;
+		if(pRowA->m_Type != pRowB->m_Type)
+			return pRowA->m_Type < pRowB->m_Type ? -1 : 1;
+		if(pRowA->m_Size != pRowB->m_Size)
+			return pRowA->m_Size < pRowB->m_Size ? -1 : 1;
+		if(pRowA->m_ID != pRowB->m_ID)
+			return pRowA->m_ID < pRowB->m_ID ? -1 : 1;
+		// rows are added tick by tick
+		return pRowA->m_Offset < pRowB->m_Offset ? -1 : pRowA->m_Offset > pRowB->m_Offset;
+	}
+
+	void WriteInts(const int *pValues, int Num)
+	{
+		unsigned char aBuf[16];
+		unsigned char *pEnd = aBuf;
+		for(int i = 0; i < Num; i++)
+			pEnd = CVariableInt::Pack(pEnd, pValues[i]);
+		io_write(m_File, aBuf, pEnd-aBuf);
+		m_NumBytes += pEnd-aBuf;
+	}
+
+	void WriteBlock(const CRow *pRows, int Num)
+	{
+		int aHeader[3] = {pRows[0].m_Type, pRows[0].m_Size, Num};
+		WriteInts(aHeader, 3);
+
+		// the id and the tick come first, then the ints of the items
+		for(int c = -2; c < pRows[0].m_Size; c++)
+		{
+			unsigned char *pEnd = m_pColumn;
+			unsigned Last = 0;
+			for(int r = 0; r < Num; r++)
+			{
+				unsigned Value = c == -2 ? pRows[r].m_ID : c == -1 ? pRows[r].m_Tick : m_pData[pRows[r].m_Offset+c];
+				pEnd = CVariableInt::Pack(pEnd, (int)(Value-Last));
+				Last = Value;
+			}
+
+			unsigned long CompressedSize = m_CompressedColumnSize;
+			compress2((Bytef*)m_pCompressedColumn, &CompressedSize, (Bytef*)m_pColumn, pEnd-m_pColumn, Z_BEST_SPEED); // ignore_convention
+			int aSizes[2] = {(int)(pEnd-m_pColumn), (int)CompressedSize};
+			WriteInts(aSizes, 2);
+			io_write(m_File, m_pCompressedColumn, CompressedSize);
+			m_NumBytes += CompressedSize;
+		}
+	}
+
+	void Flush()
+	{
+		qsort(m_pRows, m_NumRows, sizeof(CRow), CompareRows);
+		for(int Start = 0, End; Start < m_NumRows; Start = End)
+		{
+			for(End = Start+1; End < m_NumRows; End++)
+				if(m_pRows[End].m_Type != m_pRows[Start].m_Type || m_pRows[End].m_Size != m_pRows[Start].m_Size)
+					break;
+			WriteBlock(&m_pRows[Start], End-Start);
+		}
+		m_NumRows = 0;
+		m_DataSize = 0;
+	}
+
+public:
+	int m_LastTick;
+	int m_NumSnapshots;
+	int64 m_NumItems;
+	int64 m_NumBytes;
+
+	CColumnWriter()
+	{
+		m_pPlayer = 0;
+		m_File = 0;
+		m_pData = (int *)mem_alloc(BUFFER_INTS*sizeof(int), 1);
+		m_pRows = (CRow *)mem_alloc(MAX_ROWS*sizeof(CRow), 1);
+		m_pColumn = (unsigned char *)mem_alloc(MAX_ROWS*5, 1); // an int packs into at most 5 bytes
+		m_CompressedColumnSize = compressBound(MAX_ROWS*5);
+		m_pCompressedColumn = (unsigned char *)mem_alloc(m_CompressedColumnSize, 1);
+	}
+
+	~CColumnWriter()
+	{
+		mem_free(m_pData);
+		mem_free(m_pRows);
+		mem_free(m_pColumn);
+		mem_free(m_pCompressedColumn);
+	}
+
+	void Start(const CDemoPlayer *pPlayer, IOHANDLE File)
+	{
+		m_pPlayer = pPlayer;
+		m_File = File;
+		m_LastTick = -1;
+		m_DataSize = 0;
+		m_NumRows = 0;
+		m_NumSnapshots = 0;
+		m_NumItems = 0;
+		m_NumBytes = sizeof(gs_aColumnsMagic);
+		io_write(m_File, gs_aColumnsMagic, sizeof(gs_aColumnsMagic));
+	}
+
+	void Finish()
+	{
+		Flush();
+		io_close(m_File);
+		m_File = 0;
+	}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		// the player repeats the last snapshot for ticks without one
+		int Tick = m_pPlayer->Info()->m_Info.m_CurrentTick;
+		if(Tick == m_LastTick)
+			return;
+		m_LastTick = Tick;
+
+		CSnapshot *pSnap = (CSnapshot *)pData;
+		if(m_NumRows+pSnap->NumItems() > MAX_ROWS || m_DataSize+Size/(int)sizeof(int) > BUFFER_INTS)
+			Flush();
+
+		for(int i = 0; i < pSnap->NumItems(); i++)
+		{
+			CSnapshotItem *pItem = pSnap->GetItem(i);
+			CRow *pRow = &m_pRows[m_NumRows++];
+			pRow->m_Type = pItem->Type();
+			pRow->m_Size = pSnap->GetItemSize(i)/sizeof(int);
+			pRow->m_ID = pItem->ID();
+			pRow->m_Tick = Tick;
+			pRow->m_Offset = m_DataSize;
+			mem_copy(&m_pData[m_DataSize], pItem->Data(), pRow->m_Size*sizeof(int));
+			m_DataSize += pRow->m_Size;
+		}
+		m_NumSnapshots++;
+		m_NumItems += pSnap->NumItems();
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+struct CBatch
+{
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+	const CDemoList *m_pDemos;
+	const char *m_pOutputDirectory;
+	volatile unsigned m_NextDemo;
+	volatile unsigned m_NumFailed;
+	LOCK m_LoadLock;
+};
+
+struct CWorker
+{
+	CBatch *m_pBatch;
+	CSnapshotDelta m_SnapshotDelta;
+	CDemoPlayer *m_pPlayer;
+	CColumnWriter m_Writer;
+	CJob m_Job;
+
+	int m_NumDemos;
+	int64 m_NumTicks;
+	int64 m_NumItems;
+	int64 m_NumBytes;
+
+	CWorker() : m_pPlayer(new CDemoPlayer(&m_SnapshotDelta)), m_NumDemos(0), m_NumTicks(0), m_NumItems(0), m_NumBytes(0)
+	{
+		// the demo deltas leave out the size of the items the game knows
+		CNetObjHandler NetObjHandler;
+		for(int i = 0; i < NUM_NETOBJTYPES; i++)
+			m_SnapshotDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+		m_pPlayer->SetListner(&m_Writer);
+	}
+
+	~CWorker() { delete m_pPlayer; }
+};
+
+static bool ProcessDemo(CWorker *pWorker, int Index)
+{
+	CBatch *pBatch = pWorker->m_pBatch;
+	const char *pFilename = pBatch->m_pDemos->m_aaNames[Index];
+
+	// loading saves the map of the demo, one at a time
+	lock_wait(pBatch->m_LoadLock);
+	const char *pError = pWorker->m_pPlayer->Load(pBatch->m_pStorage, pBatch->m_pConsole, pFilename,
+		pBatch->m_pDemos->m_aStorageTypes[Index], GAME_NETVERSION);
+	lock_unlock(pBatch->m_LoadLock);
+	if(pError)
+		return false;
+
+	const char *pName = pFilename;
+	for(const char *p = pFilename; *p; p++)
+		if(*p == '/' || *p == '\\')
+			pName = p+1;
+	char aOutput[512];
+	str_format(aOutput, sizeof(aOutput), "%s/%.*s.cols", pBatch->m_pOutputDirectory, str_length(pName)-5, pName);
+	IOHANDLE File = pBatch->m_pStorage->OpenFile(aOutput, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("demo_batch", "couldn't open '%s' for writing", aOutput);
+		pWorker->m_pPlayer->Stop();
+		return false;
+	}
+
+	// decode tick after tick, the player pauses at the end
+	int64 Start = time_get();
+	CDemoPlayer *pPlayer = pWorker->m_pPlayer;
+	pWorker->m_Writer.Start(pPlayer, File);
+	pPlayer->Play();
+	while(pPlayer->IsPlaying() && !pPlayer->BaseInfo()->m_Paused)
+		pPlayer->NextFrame();
+	pWorker->m_Writer.Finish();
+	int Ticks = pPlayer->BaseInfo()->m_LastTick-pPlayer->BaseInfo()->m_FirstTick+1;
+	// demos of servers that went down end in a broken chunk, keep what was read
+	if(!pPlayer->IsPlaying())
+		dbg_msg("demo_batch", "%s: ends early, exported up to tick %d", pFilename, pWorker->m_Writer.m_LastTick);
+	pPlayer->Stop();
+
+	dbg_msg("demo_batch", "%s: %d ticks, %d snapshots, %d kb, %.2f ms", pFilename, Ticks, pWorker->m_Writer.m_NumSnapshots,
+		(int)(pWorker->m_Writer.m_NumBytes/1024), (time_get()-Start)*1000.0/time_freq());
+	pWorker->m_NumDemos++;
+	pWorker->m_NumTicks += Ticks;
+	pWorker->m_NumItems += pWorker->m_Writer.m_NumItems;
+	pWorker->m_NumBytes += pWorker->m_Writer.m_NumBytes;
+	return true;
+}
+
+static int WorkerThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	CBatch *pBatch = pWorker->m_pBatch;
+
+	// take the next demo until there are none left, long demos don't hold up the others
+	while(1)
+	{
+		int Index = (int)atomic_inc(&pBatch->m_NextDemo)-1;
+		if(Index >= pBatch->m_pDemos->m_Num)
+			break;
+		if(!ProcessDemo(pWorker, Index))
+			atomic_inc(&pBatch->m_NumFailed);
+	}
+	return 0;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	if(!pStorage || !pConsole)
+		return -1;
+
+	static CDemoList s_Demos;
+	s_Demos.m_Num = 0;
+	int NumThreads = DEFAULT_THREADS;
+	const char *pOutputDirectory = "columns";
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(!str_comp(argv[i], "-j") && i+1 < argc) // ignore_convention
+			NumThreads = clamp(str_toint(argv[++i]), 1, (int)MAX_THREADS); // ignore_convention
+		else if(!str_comp(argv[i], "-o") && i+1 < argc) // ignore_convention
+			pOutputDirectory = argv[++i]; // ignore_convention
+		else
+		{
+			int Length = str_length(argv[i]); // ignore_convention
+			if(Length > 5 && str_comp(argv[i]+Length-5, ".demo") == 0 && s_Demos.m_Num < MAX_DEMOS) // ignore_convention
+			{
+				str_copy(s_Demos.m_aaNames[s_Demos.m_Num], argv[i], sizeof(s_Demos.m_aaNames[0])); // ignore_convention
+				s_Demos.m_aStorageTypes[s_Demos.m_Num++] = IStorage::TYPE_ALL;
+			}
+			else
+			{
+				s_Demos.m_pDirectory = argv[i]; // ignore_convention
+				pStorage->ListDirectory(IStorage::TYPE_ALL, s_Demos.m_pDirectory, ListDemosCallback, &s_Demos);
+			}
+		}
+	}
+
+	if(!s_Demos.m_Num)
+	{
+		dbg_msg("demo_batch", "usage: demo_batch [-j <threads>] [-o <output directory>] <demo or directory>...");
+		return -1;
+	}
+
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+
+	pStorage->CreateFolder("downloadedmaps", IStorage::TYPE_SAVE);
+	pStorage->CreateFolder(pOutputDirectory, IStorage::TYPE_SAVE);
+
+	CBatch Batch;
+	Batch.m_pStorage = pStorage;
+	Batch.m_pConsole = pConsole;
+	Batch.m_pDemos = &s_Demos;
+	Batch.m_pOutputDirectory = pOutputDirectory;
+	Batch.m_NextDemo = 0;
+	Batch.m_NumFailed = 0;
+	Batch.m_LoadLock = lock_create();
+
+	// this thread works through the demos too
+	CWorker *apWorkers[MAX_THREADS];
+	for(int i = 0; i < NumThreads; i++)
+	{
+		apWorkers[i] = new CWorker;
+		apWorkers[i]->m_pBatch = &Batch;
+	}
+
+	int64 Start = time_get();
+	CJobPool Pool;
+	if(NumThreads > 1)
+		Pool.Init(NumThreads-1);
+	for(int i = 1; i < NumThreads; i++)
+		Pool.Add(&apWorkers[i]->m_Job, WorkerThread, apWorkers[i]);
+	WorkerThread(apWorkers[0]);
+	for(int i = 1; i < NumThreads; i++)
+		Pool.Wait(&apWorkers[i]->m_Job);
+	int64 Time = time_get()-Start;
+
+	int NumDemos = 0;
+	int64 NumTicks = 0, NumItems = 0, NumBytes = 0;
+	for(int i = 0; i < NumThreads; i++)
+	{
+		NumDemos += apWorkers[i]->m_NumDemos;
+		NumTicks += apWorkers[i]->m_NumTicks;
+		NumItems += apWorkers[i]->m_NumItems;
+		NumBytes += apWorkers[i]->m_NumBytes;
+		delete apWorkers[i];
+	}
+	lock_destroy(Batch.m_LoadLock);
+
+	dbg_msg("demo_batch", "%d demos, %d failed, %d threads, %.2f s, %.0f ticks/s, %.0f items/s, %d kb written",
+		NumDemos, Batch.m_NumFailed, NumThreads, Time/(double)time_freq(), NumTicks*time_freq()/(double)max(Time, (int64)1),
+		NumItems*time_freq()/(double)max(Time, (int64)1), (int)(NumBytes/1024));
+	return Batch.m_NumFailed ? -1 : 0;
+}
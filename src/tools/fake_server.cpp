@@ -6,7 +6,18 @@
 #include <engine/shared/network.h>
 #include <mastersrv/mastersrv.h>
 
-CNetServer *pNet;
+enum
+{
+	LOAD_IN_FLIGHT=4,
+	MAX_SERVERS_PER_LIST_PACKET=75,
+	REGISTER_TIMEOUT=120,
+};
+
+CNetServer *pNets;
+bool *pRegistered;
+int NumServers = 1;
+int NumRegistered = 0;
+int LoadSeconds = 0;
 
 int Progression = 50;
 int GameType = 0;
@@ -27,7 +38,7 @@ int MaxPlayers = 0;
 char aInfoMsg[1024];
 int aInfoMsgSize;
 
-static void SendHeartBeats()
+static void SendHeartBeats(CNetServer *pNet)
 {
 	static unsigned char aData[sizeof(SERVERBROWSE_HEARTBEAT) + 2];
 	CNetChunk Packet;
@@ -86,7 +97,7 @@ static void BuildInfoMsg()
 	}
 }
 
-static void SendServerInfo(NETADDR *pAddr)
+static void SendServerInfo(CNetServer *pNet, NETADDR *pAddr)
 {
 	CNetChunk p;
 	p.m_ClientID = -1;
@@ -97,7 +108,7 @@ static void SendServerInfo(NETADDR *pAddr)
 	pNet->Send(&p);
 }
 
-static void SendFWCheckResponse(NETADDR *pAddr)
+static void SendFWCheckResponse(CNetServer *pNet, NETADDR *pAddr)
 {
 	CNetChunk p;
 	p.m_ClientID = -1;
@@ -108,62 +119,167 @@ static void SendFWCheckResponse(NETADDR *pAddr)
 	pNet->Send(&p);
 }
 
+// sends requests to the first master as fast as it answers them. responses
+// that get lost are not waited for, so the rates are the ones that arrived
+static void MeasureRequests(CNetClient *pClient, const unsigned char *pRequest, int RequestSize,
+	const unsigned char *pResponse, int ResponseSize, int PacketsPerRequest, const char *pName)
+{
+	CNetChunk Request;
+	Request.m_ClientID = -1;
+	Request.m_Address = aMasterServers[0];
+	Request.m_Flags = NETSENDFLAG_CONNLESS;
+	Request.m_DataSize = RequestSize;
+	Request.m_pData = pRequest;
+
+	int64 Packets = 0;
+	int64 Entries = 0;
+	int64 Start = time_get();
+	int64 End = Start+time_freq()*LoadSeconds;
+	int64 LastPacket = Start;
+	int InFlight = 0;
+	int PacketsLeft = 0;
+	while(time_get() < End)
+	{
+		if(time_get() > LastPacket+time_freq()/100)
+		{
+			InFlight = 0;
+			LastPacket = time_get();
+		}
+		while(InFlight < LOAD_IN_FLIGHT)
+		{
+			pClient->Send(&Request);
+			InFlight++;
+		}
+
+		pClient->Update();
+		CNetChunk p;
+		while(pClient->Recv(&p))
+		{
+			if(p.m_DataSize >= ResponseSize && mem_comp(p.m_pData, pResponse, ResponseSize) == 0)
+			{
+				Packets++;
+				if(pResponse == SERVERBROWSE_LIST)
+					Entries += (p.m_DataSize-ResponseSize)/sizeof(CMastersrvAddr);
+				LastPacket = time_get();
+				if(--PacketsLeft <= 0)
+				{
+					PacketsLeft = PacketsPerRequest;
+					InFlight = max(InFlight-1, 0);
+				}
+			}
+		}
+	}
+
+	double Seconds = (time_get()-Start)/(double)time_freq();
+	dbg_msg("fake_server", "%s: %.0f requests/s, %.0f packets/s, %.0f entries/s", pName,
+		Packets/(double)PacketsPerRequest/Seconds, Packets/Seconds, Entries/Seconds);
+}
+
+static int RequestLoad(int64 RegisterTime)
+{
+	CNetClient Client;
+	NETADDR BindAddr = {NETTYPE_IPV4, {0},0};
+	if(!Client.Open(BindAddr, 0))
+		return 0;
+
+	dbg_msg("fake_server", "%d of %d servers registered in %.1fs", NumRegistered, NumServers, RegisterTime/(double)time_freq());
+	MeasureRequests(&Client, SERVERBROWSE_GETCOUNT, sizeof(SERVERBROWSE_GETCOUNT), SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT), 1, "count");
+	MeasureRequests(&Client, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST), SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST),
+		max((NumRegistered+MAX_SERVERS_PER_LIST_PACKET-1)/MAX_SERVERS_PER_LIST_PACKET, 1), "list");
+	return 1;
+}
+
 static int Run()
 {
-	int64 NextHeartBeat = 0;
+	int64 *pNextHeartBeat = new int64[NumServers];
+	int64 StartTime = time_get();
 	NETADDR BindAddr = {NETTYPE_IPV4, {0},0};
 
-	if(!pNet->Open(BindAddr, 0, 0, 0, 0))
-		return 0;
+	for(int i = 0; i < NumServers; i++)
+	{
+		if(!pNets[i].Open(BindAddr, 0, 0, 0, 0))
+			return 0;
+
+		// spread the first heartbeats to not flood the masters
+		pNextHeartBeat[i] = StartTime + time_freq()*i/2000;
+	}
 
 	while(1)
 	{
-		CNetChunk p;
-		pNet->Update();
-		while(pNet->Recv(&p))
+		for(int i = 0; i < NumServers; i++)
 		{
-			if(p.m_ClientID == -1)
+			CNetServer *pNet = &pNets[i];
+			CNetChunk p;
+			pNet->Update();
+			while(pNet->Recv(&p))
 			{
-				if(p.m_DataSize >= sizeof(SERVERBROWSE_GETINFO) &&
-					mem_comp(p.m_pData, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO)) == 0)
-				{
-					SendServerInfo(&p.m_Address);
-				}
-				else if(p.m_DataSize == sizeof(SERVERBROWSE_FWCHECK) &&
-					mem_comp(p.m_pData, SERVERBROWSE_FWCHECK, sizeof(SERVERBROWSE_FWCHECK)) == 0)
+				if(p.m_ClientID == -1)
 				{
-					SendFWCheckResponse(&p.m_Address);
+					if(p.m_DataSize >= (int)sizeof(SERVERBROWSE_GETINFO) &&
+						mem_comp(p.m_pData, SERVERBROWSE_GETINFO, sizeof(SERVERBROWSE_GETINFO)) == 0)
+					{
+						SendServerInfo(pNet, &p.m_Address);
+					}
+					else if(p.m_DataSize == sizeof(SERVERBROWSE_FWCHECK) &&
+						mem_comp(p.m_pData, SERVERBROWSE_FWCHECK, sizeof(SERVERBROWSE_FWCHECK)) == 0)
+					{
+						SendFWCheckResponse(pNet, &p.m_Address);
+					}
+					else if(p.m_DataSize == sizeof(SERVERBROWSE_FWOK) &&
+						mem_comp(p.m_pData, SERVERBROWSE_FWOK, sizeof(SERVERBROWSE_FWOK)) == 0 && !pRegistered[i])
+					{
+						pRegistered[i] = true;
+						NumRegistered++;
+					}
 				}
 			}
+
+			/* send heartbeats if needed */
+			if(pNextHeartBeat[i] < time_get())
+			{
+				pNextHeartBeat[i] = time_get()+time_freq()*(15+(random_int()%15));
+				SendHeartBeats(pNet);
+			}
 		}
 
-		/* send heartbeats if needed */
-		if(NextHeartBeat < time_get())
+		if(LoadSeconds && NumMasters && (NumRegistered == NumServers || time_get() > StartTime+time_freq()*REGISTER_TIMEOUT))
 		{
-			NextHeartBeat = time_get()+time_freq()*(15+(random_int()%15));
-			SendHeartBeats();
+			delete[] pNextHeartBeat;
+			return RequestLoad(time_get()-StartTime);
 		}
 
-		thread_sleep(100);
+		thread_sleep(NumServers > 1 ? 1 : 100);
 	}
 }
 
 int main(int argc, char **argv)
 {
-	pNet = new CNetServer;
+	dbg_logger_stdout();
+	net_init();
 
 	while(argc)
 	{
-		// ?
-		/*if(str_comp(*argv, "-m") == 0)
+		if(str_comp(*argv, "-m") == 0 && NumMasters < 16)
 		{
 			argc--; argv++;
-			net_host_lookup(*argv, &aMasterServers[NumMasters], NETTYPE_IPV4);
+			if(net_host_lookup(*argv, &aMasterServers[NumMasters], NETTYPE_IPV4) == 0)
+			{
+				if(aMasterServers[NumMasters].port == 0)
+					aMasterServers[NumMasters].port = MASTERSERVER_PORT;
+				NumMasters++;
+			}
+		}
+		else if(str_comp(*argv, "-s") == 0)
+		{
 			argc--; argv++;
-			aMasterServers[NumMasters].port = str_toint(*argv);
-			NumMasters++;
+			NumServers = max(str_toint(*argv), 1);
 		}
-		else */if(str_comp(*argv, "-p") == 0)
+		else if(str_comp(*argv, "-l") == 0)
+		{
+			argc--; argv++;
+			LoadSeconds = max(str_toint(*argv), 0);
+		}
+		else if(str_comp(*argv, "-p") == 0)
 		{
 			argc--; argv++;
 			PlayerNames[NumPlayers++] = *argv;
@@ -204,10 +320,15 @@ int main(int argc, char **argv)
 		argc--; argv++;
 	}
 
+	pNets = new CNetServer[NumServers];
+	pRegistered = new bool[NumServers];
+	mem_zero(pRegistered, sizeof(bool)*NumServers);
+
 	BuildInfoMsg();
 	int RunReturn = Run();
 
-	delete pNet;
+	delete[] pNets;
+	delete[] pRegistered;
 	return RunReturn;
 }
 
@@ -1,9 +1,16 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
+enum
+{
+	NUM_THREADS=3,
+};
+
 int main(int argc, const char **argv)
 {
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
@@ -12,15 +19,21 @@ int main(int argc, const char **argv)
 	char aFileName[1024];
 	CDataFileReader DataFile;
 	CDataFileWriter df;
+	CJobPool Pool;
 
-	if(!pStorage || argc != 3)
+	if(!pStorage || (argc != 3 && argc != 4))
+	{
+		dbg_msg("map_resave", "usage: map_resave <source> <destination> [compression level 0-9]");
 		return -1;
+	}
 
 	str_format(aFileName, sizeof(aFileName), "%s", argv[2]);
+	int CompressionLevel = argc == 4 ? clamp(str_toint(argv[3]), 0, 9) : (int)CDataFileWriter::COMPRESSION_DEFAULT;
 
+	Pool.Init(NUM_THREADS);
 	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ALL))
 		return -1;
-	if(!df.Open(pStorage, aFileName))
+	if(!df.Open(pStorage, aFileName, &Pool, CompressionLevel))
 		return -1;
 
 	// add all items
@@ -31,15 +44,23 @@ int main(int argc, const char **argv)
 		df.AddItem(Type, ID, Size, pPtr);
 	}
 
-	// add all data
+	// add all data, decompressed up front, the writer keeps a copy of what it still compresses
+	{
+		int *pIndices = (int *)mem_alloc(max(DataFile.NumData(), 1)*sizeof(int), 1);
+		for(Index = 0; Index < DataFile.NumData(); Index++)
+			pIndices[Index] = Index;
+		DataFile.LoadData(pIndices, DataFile.NumData(), &Pool);
+		mem_free(pIndices);
+	}
+	DataFile.SetCacheSize(0);
 	for(Index = 0; Index < DataFile.NumData(); Index++)
 	{
 		pPtr = DataFile.GetData(Index);
-		Size = DataFile.GetDataSize(Index);
+		Size = DataFile.GetUncompressedDataSize(Index);
 		df.AddData(Size, pPtr);
+		DataFile.UnloadData(Index);
 	}
 
 	DataFile.Close();
-	df.Finish();
-	return 0;
+	return df.Finish() == 0 ? 0 : -1;
 }
@@ -1,8 +1,16 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
-enum { NUM_SOCKETS = 64 };
+enum
+{
+	NUM_SOCKETS = 64,
+
+	LOAD_PORT = 8399,
+	LOAD_BURST = 32,
+	LOAD_MAX_SIZE = 1400,
+};
 
 void Run(NETADDR Dest)
 {
@@ -28,8 +36,102 @@ void Run(NETADDR Dest)
 	}
 }
 
+// sends bursts of packets over the loopback device and receives them again,
+// once with a system call per packet and once with the batched calls
+static double RunLoad(NETSOCKET Sender, NETSOCKET Receiver, NETADDR Dest, int Size, int Seconds, bool Batched, int *pLost)
+{
+	static unsigned char s_aaData[LOAD_BURST][LOAD_MAX_SIZE];
+	NETDATAGRAM aSend[LOAD_BURST];
+	NETDATAGRAM aRecv[LOAD_BURST];
+	for(int i = 0; i < LOAD_BURST; i++)
+	{
+		aSend[i].addr = Dest;
+		aSend[i].data = s_aaData[i];
+		aSend[i].size = Size;
+	}
+
+	int64 Packets = 0;
+	int64 Sent = 0;
+	int64 Start = time_get();
+	int64 End = Start + time_freq()*Seconds;
+	int64 Now = Start;
+	while(Now < End)
+	{
+		if(Batched)
+			net_udp_send_batch(Sender, aSend, LOAD_BURST);
+		else
+		{
+			for(int i = 0; i < LOAD_BURST; i++)
+				net_udp_send(Sender, &Dest, s_aaData[i], Size);
+		}
+		Sent += LOAD_BURST;
+
+		// loopback packets are queued at the receiver by the time the send call returns
+		while(1)
+		{
+			int Received = 0;
+			if(Batched)
+			{
+				for(int i = 0; i < LOAD_BURST; i++)
+				{
+					aRecv[i].data = s_aaData[i];
+					aRecv[i].size = LOAD_MAX_SIZE;
+				}
+				Received = net_udp_recv_batch(Receiver, aRecv, LOAD_BURST);
+			}
+			else
+			{
+				NETADDR Addr;
+				Received = net_udp_recv(Receiver, &Addr, s_aaData[0], LOAD_MAX_SIZE) > 0 ? 1 : 0;
+			}
+			if(Received <= 0)
+				break;
+			Packets += Received;
+		}
+
+		Now = time_get();
+	}
+
+	*pLost = (int)(Sent-Packets);
+	return Packets/((Now-Start)/(double)time_freq());
+}
+
+static int Load(int Size, int Seconds)
+{
+	NETADDR BindAddr = {NETTYPE_IPV4, {127,0,0,1}, LOAD_PORT};
+	NETSOCKET Receiver = net_udp_create(BindAddr, 0);
+	BindAddr.port = 0;
+	NETSOCKET Sender = net_udp_create(BindAddr, 0);
+	if(Receiver.type == NETTYPE_INVALID || Sender.type == NETTYPE_INVALID)
+	{
+		dbg_msg("packetgen", "couldn't open the loopback sockets on port %d", LOAD_PORT);
+		return -1;
+	}
+
+	NETADDR Dest = {NETTYPE_IPV4, {127,0,0,1}, LOAD_PORT};
+	int Lost = 0;
+	double Single = RunLoad(Sender, Receiver, Dest, Size, Seconds, false, &Lost);
+	dbg_msg("packetgen", "single  %d byte packets: %10.0f packets/s (%d lost)", Size, Single, Lost);
+	double Batched = RunLoad(Sender, Receiver, Dest, Size, Seconds, true, &Lost);
+	dbg_msg("packetgen", "batched %d byte packets: %10.0f packets/s (%d lost), %.2fx", Size, Batched, Lost, Batched/Single);
+
+	net_udp_close(Sender);
+	net_udp_close(Receiver);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
+	// packetgen load [size] [seconds]: measures the packet throughput over the loopback device
+	if(argc > 1 && str_comp(argv[1], "load") == 0) // ignore_convention
+	{
+		dbg_logger_stdout();
+		net_init();
+		int Size = argc > 2 ? clamp(str_toint(argv[2]), 1, (int)LOAD_MAX_SIZE) : 64; // ignore_convention
+		int Seconds = argc > 3 ? max(str_toint(argv[3]), 1) : 3; // ignore_convention
+		return Load(Size, Seconds);
+	}
+
 	NETADDR Dest = {NETTYPE_IPV4, {127,0,0,1}, 8303};
 	Run(Dest);
 	return 0;